@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cache.hpp"
+#include "utils/log.hpp"
+
+// Cache hits from several threads at once, a single locked shard against
+// the sharded cache. Each thread looks up random cached names, as the
+// resolver workers do for clients answered from the cache.
+// Usage: dns-bench-cache [NAMES [LOOKUPS_PER_THREAD [MAX_THREADS]]]
+
+constexpr int ROUNDS = 3;
+
+static std::string Name(size_t i) {
+    return "host" + std::to_string(i) + ".bench.example";
+}
+
+// Lookups per second of threads hitting cache, best of ROUNDS
+static double Measure(TLRUCache& cache, const std::vector<cacheKey>& keys, size_t threads, size_t lookups) {
+    double best = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        std::atomic<size_t> ready = 0;
+        std::atomic<bool> go = false;
+        std::atomic<size_t> misses = 0;
+        std::vector<std::thread> workers;
+
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                uint64_t state = 88172645463325252ull + t * 0x9E3779B97F4A7C15ull;
+                ready++;
+                while (!go.load(std::memory_order_acquire)) {}
+
+                for (size_t i = 0; i < lookups; i++) {
+                    state ^= state << 13;
+                    state ^= state >> 7;
+                    state ^= state << 17;
+                    if (!cache.get(keys[state % keys.size()]).has_value()) {
+                        misses.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+            });
+        }
+        while (ready.load() < threads) {}
+
+        auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (misses.load() > 0) {
+            std::cerr << misses.load() << " lookups missed\n";
+        }
+        best = std::max(best, threads * lookups / seconds);
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    size_t names = argc > 1 ? std::stoul(argv[1]) : 50000;
+    size_t lookups = argc > 2 ? std::stoul(argv[2]) : 500000;
+    size_t maxThreads = argc > 3 ? std::stoul(argv[3]) : std::max(2u, std::thread::hardware_concurrency());
+
+    utils::Logger::get().config(TARGET_CONSOLE, utils::LogLevel::ERROR);
+
+    std::vector<cacheKey> keys;
+    keys.reserve(names);
+    for (size_t i = 0; i < names; i++) {
+        keys.push_back({Name(i), dnslib::TYPE::A});
+    }
+
+    // Room to spare, keys do not spread over the shards exactly evenly
+    TLRUCache single(names * 2, 1);
+    TLRUCache sharded(names * 2, TLRUCache::MAX_SHARDS);
+    for (auto* cache : {&single, &sharded}) {
+        for (size_t i = 0; i < names; i++) {
+            auto records = std::make_shared<std::vector<std::shared_ptr<dnslib::ResourceRecord>>>();
+            records->push_back(std::make_shared<dnslib::ARecord>(Name(i), 3600, static_cast<uint32_t>(0x0A000000 + i)));
+            cache->put(keys[i], records, 3600);
+        }
+    }
+
+    std::cout << names << " cached names, " << lookups << " lookups per thread, best of " << ROUNDS << " rounds, "
+              << sharded.shardCount() << " shards\n"
+              << std::setw(8) << "threads" << std::setw(16) << "1 shard/s" << std::setw(16) << "sharded/s"
+              << std::setw(10) << "speedup" << "\n";
+
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        double base = Measure(single, keys, threads, lookups);
+        double split = Measure(sharded, keys, threads, lookups);
+        std::cout << std::setw(8) << threads
+                  << std::setw(16) << static_cast<uint64_t>(base)
+                  << std::setw(16) << static_cast<uint64_t>(split)
+                  << std::setw(10) << std::fixed << std::setprecision(2) << split / base << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <malloc.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cache.hpp"
+#include "flatcache.hpp"
+#include "utils/log.hpp"
+
+// Heap bytes per entry and lookup latency of the list cache and the flat
+// CLOCK cache, both one shard and filled to capacity. All entries share
+// one record set, so only the cache structures and key names are counted.
+// Usage: dns-bench-flatcache [ENTRIES [LOOKUPS]]
+
+constexpr int ROUNDS = 3;
+
+static std::string Name(size_t i) {
+    return "host" + std::to_string(i) + ".bench.example";
+}
+
+// Large blocks such as the flat tables are mmap'ed, counted apart
+static size_t HeapInUse() {
+    auto info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+struct Result {
+    double bytesPerEntry = 0;
+    double hitNs = 0;
+    double missNs = 0;
+};
+
+// Nanoseconds per lookup of keys in a random order, best of ROUNDS
+template <typename Cache>
+static double Lookups(Cache& cache, const std::vector<cacheKey>& keys, size_t lookups, size_t& found) {
+    double best = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        uint64_t state = 88172645463325252ull;
+        found = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < lookups; i++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            found += cache.get(keys[state % keys.size()]).has_value() ? 1 : 0;
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lookups;
+        if (round == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+template <typename Cache>
+static Result Measure(const std::vector<cacheKey>& keys, const std::vector<cacheKey>& absent, size_t lookups) {
+    auto records = std::make_shared<std::vector<std::shared_ptr<dnslib::ResourceRecord>>>();
+    records->push_back(std::make_shared<dnslib::ARecord>("bench.example", 3600, 0x0A000001u));
+
+    Result result;
+    size_t before = HeapInUse();
+    auto cache = std::make_unique<Cache>(static_cast<int>(keys.size()), 1);
+    for (const auto& key : keys) {
+        cache->put(key, records, 3600);
+    }
+    result.bytesPerEntry = static_cast<double>(HeapInUse() - before) / keys.size();
+
+    size_t found = 0;
+    result.hitNs = Lookups(*cache, keys, lookups, found);
+    if (found != lookups) {
+        std::cerr << lookups - found << " of " << lookups << " lookups missed\n";
+    }
+    result.missNs = Lookups(*cache, absent, lookups, found);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    size_t entries = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    size_t lookups = argc > 2 ? std::stoul(argv[2]) : 2000000;
+
+    utils::Logger::get().config(TARGET_CONSOLE, utils::LogLevel::ERROR);
+
+    std::vector<cacheKey> keys;
+    std::vector<cacheKey> absent;
+    keys.reserve(entries);
+    absent.reserve(entries);
+    for (size_t i = 0; i < entries; i++) {
+        keys.push_back({Name(i), dnslib::TYPE::A});
+        absent.push_back({Name(i), dnslib::TYPE::MX});
+    }
+
+    std::cout << entries << " entries, " << lookups << " random lookups, best of " << ROUNDS << " rounds\n"
+              << std::setw(12) << "engine" << std::setw(14) << "bytes/entry" << std::setw(10) << "hit ns"
+              << std::setw(10) << "miss ns" << "\n";
+
+    auto print = [](const char* engine, const Result& result) {
+        std::cout << std::setw(12) << engine << std::fixed << std::setprecision(1)
+                  << std::setw(14) << result.bytesPerEntry
+                  << std::setw(10) << result.hitNs
+                  << std::setw(10) << result.missNs << "\n";
+    };
+    print("list+map", Measure<TLRUCache>(keys, absent, lookups));
+    print("flat clock", Measure<FlatCache>(keys, absent, lookups));
+    return 0;
+}
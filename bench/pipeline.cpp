@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "resolver.hpp"
+#include "utils/log.hpp"
+
+// Client queries answered from the cache, handled in batches of various
+// sizes through the resolver front path: queue pop, parse, lookup,
+// serialization and queueing of the answer. Size 1 is the query by query
+// pipeline. Usage: dns-bench-pipeline [NAMES [QUERIES]]
+
+constexpr int ROUNDS = 3;
+
+static uint64_t Cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static std::string Name(size_t i) {
+    return "host" + std::to_string(i) + ".bench.example";
+}
+
+int main(int argc, char** argv) {
+    size_t names = argc > 1 ? std::stoul(argv[1]) : 50000;
+    size_t queries = argc > 2 ? std::stoul(argv[2]) : 200000;
+
+    utils::Logger::get().config(TARGET_CONSOLE, utils::LogLevel::ERROR);
+
+    TLRUCache cache(names);
+    for (size_t i = 0; i < names; i++) {
+        auto records = std::make_shared<RecordList>();
+        records->push_back(std::make_shared<dnslib::ARecord>(Name(i), 3600, static_cast<uint32_t>(0x0A000000 + i)));
+        cache.put({Name(i), dnslib::TYPE::A}, records, 3600);
+    }
+
+    // Spread over the whole cache, as many clients asking for many names would
+    std::vector<dnslib::DNSMessageL> wire;
+    wire.reserve(queries);
+    uint64_t state = 88172645463325252ull;
+    for (size_t i = 0; i < queries; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        dnslib::PacketBuilder builder;
+        builder.setId(i & 0xFFFF);
+        builder.withFlags(dnslib::PacketFlag::RECURSION_DES);
+        builder.addQuestion(Name(state % names), dnslib::TYPE::A);
+
+        dnslib::DNSMessageL message{};
+        message.peerAddress.sin_family = AF_INET;
+        message.peerAddress.sin_port = htons(40000 + (i & 0xFF));
+        inet_pton(AF_INET, "192.0.2.1", &message.peerAddress.sin_addr);
+        builder.build().serialize(message.data);
+        wire.push_back(std::move(message));
+    }
+
+    ServerConfig config;
+    config.queryBudget = 0;
+    utils::Executor executor(1);
+    utils::ETSQueue<dnslib::DNSMessageL> in;
+    utils::ETSQueue<dnslib::DNSMessageL> out;
+    Resolver resolver(executor, cache, out, config);
+
+    std::cout << names << " cached names, " << queries << " queries, best of " << ROUNDS << " rounds\n"
+              << std::setw(6) << "batch" << std::setw(14) << "queries/s" << std::setw(10) << "ns/query"
+              << std::setw(14) << "cycles/query" << "\n";
+
+    for (size_t batchSize : {1, 4, 16, 32, 64, 256}) {
+        double bestSeconds = 0;
+        uint64_t bestCycles = 0;
+
+        for (int round = 0; round < ROUNDS; round++) {
+            for (const auto& message : wire) {
+                in.push(message);
+            }
+
+            std::vector<dnslib::DNSMessageL> batch;
+            batch.reserve(batchSize);
+            auto start = std::chrono::steady_clock::now();
+            uint64_t startCycles = Cycles();
+
+            while (in.popBatch(batch, batchSize, std::chrono::milliseconds(0)) > 0) {
+                resolver.handleBatch(batch);
+            }
+
+            uint64_t cycles = Cycles() - startCycles;
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if (out.size() != queries) {
+                std::cerr << "Expected " << queries << " answers, got " << out.size() << "\n";
+                return 1;
+            }
+            dnslib::DNSMessageL answer;
+            while (out.tryPop(answer)) {}
+            out.consumeEvent();
+
+            if (round == 0 || seconds < bestSeconds) {
+                bestSeconds = seconds;
+                bestCycles = cycles;
+            }
+        }
+
+        std::cout << std::setw(6) << batchSize
+                  << std::setw(14) << static_cast<uint64_t>(queries / bestSeconds)
+                  << std::setw(10) << std::fixed << std::setprecision(0) << bestSeconds * 1e9 / queries
+                  << std::setw(14) << bestCycles / queries << "\n";
+    }
+    return 0;
+}
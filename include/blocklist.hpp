@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Set of blocked domain names
+ *
+ * Rules are exact names (example.com) or whole subtrees (*.example.com,
+ * the name itself and everything below it). They are stored in a trie
+ * keyed by labels from the TLD down, with chains of single-child nodes
+ * merged into one edge and edge labels shared between nodes. A Bloom
+ * filter of every rule name answers most lookups for names that are not
+ * blocked without touching the trie.
+ *
+ * Immutable once built, so any number of threads can look names up.
+ */
+class Blocklist {
+public:
+    class Builder;
+
+private:
+    static constexpr uint8_t EXACT = 1;
+    static constexpr uint8_t SUBTREE = 2;
+
+    struct Node {
+        uint32_t edge;          // offset in labels: one or more labels, TLD side first, separated by '\0'
+        uint16_t edgeLength;
+        uint8_t flags;
+        uint8_t reserved;
+        uint32_t firstChild;    // children are contiguous, sorted by their first label
+        uint32_t childCount;
+    };
+
+    std::vector<Node> nodes;    // nodes[0] is the root
+    std::string labels;
+    std::vector<uint64_t> bloom;
+    uint32_t bloomBits = 0;
+    size_t exactRules = 0;
+    size_t subtreeRules = 0;
+
+    bool mayContain(const std::vector<std::string_view>& parts) const;
+    const Node* child(const Node& parent, std::string_view label) const;
+
+public:
+    /**
+     * @brief Whether name or one of its parent domains is blocked
+     *
+     * Case-insensitive, a trailing dot is ignored.
+     */
+    bool blocked(std::string_view name) const;
+
+    /**
+     * @brief Reads rules from list files
+     *
+     * One rule per line: a name, *.name for the whole subtree, or a hosts
+     * file line (0.0.0.0 name...). Text after '#' is a comment. Malformed
+     * names are skipped and counted.
+     *
+     * @throw std::runtime_error if a file cannot be read
+     */
+    static std::shared_ptr<const Blocklist> load(const std::vector<std::string>& files, size_t& skipped);
+
+    size_t size() const { return exactRules + subtreeRules; }
+    size_t exactCount() const { return exactRules; }
+    size_t subtreeCount() const { return subtreeRules; }
+    // Bytes held by the trie, its labels and the Bloom filter
+    size_t memoryUsage() const;
+};
+
+/**
+ * @brief Collects rules, then builds the immutable list
+ */
+class Blocklist::Builder {
+private:
+    // Labels TLD first, separated by '\0' so that a name sorts right before its subdomains
+    std::vector<std::pair<std::string, uint8_t>> rules;
+
+    void buildChildren(Blocklist& list, uint32_t node, size_t lo, size_t hi, size_t start, std::unordered_map<std::string, uint32_t>& interned);
+
+public:
+    /**
+     * @brief Adds an exact name or a *.name subtree rule
+     *
+     * @return false if the name is malformed
+     */
+    bool add(std::string_view rule);
+
+    std::shared_ptr<const Blocklist> build();
+};
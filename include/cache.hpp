@@ -10,6 +10,7 @@
 #include <vector>
 #include <mutex>
 #include "dns.hpp"
+#include "dnssec.hpp"
 
 struct cacheKey {
     std::string name;
@@ -30,12 +31,56 @@ struct hash<cacheKey> {
 }
 
 
+/**
+ * @brief Type under which NXDOMAIN is cached for a name
+ *
+ * Type 0 is reserved and never queried, so a NXDOMAIN entry can share the
+ * cache with the per-type NODATA and positive entries of the same name.
+ */
+constexpr dnslib::TYPE NXDOMAIN_TYPE = static_cast<dnslib::TYPE>(0);
+
+/**
+ * @brief How far cached data is trusted, by where it came from (RFC 2181 5.4.1)
+ *
+ * Fresh data is never replaced by data of a lower rank. Clients are only
+ * answered from ANSWER and above, glue just helps to find servers.
+ */
+enum class Trust : uint8_t {
+    GLUE,           // additional section of a referral
+    AUTHORITY,      // authority section, the SOA of a negative answer
+    ANSWER,         // answer section without the AA bit, as forwarders give it
+    AUTHORITATIVE,  // answer section of an authoritative answer
+};
+
+/**
+ * @brief Serialized response to a cached question, replayed on later hits
+ *
+ * Only the ID, the RD flag and the TTLs at ttlOffsets differ between
+ * clients, they are patched into a copy.
+ */
+struct WireAnswer {
+    std::vector<uint8_t> data;
+    std::vector<uint16_t> ttlOffsets;
+};
+
 struct CacheEntry {
     cacheKey key;
     //Tutaj zmiana - ResourceRecord jest abstrakcyjny i nie da się wywołać -> wskaźniki :)) 
     //std::shared_ptr<std::vector<dnslib::ResourceRecord>> value;
     std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>> value;
+    // Set only for negative entries (RFC 2308), which keep no value at all
+    std::shared_ptr<dnslib::ResourceRecord> soa;
     std::chrono::steady_clock::time_point expireTime;
+    // DNSSEC status found when the entry was stored, a hit never validates again
+    Security security = Security::UNCHECKED;
+    Trust trust = Trust::ANSWER;
+    // Response to the question of key made from this entry alone, set on its first hit
+    std::shared_ptr<const WireAnswer> wire;
+
+    // Popularity tracking for prefetch
+    std::chrono::steady_clock::time_point insertTime;
+    uint32_t hits = 0;
+    bool prefetchQueued = false;
 };
 
 
@@ -44,20 +89,66 @@ struct CacheEntry {
  * 
  * key - 
  * value - std::shared_ptr<ResourceRecord>
+ *
+ * Split into shards picked by key hash, each with its own lock, LRU list
+ * and share of the capacity, so resolutions on several workers rarely
+ * wait for each other. Recency and eviction are per shard.
  */
 class TLRUCache {
 
+public:
+    // Shards are not made smaller than this, small caches stay one exact LRU
+    static constexpr size_t MIN_SHARD_CAPACITY = 64;
+    static constexpr size_t MAX_SHARDS = 64;
+
 private:
-    int capacity;
-//   std::mutex mtx;
     using List = std::list<CacheEntry>;
 
-    List list;
-
-    std::unordered_map<cacheKey, List::iterator> cacheMap;
+    // Own cache line each, a shard's lock does not bounce its neighbours
+    struct alignas(64) Shard {
+        std::mutex mtx;
+        size_t capacity = 0;
+        List list;
+        std::unordered_map<cacheKey, List::iterator> cacheMap;
+
+        // Expired entries are kept this long for serve-stale (RFC 8767), every shard has a copy
+        std::chrono::seconds staleWindow{0};
+        unsigned prefetchWindow = 0;
+        double prefetchMinRate = 0;
+        std::vector<cacheKey> prefetchQueue;
+
+        // Returns the entry for key, fresh or stale, and marks it as most recently used, list.end() if none
+        List::iterator find(const cacheKey& key);
+        // Whether a fresh entry for key ranks above trust
+        bool outranked(const cacheKey& key, Trust trust, std::chrono::steady_clock::time_point now) const;
+        void insert(CacheEntry entry);
+        // Counts a hit and queues the entry for refresh once it is popular and close to expiry
+        void countHit(CacheEntry& entry);
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    size_t numShards = 1;
+    unsigned shardBits = 0;
+
+    Shard& shardOf(const cacheKey& key);
 
 public:
-    TLRUCache(int capacity) : capacity(capacity) {}
+    /**
+     * @param shards wanted number of shards, rounded up to a power of two;
+     *        0 takes one per hardware thread. Fewer are made if they would
+     *        hold less than MIN_SHARD_CAPACITY entries each.
+     */
+    explicit TLRUCache(int capacity, size_t shards = 0);
+
+    /**
+     * @brief Shard count for total entries, as the constructor takes it
+     *
+     * A power of two, at most MAX_SHARDS, and never so many that a shard
+     * would hold less than MIN_SHARD_CAPACITY entries.
+     */
+    static size_t shardsFor(size_t total, size_t wanted);
+
+    size_t shardCount() const { return numShards; }
 
     /* - zmiana ze względu na wcześniejszą zmianę w CacheEntry
     std::optional<std::shared_ptr<std::vector<dnslib::ResourceRecord>>> get(cacheKey key);
@@ -65,7 +156,87 @@ public:
     void put(cacheKey key, std::shared_ptr<std::vector<dnslib::ResourceRecord>> value, uint32_t TTL);
     */
 
-    std::optional<std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>>> get(cacheKey key);
-
-    void put(cacheKey key, std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>> value, uint32_t TTL);
+    /**
+     * @param security set to the DNSSEC status stored with the records, if not null
+     * @param minTrust records stored with a lower rank are not returned
+     * @param expires set to the expiry of the records, if not null
+     */
+    std::optional<std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>>> get(cacheKey key, Security* security = nullptr,
+                                                                                             Trust minTrust = Trust::ANSWER,
+                                                                                             std::chrono::steady_clock::time_point* expires = nullptr);
+
+    /**
+     * @return false if a fresh entry of a higher rank is kept instead
+     */
+    bool put(cacheKey key, std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>> value, uint32_t TTL,
+             Security security = Security::UNCHECKED, Trust trust = Trust::ANSWER);
+
+    /**
+     * @brief Looks up a negative entry
+     *
+     * NODATA is cached under the queried name and type, NXDOMAIN under
+     * the name and NXDOMAIN_TYPE. get() never returns negative entries.
+     *
+     * @return SOA record proving the negative answer
+     */
+    std::optional<std::shared_ptr<dnslib::ResourceRecord>> getNegative(cacheKey key, Security* security = nullptr,
+                                                                       std::chrono::steady_clock::time_point* expires = nullptr);
+
+    /**
+     * @brief Stores a negative entry, ranked as AUTHORITY data
+     *
+     * @return false if a fresh entry of a higher rank is kept instead
+     */
+    bool putNegative(cacheKey key, std::shared_ptr<dnslib::ResourceRecord> soa, uint32_t TTL, Security security = Security::UNCHECKED);
+
+    /**
+     * @brief Response stored with the fresh entry for key, positive or negative
+     *
+     * Counts as a hit like get(). Nothing if the entry has none yet.
+     *
+     * @param expires set to the expiry of the entry
+     */
+    std::shared_ptr<const WireAnswer> getWire(const cacheKey& key, std::chrono::steady_clock::time_point& expires);
+
+    /**
+     * @brief Stores wire with the entry for key, if it is still the one that expires then
+     *
+     * A put() for key replaces the entry and drops the response with it.
+     */
+    void attachWire(const cacheKey& key, std::chrono::steady_clock::time_point expires, std::shared_ptr<const WireAnswer> wire);
+
+    /**
+     * @brief Hashes keys and starts loading their hash buckets into the CPU cache
+     *
+     * Only a hint, meant for a batch of lookups: by the time get() is called
+     * for the first key the memory for the later ones is on its way.
+     */
+    void prefetch(const std::vector<cacheKey>& keys);
+
+    /**
+     * @brief Looks up records regardless of expiry, within the stale window
+     *
+     * Meant for serve-stale only, get() never returns expired records.
+     * Bogus records and glue are never served stale.
+     */
+    std::optional<std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>>> getStale(cacheKey key);
+
+    /**
+     * @brief Keeps expired entries for window longer, 0 drops them on expiry
+     */
+    void setStaleWindow(std::chrono::seconds window);
+
+    /**
+     * @brief Enables prefetching of popular entries
+     *
+     * An entry returned by get() within the last windowPercent of its TTL,
+     * and hit at least minHitsPerMinute times since it was stored, is queued
+     * for refresh once. The entry itself stays valid until it expires.
+     */
+    void setPrefetch(unsigned windowPercent, double minHitsPerMinute);
+
+    /**
+     * @brief Hands over keys queued for refresh since the last call
+     */
+    std::vector<cacheKey> takePrefetchCandidates();
 };
\ No newline at end of file
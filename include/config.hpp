@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <netinet/in.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Runtime configuration, filled from the command line
+ */
+struct ServerConfig {
+    bool daemon = false;
+
+    // Resolver worker threads, 0 for one per hardware thread
+    unsigned threads = 0;
+
+    // Entries hit within the last prefetchWindow percent of their TTL are
+    // refreshed in the background, if they are hit at least prefetchMinRate
+    // times per minute. A window of 0 disables prefetching.
+    unsigned prefetchWindow = 10;
+    double prefetchMinRate = 6;
+    // Upper bound on prefetch resolutions started per second
+    double prefetchLimit = 20;
+
+    // Serve-stale (RFC 8767): expired records are kept for staleWindow
+    // seconds and answered when a resolution takes longer than
+    // staleAnswerTimeout milliseconds or fails. A window of 0 disables it.
+    unsigned staleWindow = 86400;
+    unsigned staleAnswerTimeout = 1800;
+
+    // Forwarding mode: queries go to these recursive resolvers instead of
+    // being resolved iteratively from the root. A query is duplicated to a
+    // second upstream once the first one is slower than its hedgePercentile
+    // latency (0 disables hedging). Every upstream is probed each
+    // healthInterval seconds.
+    std::vector<sockaddr_in> forwarders;
+    double hedgePercentile = 90;
+    unsigned healthInterval = 5;
+
+    // Local root zone mirror (RFC 8806): root referrals are answered from
+    // this master file instead of the root servers. Reloaded on SIGHUP.
+    std::string rootZone;
+
+    // Zones answered authoritatively from an image built by dns-zonec,
+    // before the cache is looked at. Reloaded on SIGHUP.
+    std::string zoneImage;
+
+    // Names listed in these files, and the subtrees of *.name rules, are
+    // answered NXDOMAIN, or with the sinkhole address (host byte order) if
+    // one is set. Loaded in the background, reloaded on SIGHUP.
+    std::vector<std::string> blocklists;
+    std::optional<uint32_t> sinkhole;
+
+    // Iterative mode: queries outstanding to one nameserver at once, and
+    // queries per second sent to it. Queries over either limit wait for
+    // their turn, or go to another nameserver of the zone. 0 disables a limit.
+    unsigned nsMaxOutstanding = 64;
+    double nsQueryRate = 200;
+
+    // Iterative mode: a cache miss for A or AAAA also fetches the other
+    // type from the servers that answered, for clients whose share of
+    // A/AAAA queries coming in pairs is at least companionRatio.
+    bool companionFetch = false;
+    double companionRatio = 0.5;
+
+    // Response Rate Limiting: responses per second allowed per client /24
+    // and response kind, 0 disables it. Over the limit every rrlSlip-th
+    // response is sent truncated and the others dropped (0 drops all).
+    double rrlRate = 0;
+    unsigned rrlSlip = 2;
+
+    // Random-subdomain attack mitigation: once zoneGuardRatio of the
+    // answered upstream resolutions for a zone end in NXDOMAIN, only
+    // zoneGuardCap of them may run at once. The rest are denied if a cached
+    // NSEC range or NXDOMAIN ancestor proves it, else they fail and may be
+    // served stale. A cap of 0 disables it.
+    unsigned zoneGuardCap = 8;
+    double zoneGuardRatio = 0.8;
+
+    // Truncated upstream answers are asked again over TCP, on up to
+    // tcpConnections pooled connections per server, closed after
+    // tcpIdleTimeout seconds without queries.
+    unsigned tcpConnections = 2;
+    unsigned tcpIdleTimeout = 10;
+
+    // Milliseconds a client query may take from its receipt, about what
+    // stub resolvers wait. Past it the resolution is abandoned and the
+    // client gets SERVFAIL. 0 lets resolutions run to completion.
+    unsigned queryBudget = 4000;
+
+    // Client queries taken off the network queue at once. A batch goes
+    // through each stage (parse, cache lookup, serialization) before the
+    // next stage starts, 1 handles queries one by one.
+    unsigned batchSize = 32;
+
+    // DNSSEC validation: answers are checked against the root KSKs, or the
+    // DS records in trustAnchors if set. Bogus answers get SERVFAIL,
+    // secure ones the AD flag.
+    bool dnssec = false;
+    std::string trustAnchors;
+
+    // Aggressive negative caching (RFC 8198): with validation on, names and
+    // types in the gaps of cached NSEC/NSEC3 records are denied without
+    // asking upstream, up to nsecCacheSize records.
+    bool aggressiveNsec = true;
+    size_t nsecCacheSize = 100000;
+};
+
+/**
+ * @brief Parses command line arguments
+ *
+ * @throw std::invalid_argument on unknown options or malformed values
+ */
+ServerConfig parseArgs(int argc, char** argv);
+
+std::string usage(const std::string& program);
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dns.hpp"
+
+/**
+ * @brief DNSSEC status of an RRset or of a whole answer
+ *
+ * Ordered from the weakest: an answer is as strong as its weakest part.
+ */
+enum class Security : uint8_t {
+    BOGUS,          // signatures missing or wrong where the chain of trust requires them
+    UNCHECKED,      // validation is off
+    INSECURE,       // provably outside any signed zone, or not proven either way for negative answers
+    SECURE,         // signed, the chain of trust leads to a trust anchor
+};
+
+inline Security Weakest(Security a, Security b) {
+    return a < b ? a : b;
+}
+
+std::string to_string(Security security);
+
+/**
+ * @brief Records of one owner name and type, with the RRSIGs covering them
+ */
+struct SignedRRset {
+    std::vector<std::shared_ptr<dnslib::ResourceRecord>> records;
+    std::vector<std::shared_ptr<dnslib::ResourceRecord>> signatures;
+};
+
+/**
+ * @brief DNSSEC signature verification and the trusted key material
+ *
+ * Verifies RRSIGs (RSA/SHA-256 and SHA-512, ECDSA P-256 and P-384,
+ * Ed25519 and Ed448) over RRsets put in canonical form (RFC 4034, section
+ * 6), matches DNSKEYs against DS records and checks NSEC and NSEC3 denial
+ * of existence proofs. It fetches nothing: the resolver walks the chain of
+ * trust and stores what it validated here.
+ *
+ * Two caches, per zone, keep that chain short: the validated DNSKEY set of
+ * a zone, or the proof that it is unsigned, and what the parent said about
+ * each name asked for a DS, so a name is checked once per TTL.
+ */
+class Validator {
+public:
+    using Clock = std::chrono::steady_clock;
+    using RecordList = std::vector<std::shared_ptr<dnslib::ResourceRecord>>;
+
+    // NSEC3 hashes computed at most for this many iterations, zones above are insecure (RFC 9276)
+    static constexpr uint16_t MAX_NSEC3_ITERATIONS = 150;
+
+    // Keys trusted for a zone, none if the zone is provably unsigned
+    struct ZoneKeys {
+        bool secure = false;
+        RecordList keys;
+    };
+
+    // What the parent of a name says about it as a child zone
+    enum class Delegation {
+        SECURE,             // signed DS records, in ds
+        INSECURE,           // a delegation without DS, or a parent that is unsigned itself
+        NONE,               // not a zone cut, the name belongs to the parent zone
+    };
+
+    struct DelegationInfo {
+        Delegation kind = Delegation::NONE;
+        RecordList ds;
+    };
+
+private:
+    template <typename T>
+    struct Expiring {
+        T value;
+        Clock::time_point expires;
+    };
+
+    RecordList anchors;
+
+    mutable std::mutex mtx;
+    std::unordered_map<std::string, Expiring<ZoneKeys>> keyCache;
+    std::unordered_map<std::string, Expiring<DelegationInfo>> delegationCache;
+
+public:
+    /**
+     * @param anchors DS records of the trust anchors, usually the root KSKs
+     */
+    explicit Validator(RecordList anchors);
+
+    /**
+     * @brief DS records of the root zone KSKs published by IANA (key tags 20326 and 38696)
+     */
+    static RecordList rootAnchors();
+
+    /**
+     * @brief Reads DS records from a file in master file format
+     *
+     * One record per line: "name [ttl] [IN] DS keytag algorithm digesttype hexdigest".
+     * Empty lines and ';' comments are skipped.
+     *
+     * @throw std::runtime_error if the file cannot be read or a line is not a DS record
+     */
+    static RecordList loadAnchors(const std::string& path);
+
+    // DS records configured for zone, empty unless zone is a trust anchor
+    RecordList anchorsFor(const std::string& zone) const;
+
+    /**
+     * @brief Data an RRSIG signs: its own fields, then the RRset in canonical form
+     *
+     * Owner names and the names inside the RDATA of the RFC 4034 types are
+     * lowercased, the TTL is the original one, records are sorted by RDATA
+     * and duplicates dropped. A wildcard expansion is signed under the
+     * wildcard owner.
+     */
+    static std::vector<uint8_t> signedData(const dnslib::RRSIGRecord& signature, const RecordList& rrset);
+
+    /**
+     * @brief Checks the cryptographic signature alone, not its validity period
+     */
+    static bool verify(const dnslib::RRSIGRecord& signature, const RecordList& rrset, const dnslib::DNSKEYRecord& key);
+
+    // Whether now lies within the validity period of signature (serial number arithmetic)
+    static bool current(const dnslib::RRSIGRecord& signature, std::time_t now = std::time(nullptr));
+
+    /**
+     * @brief Splits a message section into RRsets, in order of appearance
+     *
+     * RRSIGs are attached to the RRset they cover, RRSIGs covering nothing
+     * in records are dropped.
+     */
+    static std::vector<SignedRRset> group(const RecordList& records);
+
+    /**
+     * @brief Validates rrset with keys already trusted
+     *
+     * @return SECURE if a current signature verifies with one of keys,
+     *         INSECURE if keys are those of an unsigned zone, BOGUS otherwise
+     */
+    static Security check(const SignedRRset& rrset, const ZoneKeys& keys);
+
+    // Whether ds holds the digest of key
+    static bool matches(const dnslib::DNSKEYRecord& key, const dnslib::DSRecord& ds);
+
+    static bool supportedAlgorithm(uint8_t algorithm);
+    static bool supportedDigest(uint8_t digestType);
+
+    /**
+     * @brief Validates a zone's DNSKEY RRset against the DS records for it
+     *
+     * A key matching one of ds has to sign the whole key set.
+     *
+     * @return the trusted keys, nothing if no usable signature chains them to ds
+     */
+    static std::optional<RecordList> validateKeySet(const RecordList& dnskeys, const RecordList& signatures, const RecordList& ds);
+
+    /**
+     * @brief NSEC3 hash of name (RFC 5155, section 5), SHA-1 only
+     */
+    static std::vector<uint8_t> nsec3Hash(const std::string& name, const std::vector<uint8_t>& salt, uint16_t iterations);
+
+    // Whether proofs use NSEC3 with more than MAX_NSEC3_ITERATIONS, such zones are treated as unsigned
+    static bool exceedsIterations(const RecordList& proofs);
+
+    /**
+     * @brief Checks that proofs deny type at name while the name itself exists
+     *
+     * @param proofs validated NSEC or NSEC3 records of the answer
+     */
+    static bool deniesType(const std::string& name, uint16_t type, const RecordList& proofs);
+
+    /**
+     * @brief Checks that proofs deny name and any wildcard that could have produced it
+     */
+    static bool deniesName(const std::string& name, const RecordList& proofs);
+
+    /**
+     * @brief Checks that proofs deny the exact name, for a wildcard answer that was synthesized for it
+     *
+     * @param labels label count of the RRSIG, that of the closest encloser
+     */
+    static bool deniesExactName(const std::string& name, uint8_t labels, const RecordList& proofs);
+
+    /**
+     * @brief Reads what a denial of DS at name tells about the zone cut
+     *
+     * @return INSECURE for a delegation without DS (or an opt-out span
+     *         covering it), NONE if name is no zone cut, nothing if the
+     *         proofs say neither
+     */
+    static std::optional<Delegation> delegationFromDenial(const std::string& name, const RecordList& proofs);
+
+    std::optional<ZoneKeys> keys(const std::string& zone, Clock::time_point now = Clock::now());
+    void storeKeys(const std::string& zone, ZoneKeys keys, uint32_t ttl, Clock::time_point now = Clock::now());
+
+    std::optional<DelegationInfo> delegation(const std::string& name, Clock::time_point now = Clock::now());
+    void storeDelegation(const std::string& name, DelegationInfo info, uint32_t ttl, Clock::time_point now = Clock::now());
+
+    std::string toString() const;
+};
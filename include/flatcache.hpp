@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "cache.hpp"
+
+/**
+ * @brief Cache engine with the interface of TLRUCache on flat tables
+ *
+ * Every shard keeps its entries in one dense array and finds them through
+ * an open-addressing table (linear probing, backward-shift deletion) of
+ * 32-bit buckets: an occupied bit and a 7-bit fingerprint of the hash
+ * above the 24-bit index of the entry. A probe reads 16 buckets per cache
+ * line and only compares the keys of entries whose fingerprint matches.
+ * A hit sets the entry's referenced flag and nothing else moves.
+ *
+ * Eviction is CLOCK over the dense array: the hand clears referenced
+ * flags and takes the first entry not used since its last pass. New
+ * entries start referenced, so they survive one sweep. Entries past their
+ * stale window are taken whatever their flag. The last entry moves into
+ * the freed place.
+ *
+ * All memory is allocated up front, the table is at most half full.
+ */
+class FlatCache {
+public:
+    static constexpr size_t MIN_SHARD_CAPACITY = TLRUCache::MIN_SHARD_CAPACITY;
+    static constexpr size_t MAX_SHARDS = TLRUCache::MAX_SHARDS;
+    // Entries a shard can index
+    static constexpr size_t MAX_SHARD_CAPACITY = (size_t(1) << 24) - 1;
+
+private:
+    static constexpr size_t NONE = SIZE_MAX;
+
+    struct Slot {
+        CacheEntry entry;
+        size_t hash = 0;
+        bool referenced = false;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mtx;
+        size_t capacity = 0;
+        size_t mask = 0;
+        size_t hand = 0;
+        std::vector<uint32_t> buckets;
+        std::vector<Slot> slots;
+
+        // Expired entries are kept this long for serve-stale (RFC 8767), every shard has a copy
+        std::chrono::seconds staleWindow{0};
+        unsigned prefetchWindow = 0;
+        double prefetchMinRate = 0;
+        std::vector<cacheKey> prefetchQueue;
+
+        // Slot of key, fresh or stale, NONE if none; entries past the stale window are dropped
+        size_t find(const cacheKey& key, size_t hash);
+        // Bucket pointing at slot
+        size_t bucketOf(size_t slot) const;
+        bool outranked(const cacheKey& key, size_t hash, Trust trust, std::chrono::steady_clock::time_point now);
+        void insert(CacheEntry entry, size_t hash);
+        void erase(size_t slot);
+        void evict(std::chrono::steady_clock::time_point now);
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    size_t numShards = 1;
+    unsigned shardBits = 0;
+
+    Shard& shardOf(size_t hash);
+
+public:
+    /**
+     * @param shards as for TLRUCache, more are made if a shard would index
+     *        over MAX_SHARD_CAPACITY entries
+     * @throw std::invalid_argument if even MAX_SHARDS shards cannot hold capacity
+     */
+    explicit FlatCache(int capacity, size_t shards = 0);
+
+    size_t shardCount() const { return numShards; }
+
+    // Bytes of the tables, without what the entries point to
+    size_t tableBytes() const;
+
+    // Same contracts as the TLRUCache methods of the same names
+    std::optional<std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>>> get(cacheKey key, Security* security = nullptr,
+                                                                                             Trust minTrust = Trust::ANSWER,
+                                                                                             std::chrono::steady_clock::time_point* expires = nullptr);
+    bool put(cacheKey key, std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>> value, uint32_t TTL,
+             Security security = Security::UNCHECKED, Trust trust = Trust::ANSWER);
+
+    std::optional<std::shared_ptr<dnslib::ResourceRecord>> getNegative(cacheKey key, Security* security = nullptr,
+                                                                       std::chrono::steady_clock::time_point* expires = nullptr);
+    bool putNegative(cacheKey key, std::shared_ptr<dnslib::ResourceRecord> soa, uint32_t TTL, Security security = Security::UNCHECKED);
+
+    std::shared_ptr<const WireAnswer> getWire(const cacheKey& key, std::chrono::steady_clock::time_point& expires);
+    void attachWire(const cacheKey& key, std::chrono::steady_clock::time_point expires, std::shared_ptr<const WireAnswer> wire);
+
+    void prefetch(const std::vector<cacheKey>& keys);
+    std::optional<std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>>> getStale(cacheKey key);
+
+    void setStaleWindow(std::chrono::seconds window);
+    void setPrefetch(unsigned windowPercent, double minHitsPerMinute);
+    std::vector<cacheKey> takePrefetchCandidates();
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dns.hpp"
+
+/**
+ * @brief Aggressive use of DNSSEC-validated NSEC and NSEC3 records (RFC 8198)
+ *
+ * Keeps the validated denial records of each signed zone in the order of
+ * the zone: NSEC by canonical owner name, NSEC3 by owner hash. A name in a
+ * proven gap gets a NXDOMAIN, a type missing from the bitmap of the name a
+ * NODATA, both without asking upstream, which is what random subdomain
+ * floods against signed zones need.
+ *
+ * Records expire with the shortest of their TTL and the SOA TTL and
+ * minimum (RFC 9077). Opt-out NSEC3 are not kept, their spans may hide
+ * unsigned delegations.
+ */
+class NsecCache {
+public:
+    using Clock = std::chrono::steady_clock;
+    using RecordList = std::vector<std::shared_ptr<dnslib::ResourceRecord>>;
+
+    // Answer proven by the cached records
+    struct Denial {
+        dnslib::RCODE rcode = dnslib::RCODE::NAMEERROR;
+        std::shared_ptr<dnslib::ResourceRecord> soa;
+    };
+
+private:
+    struct Entry {
+        std::shared_ptr<dnslib::ResourceRecord> record;
+        Clock::time_point expires;
+    };
+
+    struct Zone {
+        std::shared_ptr<dnslib::ResourceRecord> soa;
+        Clock::time_point soaExpires;
+        std::map<std::string, Entry> nsec;      // by canonical key of the owner
+        std::map<std::string, Entry> nsec3;     // by owner hash, base32hex keeps the order
+        std::vector<uint8_t> salt;              // NSEC3 parameters of the records in nsec3
+        uint16_t iterations = 0;
+    };
+
+    mutable std::mutex mtx;
+    std::unordered_map<std::string, Zone> zones;
+    size_t capacity;
+    uint32_t maxTtl;
+    size_t records = 0;
+
+    void insert(std::map<std::string, Entry>& ranges, std::string key, Entry entry);
+    void erase(const std::string& zone);
+    void prune(const std::string& keep, Clock::time_point now);
+
+public:
+    /**
+     * @param capacity NSEC and NSEC3 records kept over all zones
+     * @param maxTtl upper bound on the time a record is used
+     */
+    NsecCache(size_t capacity, uint32_t maxTtl) : capacity(capacity), maxTtl(maxTtl) {}
+
+    /**
+     * @brief Keeps the denial records of a negative answer
+     *
+     * @param authority authority section of a NXDOMAIN or NODATA answer whose
+     *        SOA, NSEC and NSEC3 RRsets all validated as secure
+     */
+    void store(const RecordList& authority, Clock::time_point now = Clock::now());
+
+    /**
+     * @brief Answers for name and type from the cached ranges alone
+     *
+     * @return the denial if the records of the closest enclosing zone prove
+     *         one, nothing if the name may exist or nothing is known
+     */
+    std::optional<Denial> lookup(const std::string& name, dnslib::TYPE type, Clock::time_point now = Clock::now());
+
+    size_t size() const;
+
+    std::string toString() const;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Per-nameserver latency and health statistics
+ *
+ * Tracks a smoothed RTT (RFC 6298 style SRTT/RTTVAR) and timeout counts
+ * for every upstream address the resolver talks to. Statistics decay while
+ * a server is not used, so a slow or failed server is eventually retried.
+ * Servers that keep timing out are put in an exponential back-off.
+ * At most maxServers addresses are tracked, the longest unused ones make
+ * room for new ones.
+ *
+ * Addresses are IPv4 in host byte order, as returned by ARecord::getIpAddress().
+ */
+class NameserverStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Probability of picking a random candidate instead of the fastest one
+    static constexpr double EXPLORE_RATE = 0.05;
+    // Consecutive timeouts before a server is backed off
+    static constexpr int BACKOFF_THRESHOLD = 3;
+    static constexpr size_t MAX_SERVERS = 4096;
+
+private:
+    struct Entry {
+        double srtt = 0;            // ms
+        double rttvar = 0;          // ms
+        uint32_t samples = 0;
+        double timeouts = 0;        // decayed timeout count
+        int consecutiveTimeouts = 0;
+        Clock::time_point updated;
+        Clock::time_point backoffUntil;
+    };
+
+    mutable std::mutex mtx;
+    std::unordered_map<uint32_t, Entry> servers;
+    size_t maxServers;
+    double exploreRate;
+    std::mt19937 rng{std::random_device{}()};
+
+    // Applies time decay to entry, as of now
+    void decay(Entry& entry, Clock::time_point now);
+    double score(uint32_t address, Clock::time_point now);
+    // Entry of address, made if there is none, evicting if the table is full
+    Entry& entryFor(uint32_t address, Clock::time_point now);
+
+public:
+    explicit NameserverStats(size_t maxServers = MAX_SERVERS, double exploreRate = EXPLORE_RATE);
+
+    /**
+     * @brief Records a successful exchange with the server
+     *
+     * @param address server IPv4 address
+     * @param rtt measured round trip time
+     */
+    void recordRtt(uint32_t address, std::chrono::microseconds rtt, Clock::time_point now = Clock::now());
+
+    /**
+     * @brief Records a query to the server that was never answered
+     */
+    void recordTimeout(uint32_t address, Clock::time_point now = Clock::now());
+
+    /**
+     * @brief Picks the server to query among candidates
+     *
+     * Prefers the lowest SRTT, skipping servers in back-off unless every
+     * candidate is. Occasionally picks a random candidate to refresh
+     * statistics of servers that are not the current favourite.
+     *
+     * @return chosen address, candidates must not be empty
+     */
+    uint32_t select(const std::vector<uint32_t>& candidates, Clock::time_point now = Clock::now());
+
+    /**
+     * @brief Retransmission timeout for a query to the server
+     */
+    std::chrono::milliseconds timeout(uint32_t address);
+
+    size_t size() const;
+
+    std::string toString() const;
+};
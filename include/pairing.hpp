@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "dns.hpp"
+
+/**
+ * @brief Per-client rate of A and AAAA queries that come in pairs
+ *
+ * Dual-stack stubs ask A and AAAA for a name back to back. Keeps, per
+ * client address, the last few A/AAAA questions and decayed counts of such
+ * queries and of those that completed a pair, so the resolver only fetches
+ * the sibling type ahead of time for clients that will ask for it.
+ *
+ * Addresses are IPv4 in host byte order.
+ */
+class PairingTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Clients tracked before idle ones are forgotten
+    static constexpr size_t MAX_CLIENTS = 100000;
+    // Questions of a client remembered to spot the second half of a pair
+    static constexpr size_t RECENT = 4;
+
+private:
+    struct Question {
+        std::string name;
+        dnslib::TYPE type = dnslib::TYPE::A;
+        Clock::time_point at;
+        bool paired = false;
+    };
+
+    struct Client {
+        double queries = 0;         // decayed A/AAAA queries
+        double paired = 0;          // decayed queries that were half of a pair
+        Clock::time_point updated;
+        std::array<Question, RECENT> recent;
+        size_t next = 0;
+    };
+
+    mutable std::mutex mtx;
+    std::unordered_map<uint32_t, Client> clients;
+    double ratio;
+
+    void decay(Client& client, Clock::time_point now);
+    void prune(Clock::time_point now);
+
+public:
+    /**
+     * @param ratio share of paired queries from which a client gets sibling fetches
+     */
+    explicit PairingTracker(double ratio) : ratio(ratio) {}
+
+    /**
+     * @brief Records an A or AAAA question of the client
+     *
+     * @return true if the client will probably ask the sibling type of name
+     *         next, false for other types and for the second half of a pair
+     */
+    bool observe(uint32_t client, const std::string& name, dnslib::TYPE type, Clock::time_point now = Clock::now());
+
+    // Estimated share of the client's A/AAAA queries that come in pairs
+    double rate(uint32_t client) const;
+
+    std::string toString() const;
+};
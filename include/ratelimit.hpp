@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <netinet/in.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Response Rate Limiting against reflection floods
+ *
+ * Every client response is charged to a token bucket keyed by the client
+ * /24 prefix and the kind of response (answer, NODATA, NXDOMAIN, error),
+ * so a spoofed flood towards one victim network runs dry quickly while
+ * other clients are unaffected. Over the limit, one response in `slip` is
+ * replaced by a small truncated one, letting a real client retry over TCP,
+ * and the others are dropped.
+ *
+ * The table has a fixed size: sharded, each shard a small set-associative
+ * array where the least recently used entry of a set makes room.
+ */
+class ResponseRateLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Action { SEND, SLIP, DROP };
+
+    static constexpr size_t SHARDS = 16;
+    static constexpr size_t WAYS = 4;
+
+private:
+    struct Entry {
+        uint64_t key = 0;               // 0 for a free slot
+        double tokens = 0;
+        Clock::time_point last;
+        uint32_t limited = 0;           // responses refused since the bucket ran dry
+    };
+
+    struct alignas(64) Shard {
+        mutable std::mutex mtx;
+        std::vector<Entry> entries;
+    };
+
+    double rate;
+    double burst;
+    unsigned slip;
+    size_t setsPerShard;
+    std::array<Shard, SHARDS> shards;
+
+public:
+    /**
+     * @param rate responses per second allowed per prefix and kind, also the burst (at least 1)
+     * @param slip every slip-th refused response is truncated instead of dropped, 0 drops all
+     * @param capacity tracked prefix and kind pairs, rounded up to a multiple of SHARDS * WAYS
+     */
+    ResponseRateLimiter(double rate, unsigned slip, size_t capacity = 65536);
+
+    /**
+     * @brief Charges response to the client and tells what to do with it
+     */
+    Action check(const sockaddr_in& client, const std::vector<uint8_t>& response, Clock::time_point now = Clock::now());
+
+    /**
+     * @brief Header and question of response with TC set and no records
+     */
+    static std::vector<uint8_t> truncate(const std::vector<uint8_t>& response);
+
+    // Prefix and kind pairs refused within the last second
+    size_t limitedCount(Clock::time_point now = Clock::now()) const;
+
+    std::string toString() const;
+};
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "dns.hpp"
+#include "message/DNSMessage.hpp"
+#include "message/DNSPacket.hpp"
+#include "cache.hpp"
+#include "blocklist.hpp"
+#include "config.hpp"
+#include "dnssec.hpp"
+#include "nseccache.hpp"
+#include "nsstats.hpp"
+#include "pairing.hpp"
+#include "ratelimit.hpp"
+#include "rootzone.hpp"
+#include "throttle.hpp"
+#include "zoneguard.hpp"
+#include "zoneimage.hpp"
+#include "transaction.hpp"
+#include "upstream.hpp"
+#include "utils/etsqueue.hpp"
+#include "utils/executor.hpp"
+#include "utils/task.hpp"
+#include "utils/tokenbucket.hpp"
+
+using RecordList = std::vector<std::shared_ptr<dnslib::ResourceRecord>>;
+
+/**
+ * @brief Outcome of resolving a name
+ */
+struct Resolution {
+    bool failed = false;                // no usable answer, the client gets SERVFAIL
+    dnslib::RCODE rcode = dnslib::RCODE::NOERROR;
+    RecordList chain;                   // CNAME links from the asked name to the final one
+    RecordList records;                 // records of the asked type owned by the final name
+    RecordList authority;               // proof of a negative answer
+    Security security = Security::UNCHECKED;
+    // First expiry of the cache entries it was read from, max if it was not
+    std::chrono::steady_clock::time_point expires = std::chrono::steady_clock::time_point::max();
+};
+
+/**
+ * @brief Servers known to hold the zone of a name, found by an earlier walk
+ */
+struct Delegation {
+    std::string name;
+    std::string zone;                   // bailiwick of the servers
+    std::vector<uint32_t> servers;
+};
+
+struct CompanionFetch;
+
+/**
+ * @brief Why a resolution runs, inherited by its sub-resolutions
+ */
+struct QueryContext {
+    bool prefetch = false;              // background refresh of a cache entry, nobody waits for it
+    int depth = 0;                      // nesting of glue-less NS address sub-resolutions
+    // Past it the client has given up, upstream work stops
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    // Where the walk for delegation->name starts instead of the root
+    std::shared_ptr<const Delegation> delegation;
+    // Sibling A/AAAA fetch to start once the servers of the name are found
+    std::shared_ptr<CompanionFetch> companion;
+};
+
+/**
+ * @brief Recursive resolver
+ *
+ * Every client query becomes a coroutine on the executor. It awaits upstream
+ * answers and timers, so a suspended resolution costs only its frame.
+ * Iterates from the root, or forwards to the configured upstreams.
+ */
+class Resolver {
+private:
+    struct ClientSlot;
+
+    utils::Executor& executor;
+    TLRUCache& cache;
+    utils::ETSQueue<dnslib::DNSMessageL>& outputQueue;
+    ServerConfig config;
+    sockaddr_in rootAddr{};
+
+    NameserverStats nsStats;
+    std::unique_ptr<UpstreamPool> upstreams;    // set in forwarding mode
+    std::unique_ptr<ServerThrottle> throttle;   // set if queries per nameserver are limited
+    std::unique_ptr<ResponseRateLimiter> rrl;   // set if client responses are rate limited
+    std::unique_ptr<ZoneGuard> zoneGuard;       // set if random subdomain attacks are mitigated
+    std::unique_ptr<Validator> validator;       // set if answers are validated with DNSSEC
+    std::unique_ptr<NsecCache> nsecCache;       // set if validated NSEC/NSEC3 records deny names (RFC 8198)
+    std::unique_ptr<PairingTracker> pairing;    // set if A/AAAA siblings are fetched ahead of the client
+    TransactionTable transactions;
+    std::unique_ptr<TcpPool> tcpPool;           // answers are delivered like UDP ones
+    // Local root zone copy, swapped as a whole on reload, empty if none is loaded
+    std::atomic<std::shared_ptr<const RootZone>> rootZone;
+    // Local authoritative zones, swapped the same way
+    std::atomic<std::shared_ptr<const ZoneImage>> localZones;
+    // Names refused before anything else is looked at
+    std::atomic<std::shared_ptr<const Blocklist>> blocklist;
+
+    std::mutex prefetchMtx;
+    std::unordered_set<cacheKey> prefetchInflight;
+    utils::TokenBucket prefetchBudget;
+
+    // Sibling fetches started and not done yet, by the question they answer
+    std::mutex companionMtx;
+    std::unordered_map<cacheKey, std::shared_ptr<CompanionFetch>> companions;
+
+    // Coroutines sleeping for long (probes, serve-stale timers) check it when they wake up
+    std::shared_ptr<std::atomic<bool>> alive;
+
+    // Client for a parsed query, nullptr if it has no question or is past its deadline already
+    std::shared_ptr<ClientSlot> acceptQuery(const dnslib::DNSMessageL& message, const dnslib::DNSPacket& packet);
+    // Answers clients from the blocklist, local zones and cache, the others get a resolution
+    void serveClients(std::vector<std::shared_ptr<ClientSlot>>& clients);
+    void deliverResponse(const dnslib::DNSMessageL& message, dnslib::DNSPacket packet);
+    // Resolution of a client query the cache could not answer
+    utils::Task<void> serveClient(std::shared_ptr<ClientSlot> client);
+    utils::Task<void> answerStale(std::shared_ptr<ClientSlot> client, std::vector<uint8_t> response);
+
+    // One upstream exchange for name, iterative from the root or forwarded
+    utils::Task<std::optional<UpstreamReply>> lookup(std::string name, dnslib::TYPE type, QueryContext context);
+    utils::Task<std::optional<UpstreamReply>> iterate(std::string name, dnslib::TYPE type, QueryContext context);
+    utils::Task<std::optional<UpstreamReply>> askServers(std::vector<uint32_t> candidates, std::string name, dnslib::TYPE type, QueryContext context);
+    utils::Task<std::optional<UpstreamReply>> askUpstreams(std::string name, dnslib::TYPE type, QueryContext context);
+    utils::Task<UpstreamReply> retryOverTcp(Transaction& transaction, UpstreamReply truncated, std::string name, dnslib::TYPE type, bool recursionDesired, QueryContext context);
+    utils::Task<std::optional<uint32_t>> resolveAddress(std::string name, QueryContext context);
+    std::optional<UpstreamReply> askRootZone(const std::string& name, dnslib::TYPE type);
+
+    // DNSSEC validation, the chain of trust is fetched with lookup() as needed
+    utils::Task<std::vector<Security>> validateRRsets(std::vector<SignedRRset> rrsets, RecordList authority, QueryContext context);
+    utils::Task<Security> validateRRset(SignedRRset rrset, RecordList authority, QueryContext context);
+    utils::Task<Security> validateDenial(std::string name, dnslib::TYPE type, dnslib::RCODE rcode, RecordList authority, QueryContext context);
+    // Validated NSEC and NSEC3 records of an authority section
+    utils::Task<RecordList> provenDenials(RecordList authority, QueryContext context);
+    // Trusted keys of zone, nothing if they cannot be validated
+    utils::Task<std::optional<Validator::ZoneKeys>> zoneKeys(std::string zone, QueryContext context);
+    // What the parent zone of name says about name as a zone cut
+    utils::Task<std::optional<Validator::DelegationInfo>> delegationOf(std::string name, QueryContext context);
+    // Closest zone at or above name, walked down from the trust anchors, with its keys
+    utils::Task<std::optional<std::pair<std::string, Validator::ZoneKeys>>> enclosingZone(std::string name, QueryContext context);
+
+    // Sibling A/AAAA fetch for a client likely to ask for it, nullptr if it is cached or being fetched
+    std::shared_ptr<CompanionFetch> startCompanion(const std::string& name, dnslib::TYPE type);
+    std::shared_ptr<CompanionFetch> findCompanion(const cacheKey& key);
+    // Starts the fetch of context, if any, at the servers of zone that answered name
+    void launchCompanion(const QueryContext& context, const std::string& name, dnslib::TYPE type, const std::string& zone, const std::vector<uint32_t>& servers);
+    utils::Task<void> fetchCompanion(std::shared_ptr<CompanionFetch> companion, std::shared_ptr<const Delegation> delegation, std::chrono::steady_clock::time_point deadline);
+    // Wakes up the clients waiting for the fetch
+    void finishCompanion(const std::shared_ptr<CompanionFetch>& companion);
+
+    void startPrefetches();
+    utils::Task<void> prefetch(cacheKey key);
+    utils::Task<void> probeUpstream(size_t upstream);
+
+    void send(const sockaddr_in& address, std::vector<uint8_t> data);
+    // Applies response rate limiting, false if the response is to be dropped
+    bool limitResponse(const sockaddr_in& address, std::vector<uint8_t>& data);
+    void loadRootZone();
+    void loadLocalZones();
+    utils::Task<void> loadBlocklists();
+
+public:
+    Resolver(utils::Executor& executor, TLRUCache& cache, utils::ETSQueue<dnslib::DNSMessageL>& outputQueue, const ServerConfig& config);
+    ~Resolver();
+
+    Resolver(const Resolver&) = delete;
+    Resolver& operator=(const Resolver&) = delete;
+
+    /**
+     * @brief Entry point for every message read from the network
+     *
+     * Client queries start a resolution, upstream answers resume the one
+     * waiting for them.
+     *
+     * @throw std::exception if the message cannot be parsed
+     */
+    void handleMessage(dnslib::DNSMessageL message);
+
+    /**
+     * @brief Handles messages stage by stage instead of one after another
+     *
+     * All are parsed first, then the cache keys of the client queries are
+     * hashed and prefetched, then everything is looked up, and last the
+     * answers are serialized and queued together. Each stage runs over the
+     * whole batch with its code and data still hot. Queries the cache
+     * cannot answer become resolutions as in handleMessage(). Messages
+     * that cannot be parsed are logged and skipped. Empties messages.
+     */
+    void handleBatch(std::vector<dnslib::DNSMessageL>& messages);
+
+    /**
+     * @brief Resolves name, following CNAMEs, from the cache when possible
+     */
+    utils::Task<Resolution> resolve(std::string name, dnslib::TYPE type, QueryContext context);
+
+    /**
+     * @brief Reads the root zone file, the zone image and the blocklists again and swaps them in
+     *
+     * Resolutions in flight keep the copies they started with. If a file
+     * is invalid its current copy stays.
+     */
+    utils::Task<void> reload();
+};
+
+// Async-signal-safe, the resolver worker picks the request up
+void requestReload();
+
+void resolverWorker(
+    utils::ETSQueue<dnslib::DNSMessageL>& inputQueue,
+    utils::ETSQueue<dnslib::DNSMessageL>& outputQueue,
+    TLRUCache& dnsCache,
+    const ServerConfig& config
+);
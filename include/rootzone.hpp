@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dns.hpp"
+#include "message/DNSPacket.hpp"
+
+/**
+ * @brief Local copy of the root zone (RFC 8806)
+ *
+ * Loaded from a master file such as https://www.internic.net/domain/root.zone,
+ * it answers what a root server would: referrals to the TLD servers and
+ * NXDOMAIN for names under undelegated TLDs. Only the SOA, NS and A records
+ * are kept, everything else in the file is skipped.
+ *
+ * A loaded zone is immutable, reloading builds a new one, so any number of
+ * resolutions can share it.
+ */
+class RootZone {
+public:
+    using RecordList = std::vector<std::shared_ptr<dnslib::ResourceRecord>>;
+
+private:
+    std::shared_ptr<dnslib::SOARecord> soa;
+    RecordList apexNs;
+    std::unordered_map<std::string, RecordList> delegations;   // TLD -> its NS records
+    std::unordered_map<std::string, RecordList> glue;          // NS name -> its A records
+    std::chrono::system_clock::time_point expiresAt;
+
+    void addGlue(dnslib::PacketBuilder& builder, const RecordList& nsRecords) const;
+
+public:
+    /**
+     * @brief Reads and validates a root zone master file
+     *
+     * The zone must have a SOA and NS records at the apex, delegate at least one
+     * TLD and hold nothing deeper than the TLDs except glue.
+     * It is usable until the SOA expire interval after the file was last modified.
+     *
+     * @throw std::runtime_error if the file cannot be read or is not a valid root zone
+     */
+    static std::shared_ptr<const RootZone> load(const std::string& path);
+
+    /**
+     * @brief Answer of a root server for name
+     *
+     * @return nothing for questions the copy cannot answer (DS and the like),
+     *         they go to the network
+     */
+    std::optional<dnslib::DNSPacket> answer(const std::string& name, dnslib::TYPE type) const;
+
+    bool expired() const { return std::chrono::system_clock::now() > expiresAt; }
+
+    uint32_t serial() const { return soa->getSerial(); }
+    size_t tldCount() const { return delegations.size(); }
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "dns.hpp"
+#include "message/DNSMessage.hpp"
+
+/**
+ * @brief Persistent TCP connections to upstream servers
+ *
+ * Queries are pipelined (RFC 7766): several may be in flight on one
+ * connection, answers come back in any order and are matched by their ID.
+ * A server gets up to maxPerServer connections, new queries go to the
+ * least busy one. Connections without queries are closed after
+ * idleTimeout. A query is forgotten once its deadline passes, and a
+ * connection left with nothing but such queries is closed: its server
+ * stopped answering. If a server closes a connection with queries still
+ * unanswered, they are sent again once on a new one, before their deadline.
+ *
+ * A thread of its own runs the sockets. Answers are handed to the deliver
+ * callback, from that thread.
+ */
+class TcpPool {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Deliver = std::function<void(dnslib::DNSMessageL)>;
+
+    // Queries in flight on a connection before another one is opened
+    static constexpr size_t MAX_PIPELINE = 16;
+
+private:
+    struct Query {
+        std::vector<uint8_t> data;
+        Clock::time_point deadline;                     // nobody waits for the answer after it
+        int attempts = 0;
+    };
+
+    struct Connection {
+        int fd = -1;
+        sockaddr_in server{};
+        bool connected = false;
+        std::vector<uint8_t> out;                       // length-prefixed queries not written yet
+        std::vector<uint8_t> in;
+        std::unordered_map<uint16_t, Query> pending;    // by DNS ID, kept until answered or expired
+        Clock::time_point lastUsed;
+    };
+
+    Deliver deliver;
+    size_t maxPerServer;
+    Clock::duration idleTimeout;
+
+    int epollFd = -1;
+    int wakeFd = -1;
+
+    std::mutex mtx;
+    std::vector<std::pair<sockaddr_in, Query>> submitted;
+    bool stopping = false;
+
+    // Owned by the pool thread
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::atomic<size_t> openConnections{0};
+
+    std::thread thread;
+
+    void run();
+    void dispatch(const sockaddr_in& server, Query query);
+    Connection* open(const sockaddr_in& server);
+    void handle(Connection& connection, uint32_t events);
+    void flush(Connection& connection);
+    void fail(Connection& connection);
+    void closeIdle(Clock::time_point now);
+
+public:
+    /**
+     * @throw std::runtime_error if the event loop cannot be set up
+     */
+    TcpPool(Deliver deliver, size_t maxPerServer, std::chrono::seconds idleTimeout);
+    ~TcpPool();
+
+    TcpPool(const TcpPool&) = delete;
+    TcpPool& operator=(const TcpPool&) = delete;
+
+    /**
+     * @brief Queues a DNS query (without the TCP length prefix) for server
+     *
+     * Thread-safe.
+     * @param deadline when the sender stops waiting, the query is dropped then
+     */
+    void send(const sockaddr_in& server, std::vector<uint8_t> query, Clock::time_point deadline);
+
+    size_t connectionCount() const { return openConnections.load(); }
+};
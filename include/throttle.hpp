@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "utils/executor.hpp"
+#include "utils/tokenbucket.hpp"
+
+/**
+ * @brief Outbound limits per authoritative server
+ *
+ * Caps the queries outstanding to each nameserver and the rate they are
+ * sent at, with a token bucket per server. A query over either limit waits
+ * in a FIFO queue of its server and goes out in turn as answers come back
+ * or tokens refill, so a busy resolver does not get itself rate limited by
+ * large authoritatives. Other servers are not held up.
+ *
+ * Addresses are IPv4 in host byte order, as for NameserverStats.
+ */
+class ServerThrottle {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Servers tracked before idle ones are forgotten
+    static constexpr size_t MAX_SERVERS = 10000;
+
+private:
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        bool* granted;                  // in the awaiter, set before the handle is resumed
+        Clock::time_point queued;
+        bool done = false;              // granted or expired, skipped if still in the queue
+    };
+
+    struct Server {
+        std::mutex mtx;
+        unsigned maxOutstanding = 0;
+        unsigned outstanding = 0;
+        std::optional<utils::TokenBucket> bucket;
+        std::deque<std::shared_ptr<Waiter>> queue;
+        size_t waiting = 0;             // queue entries not done
+        bool timerArmed = false;        // a dispatch is due when the next token is there
+
+        uint64_t delayed = 0;           // queries that had to wait and went out
+        uint64_t expired = 0;           // queries that waited past their deadline
+        double delayAvg = 0;            // ms, smoothed like an SRTT
+        double delayMax = 0;            // ms
+    };
+
+    utils::Executor& executor;
+    unsigned maxOutstanding;
+    double rate;
+
+    mutable std::mutex mtx;
+    std::unordered_map<uint32_t, std::shared_ptr<Server>> servers;
+
+    std::shared_ptr<Server> find(uint32_t address, bool create);
+    bool enqueue(uint32_t address, Clock::time_point deadline, std::coroutine_handle<> handle, bool* granted);
+    // Timers only hold the server and the executor, they may fire after the throttle is gone
+    static bool admit(Server& server);
+    // Grants the queries at the head of the queue that fit, the server lock held
+    static void dispatch(const std::shared_ptr<Server>& server, utils::Executor& executor);
+
+public:
+    /**
+     * @param maxOutstanding queries in flight per server, 0 for no cap
+     * @param rate queries per second per server, with a burst of as many, 0 for no limit
+     */
+    ServerThrottle(utils::Executor& executor, unsigned maxOutstanding, double rate)
+        : executor(executor), maxOutstanding(maxOutstanding), rate(rate) {}
+
+    /**
+     * @brief co_await throttle.acquire(address, deadline) waits for a slot to query the server
+     *
+     * @return true once the query may be sent, it has to be followed by
+     *         release(); false if the deadline passed first
+     */
+    auto acquire(uint32_t address, Clock::time_point deadline) {
+        struct Awaiter {
+            ServerThrottle& throttle;
+            uint32_t address;
+            Clock::time_point deadline;
+            bool granted = false;
+
+            bool await_ready() { return false; }
+            bool await_suspend(std::coroutine_handle<> handle) {
+                return throttle.enqueue(address, deadline, handle, &granted);
+            }
+            bool await_resume() { return granted; }
+        };
+        return Awaiter{*this, address, deadline};
+    }
+
+    // The query answered or timed out, the next one queued for the server may go
+    void release(uint32_t address);
+
+    // Queries waiting for the server
+    size_t queued(uint32_t address);
+
+    std::string toString() const;
+};
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "dns.hpp"
+#include "message/DNSMessage.hpp"
+#include "message/DNSPacket.hpp"
+#include "tcppool.hpp"
+#include "utils/etsqueue.hpp"
+#include "utils/executor.hpp"
+
+/**
+ * @brief Answer to an upstream query, with the server it came from
+ */
+struct UpstreamReply {
+    dnslib::DNSPacket packet;
+    sockaddr_in source;
+    std::chrono::microseconds rtt;
+    // Zone the source was asked as a server of, set by the resolver, "" for the root and forwarders
+    std::string zone;
+};
+
+/**
+ * @brief Upstream transactions in flight, keyed by their DNS ID
+ *
+ * The network side hands every upstream answer to deliver(), which wakes
+ * the coroutine waiting for it. IDs are random and unique among the
+ * transactions in flight. An answer must come from a server asked and
+ * repeat the question, anything else is dropped.
+ */
+class TransactionTable {
+public:
+    struct State {
+        std::mutex mtx;
+        uint16_t id = 0;
+        // Question sent, set by the first send
+        std::string name;
+        dnslib::TYPE type{};
+        // Servers asked and not answered yet, with the time they were asked
+        std::vector<std::pair<sockaddr_in, std::chrono::steady_clock::time_point>> outstanding;
+        std::vector<UpstreamReply> replies;
+        std::coroutine_handle<> waiter;
+        uint64_t waitSeq = 0;
+    };
+
+private:
+    std::mutex mtx;
+    std::unordered_map<uint16_t, std::shared_ptr<State>> transactions;
+    std::mt19937 rng{std::random_device{}()};
+
+public:
+    std::shared_ptr<State> open();
+    void close(uint16_t id);
+
+    /**
+     * @brief Hands an upstream answer to its transaction
+     *
+     * @return false if no transaction waits for this ID from this source, or
+     *         the answer is to another question
+     */
+    bool deliver(const dnslib::DNSMessageL& message, dnslib::DNSPacket packet, utils::Executor& executor);
+
+    size_t size();
+};
+
+/**
+ * @brief One upstream query under a single DNS ID
+ *
+ * The same question may be sent to several servers (retries, hedging), any
+ * of them may answer. The ID is released when the transaction is destroyed,
+ * later answers are dropped.
+ */
+class Transaction {
+private:
+    TransactionTable& table;
+    utils::Executor& executor;
+    utils::ETSQueue<dnslib::DNSMessageL>& outputQueue;
+    std::shared_ptr<TransactionTable::State> state;
+    bool dnssecOk;
+
+public:
+    /**
+     * @param dnssecOk ask for signatures: queries carry an EDNS OPT record with the DO bit
+     */
+    Transaction(TransactionTable& table, utils::Executor& executor, utils::ETSQueue<dnslib::DNSMessageL>& outputQueue, bool dnssecOk = false);
+    ~Transaction();
+
+    Transaction(const Transaction&) = delete;
+    Transaction& operator=(const Transaction&) = delete;
+
+    uint16_t id() const { return state->id; }
+
+    /**
+     * @brief Sends the question to server
+     *
+     * @param recursionDesired set RD, for upstreams that recurse for us
+     */
+    void send(const sockaddr_in& server, const std::string& name, dnslib::TYPE type, bool recursionDesired);
+
+    // Same as send(), over a pooled TCP connection that forgets the query after deadline
+    void sendTcp(TcpPool& pool, const sockaddr_in& server, const std::string& name, dnslib::TYPE type, bool recursionDesired,
+                 std::chrono::steady_clock::time_point deadline);
+
+    // Servers the question went to and which have not answered yet
+    size_t outstanding();
+
+    // Stops waiting for server, its answer is dropped if it comes anyway
+    void abandon(const sockaddr_in& server);
+
+    /**
+     * @brief co_await transaction.wait(deadline) suspends until the next answer
+     *
+     * @return the answer, nothing if the deadline passed first
+     */
+    auto wait(std::chrono::steady_clock::time_point deadline) {
+        struct Awaiter {
+            Transaction& transaction;
+            std::chrono::steady_clock::time_point deadline;
+
+            bool await_ready() {
+                std::lock_guard<std::mutex> lock(transaction.state->mtx);
+                return !transaction.state->replies.empty();
+            }
+
+            bool await_suspend(std::coroutine_handle<> handle) {
+                auto state = transaction.state;
+                uint64_t seq;
+                {
+                    std::lock_guard<std::mutex> lock(state->mtx);
+                    if (!state->replies.empty()) return false;
+                    state->waiter = handle;
+                    seq = ++state->waitSeq;
+                }
+
+                auto& executor = transaction.executor;
+                executor.postAt(deadline, [state, seq, &executor] {
+                    std::coroutine_handle<> waiter;
+                    {
+                        std::lock_guard<std::mutex> lock(state->mtx);
+                        if (state->waitSeq != seq || !state->waiter) return;
+                        waiter = std::exchange(state->waiter, nullptr);
+                    }
+                    executor.post(waiter);
+                });
+                return true;
+            }
+
+            std::optional<UpstreamReply> await_resume() {
+                std::lock_guard<std::mutex> lock(transaction.state->mtx);
+                if (transaction.state->replies.empty()) return std::nullopt;
+
+                auto reply = std::move(transaction.state->replies.front());
+                transaction.state->replies.erase(transaction.state->replies.begin());
+                return reply;
+            }
+        };
+        return Awaiter{*this, deadline};
+    }
+};
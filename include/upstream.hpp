@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <netinet/in.h>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Set of recursive resolvers queries are forwarded to
+ *
+ * Spreads load over the healthy upstreams, keeps a window of recent
+ * latencies per upstream to time hedged requests and tracks health from
+ * both real queries and the resolver's periodic probes. An upstream is
+ * marked down after a few consecutive failures and comes back on its next
+ * successful answer.
+ *
+ * Upstreams are referred to by their index in the list given at construction.
+ */
+class UpstreamPool {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Consecutive failures before an upstream is marked down
+    static constexpr int FAILURE_THRESHOLD = 3;
+    // Latency samples kept per upstream
+    static constexpr size_t LATENCY_WINDOW = 64;
+
+private:
+    struct Upstream {
+        sockaddr_in address;
+        bool healthy = true;
+        int consecutiveFailures = 0;
+        uint32_t outstanding = 0;
+        std::vector<std::chrono::microseconds> latencies;   // ring buffer of LATENCY_WINDOW samples
+        size_t nextSample = 0;
+        uint64_t answers = 0;
+        uint64_t failures = 0;
+    };
+
+    mutable std::mutex mtx;
+    std::vector<Upstream> upstreams;
+    double hedgePercentile;
+    std::mt19937 rng{std::random_device{}()};
+
+    std::chrono::microseconds percentile(const Upstream& upstream, double pct) const;
+
+public:
+    /**
+     * @param servers upstream addresses, must not be empty
+     * @param hedgePercentile latency percentile after which a query is hedged, 0 disables hedging
+     */
+    UpstreamPool(std::vector<sockaddr_in> servers, double hedgePercentile);
+
+    size_t size() const { return upstreams.size(); }
+    const sockaddr_in& address(size_t index) const { return upstreams[index].address; }
+
+    // Index of the upstream with this address and port, if it is one
+    std::optional<size_t> find(const sockaddr_in& address) const;
+
+    /**
+     * @brief Picks the upstream for a new query
+     *
+     * Compares two random healthy upstreams that are not excluded and takes
+     * the one with fewer outstanding queries, then the faster one. Falls back
+     * to upstreams that are down when no healthy one is left.
+     *
+     * @return nothing when every upstream is excluded
+     */
+    std::optional<size_t> select(const std::vector<size_t>& exclude);
+
+    // A query went to the upstream, it stays outstanding until released
+    void acquire(size_t index);
+    void release(size_t index);
+
+    void recordAnswer(size_t index, std::chrono::microseconds rtt);
+    // Timeout or an unusable answer (SERVFAIL, REFUSED)
+    void recordFailure(size_t index);
+
+    /**
+     * @brief How long to wait for the upstream before hedging to another one
+     *
+     * @return nothing if hedging is disabled or there is no other upstream
+     */
+    std::optional<std::chrono::microseconds> hedgeDelay(size_t index) const;
+
+    std::string toString() const;
+};
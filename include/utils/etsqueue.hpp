@@ -1,8 +1,10 @@
 #pragma once
 
+#include <chrono>
 #include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <vector>
 
 
 namespace utils {
@@ -21,8 +23,14 @@ public:
 
     void push(T item);
     T pop();
+    bool popFor(T& outItem, std::chrono::milliseconds timeout);
     bool tryPop(T& outItem);
 
+    // One lock and one wakeup for all of items
+    void pushAll(std::vector<T>& items);
+    // Waits up to timeout for an item, then appends up to max of those queued to out
+    size_t popBatch(std::vector<T>& out, size_t max, std::chrono::milliseconds timeout);
+
     bool empty() const;
     size_t size() const;
 
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+/**
+ * @brief Work-stealing thread pool running coroutines
+ *
+ * Every worker owns a deque: it takes its own work from the back (the most
+ * recently scheduled, still warm in cache) and steals from the front of the
+ * other deques when it runs dry. Coroutines scheduled from a worker stay on
+ * that worker, the ones scheduled from outside are spread round robin.
+ *
+ * A separate timer thread fires callbacks at their deadline, which is what
+ * sleepFor() and the upstream transaction timeouts are built on.
+ */
+class Executor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    struct Worker {
+        std::mutex mtx;
+        std::deque<std::coroutine_handle<>> tasks;
+        std::thread thread;
+    };
+
+    struct Timer {
+        Clock::time_point deadline;
+        uint64_t seq;                       // keeps timers with equal deadlines in order
+        std::function<void()> callback;
+
+        bool operator>(const Timer& other) const {
+            return deadline != other.deadline ? deadline > other.deadline : seq > other.seq;
+        }
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> nextWorker{0};
+
+    std::mutex idleMtx;
+    std::condition_variable idleCond;
+    std::atomic<size_t> queued{0};
+    bool stopping = false;
+
+    std::mutex timerMtx;
+    std::condition_variable timerCond;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    uint64_t timerSeq = 0;
+    bool timersStopping = false;
+    std::thread timerThread;
+
+    bool takeWork(size_t index, std::coroutine_handle<>& handle);
+    void runWorker(size_t index);
+    void runTimers();
+
+public:
+    /**
+     * @param threads number of workers, 0 for one per hardware thread
+     */
+    explicit Executor(size_t threads = 0);
+
+    // Stops the timers and the workers, coroutines still suspended are abandoned
+    ~Executor();
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    // Resumes the coroutine on one of the workers
+    void post(std::coroutine_handle<> handle);
+
+    // Runs callback on the timer thread once deadline passes, it must not block
+    void postAt(Clock::time_point deadline, std::function<void()> callback);
+
+    // co_await executor.schedule() continues on a worker
+    auto schedule() {
+        struct Awaiter {
+            Executor& executor;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { executor.post(handle); }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{*this};
+    }
+
+    // co_await executor.sleepUntil(t) continues on a worker once t passes
+    auto sleepUntil(Clock::time_point deadline) {
+        struct Awaiter {
+            Executor& executor;
+            Clock::time_point deadline;
+            bool await_ready() const noexcept { return Clock::now() >= deadline; }
+            void await_suspend(std::coroutine_handle<> handle) {
+                executor.postAt(deadline, [target = &executor, handle] { target->post(handle); });
+            }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{*this, deadline};
+    }
+
+    auto sleepFor(Clock::duration duration) { return sleepUntil(Clock::now() + duration); }
+};
+
+}
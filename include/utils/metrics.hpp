@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+namespace utils {
+
+/**
+ * @brief Process wide registry of counters and tables
+ *
+ * Counters are plain monotonic values, tables are callbacks rendering
+ * a multi-line snapshot of some component (e.g. nameserver statistics).
+ * Everything is rendered by dump(), which the resolver logs on SIGUSR1.
+ */
+class Metrics {
+private:
+    std::mutex mtx;
+    std::map<std::string, std::atomic<uint64_t>> counters;
+    std::map<std::string, std::function<std::string()>> tables;
+    std::atomic<bool> dumpRequested = false;
+
+    Metrics() = default;
+public:
+    static Metrics& get() {
+        static Metrics instance;
+        return instance;
+    }
+
+    std::atomic<uint64_t>& counter(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return counters[name];
+    }
+
+    void table(const std::string& name, std::function<std::string()> provider) {
+        std::lock_guard<std::mutex> lock(mtx);
+        tables[name] = std::move(provider);
+    }
+
+    void removeTable(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mtx);
+        tables.erase(name);
+    }
+
+    // Async-signal-safe, only flips a lock-free flag
+    void requestDump() { dumpRequested.store(true, std::memory_order_relaxed); }
+    bool takeDumpRequest() { return dumpRequested.exchange(false, std::memory_order_relaxed); }
+
+    std::string dump() {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        std::stringstream ss;
+        ss << "--- Metrics ---";
+        for (const auto& [name, value] : counters) {
+            ss << "\n" << name << " " << value.load(std::memory_order_relaxed);
+        }
+        for (const auto& [name, provider] : tables) {
+            ss << "\n[" << name << "]\n" << provider();
+        }
+        return ss.str();
+    }
+};
+}
+
+// Counter reference is resolved once per call site, so `name` must be a constant
+#define DNS_METRIC_ADD(name, n) do { \
+        static auto& _counter = utils::Metrics::get().counter(name); \
+        _counter.fetch_add(n, std::memory_order_relaxed); \
+    } while (0)
+#define DNS_METRIC_INC(name) DNS_METRIC_ADD(name, 1)
@@ -0,0 +1,309 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "utils/executor.hpp"
+#include "utils/log.hpp"
+
+namespace utils {
+
+template <typename T>
+class Task;
+
+namespace detail {
+
+// Resumes whoever awaited the task, straight away (symmetric transfer)
+struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+        auto continuation = handle.promise().continuation;
+        return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+};
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { exception = std::current_exception(); }
+};
+
+}
+
+/**
+ * @brief Lazily started coroutine producing a T
+ *
+ * Starts when awaited and resumes its awaiter when done, on whatever thread
+ * finished it. Exceptions propagate to the awaiter.
+ */
+template <typename T = void>
+class Task {
+public:
+    struct promise_type : detail::PromiseBase {
+        std::optional<T> value;
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_value(T v) { value = std::move(v); }
+    };
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+public:
+    explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    ~Task() {
+        if (handle) handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        handle.promise().continuation = awaiter;
+        return handle;
+    }
+
+    T await_resume() {
+        if (handle.promise().exception) {
+            std::rethrow_exception(handle.promise().exception);
+        }
+        return std::move(*handle.promise().value);
+    }
+};
+
+template <>
+class Task<void> {
+public:
+    struct promise_type : detail::PromiseBase {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_void() noexcept {}
+    };
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+public:
+    explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    ~Task() {
+        if (handle) handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        handle.promise().continuation = awaiter;
+        return handle;
+    }
+
+    void await_resume() {
+        if (handle.promise().exception) {
+            std::rethrow_exception(handle.promise().exception);
+        }
+    }
+};
+
+namespace detail {
+
+// Fire-and-forget coroutine owning itself, frees its frame when done
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept {}
+    };
+};
+
+inline Detached runDetached(Executor& executor, Task<void> task) {
+    co_await executor.schedule();
+    try {
+        co_await std::move(task);
+    } catch (const std::exception& e) {
+        DNS_LOG_ERR("Error " + std::string(e.what()));
+    }
+}
+
+template <typename T>
+struct FirstValueState {
+    std::mutex mtx;
+    std::optional<T> value;
+    size_t remaining;
+    std::coroutine_handle<> waiter;
+};
+
+template <typename T>
+Task<void> reportValue(std::shared_ptr<FirstValueState<T>> state, Task<std::optional<T>> task, Executor& executor) {
+    std::optional<T> result;
+    try {
+        result = co_await std::move(task);
+    } catch (const std::exception& e) {
+        DNS_LOG_ERR("Error " + std::string(e.what()));
+    }
+
+    std::coroutine_handle<> waiter;
+    {
+        std::lock_guard<std::mutex> lock(state->mtx);
+        state->remaining--;
+        if (!state->value.has_value() && result.has_value()) {
+            state->value = std::move(result);
+        }
+        if (state->value.has_value() || state->remaining == 0) {
+            waiter = std::exchange(state->waiter, nullptr);
+        }
+    }
+    if (waiter) {
+        executor.post(waiter);
+    }
+}
+
+template <typename T>
+struct AllValuesState {
+    std::mutex mtx;
+    std::vector<std::optional<T>> values;
+    size_t remaining;
+    std::coroutine_handle<> waiter;
+};
+
+template <typename T>
+Task<void> reportEach(std::shared_ptr<AllValuesState<T>> state, size_t index, Task<T> task, Executor& executor) {
+    std::optional<T> result;
+    try {
+        result = co_await std::move(task);
+    } catch (const std::exception& e) {
+        DNS_LOG_ERR("Error " + std::string(e.what()));
+    }
+
+    std::coroutine_handle<> waiter;
+    {
+        std::lock_guard<std::mutex> lock(state->mtx);
+        state->values[index] = std::move(result);
+        if (--state->remaining == 0) {
+            waiter = std::exchange(state->waiter, nullptr);
+        }
+    }
+    if (waiter) {
+        executor.post(waiter);
+    }
+}
+
+}
+
+/**
+ * @brief Runs task on the executor without waiting for it
+ *
+ * Exceptions escaping the task are logged.
+ */
+inline void spawn(Executor& executor, Task<void> task) {
+    detail::runDetached(executor, std::move(task));
+}
+
+/**
+ * @brief Runs tasks concurrently and returns the first value one of them produces
+ *
+ * Returns as soon as a task yields a value, nothing if none of them does.
+ * The other tasks keep running in the background, their results are dropped.
+ */
+template <typename T>
+Task<std::optional<T>> firstValue(Executor& executor, std::vector<Task<std::optional<T>>> tasks) {
+    auto state = std::make_shared<detail::FirstValueState<T>>();
+    state->remaining = tasks.size();
+    if (tasks.empty()) {
+        co_return std::nullopt;
+    }
+
+    for (auto& task : tasks) {
+        spawn(executor, detail::reportValue(state, std::move(task), executor));
+    }
+
+    // Holds no reference: GCC 12 may destroy a co_await operand twice, state outlives it anyway
+    struct Awaiter {
+        detail::FirstValueState<T>* state;
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle) {
+            std::lock_guard<std::mutex> lock(state->mtx);
+            if (state->value.has_value() || state->remaining == 0) return false;
+            state->waiter = handle;
+            return true;
+        }
+        void await_resume() const noexcept {}
+    };
+    co_await Awaiter{state.get()};
+
+    std::optional<T> value;
+    {
+        std::lock_guard<std::mutex> lock(state->mtx);
+        value = state->value;
+    }
+    co_return value;
+}
+
+/**
+ * @brief Runs tasks concurrently, on as many workers as are free, and waits for all of them
+ *
+ * @return the results in the order of tasks, empty for a task that threw
+ */
+template <typename T>
+Task<std::vector<std::optional<T>>> allValues(Executor& executor, std::vector<Task<T>> tasks) {
+    auto state = std::make_shared<detail::AllValuesState<T>>();
+    state->values.resize(tasks.size());
+    state->remaining = tasks.size();
+    if (tasks.empty()) {
+        co_return std::vector<std::optional<T>>{};
+    }
+
+    for (size_t i = 0; i < tasks.size(); i++) {
+        spawn(executor, detail::reportEach(state, i, std::move(tasks[i]), executor));
+    }
+
+    // Holds no reference: GCC 12 may destroy a co_await operand twice, state outlives it anyway
+    struct Awaiter {
+        detail::AllValuesState<T>* state;
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle) {
+            std::lock_guard<std::mutex> lock(state->mtx);
+            if (state->remaining == 0) return false;
+            state->waiter = handle;
+            return true;
+        }
+        void await_resume() const noexcept {}
+    };
+    co_await Awaiter{state.get()};
+
+    std::vector<std::optional<T>> values;
+    {
+        std::lock_guard<std::mutex> lock(state->mtx);
+        values = std::move(state->values);
+    }
+    co_return values;
+}
+
+}
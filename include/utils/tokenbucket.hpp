@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+namespace utils {
+
+/**
+ * @brief Classic token bucket rate limiter, not thread-safe
+ *
+ * Refills `rate` tokens per second up to `burst`.
+ */
+class TokenBucket {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    double rate;
+    double burst;
+    double tokens;
+    Clock::time_point last;
+
+    void refill() {
+        auto now = Clock::now();
+        tokens = std::min(burst, tokens + std::chrono::duration<double>(now - last).count() * rate);
+        last = now;
+    }
+
+public:
+    TokenBucket(double rate, double burst)
+        : rate(rate), burst(burst), tokens(burst), last(Clock::now()) {}
+
+    bool tryTake(double n = 1) {
+        refill();
+        if (tokens < n) {
+            return false;
+        }
+        tokens -= n;
+        return true;
+    }
+
+    // Time until n tokens are there, zero if they are already
+    Clock::duration untilAvailable(double n = 1) {
+        refill();
+        if (tokens >= n) {
+            return Clock::duration::zero();
+        }
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((n - tokens) / rate));
+    }
+};
+
+}
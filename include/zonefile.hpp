@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Resource record as written in a master file
+ *
+ * Names are absolute, lower case and without the trailing dot, the root is "".
+ * The type is upper case, RDATA is left as tokens for the caller to interpret.
+ */
+struct ZoneFileRecord {
+    std::string owner;
+    uint32_t ttl = 0;
+    std::string type;
+    std::vector<std::string> rdata;
+};
+
+/**
+ * @brief Reads a master file (RFC 1035 section 5) one record at a time
+ *
+ * Supports $ORIGIN and $TTL, comments, parenthesised continuations, quoted
+ * strings and records that reuse the previous owner. The class field may
+ * only be IN.
+ */
+class ZoneFileReader {
+private:
+    std::istream& in;
+    std::string source;
+    std::string origin;
+    std::string owner;
+    std::optional<uint32_t> defaultTtl;
+    std::optional<uint32_t> lastTtl;
+    size_t lineNo = 0;
+
+    bool nextEntry(std::vector<std::string>& tokens);
+
+public:
+    /**
+     * @param source file name used in error messages
+     * @param origin initial $ORIGIN
+     */
+    ZoneFileReader(std::istream& in, std::string source, std::string origin = "");
+
+    /**
+     * @brief Reads the next record
+     *
+     * @return false at the end of the file
+     * @throw std::runtime_error on syntax errors
+     */
+    bool next(ZoneFileRecord& record);
+
+    // Absolute form of a name token, relative names are completed with the current origin
+    std::string name(const std::string& token) const;
+    // 32-bit unsigned RDATA field
+    uint32_t number(const std::string& token) const;
+    // Error pointing at the line read last
+    std::runtime_error error(const std::string& reason) const;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dns.hpp"
+#include "message/DNSPacket.hpp"
+
+/**
+ * @brief Random-subdomain ("water torture") attack mitigation
+ *
+ * Keeps, per zone, a decayed count of answered upstream resolutions and
+ * of those that ended in NXDOMAIN, and the number running right now.
+ * Zones are learnt from the owner of the SOA sent with a NXDOMAIN, a name
+ * belongs to the closest enclosing zone known. Timeouts and server
+ * failures say nothing about the names asked and are not counted, so an
+ * outage of the zone's servers does not look like an attack.
+ *
+ * Once most resolutions for a zone end in NXDOMAIN, the zone is considered
+ * under attack: only `cap` resolutions may be outstanding at once, the
+ * others are refused. The resolver may still deny those from proof it has
+ * cached, or serve them stale. Names cached positively never get this
+ * far, and other zones keep their whole upstream capacity.
+ */
+class ZoneGuard {
+public:
+    using Clock = std::chrono::steady_clock;
+    using RecordList = std::vector<std::shared_ptr<dnslib::ResourceRecord>>;
+
+    // Decayed resolutions a zone needs before its ratio is trusted
+    static constexpr double MIN_SAMPLES = 20;
+    // Zones tracked before idle ones are forgotten
+    static constexpr size_t MAX_ZONES = 10000;
+
+    enum class Action { ASK, REFUSE };
+
+    struct Decision {
+        Action action = Action::ASK;
+        std::optional<std::string> zone;                // tracked zone the resolution is charged to
+    };
+
+private:
+    struct Zone {
+        double total = 0;                               // answered resolutions
+        double failed = 0;                              // of which NXDOMAIN
+        unsigned outstanding = 0;
+        bool attacked = false;
+        Clock::time_point updated;
+    };
+
+    mutable std::mutex mtx;
+    std::unordered_map<std::string, Zone> zones;
+    unsigned cap;
+    double ratio;
+
+    void decay(Zone& zone, Clock::time_point now);
+    void update(const std::string& name, Zone& zone, std::optional<bool> failed, Clock::time_point now);
+    void prune(Clock::time_point now);
+
+public:
+    /**
+     * @param cap resolutions allowed at once for a zone under attack
+     * @param ratio share of NXDOMAIN answers from which a zone is under attack
+     */
+    ZoneGuard(unsigned cap, double ratio) : cap(cap), ratio(ratio) {}
+
+    /**
+     * @brief Decides whether name may be resolved upstream
+     *
+     * An ASK decision has to be followed by finish().
+     */
+    Decision admit(const std::string& name, Clock::time_point now = Clock::now());
+
+    /**
+     * @brief Records how an admitted resolution ended
+     *
+     * @param rcode upstream rcode, empty if no server answered; only NOERROR
+     *        and NXDOMAIN are counted
+     * @param authority authority section of the answer, the SOA of a NXDOMAIN teaches the zone
+     */
+    void finish(const Decision& decision, std::optional<dnslib::RCODE> rcode, const RecordList& authority, Clock::time_point now = Clock::now());
+
+    bool underAttack(const std::string& zone) const;
+
+    std::string toString() const;
+};
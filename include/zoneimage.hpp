@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dns.hpp"
+
+/**
+ * @brief On-disk layout of a compiled zone image
+ *
+ * Sections follow the header in this order, each aligned to 8 bytes:
+ * zones, names sorted by key, RRsets grouped by owner, name keys, RR data.
+ * RR data is wire format, uncompressed, ready to be copied into a response.
+ * Integers are in host byte order, an image is meant for the machine
+ * that compiled it.
+ */
+namespace zoneimage {
+
+constexpr char MAGIC[8] = {'D', 'N', 'S', 'Z', 'O', 'N', 'E', '1'};
+constexpr uint32_t VERSION = 1;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t zoneCount;
+    uint32_t nameCount;
+    uint32_t rrsetCount;
+    uint64_t zonesOffset;
+    uint64_t namesOffset;
+    uint64_t rrsetsOffset;
+    uint64_t keysOffset;
+    uint64_t keysSize;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+};
+
+struct Zone {
+    uint32_t apex;              // index of the apex in the names
+    uint32_t negativeOffset;    // SOA to put in negative answers, TTL already capped to MINIMUM
+    uint32_t negativeLength;
+    uint32_t reserved;
+};
+
+// Every owner name, plus the empty non-terminals between owners and their apex
+struct Name {
+    uint32_t keyOffset;         // lower case, no trailing dot, the root is ""
+    uint16_t keyLength;
+    uint16_t rrsetCount;
+    uint32_t firstRRset;
+    uint32_t zone;              // closest enclosing zone
+};
+
+struct RRset {
+    uint16_t type;
+    uint16_t count;
+    uint16_t additionalCount;   // A/AAAA of NS, MX and SRV targets found in the image
+    uint16_t reserved;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t additionalOffset;
+    uint32_t additionalLength;
+};
+
+}
+
+/**
+ * @brief Read-only view of a compiled zone image, memory-mapped
+ *
+ * Opening only maps the file and checks its header, so it takes the same
+ * time for any zone size. Pages are read on demand and shared with every
+ * process mapping the same image.
+ */
+class ZoneImage {
+private:
+    struct Sections;
+
+    const uint8_t* base = nullptr;
+    size_t size = 0;
+    const zoneimage::Header* header = nullptr;
+    const zoneimage::Zone* zones = nullptr;
+    const zoneimage::Name* names = nullptr;
+    const zoneimage::RRset* rrsets = nullptr;
+    const char* keys = nullptr;
+    const uint8_t* data = nullptr;
+
+    ZoneImage() = default;
+
+    std::string_view key(uint32_t name) const;
+    std::optional<uint32_t> find(std::string_view key) const;
+    const zoneimage::RRset* findRRset(uint32_t name, uint16_t type) const;
+    void append(std::vector<uint8_t>& section, uint16_t& count, uint32_t offset, uint32_t length, uint16_t records) const;
+    bool lookup(std::string_view key, uint16_t type, Sections& sections, int depth) const;
+
+public:
+    ~ZoneImage();
+
+    ZoneImage(const ZoneImage&) = delete;
+    ZoneImage& operator=(const ZoneImage&) = delete;
+
+    /**
+     * @throw std::runtime_error if the file cannot be mapped or is not a zone image
+     */
+    static std::shared_ptr<const ZoneImage> open(const std::string& path);
+
+    /**
+     * @brief Builds the authoritative response to a question
+     *
+     * @param response filled with the serialized message
+     * @return false if the name is in none of the zones, the question is left to the resolver
+     * @throw std::runtime_error if the image is corrupt
+     */
+    bool answer(const std::string& name, dnslib::TYPE type, uint16_t id, bool recursionDesired, std::vector<uint8_t>& response) const;
+
+    size_t zoneCount() const { return header->zoneCount; }
+    size_t nameCount() const { return header->nameCount; }
+};
+
+struct ZoneCompileStats {
+    size_t zones = 0;
+    size_t names = 0;
+    size_t rrsets = 0;
+    size_t records = 0;
+    size_t bytes = 0;
+};
+
+/**
+ * @brief Compiles master files into a zone image
+ *
+ * Every file holds one zone, its apex is the owner of its SOA. Supports
+ * A, AAAA, NS, CNAME, PTR, MX, TXT, SRV and SOA records, plus any type in
+ * the RFC 3597 generic form (TYPE99 \# 4 0a000001). Wildcards are not.
+ * The image is written to a temporary file renamed over output, so
+ * servers mapping the old image are not disturbed.
+ *
+ * @throw std::runtime_error on invalid zones or I/O errors
+ */
+ZoneCompileStats compileZones(const std::vector<std::string>& files, const std::string& output);
@@ -36,7 +36,9 @@ namespace dnslib {
         AUTHORITATIVE   = 1 << 10,   ///< Server is authoritative for the domain.
         TRUNCATED       = 1 << 9,    ///< Message was truncated.
         RECURSION_DES   = 1 << 8,    ///< Recursion is desired.
-        RECURSION_AVAIL = 1 << 7     ///< Recursion is available.
+        RECURSION_AVAIL = 1 << 7,    ///< Recursion is available.
+        AUTHENTIC_DATA  = 1 << 5,    ///< Every record of the answer was validated (DNSSEC).
+        CHECKING_DISABLED = 1 << 4   ///< The client validates by itself (DNSSEC).
     };
 
     /**
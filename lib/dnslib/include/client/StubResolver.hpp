@@ -0,0 +1,172 @@
+/**
+ * @file StubResolver.hpp
+ * @brief Defines the StubResolver class, a non-blocking DNS client for many concurrent lookups.
+ * @version 0.1
+ * @date 2026-01-01
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include "../message/DNSPacket.hpp"
+#include "../utils/types.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <netinet/in.h>
+#include <optional>
+#include <string>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unordered_map>
+#include <vector>
+
+namespace dnslib {
+
+    /**
+     * @brief How a lookup of the StubResolver ended.
+     */
+    enum class LookupStatus {
+        ANSWERED,   ///< The server answered, whatever the rcode. Truncated answers are not retried over TCP.
+        TIMEOUT,    ///< No matching answer after every attempt.
+        ERROR       ///< The query could not be sent or the answer could not be parsed.
+    };
+
+    /**
+     * @brief Outcome of one lookup.
+     */
+    struct LookupResult {
+        std::uint64_t ticket = 0;               ///< The value submit() returned for the lookup.
+        LookupStatus status = LookupStatus::TIMEOUT;
+        std::optional<DNSPacket> response;      ///< Set if status is ANSWERED.
+    };
+
+    /**
+     * @brief A non-blocking stub resolver: queries one recursive server over UDP.
+     *
+     * Lookups are sent as soon as they are submitted, spread over a few
+     * connected UDP sockets. Answers are matched on the socket, the random
+     * ID and the question, anything else is dropped. A lookup without a
+     * matching answer is sent again after the timeout, then fails.
+     *
+     * The resolver is driven by a single thread, the one calling submit()
+     * and poll(); it holds no lock, so that thread can keep tens of
+     * thousands of lookups in flight. fd() can be added to an event loop,
+     * it becomes readable when poll() has work to do: answers to read or a
+     * timeout due.
+     *
+     * Completion goes either through the callback given to submit(), called
+     * from poll(), or, without a callback, through a queue read with
+     * takeCompleted(), signalled on the eventfd completionFd().
+     */
+    class StubResolver {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using Callback = std::function<void(LookupResult)>;
+
+        struct Options {
+            std::size_t sockets = 4;                            ///< UDP sockets the queries are spread over.
+            std::chrono::milliseconds timeout{1000};            ///< Wait for an answer before sending again.
+            unsigned attempts = 2;                              ///< Sends per lookup, the first included.
+            bool recursionDesired = true;
+        };
+
+    private:
+        struct Lookup {
+            std::uint16_t id;
+            std::size_t socket;
+            std::string name;
+            TYPE type;
+            unsigned attempts = 0;
+            bool sent = false;
+            Clock::time_point deadline;
+            std::vector<uint8_t> wire;
+            Callback callback;
+        };
+
+        Options options;
+        std::vector<int> sockets;
+        int epollFd = -1;
+        int eventFd = -1;
+        int timerFd = -1;
+        Clock::time_point armed{};
+        std::uint64_t nextTicket = 1;
+        std::size_t nextSocket = 0;
+        std::uint64_t idState;
+
+        std::unordered_map<std::uint64_t, Lookup> lookups;
+        // Per socket, query ID to ticket
+        std::vector<std::unordered_map<std::uint16_t, std::uint64_t>> inflight;
+        // Deadlines in send order, which with one timeout is deadline order; stale entries are skipped
+        std::deque<std::pair<Clock::time_point, std::uint64_t>> deadlines;
+        std::vector<LookupResult> completed;
+        std::size_t ended = 0;
+        // recvmmsg() batch, set up once: one datagram slot per message
+        std::vector<uint8_t> receiveBuffers;
+        std::vector<iovec> receiveVectors;
+        std::vector<mmsghdr> receiveMessages;
+
+        void close();
+        void arm();
+        std::uint16_t freeId(std::size_t socket);
+        void send(std::uint64_t ticket, Lookup& lookup, Clock::time_point now);
+        void receive(std::size_t socket);
+        void expire(Clock::time_point now);
+        void complete(std::uint64_t ticket, LookupStatus status, std::optional<DNSPacket> response);
+
+    public:
+        /**
+         * @brief Opens the sockets, connected to server.
+         *
+         * @param server The recursive server to query.
+         * @param options Sockets, timeout and attempts.
+         * @throw std::runtime_error if a socket, the epoll instance or the eventfd cannot be created.
+         */
+        explicit StubResolver(const sockaddr_in& server, Options options);
+        explicit StubResolver(const sockaddr_in& server) : StubResolver(server, Options{}) {}
+        /// Closes the sockets, lookups still pending end without a result.
+        ~StubResolver();
+
+        StubResolver(const StubResolver&) = delete;
+        StubResolver& operator=(const StubResolver&) = delete;
+
+        /**
+         * @brief Starts a lookup, the query is sent before this returns.
+         *
+         * @param name The name to look up, without a trailing dot.
+         * @param type The record type wanted.
+         * @param callback Called from poll() when the lookup ends; if empty, the
+         *        result is queued for takeCompleted() instead.
+         * @return A ticket identifying the lookup in its result.
+         * @throw std::runtime_error if every socket has all its query IDs in use.
+         */
+        std::uint64_t submit(const std::string& name, TYPE type, Callback callback = nullptr);
+
+        /**
+         * @brief Reads the answers that arrived and fails lookups past their last timeout.
+         *
+         * @param wait How long to wait for an answer if none is there yet, 0 to return at once.
+         * @return The number of lookups that ended.
+         */
+        std::size_t poll(std::chrono::milliseconds wait = std::chrono::milliseconds(0));
+
+        /**
+         * @brief Returns the results of the lookups submitted without a callback, and resets completionFd().
+         */
+        std::vector<LookupResult> takeCompleted();
+
+        /// Lookups not ended yet.
+        std::size_t pending() const { return lookups.size(); }
+
+        /// An epoll descriptor, readable when poll() has answers or timeouts to handle.
+        int fd() const { return epollFd; }
+
+        /// An eventfd, readable while results wait for takeCompleted().
+        int completionFd() const { return eventFd; }
+    };
+
+}
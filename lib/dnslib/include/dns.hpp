@@ -27,3 +27,4 @@
 #include "parser/PacketParser.hpp"
 
 #include "message/DNSMessage.hpp"
+#include "client/StubResolver.hpp"
@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <netinet/in.h>
 #include <vector>
@@ -46,5 +47,8 @@ namespace dnslib {
 
         /// The transport protocol (UDP or TCP) over which the message was received.
         PROTO protocol;
+
+        /// When the message was read from the socket, the epoch if unknown.
+        std::chrono::steady_clock::time_point received{};
     };
 }
\ No newline at end of file
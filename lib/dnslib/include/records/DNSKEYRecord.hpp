@@ -0,0 +1,79 @@
+/**
+ * @file DNSKEYRecord.hpp
+ * @brief Defines the DNSKEYRecord class for representing a DNS 'DNSKEY' record.
+ * @version 0.1
+ * @date 2026-01-01
+ * 
+ * @copyright Copyright (c) 2026
+ * 
+ */
+
+#pragma once
+
+#include "ResourceRecord.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace dnslib {
+
+    /**
+     * @brief Represents a DNS 'DNSKEY' record (RFC 4034), a public key of the zone it is owned by.
+     */
+    class DNSKEYRecord : public ResourceRecord {
+    private:
+        std::uint16_t flags;
+        std::uint8_t protocol;
+        std::uint8_t algorithm;
+        std::vector<uint8_t> publicKey;
+    public:
+        static constexpr std::uint16_t ZONE_KEY = 1 << 8;      ///< Key may sign the zone's RRsets.
+        static constexpr std::uint16_t SECURE_ENTRY = 1;       ///< Key signing key, referenced from the parent.
+        static constexpr std::uint16_t REVOKED = 1 << 7;       ///< Revoked (RFC 5011), never to be used.
+
+        /**
+         * @brief Constructs a new DNSKEYRecord object.
+         * 
+         * @param n The zone apex name.
+         * @param ttl The time-to-live for this record in seconds.
+         * @param flags Key flags, see ZONE_KEY, SECURE_ENTRY and REVOKED.
+         * @param protocol Always 3.
+         * @param algorithm The DNSSEC algorithm number (8 RSASHA256, 13 ECDSAP256SHA256, ...).
+         * @param publicKey The public key in the algorithm's wire format.
+         */
+        DNSKEYRecord(std::string n, uint32_t ttl, std::uint16_t flags, std::uint8_t protocol,
+                     std::uint8_t algorithm, std::vector<uint8_t> publicKey)
+            : ResourceRecord(n, 48, ttl), flags(flags), protocol(protocol), algorithm(algorithm),
+              publicKey(std::move(publicKey)) {}
+
+        /**
+         * @brief Serializes the DNSKEYRecord into a byte buffer in DNS wire format.
+         * 
+         * @param buff The buffer to which the serialized data will be appended.
+         */
+        void serialize(std::vector<uint8_t>& buff) const override;
+
+        /**
+         * @brief Returns a string representation of the DNSKEYRecord.
+         * 
+         * @return A std::string describing the DNSKEYRecord, typically
+         *         "NAME TTL IN DNSKEY FLAGS PROTOCOL ALGORITHM BASE64KEY".
+         */
+        std::string toString() const override;
+
+        /**
+         * @brief Gets the RDATA exactly as it goes on the wire.
+         */
+        std::vector<uint8_t> getRdata() const;
+
+        /**
+         * @brief Computes the key tag (RFC 4034, Appendix B) referenced by RRSIG and DS records.
+         */
+        std::uint16_t keyTag() const;
+
+        std::uint16_t getFlags() const { return flags; }
+        std::uint8_t getProtocol() const { return protocol; }
+        std::uint8_t getAlgorithm() const { return algorithm; }
+        const std::vector<uint8_t>& getPublicKey() const { return publicKey; }
+    };
+
+}
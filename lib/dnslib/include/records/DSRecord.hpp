@@ -0,0 +1,68 @@
+/**
+ * @file DSRecord.hpp
+ * @brief Defines the DSRecord class for representing a DNS 'DS' (Delegation Signer) record.
+ * @version 0.1
+ * @date 2026-01-01
+ * 
+ * @copyright Copyright (c) 2026
+ * 
+ */
+
+#pragma once
+
+#include "ResourceRecord.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace dnslib {
+
+    /**
+     * @brief Represents a DNS 'DS' record (RFC 4034), published by a parent zone.
+     * 
+     * It holds the digest of one DNSKEY of the child zone and links the
+     * child into the parent's chain of trust.
+     */
+    class DSRecord : public ResourceRecord {
+    private:
+        std::uint16_t keyTag;
+        std::uint8_t algorithm;
+        std::uint8_t digestType;
+        std::vector<uint8_t> digest;
+    public:
+        /**
+         * @brief Constructs a new DSRecord object.
+         * 
+         * @param n The name of the delegated (child) zone.
+         * @param ttl The time-to-live for this record in seconds.
+         * @param keyTag The key tag of the referenced DNSKEY.
+         * @param algorithm The algorithm of the referenced DNSKEY.
+         * @param digestType The digest algorithm (1 SHA-1, 2 SHA-256, 4 SHA-384).
+         * @param digest The digest of the owner name and DNSKEY RDATA.
+         */
+        DSRecord(std::string n, uint32_t ttl, std::uint16_t keyTag, std::uint8_t algorithm,
+                 std::uint8_t digestType, std::vector<uint8_t> digest)
+            : ResourceRecord(n, 43, ttl), keyTag(keyTag), algorithm(algorithm),
+              digestType(digestType), digest(std::move(digest)) {}
+
+        /**
+         * @brief Serializes the DSRecord into a byte buffer in DNS wire format.
+         * 
+         * @param buff The buffer to which the serialized data will be appended.
+         */
+        void serialize(std::vector<uint8_t>& buff) const override;
+
+        /**
+         * @brief Returns a string representation of the DSRecord.
+         * 
+         * @return A std::string describing the DSRecord, typically
+         *         "NAME TTL IN DS KEYTAG ALGORITHM DIGESTTYPE DIGEST".
+         */
+        std::string toString() const override;
+
+        std::uint16_t getKeyTag() const { return keyTag; }
+        std::uint8_t getAlgorithm() const { return algorithm; }
+        std::uint8_t getDigestType() const { return digestType; }
+        const std::vector<uint8_t>& getDigest() const { return digest; }
+    };
+
+}
@@ -0,0 +1,83 @@
+/**
+ * @file NSEC3Record.hpp
+ * @brief Defines the NSEC3Record class for representing a DNS 'NSEC3' record.
+ * @version 0.1
+ * @date 2026-01-01
+ * 
+ * @copyright Copyright (c) 2026
+ * 
+ */
+
+#pragma once
+
+#include "ResourceRecord.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace dnslib {
+
+    /**
+     * @brief Represents a DNS 'NSEC3' record (RFC 5155), hashed denial of existence.
+     * 
+     * Works like NSEC over the hashes of the zone's names instead of the names:
+     * the owner's first label is the base32hex hash of a name, and no hash lies
+     * between it and nextHashed.
+     */
+    class NSEC3Record : public ResourceRecord {
+    private:
+        std::uint8_t hashAlgorithm;
+        std::uint8_t flags;
+        std::uint16_t iterations;
+        std::vector<uint8_t> salt;
+        std::vector<uint8_t> nextHashed;
+        std::vector<uint16_t> types;
+    public:
+        static constexpr std::uint8_t OPT_OUT = 1;   ///< Unsigned delegations may lie in the span.
+
+        /**
+         * @brief Constructs a new NSEC3Record object.
+         * 
+         * @param n The owner name, base32hex hash label followed by the zone.
+         * @param ttl The time-to-live for this record in seconds.
+         * @param hashAlgorithm Always 1, SHA-1.
+         * @param flags See OPT_OUT.
+         * @param iterations Additional hash iterations.
+         * @param salt Salt appended to the name at every iteration.
+         * @param nextHashed The next hash of the zone in order, raw bytes.
+         * @param types The types present at the hashed name, in ascending order.
+         */
+        NSEC3Record(std::string n, uint32_t ttl, std::uint8_t hashAlgorithm, std::uint8_t flags,
+                    std::uint16_t iterations, std::vector<uint8_t> salt, std::vector<uint8_t> nextHashed,
+                    std::vector<uint16_t> types)
+            : ResourceRecord(n, 50, ttl), hashAlgorithm(hashAlgorithm), flags(flags), iterations(iterations),
+              salt(std::move(salt)), nextHashed(std::move(nextHashed)), types(std::move(types)) {}
+
+        /**
+         * @brief Serializes the NSEC3Record into a byte buffer in DNS wire format.
+         * 
+         * @param buff The buffer to which the serialized data will be appended.
+         */
+        void serialize(std::vector<uint8_t>& buff) const override;
+
+        /**
+         * @brief Returns a string representation of the NSEC3Record,
+         *        "NAME TTL IN NSEC3 ALG FLAGS ITERATIONS SALT NEXT TYPE...".
+         */
+        std::string toString() const override;
+
+        std::uint8_t getHashAlgorithm() const { return hashAlgorithm; }
+        std::uint8_t getFlags() const { return flags; }
+        std::uint16_t getIterations() const { return iterations; }
+        const std::vector<uint8_t>& getSalt() const { return salt; }
+        const std::vector<uint8_t>& getNextHashed() const { return nextHashed; }
+        const std::vector<uint16_t>& getTypes() const { return types; }
+
+        bool optOut() const { return flags & OPT_OUT; }
+
+        /**
+         * @brief Checks whether the type bitmap lists type.
+         */
+        bool hasType(uint16_t type) const;
+    };
+
+}
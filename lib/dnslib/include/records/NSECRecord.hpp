@@ -0,0 +1,62 @@
+/**
+ * @file NSECRecord.hpp
+ * @brief Defines the NSECRecord class for representing a DNS 'NSEC' (Next Secure) record.
+ * @version 0.1
+ * @date 2026-01-01
+ * 
+ * @copyright Copyright (c) 2026
+ * 
+ */
+
+#pragma once
+
+#include "ResourceRecord.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace dnslib {
+
+    /**
+     * @brief Represents a DNS 'NSEC' record (RFC 4034), authenticated denial of existence.
+     * 
+     * It names the next owner in the zone's canonical order, so no name exists
+     * between the two, and lists the types present at its own owner.
+     */
+    class NSECRecord : public ResourceRecord {
+    private:
+        std::string nextName;
+        std::vector<uint16_t> types;
+    public:
+        /**
+         * @brief Constructs a new NSECRecord object.
+         * 
+         * @param n The owner name.
+         * @param ttl The time-to-live for this record in seconds.
+         * @param nextName The next owner name of the zone in canonical order, the apex for the last one.
+         * @param types The types present at the owner, in ascending order.
+         */
+        NSECRecord(std::string n, uint32_t ttl, std::string nextName, std::vector<uint16_t> types)
+            : ResourceRecord(n, 47, ttl), nextName(std::move(nextName)), types(std::move(types)) {}
+
+        /**
+         * @brief Serializes the NSECRecord into a byte buffer in DNS wire format.
+         * 
+         * @param buff The buffer to which the serialized data will be appended.
+         */
+        void serialize(std::vector<uint8_t>& buff) const override;
+
+        /**
+         * @brief Returns a string representation of the NSECRecord, "NAME TTL IN NSEC NEXT TYPE...".
+         */
+        std::string toString() const override;
+
+        std::string getNextName() const { return nextName; }
+        const std::vector<uint16_t>& getTypes() const { return types; }
+
+        /**
+         * @brief Checks whether the type bitmap lists type.
+         */
+        bool hasType(uint16_t type) const;
+    };
+
+}
@@ -0,0 +1,57 @@
+/**
+ * @file OPTRecord.hpp
+ * @brief Defines the OPTRecord class, the EDNS(0) pseudo-record.
+ * @version 0.1
+ * @date 2026-01-01
+ * 
+ * @copyright Copyright (c) 2026
+ * 
+ */
+
+#pragma once
+
+#include "ResourceRecord.hpp"
+#include <cstdint>
+
+namespace dnslib {
+
+    /**
+     * @brief Represents the EDNS(0) OPT pseudo-record (RFC 6891) of the additional section.
+     * 
+     * The CLASS field carries the UDP payload size the sender can receive and
+     * the TTL field the extended flags, of which only DO ("DNSSEC OK",
+     * RFC 3225) is kept. Options are not supported and skipped when parsed.
+     */
+    class OPTRecord : public ResourceRecord {
+    private:
+        std::uint16_t udpPayloadSize;
+        bool dnssecOk;
+    public:
+        static constexpr std::uint32_t DO_BIT = 1 << 15;
+
+        /**
+         * @brief Constructs a new OPTRecord object.
+         * 
+         * @param udpPayloadSize The largest UDP response the sender accepts.
+         * @param dnssecOk Whether the sender wants DNSSEC records in answers.
+         */
+        OPTRecord(std::uint16_t udpPayloadSize, bool dnssecOk)
+            : ResourceRecord("", 41, dnssecOk ? DO_BIT : 0), udpPayloadSize(udpPayloadSize), dnssecOk(dnssecOk) {}
+
+        /**
+         * @brief Serializes the OPTRecord, payload size in place of the class, flags in place of the TTL.
+         * 
+         * @param buff The buffer to which the serialized data will be appended.
+         */
+        void serialize(std::vector<uint8_t>& buff) const override;
+
+        /**
+         * @brief Returns a string representation of the OPTRecord, e.g. "OPT udp=1232 do".
+         */
+        std::string toString() const override;
+
+        std::uint16_t getUdpPayloadSize() const { return udpPayloadSize; }
+        bool getDnssecOk() const { return dnssecOk; }
+    };
+
+}
@@ -0,0 +1,95 @@
+/**
+ * @file RRSIGRecord.hpp
+ * @brief Defines the RRSIGRecord class for representing a DNS 'RRSIG' (signature) record.
+ * @version 0.1
+ * @date 2026-01-01
+ * 
+ * @copyright Copyright (c) 2026
+ * 
+ */
+
+#pragma once
+
+#include "ResourceRecord.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace dnslib {
+
+    /**
+     * @brief Represents a DNS 'RRSIG' record (RFC 4034), the signature over one RRset.
+     * 
+     * The signature covers the RRset of typeCovered owned by the same name,
+     * made with the key of signerName identified by keyTag.
+     */
+    class RRSIGRecord : public ResourceRecord {
+    private:
+        std::uint16_t typeCovered;
+        std::uint8_t algorithm;
+        std::uint8_t labels;
+        std::uint32_t originalTtl;
+        std::uint32_t expiration;
+        std::uint32_t inception;
+        std::uint16_t keyTag;
+        std::string signerName;
+        std::vector<uint8_t> signature;
+    public:
+        /**
+         * @brief Constructs a new RRSIGRecord object.
+         * 
+         * @param n The owner name of the signed RRset.
+         * @param ttl The time-to-live for this record in seconds.
+         * @param typeCovered The type of the signed RRset.
+         * @param algorithm The DNSSEC algorithm number of the signing key.
+         * @param labels Labels of the original owner name, fewer than the owner has if it was a wildcard.
+         * @param originalTtl The TTL of the RRset as in the authoritative zone.
+         * @param expiration End of the validity period, seconds since the epoch (serial arithmetic).
+         * @param inception Start of the validity period, seconds since the epoch (serial arithmetic).
+         * @param keyTag The key tag of the signing DNSKEY.
+         * @param signerName The zone whose key made the signature.
+         * @param signature The signature bytes.
+         */
+        RRSIGRecord(std::string n, uint32_t ttl, std::uint16_t typeCovered, std::uint8_t algorithm,
+                    std::uint8_t labels, std::uint32_t originalTtl, std::uint32_t expiration,
+                    std::uint32_t inception, std::uint16_t keyTag, std::string signerName,
+                    std::vector<uint8_t> signature)
+            : ResourceRecord(n, 46, ttl), typeCovered(typeCovered), algorithm(algorithm), labels(labels),
+              originalTtl(originalTtl), expiration(expiration), inception(inception), keyTag(keyTag),
+              signerName(std::move(signerName)), signature(std::move(signature)) {}
+
+        /**
+         * @brief Serializes the RRSIGRecord into a byte buffer in DNS wire format.
+         * 
+         * @param buff The buffer to which the serialized data will be appended.
+         */
+        void serialize(std::vector<uint8_t>& buff) const override;
+
+        /**
+         * @brief Returns a string representation of the RRSIGRecord.
+         * 
+         * @return A std::string describing the RRSIGRecord, typically "NAME TTL IN RRSIG TYPE
+         *         ALGORITHM LABELS ORIGINALTTL EXPIRATION INCEPTION KEYTAG SIGNER BASE64SIGNATURE".
+         */
+        std::string toString() const override;
+
+        /**
+         * @brief Writes the RDATA without the signature, with the signer name in canonical form.
+         * 
+         * This is how the RRSIG itself enters the data it signs (RFC 4034, section 3.1.8.1).
+         * 
+         * @param buff The buffer to which the fields are appended.
+         */
+        void writeSignedFields(std::vector<uint8_t>& buff) const;
+
+        std::uint16_t getTypeCovered() const { return typeCovered; }
+        std::uint8_t getAlgorithm() const { return algorithm; }
+        std::uint8_t getLabels() const { return labels; }
+        std::uint32_t getOriginalTtl() const { return originalTtl; }
+        std::uint32_t getExpiration() const { return expiration; }
+        std::uint32_t getInception() const { return inception; }
+        std::uint16_t getKeyTag() const { return keyTag; }
+        std::string getSignerName() const { return signerName; }
+        const std::vector<uint8_t>& getSignature() const { return signature; }
+    };
+
+}
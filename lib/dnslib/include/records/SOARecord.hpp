@@ -0,0 +1,92 @@
+/**
+ * @file SOARecord.hpp
+ * @brief Defines the SOARecord class for representing a DNS 'SOA' (Start of Authority) record.
+ * @version 0.1
+ * @date 2026-01-01
+ * 
+ * @copyright Copyright (c) 2026
+ * 
+ */
+
+#pragma once
+
+#include "ResourceRecord.hpp"
+#include <cstdint>
+#include <string>
+
+namespace dnslib {
+
+    /**
+     * @brief Represents a DNS 'SOA' record, which marks the start of a zone of authority.
+     * 
+     * Besides zone maintenance parameters, the SOA record carries the MINIMUM field,
+     * which RFC 2308 defines as the TTL for negative answers (NXDOMAIN/NODATA) from the zone.
+     */
+    class SOARecord : public ResourceRecord {
+    private:
+        std::string mname;
+        std::string rname;
+        std::uint32_t serial;
+        std::uint32_t refresh;
+        std::uint32_t retry;
+        std::uint32_t expire;
+        std::uint32_t minimum;
+    public:
+        /**
+         * @brief Constructs a new SOARecord object.
+         * 
+         * @param n The zone apex name.
+         * @param ttl The time-to-live for this record in seconds.
+         * @param mname The primary name server of the zone.
+         * @param rname The mailbox of the person responsible for the zone.
+         * @param serial The version number of the zone.
+         * @param refresh Seconds before secondaries should refresh the zone.
+         * @param retry Seconds before a failed refresh is retried.
+         * @param expire Seconds after which secondaries stop answering for the zone.
+         * @param minimum The negative caching TTL in seconds.
+         */
+        SOARecord(std::string n, uint32_t ttl, std::string mname, std::string rname,
+                  std::uint32_t serial, std::uint32_t refresh, std::uint32_t retry,
+                  std::uint32_t expire, std::uint32_t minimum)
+            : ResourceRecord(n, 6, ttl), mname(mname), rname(rname), serial(serial),
+              refresh(refresh), retry(retry), expire(expire), minimum(minimum) {}
+
+        /**
+         * @brief Serializes the SOARecord into a byte buffer in DNS wire format.
+         * 
+         * @param buff The buffer to which the serialized data will be appended.
+         */
+        void serialize(std::vector<uint8_t>& buff) const override;
+
+        /**
+         * @brief Returns a string representation of the SOARecord.
+         * 
+         * @return A std::string describing the SOARecord, typically
+         *         "NAME TTL IN SOA MNAME RNAME SERIAL REFRESH RETRY EXPIRE MINIMUM".
+         */
+        std::string toString() const override;
+
+        /**
+         * @brief Gets the primary name server of the zone.
+         */
+        std::string getMname() const { return mname; }
+
+        /**
+         * @brief Gets the mailbox of the zone administrator.
+         */
+        std::string getRname() const { return rname; }
+
+        std::uint32_t getSerial() const { return serial; }
+        std::uint32_t getRefresh() const { return refresh; }
+        std::uint32_t getRetry() const { return retry; }
+        std::uint32_t getExpire() const { return expire; }
+
+        /**
+         * @brief Gets the MINIMUM field, used as negative caching TTL.
+         * 
+         * @return The MINIMUM value in seconds.
+         */
+        std::uint32_t getMinimum() const { return minimum; }
+    };
+
+}
@@ -17,4 +17,11 @@
 #include "CNAMERecord.hpp"
 #include "PTRRecord.hpp"
 #include "MXRecord.hpp"
+#include "SOARecord.hpp"
+#include "DSRecord.hpp"
+#include "RRSIGRecord.hpp"
+#include "DNSKEYRecord.hpp"
+#include "OPTRecord.hpp"
+#include "NSECRecord.hpp"
+#include "NSEC3Record.hpp"
 #include "UnknownRecord.hpp"
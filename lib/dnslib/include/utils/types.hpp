@@ -23,11 +23,19 @@ namespace dnslib {
         A = 1,      ///< Query for an IPv4 address.
         NS = 2,     ///< Query for a name server.
         CNAME = 5,  ///< Query for a canonical name.
+        SOA = 6,    ///< Query for the start of a zone of authority.
         PTR = 12,   ///< Query for a pointer record.
         HINFO = 13, ///< Query for host information.
         MINFO = 14, ///< Query for mailbox information.
         MX = 15,    ///< Query for a mail exchange record.
-        TXT = 16    ///< Query for a text record.
+        TXT = 16,   ///< Query for a text record.
+        AAAA = 28,  ///< Query for an IPv6 address, answers are kept as UnknownRecord.
+        OPT = 41,   ///< EDNS(0) pseudo-record, never queried.
+        DS = 43,    ///< Query for the delegation signer of a child zone.
+        RRSIG = 46, ///< Query for the signatures of a name.
+        NSEC = 47,  ///< Next owner name in a signed zone, denial of existence.
+        DNSKEY = 48,///< Query for the public keys of a zone.
+        NSEC3 = 50  ///< Hashed denial of existence.
     };
 
     /**
@@ -54,6 +62,10 @@ namespace std {
                 return "A";
             case dnslib::TYPE::NS:
                 return "NS";
+            case dnslib::TYPE::CNAME:
+                return "CNAME";
+            case dnslib::TYPE::SOA:
+                return "SOA";
             case dnslib::TYPE::PTR:
                 return "PTR";
             case dnslib::TYPE::HINFO:
@@ -64,6 +76,20 @@ namespace std {
                 return "MX";
             case dnslib::TYPE::TXT:
                 return "TXT";
+            case dnslib::TYPE::AAAA:
+                return "AAAA";
+            case dnslib::TYPE::OPT:
+                return "OPT";
+            case dnslib::TYPE::DS:
+                return "DS";
+            case dnslib::TYPE::RRSIG:
+                return "RRSIG";
+            case dnslib::TYPE::NSEC:
+                return "NSEC";
+            case dnslib::TYPE::DNSKEY:
+                return "DNSKEY";
+            case dnslib::TYPE::NSEC3:
+                return "NSEC3";
             default:
                 return "Unknown";
         }
@@ -48,4 +48,30 @@ namespace dnslib::utils {
      */
     void writeDomain(std::vector<uint8_t>& buffer, std::string name);
 
+    /**
+     * @brief Encodes bytes as base64 (RFC 4648), as keys and signatures appear in zone files.
+     * 
+     * @param data The bytes to encode.
+     * @return The padded base64 text.
+     */
+    std::string toBase64(const std::vector<uint8_t>& data);
+
+    /**
+     * @brief Encodes bytes as lowercase base32 with the extended hex alphabet, without padding.
+     * 
+     * NSEC3 owner names carry hashes in this form (RFC 5155).
+     * 
+     * @param data The bytes to encode.
+     * @return The encoded text.
+     */
+    std::string toBase32Hex(const std::vector<uint8_t>& data);
+
+    /**
+     * @brief Writes a type bitmap as in NSEC and NSEC3 records (RFC 4034, section 4.1.2).
+     * 
+     * @param buffer The buffer to write to.
+     * @param types The types to list, in ascending order.
+     */
+    void writeTypeBitmap(std::vector<uint8_t>& buffer, const std::vector<uint16_t>& types);
+
 }
\ No newline at end of file
@@ -27,6 +27,8 @@ namespace dnslib {
         packet.header.setTruncated(flags & PacketFlag::TRUNCATED);
         packet.header.setRecursionDesired(flags & PacketFlag::RECURSION_DES);
         packet.header.setRecursionAvailable(flags & PacketFlag::RECURSION_AVAIL);
+        packet.header.setAuthenticData(flags & PacketFlag::AUTHENTIC_DATA);
+        packet.header.setCheckingDisabled(flags & PacketFlag::CHECKING_DISABLED);
         return *this;
     }
 
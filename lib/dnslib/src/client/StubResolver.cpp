@@ -0,0 +1,274 @@
+#include "client/StubResolver.hpp"
+#include "builder/PacketBuilder.hpp"
+#include "parser/PacketParser.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <utility>
+
+namespace dnslib {
+
+    namespace {
+        // Datagrams read per recvmmsg call
+        constexpr std::size_t RECV_BATCH = 64;
+        // Largest UDP answer read, EDNS included
+        constexpr std::size_t MAX_DATAGRAM = 4096;
+        // Receive buffer asked for each socket, bursts of answers queue there between polls
+        constexpr int SOCKET_BUFFER = 4 << 20;
+        // IDs left unused on a socket, so that a free one is found in a few draws
+        constexpr std::size_t MAX_INFLIGHT_PER_SOCKET = 0xF000;
+        // Epoll tag of the timer, the sockets use their index
+        constexpr std::uint64_t TIMER_TAG = ~std::uint64_t(0);
+
+        std::runtime_error SystemError(const std::string& what) {
+            return std::runtime_error(what + ": " + std::strerror(errno));
+        }
+
+        bool SameName(const std::string& a, const std::string& b) {
+            return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](unsigned char x, unsigned char y) {
+                return std::tolower(x) == std::tolower(y);
+            });
+        }
+    }
+
+    StubResolver::StubResolver(const sockaddr_in& server, Options options) : options(options) {
+        if (this->options.sockets == 0 || this->options.attempts == 0) {
+            throw std::invalid_argument("StubResolver needs at least one socket and one attempt");
+        }
+        idState = (static_cast<std::uint64_t>(std::random_device{}()) << 32) | std::random_device{}() | 1;
+
+        receiveBuffers.resize(RECV_BATCH * MAX_DATAGRAM);
+        receiveVectors.resize(RECV_BATCH);
+        receiveMessages.resize(RECV_BATCH);
+        for (std::size_t i = 0; i < RECV_BATCH; i++) {
+            receiveVectors[i] = {receiveBuffers.data() + i * MAX_DATAGRAM, MAX_DATAGRAM};
+            receiveMessages[i].msg_hdr.msg_iov = &receiveVectors[i];
+            receiveMessages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        try {
+            epollFd = epoll_create1(EPOLL_CLOEXEC);
+            eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            if (epollFd < 0 || eventFd < 0 || timerFd < 0) {
+                throw SystemError("StubResolver setup");
+            }
+
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u64 = TIMER_TAG;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event);
+
+            for (std::size_t i = 0; i < this->options.sockets; i++) {
+                int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+                if (fd < 0) {
+                    throw SystemError("StubResolver socket");
+                }
+                sockets.push_back(fd);
+                setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &SOCKET_BUFFER, sizeof(SOCKET_BUFFER));
+
+                // Connected: the kernel drops datagrams from any other source
+                if (connect(fd, reinterpret_cast<const sockaddr*>(&server), sizeof(server)) < 0) {
+                    throw SystemError("StubResolver connect");
+                }
+                event.data.u64 = i;
+                epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+            }
+        } catch (...) {
+            close();
+            throw;
+        }
+        inflight.resize(sockets.size());
+    }
+
+    StubResolver::~StubResolver() {
+        close();
+    }
+
+    void StubResolver::close() {
+        for (int fd : sockets) {
+            ::close(fd);
+        }
+        sockets.clear();
+        for (int* fd : {&epollFd, &eventFd, &timerFd}) {
+            if (*fd >= 0) ::close(*fd);
+            *fd = -1;
+        }
+    }
+
+    // Points the timer at the earliest deadline
+    void StubResolver::arm() {
+        Clock::time_point next = deadlines.empty() ? Clock::time_point{} : deadlines.front().first;
+        if (next == armed) return;
+        armed = next;
+
+        // steady_clock is CLOCK_MONOTONIC, an all zero value disarms
+        itimerspec spec{};
+        if (!deadlines.empty()) {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(next.time_since_epoch()).count();
+            spec.it_value.tv_sec = ns / 1000000000;
+            spec.it_value.tv_nsec = std::max<long>(ns % 1000000000, spec.it_value.tv_sec == 0 ? 1 : 0);
+        }
+        timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    }
+
+    std::uint16_t StubResolver::freeId(std::size_t socket) {
+        while (true) {
+            // xorshift64, IDs an off-path attacker cannot guess from the previous ones
+            idState ^= idState << 13;
+            idState ^= idState >> 7;
+            idState ^= idState << 17;
+            auto id = static_cast<std::uint16_t>(idState >> 48);
+            if (inflight[socket].count(id) == 0) return id;
+        }
+    }
+
+    std::uint64_t StubResolver::submit(const std::string& name, TYPE type, Callback callback) {
+        // Round robin, skipping sockets short of IDs
+        std::size_t socket = nextSocket;
+        for (std::size_t tried = 0; inflight[socket].size() >= MAX_INFLIGHT_PER_SOCKET; tried++) {
+            if (tried == sockets.size()) {
+                throw std::runtime_error("StubResolver: too many lookups in flight");
+            }
+            socket = (socket + 1) % sockets.size();
+        }
+        nextSocket = (socket + 1) % sockets.size();
+
+        std::uint64_t ticket = nextTicket++;
+        Lookup lookup;
+        lookup.id = freeId(socket);
+        lookup.socket = socket;
+        lookup.name = name;
+        lookup.type = type;
+        lookup.callback = std::move(callback);
+        PacketBuilder()
+            .setId(lookup.id)
+            .withFlags(options.recursionDesired ? PacketFlag::RECURSION_DES : PacketFlag::NONE)
+            .addQuestion(name, type)
+            .build()
+            .serialize(lookup.wire);
+
+        inflight[socket][lookup.id] = ticket;
+        auto& stored = lookups.emplace(ticket, std::move(lookup)).first->second;
+        send(ticket, stored, Clock::now());
+        arm();
+        return ticket;
+    }
+
+    void StubResolver::send(std::uint64_t ticket, Lookup& lookup, Clock::time_point now) {
+        lookup.attempts++;
+        lookup.deadline = now + options.timeout;
+        deadlines.emplace_back(lookup.deadline, ticket);
+
+        // A full socket buffer or an ICMP error of an earlier query: the next attempt may do better
+        if (::send(sockets[lookup.socket], lookup.wire.data(), lookup.wire.size(), MSG_DONTWAIT) >= 0) {
+            lookup.sent = true;
+        }
+    }
+
+    void StubResolver::receive(std::size_t socket) {
+        while (true) {
+            int count = recvmmsg(sockets[socket], receiveMessages.data(), RECV_BATCH, MSG_DONTWAIT, nullptr);
+            if (count <= 0) return;
+
+            for (int i = 0; i < count; i++) {
+                const uint8_t* data = receiveBuffers.data() + i * MAX_DATAGRAM;
+                std::size_t length = receiveMessages[i].msg_len;
+                if (length < 12) continue;
+
+                auto id = static_cast<std::uint16_t>((data[0] << 8) | data[1]);
+                auto it = inflight[socket].find(id);
+                if (it == inflight[socket].end()) continue;
+                std::uint64_t ticket = it->second;
+
+                DNSPacket packet;
+                try {
+                    packet = PacketParser::parse(std::vector<uint8_t>(data, data + length));
+                } catch (const std::exception&) {
+                    complete(ticket, LookupStatus::ERROR, std::nullopt);
+                    continue;
+                }
+
+                // Same ID by chance, or a forged answer: the question has to match too
+                const auto& lookup = lookups.at(ticket);
+                const auto& questions = packet.getQuestions();
+                if (!packet.getHeader().isResponse() || questions.size() != 1 || questions[0].getType() != lookup.type
+                    || !SameName(questions[0].getName(), lookup.name)) continue;
+
+                complete(ticket, LookupStatus::ANSWERED, std::move(packet));
+            }
+            if (static_cast<std::size_t>(count) < RECV_BATCH) return;
+        }
+    }
+
+    void StubResolver::expire(Clock::time_point now) {
+        while (!deadlines.empty() && deadlines.front().first <= now) {
+            auto [deadline, ticket] = deadlines.front();
+            deadlines.pop_front();
+
+            // Answered meanwhile, or sent again with a later deadline
+            auto it = lookups.find(ticket);
+            if (it == lookups.end() || it->second.deadline != deadline) continue;
+
+            if (it->second.attempts < options.attempts) {
+                send(ticket, it->second, now);
+            } else {
+                complete(ticket, it->second.sent ? LookupStatus::TIMEOUT : LookupStatus::ERROR, std::nullopt);
+            }
+        }
+    }
+
+    void StubResolver::complete(std::uint64_t ticket, LookupStatus status, std::optional<DNSPacket> response) {
+        auto it = lookups.find(ticket);
+        Lookup lookup = std::move(it->second);
+        lookups.erase(it);
+        inflight[lookup.socket].erase(lookup.id);
+        ended++;
+
+        LookupResult result{ticket, status, std::move(response)};
+        if (lookup.callback) {
+            // Last, the callback may submit again
+            lookup.callback(std::move(result));
+            return;
+        }
+        completed.push_back(std::move(result));
+        std::uint64_t one = 1;
+        [[maybe_unused]] auto written = write(eventFd, &one, sizeof(one));
+    }
+
+    std::size_t StubResolver::poll(std::chrono::milliseconds wait) {
+        std::size_t before = ended;
+
+        epoll_event events[16];
+        int count = epoll_wait(epollFd, events, 16, static_cast<int>(wait.count()));
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.u64 == TIMER_TAG) {
+                std::uint64_t expirations;
+                [[maybe_unused]] auto read = ::read(timerFd, &expirations, sizeof(expirations));
+                armed = {};
+            } else {
+                receive(events[i].data.u64);
+            }
+        }
+
+        expire(Clock::now());
+        arm();
+        return ended - before;
+    }
+
+    std::vector<LookupResult> StubResolver::takeCompleted() {
+        std::uint64_t count;
+        [[maybe_unused]] auto read = ::read(eventFd, &count, sizeof(count));
+        return std::exchange(completed, {});
+    }
+
+}
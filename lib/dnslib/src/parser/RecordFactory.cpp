@@ -2,13 +2,48 @@
 #include "records/_records.hpp"
 #include <cstddef>
 #include <cstdint>
+#include <stdexcept>
 
 namespace dnslib {
 
+    // RDATA from the current position to its end, for fields that fill up the rest
+    static std::vector<uint8_t> readRest(utils::ByteReader& reader, size_t end) {
+        if (end < reader.position()) {
+            throw std::runtime_error("RDATA shorter than its fixed fields");
+        }
+        reader.chceckBounds(end - reader.position());
+
+        const auto& buffer = reader.getBuffer();
+        std::vector<uint8_t> rest(buffer.begin() + reader.position(), buffer.begin() + end);
+        reader.setPosition(end);
+        return rest;
+    }
+
+    // NSEC and NSEC3 type bitmaps (RFC 4034, section 4.1.2) up to the end of the RDATA
+    static std::vector<uint16_t> readTypeBitmap(utils::ByteReader& reader, size_t end) {
+        std::vector<uint16_t> types;
+        while (reader.position() < end) {
+            uint8_t window = reader.readU8();
+            uint8_t length = reader.readU8();
+            if (length == 0 || length > 32 || reader.position() + length > end) {
+                throw std::runtime_error("Malformed type bitmap");
+            }
+            for (int i = 0; i < length; i++) {
+                uint8_t bits = reader.readU8();
+                for (int bit = 0; bit < 8; bit++) {
+                    if (bits & (0x80 >> bit)) {
+                        types.push_back((window << 8) | (i * 8 + bit));
+                    }
+                }
+            }
+        }
+        return types;
+    }
+
     std::shared_ptr<ResourceRecord> RecordFactory::create(utils::ByteReader& reader) {
         std::string name = reader.readDomain();
         TYPE type = static_cast<TYPE>(reader.readU16());
-        reader.readU16(); // skip class
+        uint16_t klass = reader.readU16();
         uint32_t ttl = reader.readU32();
         uint16_t rdlength = reader.readU16();
 
@@ -32,6 +67,17 @@ namespace dnslib {
                 record = std::make_shared<CNAMERecord>(name, ttl, cname);
                 break;
             }
+            case TYPE::SOA: {
+                std::string mname = reader.readDomain();
+                std::string rname = reader.readDomain();
+                std::uint32_t serial = reader.readU32();
+                std::uint32_t refresh = reader.readU32();
+                std::uint32_t retry = reader.readU32();
+                std::uint32_t expire = reader.readU32();
+                std::uint32_t minimum = reader.readU32();
+                record = std::make_shared<SOARecord>(name, ttl, mname, rname, serial, refresh, retry, expire, minimum);
+                break;
+            }
             case TYPE::PTR: {
                 std::string ptr = reader.readDomain();
                 record = std::make_shared<PTRRecord>(name, ttl, ptr);
@@ -43,6 +89,59 @@ namespace dnslib {
                 record = std::make_shared<MXRecord>(name, ttl, pref, exch);
                 break;
             }
+            case TYPE::DS: {
+                std::uint16_t keyTag = reader.readU16();
+                std::uint8_t algorithm = reader.readU8();
+                std::uint8_t digestType = reader.readU8();
+                std::vector<uint8_t> digest = readRest(reader, expectedEnd);
+                record = std::make_shared<DSRecord>(name, ttl, keyTag, algorithm, digestType, digest);
+                break;
+            }
+            case TYPE::RRSIG: {
+                std::uint16_t typeCovered = reader.readU16();
+                std::uint8_t algorithm = reader.readU8();
+                std::uint8_t labels = reader.readU8();
+                std::uint32_t originalTtl = reader.readU32();
+                std::uint32_t expiration = reader.readU32();
+                std::uint32_t inception = reader.readU32();
+                std::uint16_t keyTag = reader.readU16();
+                std::string signer = reader.readDomain();
+                std::vector<uint8_t> signature = readRest(reader, expectedEnd);
+                record = std::make_shared<RRSIGRecord>(name, ttl, typeCovered, algorithm, labels, originalTtl,
+                                                       expiration, inception, keyTag, signer, signature);
+                break;
+            }
+            case TYPE::DNSKEY: {
+                std::uint16_t flags = reader.readU16();
+                std::uint8_t protocol = reader.readU8();
+                std::uint8_t algorithm = reader.readU8();
+                std::vector<uint8_t> key = readRest(reader, expectedEnd);
+                record = std::make_shared<DNSKEYRecord>(name, ttl, flags, protocol, algorithm, key);
+                break;
+            }
+            case TYPE::NSEC: {
+                std::string next = reader.readDomain();
+                std::vector<uint16_t> types = readTypeBitmap(reader, expectedEnd);
+                record = std::make_shared<NSECRecord>(name, ttl, next, types);
+                break;
+            }
+            case TYPE::NSEC3: {
+                std::uint8_t algorithm = reader.readU8();
+                std::uint8_t flags = reader.readU8();
+                std::uint16_t iterations = reader.readU16();
+                std::vector<uint8_t> salt(reader.readU8());
+                for (auto& b : salt) b = reader.readU8();
+                std::vector<uint8_t> next(reader.readU8());
+                for (auto& b : next) b = reader.readU8();
+                std::vector<uint16_t> types = readTypeBitmap(reader, expectedEnd);
+                record = std::make_shared<NSEC3Record>(name, ttl, algorithm, flags, iterations, salt, next, types);
+                break;
+            }
+            case TYPE::OPT: {
+                // The class is the payload size, the TTL the extended rcode, version and flags
+                record = std::make_shared<OPTRecord>(klass, (ttl & OPTRecord::DO_BIT) != 0);
+                break;
+            }
             default: {
                 std::vector<uint8_t> data;
                 data.reserve(rdlength);
@@ -0,0 +1,42 @@
+#include "records/DNSKEYRecord.hpp"
+#include "utils/utils.hpp"
+#include <sstream>
+
+namespace dnslib {
+
+    void DNSKEYRecord::serialize(std::vector<uint8_t>& buff) const {
+        ResourceRecord::serialize(buff);
+
+        std::vector<uint8_t> rdata = getRdata();
+        utils::writeU16(buff, rdata.size());
+        buff.insert(buff.end(), rdata.begin(), rdata.end());
+    }
+
+    std::string DNSKEYRecord::toString() const {
+        std::stringstream ss;
+        ss << name << " " << ttl << " IN DNSKEY " << flags << " " << static_cast<int>(protocol) << " "
+           << static_cast<int>(algorithm) << " " << utils::toBase64(publicKey);
+        return ss.str();
+    }
+
+    std::vector<uint8_t> DNSKEYRecord::getRdata() const {
+        std::vector<uint8_t> rdata;
+        rdata.reserve(4 + publicKey.size());
+        utils::writeU16(rdata, flags);
+        utils::writeU8(rdata, protocol);
+        utils::writeU8(rdata, algorithm);
+        rdata.insert(rdata.end(), publicKey.begin(), publicKey.end());
+        return rdata;
+    }
+
+    std::uint16_t DNSKEYRecord::keyTag() const {
+        std::vector<uint8_t> rdata = getRdata();
+
+        uint32_t accumulator = 0;
+        for (size_t i = 0; i < rdata.size(); i++) {
+            accumulator += (i & 1) ? rdata[i] : rdata[i] << 8;
+        }
+        accumulator += (accumulator >> 16) & 0xFFFF;
+        return accumulator & 0xFFFF;
+    }
+}
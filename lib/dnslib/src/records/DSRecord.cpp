@@ -0,0 +1,27 @@
+#include "records/DSRecord.hpp"
+#include "utils/utils.hpp"
+#include <iomanip>
+#include <sstream>
+
+namespace dnslib {
+
+    void DSRecord::serialize(std::vector<uint8_t>& buff) const {
+        ResourceRecord::serialize(buff);
+
+        utils::writeU16(buff, 4 + digest.size());
+        utils::writeU16(buff, keyTag);
+        utils::writeU8(buff, algorithm);
+        utils::writeU8(buff, digestType);
+        buff.insert(buff.end(), digest.begin(), digest.end());
+    }
+
+    std::string DSRecord::toString() const {
+        std::stringstream ss;
+        ss << name << " " << ttl << " IN DS " << keyTag << " " << static_cast<int>(algorithm) << " "
+           << static_cast<int>(digestType) << " ";
+        for (auto b : digest) {
+            ss << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << static_cast<int>(b);
+        }
+        return ss.str();
+    }
+}
@@ -0,0 +1,46 @@
+#include "records/NSEC3Record.hpp"
+#include "utils/utils.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace dnslib {
+
+    void NSEC3Record::serialize(std::vector<uint8_t>& buff) const {
+        ResourceRecord::serialize(buff);
+
+        std::vector<uint8_t> tmp;
+        utils::writeU8(tmp, hashAlgorithm);
+        utils::writeU8(tmp, flags);
+        utils::writeU16(tmp, iterations);
+        utils::writeU8(tmp, salt.size());
+        tmp.insert(tmp.end(), salt.begin(), salt.end());
+        utils::writeU8(tmp, nextHashed.size());
+        tmp.insert(tmp.end(), nextHashed.begin(), nextHashed.end());
+        utils::writeTypeBitmap(tmp, types);
+
+        utils::writeU16(buff, tmp.size());
+        buff.insert(buff.end(), tmp.begin(), tmp.end());
+    }
+
+    std::string NSEC3Record::toString() const {
+        std::stringstream ss;
+        ss << name << " " << ttl << " IN NSEC3 " << static_cast<int>(hashAlgorithm) << " " << static_cast<int>(flags)
+           << " " << iterations << " ";
+        if (salt.empty()) {
+            ss << "-";
+        }
+        for (auto b : salt) {
+            ss << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << static_cast<int>(b);
+        }
+        ss << std::dec << " " << utils::toBase32Hex(nextHashed);
+        for (auto t : types) {
+            ss << " TYPE" << t;
+        }
+        return ss.str();
+    }
+
+    bool NSEC3Record::hasType(uint16_t type) const {
+        return std::binary_search(types.begin(), types.end(), type);
+    }
+}
@@ -0,0 +1,31 @@
+#include "records/NSECRecord.hpp"
+#include "utils/utils.hpp"
+#include <algorithm>
+#include <sstream>
+
+namespace dnslib {
+
+    void NSECRecord::serialize(std::vector<uint8_t>& buff) const {
+        ResourceRecord::serialize(buff);
+
+        std::vector<uint8_t> tmp;
+        utils::writeDomain(tmp, nextName);
+        utils::writeTypeBitmap(tmp, types);
+
+        utils::writeU16(buff, tmp.size());
+        buff.insert(buff.end(), tmp.begin(), tmp.end());
+    }
+
+    std::string NSECRecord::toString() const {
+        std::stringstream ss;
+        ss << name << " " << ttl << " IN NSEC " << nextName;
+        for (auto t : types) {
+            ss << " TYPE" << t;
+        }
+        return ss.str();
+    }
+
+    bool NSECRecord::hasType(uint16_t type) const {
+        return std::binary_search(types.begin(), types.end(), type);
+    }
+}
@@ -0,0 +1,21 @@
+#include "records/OPTRecord.hpp"
+#include "utils/utils.hpp"
+#include <sstream>
+
+namespace dnslib {
+
+    void OPTRecord::serialize(std::vector<uint8_t>& buff) const {
+        utils::writeDomain(buff, "");
+        utils::writeU16(buff, type);
+        utils::writeU16(buff, udpPayloadSize);
+        utils::writeU32(buff, ttl);
+        // No options
+        utils::writeU16(buff, 0);
+    }
+
+    std::string OPTRecord::toString() const {
+        std::stringstream ss;
+        ss << "OPT udp=" << udpPayloadSize << (dnssecOk ? " do" : "");
+        return ss.str();
+    }
+}
@@ -0,0 +1,41 @@
+#include "records/RRSIGRecord.hpp"
+#include "utils/utils.hpp"
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+namespace dnslib {
+
+    void RRSIGRecord::serialize(std::vector<uint8_t>& buff) const {
+        ResourceRecord::serialize(buff);
+
+        std::vector<uint8_t> tmp;
+        writeSignedFields(tmp);
+        tmp.insert(tmp.end(), signature.begin(), signature.end());
+
+        utils::writeU16(buff, tmp.size());
+        buff.insert(buff.end(), tmp.begin(), tmp.end());
+    }
+
+    void RRSIGRecord::writeSignedFields(std::vector<uint8_t>& buff) const {
+        utils::writeU16(buff, typeCovered);
+        utils::writeU8(buff, algorithm);
+        utils::writeU8(buff, labels);
+        utils::writeU32(buff, originalTtl);
+        utils::writeU32(buff, expiration);
+        utils::writeU32(buff, inception);
+        utils::writeU16(buff, keyTag);
+
+        std::string signer = signerName;
+        std::transform(signer.begin(), signer.end(), signer.begin(), [](unsigned char c) { return std::tolower(c); });
+        utils::writeDomain(buff, signer);
+    }
+
+    std::string RRSIGRecord::toString() const {
+        std::stringstream ss;
+        ss << name << " " << ttl << " IN RRSIG " << typeCovered << " " << static_cast<int>(algorithm) << " "
+           << static_cast<int>(labels) << " " << originalTtl << " " << expiration << " " << inception << " "
+           << keyTag << " " << signerName << " " << utils::toBase64(signature);
+        return ss.str();
+    }
+}
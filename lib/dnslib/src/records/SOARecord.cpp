@@ -0,0 +1,30 @@
+#include "records/SOARecord.hpp"
+#include "utils/utils.hpp"
+#include <vector>
+#include <sstream>
+
+namespace dnslib {
+
+    void SOARecord::serialize(std::vector<uint8_t>& buff) const {
+        ResourceRecord::serialize(buff);
+
+        std::vector<uint8_t> tmp;
+        utils::writeDomain(tmp, mname);
+        utils::writeDomain(tmp, rname);
+        utils::writeU32(tmp, serial);
+        utils::writeU32(tmp, refresh);
+        utils::writeU32(tmp, retry);
+        utils::writeU32(tmp, expire);
+        utils::writeU32(tmp, minimum);
+
+        utils::writeU16(buff, tmp.size());
+        buff.insert(buff.end(), tmp.begin(), tmp.end());
+    }
+
+    std::string SOARecord::toString() const {
+        std::stringstream ss;
+        ss << name << " " << ttl << " IN SOA " << mname << " " << rname << " "
+           << serial << " " << refresh << " " << retry << " " << expire << " " << minimum;
+        return ss.str();
+    }
+}
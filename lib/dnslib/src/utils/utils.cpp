@@ -56,4 +56,60 @@ namespace dnslib::utils {
         buffer.push_back(0x00);
     }
 
-}
\ No newline at end of file
+    std::string toBase64(const std::vector<uint8_t>& data) {
+        static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        std::string out;
+        out.reserve((data.size() + 2) / 3 * 4);
+        for (size_t i = 0; i < data.size(); i += 3) {
+            uint32_t chunk = data[i] << 16;
+            if (i + 1 < data.size()) chunk |= data[i + 1] << 8;
+            if (i + 2 < data.size()) chunk |= data[i + 2];
+
+            out += alphabet[(chunk >> 18) & 0x3F];
+            out += alphabet[(chunk >> 12) & 0x3F];
+            out += i + 1 < data.size() ? alphabet[(chunk >> 6) & 0x3F] : '=';
+            out += i + 2 < data.size() ? alphabet[chunk & 0x3F] : '=';
+        }
+        return out;
+    }
+
+    std::string toBase32Hex(const std::vector<uint8_t>& data) {
+        static const char alphabet[] = "0123456789abcdefghijklmnopqrstuv";
+
+        std::string out;
+        uint32_t bits = 0;
+        int pending = 0;
+        for (uint8_t b : data) {
+            bits = (bits << 8) | b;
+            pending += 8;
+            while (pending >= 5) {
+                out += alphabet[(bits >> (pending - 5)) & 0x1F];
+                pending -= 5;
+            }
+        }
+        if (pending > 0) {
+            out += alphabet[(bits << (5 - pending)) & 0x1F];
+        }
+        return out;
+    }
+
+    void writeTypeBitmap(std::vector<uint8_t>& buffer, const std::vector<uint16_t>& types) {
+        size_t i = 0;
+        while (i < types.size()) {
+            uint8_t window = types[i] >> 8;
+            uint8_t bitmap[32] = {};
+            int length = 0;
+            for (; i < types.size() && (types[i] >> 8) == window; i++) {
+                uint8_t low = types[i] & 0xFF;
+                bitmap[low / 8] |= 0x80 >> (low % 8);
+                length = low / 8 + 1;
+            }
+
+            buffer.push_back(window);
+            buffer.push_back(length);
+            buffer.insert(buffer.end(), bitmap, bitmap + length);
+        }
+    }
+
+}
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include "dns.hpp"
+
+using namespace dnslib;
+
+// RFC 4034, section 5.4: example.com. DNSKEY 256 3 5, key tag 60485
+static const std::vector<uint8_t> EXAMPLE_KEY = {
+    0x01, 0x03, 0x9e, 0x8a, 0x24, 0x74, 0x18, 0xe3, 0x18, 0x90, 0x3b, 0x21, 0x5a,
+    0x84, 0x8a, 0xcf, 0xd5, 0xf3, 0x7f, 0x02, 0x6b, 0xd4, 0x06, 0x2d, 0xb2, 0x6c,
+    0x77, 0x4c, 0x69, 0x09, 0x68, 0xd5, 0xd5, 0x6d, 0xf8, 0xbf, 0xda, 0x91, 0xe6,
+    0xf3, 0x6d, 0x9a, 0x27, 0x98, 0x88, 0xf4, 0x13, 0x33, 0x35, 0x7c, 0x5e, 0x60,
+    0x29, 0x99, 0x0d, 0x10, 0xfd, 0xf5, 0x66, 0x30, 0x62, 0xa5, 0x12, 0x76, 0x33,
+    0x26, 0x98, 0x0a, 0x61, 0x5d, 0xdb, 0xf1, 0x7a, 0x05, 0xdd, 0xfc, 0xce, 0x7e,
+    0x5f, 0xb3, 0xab, 0xcc, 0xa0, 0x5a, 0x31, 0xb0, 0x95, 0x74, 0x52, 0xd4, 0x52,
+    0x1e, 0x83, 0x87, 0x07, 0x89, 0x06, 0x31, 0x15, 0xbf, 0x97, 0xf6, 0xc3, 0x08,
+    0xcc, 0xf5, 0x7c, 0xdc, 0x9c, 0xe7, 0xfe, 0x10, 0xf6, 0xed, 0x1b, 0xd0, 0xcc,
+    0x06, 0x60, 0x03, 0x8c, 0x50, 0xdc, 0xdb, 0x0f, 0xeb, 0x96, 0x3c, 0x2f, 0x17
+};
+
+static DNSPacket RoundTrip(const std::shared_ptr<ResourceRecord>& record) {
+    auto packet = PacketBuilder().setId(1).withFlags(F_RESPONSE).addQuestion("example.com", TYPE::A)
+        .addAnswer(record).build();
+    std::vector<uint8_t> bytes;
+    packet.serialize(bytes);
+    return PacketParser::parse(bytes);
+}
+
+TEST(DNSKEYRecordTest, KeyTagMatchesRfcExample) {
+    DNSKEYRecord key("example.com", 86400, DNSKEYRecord::ZONE_KEY, 3, 5, EXAMPLE_KEY);
+    EXPECT_EQ(key.keyTag(), 60485);
+}
+
+TEST(DNSKEYRecordTest, ParsesBackFromWire) {
+    auto parsed = RoundTrip(std::make_shared<DNSKEYRecord>("example.com", 86400, 257, 3, 5, EXAMPLE_KEY));
+    ASSERT_EQ(parsed.getAnswers().size(), 1u);
+
+    auto key = std::dynamic_pointer_cast<DNSKEYRecord>(parsed.getAnswers()[0]);
+    ASSERT_TRUE(key);
+    EXPECT_EQ(key->getFlags(), 257);
+    EXPECT_EQ(key->getProtocol(), 3);
+    EXPECT_EQ(key->getAlgorithm(), 5);
+    EXPECT_EQ(key->getPublicKey(), EXAMPLE_KEY);
+}
+
+TEST(DSRecordTest, ParsesBackFromWire) {
+    std::vector<uint8_t> digest(32, 0xAB);
+    auto parsed = RoundTrip(std::make_shared<DSRecord>("example.com", 3600, 60485, 5, 2, digest));
+
+    auto ds = std::dynamic_pointer_cast<DSRecord>(parsed.getAnswers()[0]);
+    ASSERT_TRUE(ds);
+    EXPECT_EQ(ds->getKeyTag(), 60485);
+    EXPECT_EQ(ds->getAlgorithm(), 5);
+    EXPECT_EQ(ds->getDigestType(), 2);
+    EXPECT_EQ(ds->getDigest(), digest);
+}
+
+TEST(RRSIGRecordTest, ParsesBackFromWire) {
+    std::vector<uint8_t> signature = {1, 2, 3, 4, 5};
+    auto parsed = RoundTrip(std::make_shared<RRSIGRecord>(
+        "host.example.com", 3600, 1, 13, 3, 3600, 1893456000, 1861920000, 60485, "example.com", signature));
+
+    auto sig = std::dynamic_pointer_cast<RRSIGRecord>(parsed.getAnswers()[0]);
+    ASSERT_TRUE(sig);
+    EXPECT_EQ(sig->getTypeCovered(), 1);
+    EXPECT_EQ(sig->getAlgorithm(), 13);
+    EXPECT_EQ(sig->getLabels(), 3);
+    EXPECT_EQ(sig->getOriginalTtl(), 3600u);
+    EXPECT_EQ(sig->getExpiration(), 1893456000u);
+    EXPECT_EQ(sig->getInception(), 1861920000u);
+    EXPECT_EQ(sig->getKeyTag(), 60485);
+    EXPECT_EQ(sig->getSignerName(), "example.com");
+    EXPECT_EQ(sig->getSignature(), signature);
+}
+
+TEST(RRSIGRecordTest, SignedFieldsHaveALowercaseSigner) {
+    RRSIGRecord sig("host.example.com", 3600, 1, 13, 3, 3600, 2, 1, 7, "Example.COM", {9});
+    std::vector<uint8_t> fields;
+    sig.writeSignedFields(fields);
+
+    std::vector<uint8_t> expected = {
+        0, 1, 13, 3, 0, 0, 0x0E, 0x10, 0, 0, 0, 2, 0, 0, 0, 1, 0, 7,
+        7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 3, 'c', 'o', 'm', 0
+    };
+    EXPECT_EQ(fields, expected);
+}
+
+TEST(OPTRecordTest, CarriesPayloadSizeAndDnssecOk) {
+    auto packet = PacketBuilder().setId(1).addQuestion("example.com", TYPE::A)
+        .addAdditional(std::make_shared<OPTRecord>(1232, true)).build();
+    std::vector<uint8_t> bytes;
+    packet.serialize(bytes);
+
+    // Root name, type 41, payload size as the class, DO as the top bit of the flags
+    std::vector<uint8_t> expected = {0, 0, 41, 0x04, 0xD0, 0, 0, 0x80, 0, 0, 0};
+    ASSERT_GE(bytes.size(), expected.size());
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), bytes.end() - expected.size()));
+
+    auto opt = std::dynamic_pointer_cast<OPTRecord>(PacketParser::parse(bytes).getAdditional()[0]);
+    ASSERT_TRUE(opt);
+    EXPECT_EQ(opt->getUdpPayloadSize(), 1232);
+    EXPECT_TRUE(opt->getDnssecOk());
+}
+
+TEST(NSECRecordTest, TypeBitmapRoundTrips) {
+    // A, MX, RRSIG, NSEC and a type of the second window (RFC 4034, section 4.3)
+    std::vector<uint16_t> types = {1, 15, 46, 47, 1234};
+    auto parsed = RoundTrip(std::make_shared<NSECRecord>("alfa.example.com", 3600, "host.example.com", types));
+
+    auto nsec = std::dynamic_pointer_cast<NSECRecord>(parsed.getAnswers()[0]);
+    ASSERT_TRUE(nsec);
+    EXPECT_EQ(nsec->getNextName(), "host.example.com");
+    EXPECT_EQ(nsec->getTypes(), types);
+    EXPECT_TRUE(nsec->hasType(15));
+    EXPECT_FALSE(nsec->hasType(2));
+
+    std::vector<uint8_t> bitmap;
+    utils::writeTypeBitmap(bitmap, {1, 15, 46, 47});
+    std::vector<uint8_t> expected = {0x00, 0x06, 0x40, 0x01, 0x00, 0x00, 0x00, 0x03};
+    EXPECT_EQ(bitmap, expected);
+}
+
+TEST(NSEC3RecordTest, ParsesBackFromWire) {
+    std::vector<uint8_t> salt = {0xAA, 0xBB, 0xCC, 0xDD};
+    std::vector<uint8_t> next(20, 0x11);
+    auto parsed = RoundTrip(std::make_shared<NSEC3Record>(
+        "0p9mhaveqvm6t7vbl5lop2u3t2rp3tom.example", 3600, 1, NSEC3Record::OPT_OUT, 12, salt, next, std::vector<uint16_t>{2, 43}));
+
+    auto nsec3 = std::dynamic_pointer_cast<NSEC3Record>(parsed.getAnswers()[0]);
+    ASSERT_TRUE(nsec3);
+    EXPECT_EQ(nsec3->getHashAlgorithm(), 1);
+    EXPECT_TRUE(nsec3->optOut());
+    EXPECT_EQ(nsec3->getIterations(), 12);
+    EXPECT_EQ(nsec3->getSalt(), salt);
+    EXPECT_EQ(nsec3->getNextHashed(), next);
+    EXPECT_TRUE(nsec3->hasType(43));
+}
+
+TEST(UtilsTest, EncodesBase64AndBase32Hex) {
+    EXPECT_EQ(utils::toBase64({'f', 'o', 'o', 'b'}), "Zm9vYg==");
+    EXPECT_EQ(utils::toBase64({'f', 'o', 'o', 'b', 'a', 'r'}), "Zm9vYmFy");
+    // RFC 4648 test vectors, lowercase and unpadded
+    EXPECT_EQ(utils::toBase32Hex({'f', 'o', 'o', 'b'}), "cpnmuog");
+    EXPECT_EQ(utils::toBase32Hex({'f', 'o', 'o', 'b', 'a'}), "cpnmuoj1");
+}
@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include <arpa/inet.h>
+#include <fstream>
+#include <iterator>
 #include "dns.hpp"
 
 using namespace dnslib;
@@ -45,4 +47,26 @@ TEST_F(DnsPacketTest, EncodeDecodeCycle) {
     
     // ASSERT_NE(aRecord, nullptr); // Czy to na pewno ARecord?
     // EXPECT_EQ(aRecord->getIpAddress(), inet_addr(expectedIp.c_str()));
-}
\ No newline at end of file
+}
+TEST(ParserResourceTest, ParsesNoDataResponseWithSOA) {
+    std::string dir = std::string(__FILE__).substr(0, std::string(__FILE__).rfind('/'));
+    std::ifstream file(dir + "/resrc/response_1_github_soa.bin", std::ios::binary);
+    ASSERT_TRUE(file.is_open());
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    auto packet = PacketParser::parse(bytes);
+
+    EXPECT_TRUE(packet.getHeader().isResponse());
+    EXPECT_EQ(packet.getHeader().rcode(), RCODE::NOERROR);
+    EXPECT_TRUE(packet.getAnswers().empty());
+
+    ASSERT_EQ(packet.getAuthority().size(), 1);
+    auto soa = std::dynamic_pointer_cast<SOARecord>(packet.getAuthority()[0]);
+    ASSERT_NE(soa, nullptr);
+    EXPECT_EQ(soa->getName(), "github.com");
+    EXPECT_EQ(soa->getTtl(), 898);
+    EXPECT_EQ(soa->getMname(), "ns-1707.awsdns-21.co.uk");
+    EXPECT_EQ(soa->getRname(), "awsdns-hostmaster.amazon.com");
+    EXPECT_EQ(soa->getRefresh(), 7200);
+    EXPECT_EQ(soa->getMinimum(), 86400);
+}
@@ -204,3 +204,75 @@ TEST(MXRecordTest, SerializeMXRecord) {
     EXPECT_EQ(buffer, expected_buffer);
 }
 
+// -------------
+//      SOA
+// -------------
+TEST(SOARecordTest, CreateSOARecord) {
+    SOARecord record("example.com", 3600, "ns.example.com", "admin.example.com", 1, 7200, 900, 1209600, 300);
+    EXPECT_EQ(record.getName(), "example.com");
+    EXPECT_EQ(record.getTtl(), 3600);
+    EXPECT_EQ(record.getMname(), "ns.example.com");
+    EXPECT_EQ(record.getRname(), "admin.example.com");
+    EXPECT_EQ(record.getSerial(), 1);
+    EXPECT_EQ(record.getMinimum(), 300);
+}
+
+TEST(SOARecordTest, ToStringSOARecord) {
+    SOARecord record("example.com", 3600, "ns.example.com", "admin.example.com", 1, 7200, 900, 1209600, 300);
+    std::string expected = "example.com 3600 IN SOA ns.example.com admin.example.com 1 7200 900 1209600 300";
+    EXPECT_EQ(record.toString(), expected);
+}
+
+TEST(SOARecordTest, SerializeSOARecord) {
+    SOARecord record("a.com", 3600, "ns.a.com", "me.a.com", 1, 2, 3, 4, 5);
+    std::vector<uint8_t> buffer;
+    record.serialize(buffer);
+
+    std::vector<uint8_t> expected_buffer = {
+        // Name: a.com
+        1, 'a', 3, 'c', 'o', 'm', 0,
+        // Type: SOA (6)
+        0, 6,
+        // Class: IN (1)
+        0, 1,
+        // TTL: 3600
+        0, 0, 0x0E, 0x10,
+        // RDLENGTH: 40 (2 * 10 bytes of names + 5 * 4 bytes of counters)
+        0, 40,
+        // MNAME: ns.a.com
+        2, 'n', 's', 1, 'a', 3, 'c', 'o', 'm', 0,
+        // RNAME: me.a.com
+        2, 'm', 'e', 1, 'a', 3, 'c', 'o', 'm', 0,
+        // SERIAL, REFRESH, RETRY, EXPIRE, MINIMUM
+        0, 0, 0, 1,
+        0, 0, 0, 2,
+        0, 0, 0, 3,
+        0, 0, 0, 4,
+        0, 0, 0, 5
+    };
+
+    EXPECT_EQ(buffer, expected_buffer);
+}
+
+TEST(SOARecordTest, EncodeDecodeSOARecord) {
+    auto packet = PacketBuilder()
+        .setId(1)
+        .withFlags(F_RESPONSE)
+        .withRcode(RCODE::NAMEERROR)
+        .addQuestion("missing.a.com", TYPE::A)
+        .addAuthority(std::make_shared<SOARecord>("a.com", 3600, "ns.a.com", "me.a.com", 1, 2, 3, 4, 5))
+        .build();
+
+    std::vector<uint8_t> bytes;
+    packet.serialize(bytes);
+    auto parsed = PacketParser::parse(bytes);
+
+    EXPECT_EQ(parsed.getHeader().rcode(), RCODE::NAMEERROR);
+    ASSERT_EQ(parsed.getAuthority().size(), 1);
+    auto soa = std::dynamic_pointer_cast<SOARecord>(parsed.getAuthority()[0]);
+    ASSERT_NE(soa, nullptr);
+    EXPECT_EQ(soa->getMname(), "ns.a.com");
+    EXPECT_EQ(soa->getRname(), "me.a.com");
+    EXPECT_EQ(soa->getExpire(), 4);
+    EXPECT_EQ(soa->getMinimum(), 5);
+}
@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <set>
+#include <thread>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "dns.hpp"
+
+using namespace dnslib;
+using namespace std::chrono_literals;
+
+// Answers every A query sent to it on 127.0.0.1, or drops it, or first sends answers that must be ignored
+class LoopbackServer {
+public:
+    enum class Mode { ANSWER, DROP, MISMATCH_FIRST };
+
+    explicit LoopbackServer(Mode mode) : mode(mode) {
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        socklen_t length = sizeof(address);
+        getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+
+        int buffer = 4 << 20;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+        timeval timeout{0, 50000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        worker = std::thread([this] { run(); });
+    }
+
+    ~LoopbackServer() {
+        stop = true;
+        worker.join();
+        close(fd);
+    }
+
+    sockaddr_in address{};
+    std::atomic<size_t> queries{0};
+
+private:
+    Mode mode;
+    int fd;
+    std::atomic<bool> stop{false};
+    std::thread worker;
+
+    void reply(const sockaddr_in& client, uint16_t id, const std::string& name) {
+        std::vector<uint8_t> wire;
+        PacketBuilder(id)
+            .withFlags(F_RESPONSE | F_RECURSION_DES | F_RECURSION_AVAIL)
+            .addQuestion(name, TYPE::A)
+            .addAnswer(std::make_shared<ARecord>(name, 60, "10.0.0.1"))
+            .build()
+            .serialize(wire);
+        sendto(fd, wire.data(), wire.size(), 0, reinterpret_cast<const sockaddr*>(&client), sizeof(client));
+    }
+
+    void run() {
+        std::vector<uint8_t> buffer(512);
+        while (!stop) {
+            sockaddr_in client{};
+            socklen_t length = sizeof(client);
+            ssize_t size = recvfrom(fd, buffer.data(), buffer.size(), 0, reinterpret_cast<sockaddr*>(&client), &length);
+            if (size <= 0) continue;
+            queries++;
+            if (mode == Mode::DROP) continue;
+
+            auto query = PacketParser::parse(std::vector<uint8_t>(buffer.begin(), buffer.begin() + size));
+            uint16_t id = query.getHeader().getId();
+            const std::string& name = query.getQuestions()[0].getName();
+            if (mode == Mode::MISMATCH_FIRST) {
+                // Another ID, then the right ID for another name, both to be ignored
+                reply(client, id + 1, name);
+                reply(client, id, "other." + name);
+            }
+            reply(client, id, name);
+        }
+    }
+};
+
+static void PollUntilDone(StubResolver& resolver, std::chrono::milliseconds limit = 5000ms) {
+    auto until = StubResolver::Clock::now() + limit;
+    while (resolver.pending() > 0 && StubResolver::Clock::now() < until) {
+        resolver.poll(10ms);
+    }
+}
+
+TEST(StubResolverTest, AnswersThousandsOfConcurrentLookups) {
+    LoopbackServer server(LoopbackServer::Mode::ANSWER);
+    StubResolver resolver(server.address, {4, 500ms, 4, true});
+
+    constexpr size_t LOOKUPS = 5000;
+    size_t answered = 0;
+    for (size_t i = 0; i < LOOKUPS; i++) {
+        std::string name = "host" + std::to_string(i) + ".example.com";
+        resolver.submit(name, TYPE::A, [&, name](LookupResult result) {
+            ASSERT_EQ(result.status, LookupStatus::ANSWERED);
+            EXPECT_EQ(result.response->getQuestions()[0].getName(), name);
+            EXPECT_EQ(result.response->getAnswers().size(), 1u);
+            answered++;
+        });
+    }
+    PollUntilDone(resolver);
+
+    EXPECT_EQ(answered, LOOKUPS);
+    EXPECT_EQ(resolver.pending(), 0u);
+}
+
+TEST(StubResolverTest, TimesOutAfterEveryAttempt) {
+    LoopbackServer server(LoopbackServer::Mode::DROP);
+    StubResolver resolver(server.address, {1, 50ms, 3, true});
+
+    std::optional<LookupResult> result;
+    resolver.submit("example.com", TYPE::A, [&](LookupResult r) { result = std::move(r); });
+    PollUntilDone(resolver);
+
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(result->status, LookupStatus::TIMEOUT);
+    EXPECT_FALSE(result->response.has_value());
+    EXPECT_EQ(server.queries, 3u);
+}
+
+TEST(StubResolverTest, IgnoresAnswersThatDoNotMatchTheQuery) {
+    LoopbackServer server(LoopbackServer::Mode::MISMATCH_FIRST);
+    StubResolver resolver(server.address, {1, 1000ms, 1, true});
+
+    std::optional<LookupResult> result;
+    resolver.submit("WWW.Example.com", TYPE::A, [&](LookupResult r) { result = std::move(r); });
+    PollUntilDone(resolver);
+
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(result->status, LookupStatus::ANSWERED);
+    EXPECT_EQ(result->response->getQuestions()[0].getName(), "WWW.Example.com");
+}
+
+TEST(StubResolverTest, QueuesResultsAndSignalsTheEventfd) {
+    LoopbackServer server(LoopbackServer::Mode::ANSWER);
+    StubResolver resolver(server.address);
+
+    auto first = resolver.submit("a.example.com", TYPE::A);
+    auto second = resolver.submit("b.example.com", TYPE::A);
+    PollUntilDone(resolver);
+
+    uint64_t signalled = 0;
+    ASSERT_EQ(read(resolver.completionFd(), &signalled, sizeof(signalled)), static_cast<ssize_t>(sizeof(signalled)));
+    EXPECT_EQ(signalled, 2u);
+    // Put the count back, takeCompleted() resets it
+    ASSERT_EQ(write(resolver.completionFd(), &signalled, sizeof(signalled)), static_cast<ssize_t>(sizeof(signalled)));
+
+    auto results = resolver.takeCompleted();
+    ASSERT_EQ(results.size(), 2u);
+    std::set<uint64_t> tickets{results[0].ticket, results[1].ticket};
+    EXPECT_EQ(tickets, (std::set<uint64_t>{first, second}));
+    EXPECT_EQ(read(resolver.completionFd(), &signalled, sizeof(signalled)), -1);
+    EXPECT_TRUE(resolver.takeCompleted().empty());
+}
@@ -0,0 +1,306 @@
+#include "blocklist.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+
+// About 1% false positives
+constexpr size_t BLOOM_BITS_PER_RULE = 10;
+constexpr int BLOOM_HASHES = 7;
+
+// Names hosts files map to themselves, not meant as rules
+static const std::vector<std::string_view> HOSTS_NOISE = {
+    "localhost", "localhost.localdomain", "local", "broadcasthost", "ip6-localhost", "ip6-loopback", "0.0.0.0",
+};
+
+static std::string_view LabelAt(const std::string& key, size_t start) {
+    size_t end = std::min(key.find('\0', start), key.size());
+    return std::string_view(key).substr(start, end - start);
+}
+
+// FNV-1a of a label, folded into the hash of the labels above it
+static uint64_t HashLabel(uint64_t parent, std::string_view label) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : label) {
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    }
+    hash ^= parent + 0x9e3779b97f4a7c15ULL + (parent << 6) + (parent >> 2);
+    return hash;
+}
+
+static uint64_t Mix(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+bool Blocklist::Builder::add(std::string_view rule) {
+    uint8_t flag = EXACT;
+    if (rule.starts_with("*.")) {
+        flag = SUBTREE;
+        rule.remove_prefix(2);
+    }
+    if (rule.ends_with('.')) {
+        rule.remove_suffix(1);
+    }
+    if (rule.empty() || rule.size() > 253) {
+        return false;
+    }
+
+    std::vector<std::string_view> parts;
+    size_t start = 0;
+    while (start <= rule.size()) {
+        size_t end = std::min(rule.find('.', start), rule.size());
+        if (end == start || end - start > 63) return false;
+        parts.push_back(rule.substr(start, end - start));
+        start = end + 1;
+    }
+
+    std::string key;
+    key.reserve(rule.size());
+    for (auto it = parts.rbegin(); it != parts.rend(); ++it) {
+        if (!key.empty()) key += '\0';
+        for (unsigned char c : *it) {
+            if (!std::isalnum(c) && c != '-' && c != '_') return false;
+            key += static_cast<char>(std::tolower(c));
+        }
+    }
+
+    rules.emplace_back(std::move(key), flag);
+    return true;
+}
+
+/**
+ * Creates the children of node from rules[lo, hi), which all continue below
+ * it with a label starting at offset start of their key. Single-child chains
+ * without rules of their own become one edge.
+ */
+void Blocklist::Builder::buildChildren(Blocklist& list, uint32_t node, size_t lo, size_t hi, size_t start, std::unordered_map<std::string, uint32_t>& interned) {
+    struct Group {
+        size_t lo;
+        size_t hi;
+        size_t edgeEnd;
+    };
+    std::vector<Group> groups;
+
+    for (size_t i = lo; i < hi;) {
+        std::string_view label = LabelAt(rules[i].first, start);
+        size_t j = i + 1;
+        while (j < hi && LabelAt(rules[j].first, start) == label) j++;
+
+        size_t edgeEnd = start + label.size();
+        // Sorted keys: only the first of the group can end here, and if the first and
+        // the last share the next label every key in between does
+        while (rules[i].first.size() != edgeEnd) {
+            std::string_view next = LabelAt(rules[i].first, edgeEnd + 1);
+            if (rules[j - 1].first.size() <= edgeEnd || LabelAt(rules[j - 1].first, edgeEnd + 1) != next) break;
+            edgeEnd += 1 + next.size();
+        }
+
+        groups.push_back({i, j, edgeEnd});
+        i = j;
+    }
+
+    uint32_t first = static_cast<uint32_t>(list.nodes.size());
+    list.nodes[node].firstChild = first;
+    list.nodes[node].childCount = static_cast<uint32_t>(groups.size());
+    list.nodes.resize(first + groups.size());
+
+    for (size_t g = 0; g < groups.size(); g++) {
+        const auto& group = groups[g];
+        const auto& key = rules[group.lo].first;
+
+        std::string edge = key.substr(start, group.edgeEnd - start);
+        auto [it, inserted] = interned.try_emplace(edge, static_cast<uint32_t>(list.labels.size()));
+        if (inserted) {
+            list.labels += edge;
+        }
+
+        Node& child = list.nodes[first + g];
+        child = Node{};
+        child.edge = it->second;
+        child.edgeLength = static_cast<uint16_t>(edge.size());
+
+        size_t below = group.lo;
+        if (key.size() == group.edgeEnd) {
+            child.flags = rules[group.lo].second;
+            below++;
+        }
+        if (below < group.hi) {
+            buildChildren(list, first + static_cast<uint32_t>(g), below, group.hi, group.edgeEnd + 1, interned);
+        }
+    }
+}
+
+std::shared_ptr<const Blocklist> Blocklist::Builder::build() {
+    std::sort(rules.begin(), rules.end());
+
+    // The same name listed twice keeps the union of its rules
+    size_t unique = 0;
+    for (size_t i = 0; i < rules.size(); i++) {
+        if (unique > 0 && rules[unique - 1].first == rules[i].first) {
+            rules[unique - 1].second |= rules[i].second;
+        } else if (unique++ != i) {
+            rules[unique - 1] = std::move(rules[i]);
+        }
+    }
+    rules.resize(unique);
+
+    auto list = std::make_shared<Blocklist>();
+    list->nodes.push_back(Node{});
+    std::unordered_map<std::string, uint32_t> interned;
+    if (!rules.empty()) {
+        buildChildren(*list, 0, 0, rules.size(), 0, interned);
+    }
+
+    size_t bits = std::max<size_t>(1024, rules.size() * BLOOM_BITS_PER_RULE);
+    list->bloomBits = static_cast<uint32_t>((bits + 63) / 64 * 64);
+    list->bloom.assign(list->bloomBits / 64, 0);
+
+    for (const auto& [key, flags] : rules) {
+        uint64_t hash = 0;
+        for (size_t start = 0; start <= key.size();) {
+            std::string_view label = LabelAt(key, start);
+            hash = HashLabel(hash, label);
+            start += label.size() + 1;
+        }
+
+        uint64_t h2 = Mix(hash) | 1;
+        for (int k = 0; k < BLOOM_HASHES; k++) {
+            uint64_t bit = (hash + k * h2) % list->bloomBits;
+            list->bloom[bit / 64] |= 1ULL << (bit % 64);
+        }
+
+        if (flags & EXACT) list->exactRules++;
+        if (flags & SUBTREE) list->subtreeRules++;
+    }
+
+    list->nodes.shrink_to_fit();
+    list->labels.shrink_to_fit();
+    rules.clear();
+    return list;
+}
+
+bool Blocklist::mayContain(const std::vector<std::string_view>& parts) const {
+    uint64_t hash = 0;
+    for (auto label : parts) {
+        hash = HashLabel(hash, label);
+
+        uint64_t h2 = Mix(hash) | 1;
+        bool present = true;
+        for (int k = 0; k < BLOOM_HASHES && present; k++) {
+            uint64_t bit = (hash + k * h2) % bloomBits;
+            present = bloom[bit / 64] & (1ULL << (bit % 64));
+        }
+        if (present) return true;
+    }
+    return false;
+}
+
+const Blocklist::Node* Blocklist::child(const Node& parent, std::string_view label) const {
+    auto begin = nodes.begin() + parent.firstChild;
+    auto end = begin + parent.childCount;
+
+    auto firstLabel = [this](const Node& node) {
+        std::string_view edge(labels.data() + node.edge, node.edgeLength);
+        return edge.substr(0, edge.find('\0'));
+    };
+    auto it = std::lower_bound(begin, end, label, [&](const Node& node, std::string_view wanted) {
+        return firstLabel(node) < wanted;
+    });
+    if (it == end || firstLabel(*it) != label) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+bool Blocklist::blocked(std::string_view name) const {
+    if (name.ends_with('.')) {
+        name.remove_suffix(1);
+    }
+    if (name.empty() || name.size() > 253) {
+        return false;
+    }
+
+    std::string lower(name);
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    // Labels TLD first
+    std::vector<std::string_view> parts;
+    size_t end = lower.size();
+    while (true) {
+        size_t dot = lower.rfind('.', end - 1);
+        size_t start = dot == std::string::npos ? 0 : dot + 1;
+        parts.push_back(std::string_view(lower).substr(start, end - start));
+        if (dot == std::string::npos) break;
+        if (dot == 0) return false;
+        end = dot;
+    }
+
+    if (!mayContain(parts)) {
+        return false;
+    }
+
+    const Node* node = &nodes[0];
+    size_t i = 0;
+    while (true) {
+        if (node->flags & SUBTREE) return true;
+        if (i == parts.size()) return node->flags & EXACT;
+
+        const Node* next = child(*node, parts[i]);
+        if (next == nullptr) return false;
+
+        // The rest of a merged edge has to match the following labels too
+        std::string_view edge(labels.data() + next->edge, next->edgeLength);
+        size_t pos = parts[i++].size();
+        while (pos < edge.size()) {
+            size_t labelEnd = std::min(edge.find('\0', pos + 1), edge.size());
+            if (i == parts.size() || edge.substr(pos + 1, labelEnd - pos - 1) != parts[i]) return false;
+            i++;
+            pos = labelEnd;
+        }
+        node = next;
+    }
+}
+
+size_t Blocklist::memoryUsage() const {
+    return nodes.capacity() * sizeof(Node) + labels.capacity() + bloom.capacity() * sizeof(uint64_t);
+}
+
+std::shared_ptr<const Blocklist> Blocklist::load(const std::vector<std::string>& files, size_t& skipped) {
+    Builder builder;
+    skipped = 0;
+
+    for (const auto& path : files) {
+        std::ifstream in(path);
+        if (!in) throw std::runtime_error("Cannot read blocklist " + path);
+
+        std::string line;
+        while (std::getline(in, line)) {
+            std::stringstream tokens(line.substr(0, line.find('#')));
+            std::string first;
+            if (!(tokens >> first)) continue;
+
+            // hosts file: 0.0.0.0 name [name...]
+            unsigned char address[16];
+            bool hosts = inet_pton(AF_INET, first.c_str(), address) == 1 || inet_pton(AF_INET6, first.c_str(), address) == 1;
+            if (!hosts) {
+                if (!builder.add(first)) skipped++;
+                continue;
+            }
+
+            std::string name;
+            while (tokens >> name) {
+                if (std::find(HOSTS_NOISE.begin(), HOSTS_NOISE.end(), name) != HOSTS_NOISE.end()) continue;
+                if (!builder.add(name)) skipped++;
+            }
+        }
+    }
+
+    return builder.build();
+}
@@ -1,52 +1,273 @@
 #include "cache.hpp"
 #include "utils/log.hpp"
 
+#include <algorithm>
+#include <bit>
 #include <cstdint>
 #include <optional>
 #include <string>
 #include <vector>
 #include <mutex>
+#include <thread>
 
 
-//std::optional<std::shared_ptr<std::vector<dnslib::ResourceRecord>>> TLRUCache::get(cacheKey key) {
-std::optional<std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>>> TLRUCache::get(cacheKey key) {
+size_t TLRUCache::shardsFor(size_t total, size_t wanted) {
+    if (wanted == 0) {
+        wanted = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // Rounded down, rounding the bound up would leave shards short of MIN_SHARD_CAPACITY
+    size_t fitting = std::bit_floor(std::max<size_t>(total / MIN_SHARD_CAPACITY, 1));
+    return std::min({std::bit_ceil(wanted), MAX_SHARDS, fitting});
+}
+
+TLRUCache::TLRUCache(int capacity, size_t shards) {
+    size_t total = static_cast<size_t>(std::max(capacity, 1));
+    numShards = shardsFor(total, shards);
+    shardBits = std::countr_zero(numShards);
+    this->shards = std::make_unique<Shard[]>(numShards);
+    for (size_t i = 0; i < numShards; i++) {
+        this->shards[i].capacity = (total + numShards - 1) / numShards;
+    }
+}
+
+TLRUCache::Shard& TLRUCache::shardOf(const cacheKey& key) {
+    if (shardBits == 0) return shards[0];
+
+    // Top bits of the mixed hash, the maps inside use the low ones
+    uint64_t mixed = static_cast<uint64_t>(std::hash<cacheKey>()(key)) * 0x9E3779B97F4A7C15ull;
+    return shards[mixed >> (64 - shardBits)];
+}
+
+TLRUCache::List::iterator TLRUCache::Shard::find(const cacheKey& key) {
     auto it = cacheMap.find(key);
     if (it == cacheMap.end()) {
-        return std::nullopt;
+        return list.end();
     }
 
-    // Check if expired
-    if (std::chrono::steady_clock::now() > it->second->expireTime) {
+    // Check if expired, including the time it may still be served stale
+    if (std::chrono::steady_clock::now() > it->second->expireTime + staleWindow) {
         list.erase(it->second);
         cacheMap.erase(it);
         DNS_LOG_DEBUG("Cache entry expired: " + std::to_string(key.type) + ":"+ key.name);
-        return std::nullopt;
+        return list.end();
     }
 
     // Move the accessed element to the front of the list (most recently used)
     list.splice(list.begin(), list, it->second);
 
-    // Return the value
-    return it->second->value;
+    return it->second;
 }
 
-//void TLRUCache::put(cacheKey key, std::shared_ptr<std::vector<dnslib::ResourceRecord>> value, uint32_t TTL) {
-void TLRUCache::put(cacheKey key, std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>> value, uint32_t TTL) {
+bool TLRUCache::Shard::outranked(const cacheKey& key, Trust trust, std::chrono::steady_clock::time_point now) const {
     auto it = cacheMap.find(key);
+    return it != cacheMap.end() && it->second->trust > trust && now <= it->second->expireTime;
+}
+
+void TLRUCache::Shard::insert(CacheEntry entry) {
+    auto it = cacheMap.find(entry.key);
     if (it != cacheMap.end()) {
         list.erase(it->second);
         cacheMap.erase(it);
     }
 
-    auto now = std::chrono::steady_clock::now();
-    auto expireTime = now + std::chrono::seconds(TTL);
-
-    list.push_front(CacheEntry{key, value, expireTime});
+    auto key = entry.key;
+    list.push_front(std::move(entry));
     cacheMap[key] = list.begin();
 
-    if (cacheMap.size() > static_cast<size_t>(capacity) /*cacheMap.size() > capacity*/) {
+    if (cacheMap.size() > capacity) {
         auto keyToEvict = list.back().key;
         list.pop_back();
         cacheMap.erase(keyToEvict);
     }
-}
\ No newline at end of file
+}
+
+void TLRUCache::Shard::countHit(CacheEntry& entry) {
+    entry.hits++;
+    if (prefetchWindow == 0 || entry.prefetchQueued) return;
+
+    auto now = std::chrono::steady_clock::now();
+    auto lifetime = entry.expireTime - entry.insertTime;
+    auto remaining = entry.expireTime - now;
+
+    if (remaining * 100 <= lifetime * prefetchWindow) {
+        double age = std::max(std::chrono::duration<double>(now - entry.insertTime).count(), 1.0);
+        if (entry.hits * 60.0 / age >= prefetchMinRate) {
+            entry.prefetchQueued = true;
+            prefetchQueue.push_back(entry.key);
+        }
+    }
+}
+
+//std::optional<std::shared_ptr<std::vector<dnslib::ResourceRecord>>> TLRUCache::get(cacheKey key) {
+std::optional<std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>>> TLRUCache::get(cacheKey key, Security* security, Trust minTrust,
+                                                                                              std::chrono::steady_clock::time_point* expires) {
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto it = shard.find(key);
+    if (it == shard.list.end() || it->soa || it->trust < minTrust || std::chrono::steady_clock::now() > it->expireTime) {
+        return std::nullopt;
+    }
+    if (security) {
+        *security = it->security;
+    }
+    if (expires) {
+        *expires = it->expireTime;
+    }
+
+    shard.countHit(*it);
+
+    // Return the value
+    return it->value;
+}
+
+//void TLRUCache::put(cacheKey key, std::shared_ptr<std::vector<dnslib::ResourceRecord>> value, uint32_t TTL) {
+bool TLRUCache::put(cacheKey key, std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>> value, uint32_t TTL, Security security, Trust trust) {
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto now = std::chrono::steady_clock::now();
+    if (shard.outranked(key, trust, now)) {
+        return false;
+    }
+    auto expireTime = now + std::chrono::seconds(TTL);
+
+    CacheEntry entry;
+    entry.key = key;
+    entry.value = value;
+    entry.expireTime = expireTime;
+    entry.insertTime = now;
+    entry.security = security;
+    entry.trust = trust;
+    shard.insert(std::move(entry));
+    return true;
+}
+
+std::optional<std::shared_ptr<dnslib::ResourceRecord>> TLRUCache::getNegative(cacheKey key, Security* security, std::chrono::steady_clock::time_point* expires) {
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto it = shard.find(key);
+    if (it == shard.list.end() || !it->soa || std::chrono::steady_clock::now() > it->expireTime) {
+        return std::nullopt;
+    }
+    if (security) {
+        *security = it->security;
+    }
+    if (expires) {
+        *expires = it->expireTime;
+    }
+
+    return it->soa;
+}
+
+std::shared_ptr<const WireAnswer> TLRUCache::getWire(const cacheKey& key, std::chrono::steady_clock::time_point& expires) {
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto it = shard.find(key);
+    if (it == shard.list.end() || !it->wire || std::chrono::steady_clock::now() > it->expireTime) {
+        return nullptr;
+    }
+    expires = it->expireTime;
+
+    // As through get(), negative entries are not refreshed ahead
+    if (!it->soa) {
+        shard.countHit(*it);
+    }
+    return it->wire;
+}
+
+void TLRUCache::attachWire(const cacheKey& key, std::chrono::steady_clock::time_point expires, std::shared_ptr<const WireAnswer> wire) {
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto it = shard.cacheMap.find(key);
+    if (it != shard.cacheMap.end() && it->second->expireTime == expires) {
+        it->second->wire = std::move(wire);
+    }
+}
+
+bool TLRUCache::putNegative(cacheKey key, std::shared_ptr<dnslib::ResourceRecord> soa, uint32_t TTL, Security security) {
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto now = std::chrono::steady_clock::now();
+    if (shard.outranked(key, Trust::AUTHORITY, now)) {
+        return false;
+    }
+    auto expireTime = now + std::chrono::seconds(TTL);
+
+    CacheEntry entry;
+    entry.key = key;
+    entry.soa = soa;
+    entry.expireTime = expireTime;
+    entry.insertTime = now;
+    entry.security = security;
+    entry.trust = Trust::AUTHORITY;
+    shard.insert(std::move(entry));
+    return true;
+}
+
+void TLRUCache::prefetch(const std::vector<cacheKey>& keys) {
+    // First the map nodes, then the entries they point to, which by then have mostly arrived
+    std::vector<std::pair<Shard*, size_t>> buckets;
+    buckets.reserve(keys.size());
+    for (const auto& key : keys) {
+        Shard& shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        if (shard.cacheMap.empty()) continue;
+
+        size_t bucket = shard.cacheMap.bucket(key);
+        auto it = shard.cacheMap.begin(bucket);
+        if (it != shard.cacheMap.end(bucket)) {
+            __builtin_prefetch(&*it);
+        }
+        buckets.emplace_back(&shard, bucket);
+    }
+    for (auto [shard, bucket] : buckets) {
+        // A rehash meanwhile only grows the map, the hint is then just wasted
+        std::lock_guard<std::mutex> lock(shard->mtx);
+        auto it = shard->cacheMap.begin(bucket);
+        if (it != shard->cacheMap.end(bucket)) {
+            __builtin_prefetch(&*it->second);
+        }
+    }
+}
+
+std::optional<std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>>> TLRUCache::getStale(cacheKey key) {
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto it = shard.find(key);
+    if (it == shard.list.end() || it->soa || it->trust < Trust::ANSWER || it->security == Security::BOGUS) {
+        return std::nullopt;
+    }
+
+    return it->value;
+}
+
+void TLRUCache::setStaleWindow(std::chrono::seconds window) {
+    for (size_t i = 0; i < numShards; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mtx);
+        shards[i].staleWindow = window;
+    }
+}
+
+void TLRUCache::setPrefetch(unsigned windowPercent, double minHitsPerMinute) {
+    for (size_t i = 0; i < numShards; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mtx);
+        shards[i].prefetchWindow = windowPercent;
+        shards[i].prefetchMinRate = minHitsPerMinute;
+    }
+}
+
+std::vector<cacheKey> TLRUCache::takePrefetchCandidates() {
+    std::vector<cacheKey> keys;
+    for (size_t i = 0; i < numShards; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mtx);
+        keys.insert(keys.end(), shards[i].prefetchQueue.begin(), shards[i].prefetchQueue.end());
+        shards[i].prefetchQueue.clear();
+    }
+    return keys;
+}
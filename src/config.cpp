@@ -0,0 +1,213 @@
+#include "config.hpp"
+
+#include <arpa/inet.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+const char* value(int argc, char** argv, int& i) {
+    if (i + 1 >= argc) {
+        throw std::invalid_argument(std::string("Missing value for ") + argv[i]);
+    }
+    return argv[++i];
+}
+
+template <typename T>
+T number(int argc, char** argv, int& i) {
+    std::string option = argv[i];
+    std::string text = value(argc, argv, i);
+    try {
+        size_t used = 0;
+        double parsed = std::stod(text, &used);
+        if (used != text.size() || parsed < 0) {
+            throw std::invalid_argument(text);
+        }
+        return static_cast<T>(parsed);
+    } catch (const std::exception&) {
+        throw std::invalid_argument("Invalid value for " + option + ": " + text);
+    }
+}
+
+// ADDR[:PORT], port 53 if not given
+sockaddr_in address(const std::string& text) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(53);
+
+    std::string host = text;
+    auto colon = text.find(':');
+    if (colon != std::string::npos) {
+        host = text.substr(0, colon);
+        std::string port = text.substr(colon + 1);
+        if (port.empty() || port.size() > 5 || port.find_first_not_of("0123456789") != std::string::npos || std::stoul(port) > 65535) {
+            throw std::invalid_argument("Invalid port in upstream address: " + text);
+        }
+        addr.sin_port = htons(static_cast<uint16_t>(std::stoul(port)));
+    }
+
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+        throw std::invalid_argument("Invalid upstream address: " + text);
+    }
+    return addr;
+}
+
+}
+
+ServerConfig parseArgs(int argc, char** argv) {
+    ServerConfig config;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        if (arg == "-d" || arg == "--daemon") {
+            config.daemon = true;
+        } else if (arg == "--threads") {
+            config.threads = number<unsigned>(argc, argv, i);
+        } else if (arg == "--prefetch-window") {
+            config.prefetchWindow = number<unsigned>(argc, argv, i);
+        } else if (arg == "--prefetch-min-rate") {
+            config.prefetchMinRate = number<double>(argc, argv, i);
+        } else if (arg == "--prefetch-limit") {
+            config.prefetchLimit = number<double>(argc, argv, i);
+        } else if (arg == "--stale-window") {
+            config.staleWindow = number<unsigned>(argc, argv, i);
+        } else if (arg == "--stale-answer-timeout") {
+            config.staleAnswerTimeout = number<unsigned>(argc, argv, i);
+        } else if (arg == "--forward") {
+            std::stringstream list(value(argc, argv, i));
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                config.forwarders.push_back(address(item));
+            }
+        } else if (arg == "--hedge-percentile") {
+            config.hedgePercentile = number<double>(argc, argv, i);
+        } else if (arg == "--health-interval") {
+            config.healthInterval = number<unsigned>(argc, argv, i);
+        } else if (arg == "--root-zone") {
+            config.rootZone = value(argc, argv, i);
+        } else if (arg == "--zones") {
+            config.zoneImage = value(argc, argv, i);
+        } else if (arg == "--blocklist") {
+            std::stringstream list(value(argc, argv, i));
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                config.blocklists.push_back(item);
+            }
+        } else if (arg == "--blocklist-sinkhole") {
+            std::string text = value(argc, argv, i);
+            in_addr addr{};
+            if (inet_pton(AF_INET, text.c_str(), &addr) != 1) {
+                throw std::invalid_argument("Invalid sinkhole address: " + text);
+            }
+            config.sinkhole = ntohl(addr.s_addr);
+        } else if (arg == "--ns-max-outstanding") {
+            config.nsMaxOutstanding = number<unsigned>(argc, argv, i);
+        } else if (arg == "--ns-rate") {
+            config.nsQueryRate = number<double>(argc, argv, i);
+        } else if (arg == "--companion-fetch") {
+            config.companionFetch = true;
+        } else if (arg == "--companion-ratio") {
+            config.companionRatio = number<double>(argc, argv, i);
+        } else if (arg == "--rrl-rate") {
+            config.rrlRate = number<double>(argc, argv, i);
+        } else if (arg == "--rrl-slip") {
+            config.rrlSlip = number<unsigned>(argc, argv, i);
+        } else if (arg == "--zone-guard-cap") {
+            config.zoneGuardCap = number<unsigned>(argc, argv, i);
+        } else if (arg == "--zone-guard-ratio") {
+            config.zoneGuardRatio = number<double>(argc, argv, i);
+        } else if (arg == "--tcp-connections") {
+            config.tcpConnections = number<unsigned>(argc, argv, i);
+        } else if (arg == "--tcp-idle-timeout") {
+            config.tcpIdleTimeout = number<unsigned>(argc, argv, i);
+        } else if (arg == "--query-budget") {
+            config.queryBudget = number<unsigned>(argc, argv, i);
+        } else if (arg == "--batch-size") {
+            config.batchSize = number<unsigned>(argc, argv, i);
+        } else if (arg == "--dnssec") {
+            config.dnssec = true;
+        } else if (arg == "--trust-anchors") {
+            config.trustAnchors = value(argc, argv, i);
+            config.dnssec = true;
+        } else if (arg == "--no-aggressive-nsec") {
+            config.aggressiveNsec = false;
+        } else if (arg == "--nsec-cache-size") {
+            config.nsecCacheSize = number<size_t>(argc, argv, i);
+        } else {
+            throw std::invalid_argument("Unknown option: " + arg);
+        }
+    }
+
+    if (config.prefetchWindow > 100) {
+        throw std::invalid_argument("--prefetch-window is a percentage of the TTL");
+    }
+    if (config.hedgePercentile > 100) {
+        throw std::invalid_argument("--hedge-percentile is a percentile of upstream latency");
+    }
+    if (config.zoneGuardRatio <= 0 || config.zoneGuardRatio > 1) {
+        throw std::invalid_argument("--zone-guard-ratio is a share of resolutions, in (0, 1]");
+    }
+    if (config.companionRatio < 0 || config.companionRatio > 1) {
+        throw std::invalid_argument("--companion-ratio is a share of queries, in [0, 1]");
+    }
+    if (config.tcpConnections == 0) {
+        throw std::invalid_argument("--tcp-connections must be at least 1");
+    }
+    if (config.batchSize == 0) {
+        throw std::invalid_argument("--batch-size must be at least 1");
+    }
+    if (config.healthInterval == 0) {
+        throw std::invalid_argument("--health-interval must be at least 1 second");
+    }
+
+    return config;
+}
+
+std::string usage(const std::string& program) {
+    return "Usage: " + program + " [options]\n"
+        "  -d, --daemon                run in background, log to syslog\n"
+        "  --threads N                 resolver worker threads, 0 for one per CPU (0)\n"
+        "  --prefetch-window PCT       refresh entries hit in the last PCT% of TTL, 0 disables (10)\n"
+        "  --prefetch-min-rate N       hits per minute an entry needs to be prefetched (6)\n"
+        "  --prefetch-limit N          prefetch resolutions started per second (20)\n"
+        "  --stale-window SEC          keep expired records to serve stale, 0 disables (86400)\n"
+        "  --stale-answer-timeout MS   answer stale after a resolution runs this long (1800)\n"
+        "  --forward ADDR[:PORT],...   forward queries to these resolvers instead of recursing\n"
+        "  --hedge-percentile P        duplicate a forwarded query once the upstream is slower than\n"
+        "                              its P-th latency percentile, 0 disables (90)\n"
+        "  --health-interval SEC       time between health probes of each upstream (5)\n"
+        "  --root-zone FILE            answer root referrals from a local copy of the root zone,\n"
+        "                              reloaded on SIGHUP\n"
+        "  --zones IMAGE               answer the zones compiled into IMAGE by dns-zonec,\n"
+        "                              reloaded on SIGHUP\n"
+        "  --blocklist FILE,...        refuse names listed in these files (names, *.name subtrees\n"
+        "                              or hosts file lines), reloaded on SIGHUP\n"
+        "  --blocklist-sinkhole ADDR   answer blocked A queries with ADDR instead of NXDOMAIN\n"
+        "  --ns-max-outstanding N      queries outstanding to one nameserver at once, 0 for no cap (64)\n"
+        "  --ns-rate N                 queries per second to one nameserver, 0 for no limit (200)\n"
+        "  --companion-fetch           on an A or AAAA cache miss, fetch the other type too for\n"
+        "                              clients that ask for both\n"
+        "  --companion-ratio R         share of a client's A/AAAA queries that must come in pairs (0.5)\n"
+        "  --rrl-rate N                responses per second per client /24 and response kind,\n"
+        "                              0 disables rate limiting (0)\n"
+        "  --rrl-slip N                over the limit, send every N-th response truncated and\n"
+        "                              drop the others, 0 drops all (2)\n"
+        "  --zone-guard-cap N          resolutions at once for a zone under random subdomain\n"
+        "                              attack, 0 disables the detection (8)\n"
+        "  --zone-guard-ratio R        share of NXDOMAIN answers from which a zone\n"
+        "                              is considered under attack (0.8)\n"
+        "  --tcp-connections N         pooled TCP connections per upstream server, used to ask\n"
+        "                              again when an answer is truncated (2)\n"
+        "  --tcp-idle-timeout SEC      close pooled TCP connections idle for this long (10)\n"
+        "  --query-budget MS           time a client query may take from its receipt before\n"
+        "                              the resolution is abandoned, 0 disables (4000)\n"
+        "  --batch-size N              client queries handled together, stage by stage (32)\n"
+        "  --dnssec                    validate answers against the root trust anchors\n"
+        "  --trust-anchors FILE        validate against the DS records in FILE instead,\n"
+        "                              implies --dnssec\n"
+        "  --no-aggressive-nsec        always ask upstream for names the cached NSEC/NSEC3\n"
+        "                              records of a signed zone deny\n"
+        "  --nsec-cache-size N         NSEC/NSEC3 records kept to deny names (100000)\n";
+}
@@ -80,7 +80,8 @@ void networkThread(int port,
         for(int i=0; i<nfds; i++) {
             if (events[i].data.fd == sockfd) {
 
-                std::vector<uint8_t> buffer(512);
+                // EDNS upstream answers, DNSSEC ones above all, are larger than 512 bytes
+                std::vector<uint8_t> buffer(4096);
                 sockaddr_in clientAddr{};
                 socklen_t clientAddrLen = sizeof(clientAddr);
 
@@ -96,11 +97,13 @@ void networkThread(int port,
                 if (_recvfrom > 0) {
                     buffer.resize(_recvfrom);
 
+                    // The query budget starts now, however long it waits in the queue
                     inputQueue.push({
                         std::move(buffer),
                         clientAddr,
                         sockfd,
-                        dnslib::PROTO::UDP
+                        dnslib::PROTO::UDP,
+                        std::chrono::steady_clock::now()
                     });
                 }
             }
@@ -0,0 +1,731 @@
+#include "dnssec.hpp"
+
+#include "utils/metrics.hpp"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <memory>
+#include <openssl/bn.h>
+#include <openssl/core_names.h>
+#include <openssl/ecdsa.h>
+#include <openssl/evp.h>
+#include <openssl/param_build.h>
+#include <sstream>
+#include <stdexcept>
+
+// Validated material is trusted at most this long, whatever the TTLs say
+constexpr uint32_t MAX_TRUST_TTL = 86400;
+
+// RFC 8624 algorithm numbers
+constexpr uint8_t RSASHA256 = 8;
+constexpr uint8_t RSASHA512 = 10;
+constexpr uint8_t ECDSAP256SHA256 = 13;
+constexpr uint8_t ECDSAP384SHA384 = 14;
+constexpr uint8_t ED25519 = 15;
+constexpr uint8_t ED448 = 16;
+
+constexpr uint8_t DIGEST_SHA1 = 1;
+constexpr uint8_t DIGEST_SHA256 = 2;
+constexpr uint8_t DIGEST_SHA384 = 4;
+
+constexpr uint16_t TYPE_NS = static_cast<uint16_t>(dnslib::TYPE::NS);
+constexpr uint16_t TYPE_CNAME = static_cast<uint16_t>(dnslib::TYPE::CNAME);
+constexpr uint16_t TYPE_SOA = static_cast<uint16_t>(dnslib::TYPE::SOA);
+constexpr uint16_t TYPE_DS = static_cast<uint16_t>(dnslib::TYPE::DS);
+constexpr uint16_t TYPE_DNSKEY = static_cast<uint16_t>(dnslib::TYPE::DNSKEY);
+
+struct PkeyDeleter { void operator()(EVP_PKEY* p) const { EVP_PKEY_free(p); } };
+struct PkeyCtxDeleter { void operator()(EVP_PKEY_CTX* p) const { EVP_PKEY_CTX_free(p); } };
+struct MdCtxDeleter { void operator()(EVP_MD_CTX* p) const { EVP_MD_CTX_free(p); } };
+struct ParamBldDeleter { void operator()(OSSL_PARAM_BLD* p) const { OSSL_PARAM_BLD_free(p); } };
+struct ParamDeleter { void operator()(OSSL_PARAM* p) const { OSSL_PARAM_free(p); } };
+struct BnDeleter { void operator()(BIGNUM* p) const { BN_free(p); } };
+struct EcdsaSigDeleter { void operator()(ECDSA_SIG* p) const { ECDSA_SIG_free(p); } };
+
+using Pkey = std::unique_ptr<EVP_PKEY, PkeyDeleter>;
+
+
+std::string to_string(Security security) {
+    switch (security) {
+    case Security::BOGUS: return "bogus";
+    case Security::UNCHECKED: return "unchecked";
+    case Security::INSECURE: return "insecure";
+    case Security::SECURE: return "secure";
+    }
+    return "unknown";
+}
+
+static std::string Lower(std::string name) {
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+    return name;
+}
+
+static std::vector<std::string> Labels(const std::string& name) {
+    std::vector<std::string> labels;
+    if (name.empty()) return labels;
+
+    size_t start = 0;
+    while (true) {
+        size_t dot = name.find('.', start);
+        labels.push_back(name.substr(start, dot - start));
+        if (dot == std::string::npos) break;
+        start = dot + 1;
+    }
+    return labels;
+}
+
+// The last count labels of name
+static std::string Suffix(const std::string& name, size_t count) {
+    auto labels = Labels(name);
+    std::string suffix;
+    for (size_t i = labels.size() - std::min(count, labels.size()); i < labels.size(); i++) {
+        suffix += (suffix.empty() ? "" : ".") + labels[i];
+    }
+    return suffix;
+}
+
+static bool IsSubdomain(const std::string& name, const std::string& zone) {
+    if (zone.empty() || name == zone) return true;
+    return name.size() > zone.size() && name.compare(name.size() - zone.size(), zone.size(), zone) == 0
+        && name[name.size() - zone.size() - 1] == '.';
+}
+
+static std::vector<uint8_t> CanonicalName(const std::string& name) {
+    std::vector<uint8_t> wire;
+    dnslib::utils::writeDomain(wire, Lower(name));
+    return wire;
+}
+
+// Canonical DNS name order (RFC 4034, section 6.1): labels compared from the right
+static int CanonicalCompare(const std::string& a, const std::string& b) {
+    auto left = Labels(Lower(a));
+    auto right = Labels(Lower(b));
+    size_t i = left.size(), j = right.size();
+    while (i > 0 && j > 0) {
+        int order = left[--i].compare(right[--j]);
+        if (order != 0) return order < 0 ? -1 : 1;
+    }
+    if (i == j) return 0;
+    return i < j ? -1 : 1;
+}
+
+// Lowercases the uncompressed name at pos in place, returns the position after it
+static size_t LowercaseName(std::vector<uint8_t>& data, size_t pos) {
+    while (pos < data.size() && data[pos] != 0) {
+        size_t length = data[pos];
+        for (size_t i = pos + 1; i <= pos + length && i < data.size(); i++) {
+            data[i] = std::tolower(data[i]);
+        }
+        pos += length + 1;
+    }
+    return pos + 1;
+}
+
+// RDATA of rec with the embedded names of the RFC 4034 types lowercased
+static std::vector<uint8_t> CanonicalRdata(const dnslib::ResourceRecord& rec) {
+    std::vector<uint8_t> wire;
+    rec.serialize(wire);
+
+    // Owner name as written by writeDomain, uncompressed, then type, class, TTL and length
+    size_t pos = 0;
+    while (pos < wire.size() && wire[pos] != 0) pos += wire[pos] + 1;
+    pos += 11;
+    std::vector<uint8_t> rdata(wire.begin() + std::min(pos, wire.size()), wire.end());
+
+    switch (static_cast<dnslib::TYPE>(rec.getType())) {
+    case dnslib::TYPE::NS:
+    case dnslib::TYPE::CNAME:
+    case dnslib::TYPE::PTR:
+        LowercaseName(rdata, 0);
+        break;
+    case dnslib::TYPE::MX:
+        LowercaseName(rdata, 2);
+        break;
+    case dnslib::TYPE::SOA:
+        LowercaseName(rdata, LowercaseName(rdata, 0));
+        break;
+    default:
+        break;
+    }
+    return rdata;
+}
+
+static const EVP_MD* DigestFor(uint8_t algorithm) {
+    switch (algorithm) {
+    case RSASHA256:
+    case ECDSAP256SHA256:
+        return EVP_sha256();
+    case RSASHA512:
+        return EVP_sha512();
+    case ECDSAP384SHA384:
+        return EVP_sha384();
+    default:
+        return nullptr;     // EdDSA hashes internally
+    }
+}
+
+static Pkey FromParams(const char* type, OSSL_PARAM_BLD* builder) {
+    std::unique_ptr<OSSL_PARAM, ParamDeleter> params(OSSL_PARAM_BLD_to_param(builder));
+    std::unique_ptr<EVP_PKEY_CTX, PkeyCtxDeleter> ctx(EVP_PKEY_CTX_new_from_name(nullptr, type, nullptr));
+    if (!params || !ctx || EVP_PKEY_fromdata_init(ctx.get()) != 1) return nullptr;
+
+    EVP_PKEY* key = nullptr;
+    if (EVP_PKEY_fromdata(ctx.get(), &key, EVP_PKEY_PUBLIC_KEY, params.get()) != 1) return nullptr;
+    return Pkey(key);
+}
+
+// OpenSSL public key from the DNSKEY wire format of the algorithm
+static Pkey PublicKey(uint8_t algorithm, const std::vector<uint8_t>& key) {
+    switch (algorithm) {
+    case RSASHA256:
+    case RSASHA512: {
+        // RFC 3110: exponent length, exponent, modulus
+        if (key.size() < 3) return nullptr;
+        size_t exponentLength = key[0];
+        size_t offset = 1;
+        if (exponentLength == 0) {
+            exponentLength = (key[1] << 8) | key[2];
+            offset = 3;
+        }
+        if (offset + exponentLength >= key.size()) return nullptr;
+
+        std::unique_ptr<BIGNUM, BnDeleter> e(BN_bin2bn(key.data() + offset, exponentLength, nullptr));
+        std::unique_ptr<BIGNUM, BnDeleter> n(BN_bin2bn(key.data() + offset + exponentLength, key.size() - offset - exponentLength, nullptr));
+        std::unique_ptr<OSSL_PARAM_BLD, ParamBldDeleter> builder(OSSL_PARAM_BLD_new());
+        if (!e || !n || !builder) return nullptr;
+        OSSL_PARAM_BLD_push_BN(builder.get(), OSSL_PKEY_PARAM_RSA_N, n.get());
+        OSSL_PARAM_BLD_push_BN(builder.get(), OSSL_PKEY_PARAM_RSA_E, e.get());
+        return FromParams("RSA", builder.get());
+    }
+    case ECDSAP256SHA256:
+    case ECDSAP384SHA384: {
+        // RFC 6605: the point coordinates, without the uncompressed point prefix
+        size_t size = algorithm == ECDSAP256SHA256 ? 64 : 96;
+        if (key.size() != size) return nullptr;
+
+        std::vector<uint8_t> point = {0x04};
+        point.insert(point.end(), key.begin(), key.end());
+        std::unique_ptr<OSSL_PARAM_BLD, ParamBldDeleter> builder(OSSL_PARAM_BLD_new());
+        if (!builder) return nullptr;
+        OSSL_PARAM_BLD_push_utf8_string(builder.get(), OSSL_PKEY_PARAM_GROUP_NAME, algorithm == ECDSAP256SHA256 ? "prime256v1" : "secp384r1", 0);
+        OSSL_PARAM_BLD_push_octet_string(builder.get(), OSSL_PKEY_PARAM_PUB_KEY, point.data(), point.size());
+        return FromParams("EC", builder.get());
+    }
+    case ED25519:
+        return Pkey(EVP_PKEY_new_raw_public_key(EVP_PKEY_ED25519, nullptr, key.data(), key.size()));
+    case ED448:
+        return Pkey(EVP_PKEY_new_raw_public_key(EVP_PKEY_ED448, nullptr, key.data(), key.size()));
+    default:
+        return nullptr;
+    }
+}
+
+// DNSSEC carries ECDSA signatures as r and s side by side, OpenSSL wants DER
+static std::vector<uint8_t> EcdsaToDer(const std::vector<uint8_t>& signature) {
+    size_t half = signature.size() / 2;
+    std::unique_ptr<ECDSA_SIG, EcdsaSigDeleter> sig(ECDSA_SIG_new());
+    BIGNUM* r = BN_bin2bn(signature.data(), half, nullptr);
+    BIGNUM* s = BN_bin2bn(signature.data() + half, half, nullptr);
+    if (!sig || !r || !s || ECDSA_SIG_set0(sig.get(), r, s) != 1) {
+        BN_free(r);
+        BN_free(s);
+        return {};
+    }
+
+    int length = i2d_ECDSA_SIG(sig.get(), nullptr);
+    if (length <= 0) return {};
+    std::vector<uint8_t> der(length);
+    uint8_t* out = der.data();
+    i2d_ECDSA_SIG(sig.get(), &out);
+    return der;
+}
+
+static std::vector<uint8_t> Digest(const EVP_MD* md, const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> digest(EVP_MAX_MD_SIZE);
+    unsigned int length = 0;
+    if (EVP_Digest(data.data(), data.size(), digest.data(), &length, md, nullptr) != 1) return {};
+    digest.resize(length);
+    return digest;
+}
+
+static std::vector<uint8_t> ParseHex(const std::string& text) {
+    if (text.size() % 2 != 0) {
+        throw std::runtime_error("Odd number of hex digits: " + text);
+    }
+    std::vector<uint8_t> bytes;
+    for (size_t i = 0; i < text.size(); i += 2) {
+        bytes.push_back(std::stoi(text.substr(i, 2), nullptr, 16));
+    }
+    return bytes;
+}
+
+
+Validator::Validator(RecordList anchors) : anchors(std::move(anchors)) {}
+
+Validator::RecordList Validator::rootAnchors() {
+    return {
+        std::make_shared<dnslib::DSRecord>("", MAX_TRUST_TTL, 20326, RSASHA256, DIGEST_SHA256,
+            ParseHex("E06D44B80B8F1D39A95C0B0D7C65D08458E880409BBC683457104237C7F8EC8D")),
+        std::make_shared<dnslib::DSRecord>("", MAX_TRUST_TTL, 38696, RSASHA256, DIGEST_SHA256,
+            ParseHex("683D2D0ACB8C9B712A1948B27F741219298D0A450D612C483AF444A4C0FB2B16")),
+    };
+}
+
+Validator::RecordList Validator::loadAnchors(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Cannot read trust anchors from " + path);
+    }
+
+    RecordList anchors;
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++) {
+        line = line.substr(0, line.find(';'));
+        std::istringstream in(line);
+        std::vector<std::string> fields;
+        for (std::string field; in >> field;) fields.push_back(field);
+        if (fields.empty()) continue;
+
+        // The TTL and the class are optional
+        auto ds = std::find(fields.begin(), fields.end(), "DS");
+        if (ds == fields.end() || fields.end() - ds < 5) {
+            throw std::runtime_error(path + ":" + std::to_string(number) + ": not a DS record");
+        }
+
+        std::string name = Lower(fields[0]);
+        if (!name.empty() && name.back() == '.') name.pop_back();
+        try {
+            anchors.push_back(std::make_shared<dnslib::DSRecord>(name, MAX_TRUST_TTL,
+                std::stoi(ds[1]), std::stoi(ds[2]), std::stoi(ds[3]), ParseHex(ds[4])));
+        } catch (const std::exception& e) {
+            throw std::runtime_error(path + ":" + std::to_string(number) + ": " + e.what());
+        }
+    }
+    return anchors;
+}
+
+Validator::RecordList Validator::anchorsFor(const std::string& zone) const {
+    RecordList found;
+    for (const auto& anchor : anchors) {
+        if (Lower(anchor->getName()) == Lower(zone)) found.push_back(anchor);
+    }
+    return found;
+}
+
+std::vector<uint8_t> Validator::signedData(const dnslib::RRSIGRecord& signature, const RecordList& rrset) {
+    std::vector<uint8_t> data;
+    signature.writeSignedFields(data);
+    if (rrset.empty()) return data;
+
+    std::string owner = Lower(rrset[0]->getName());
+    size_t labels = Labels(owner).size();
+    if (!owner.empty() && owner.rfind("*.", 0) == 0) labels--;
+    if (signature.getLabels() < labels) {
+        // Expanded from a wildcard, signed as the wildcard
+        owner = signature.getLabels() == 0 ? "*" : "*." + Suffix(owner, signature.getLabels());
+    }
+    std::vector<uint8_t> ownerWire = CanonicalName(owner);
+
+    std::vector<std::vector<uint8_t>> rdatas;
+    for (const auto& rec : rrset) {
+        rdatas.push_back(CanonicalRdata(*rec));
+    }
+    std::sort(rdatas.begin(), rdatas.end());
+    rdatas.erase(std::unique(rdatas.begin(), rdatas.end()), rdatas.end());
+
+    for (const auto& rdata : rdatas) {
+        data.insert(data.end(), ownerWire.begin(), ownerWire.end());
+        dnslib::utils::writeU16(data, rrset[0]->getType());
+        dnslib::utils::writeU16(data, 1);
+        dnslib::utils::writeU32(data, signature.getOriginalTtl());
+        dnslib::utils::writeU16(data, rdata.size());
+        data.insert(data.end(), rdata.begin(), rdata.end());
+    }
+    return data;
+}
+
+bool Validator::verify(const dnslib::RRSIGRecord& signature, const RecordList& rrset, const dnslib::DNSKEYRecord& key) {
+    if (rrset.empty() || signature.getAlgorithm() != key.getAlgorithm() || signature.getKeyTag() != key.keyTag()) return false;
+    if (key.getProtocol() != 3 || !(key.getFlags() & dnslib::DNSKEYRecord::ZONE_KEY) || (key.getFlags() & dnslib::DNSKEYRecord::REVOKED)) return false;
+    if (Lower(signature.getSignerName()) != Lower(key.getName())) return false;
+
+    auto publicKey = PublicKey(key.getAlgorithm(), key.getPublicKey());
+    if (!publicKey) return false;
+
+    std::vector<uint8_t> sig = signature.getSignature();
+    if (key.getAlgorithm() == ECDSAP256SHA256 || key.getAlgorithm() == ECDSAP384SHA384) {
+        sig = EcdsaToDer(sig);
+        if (sig.empty()) return false;
+    }
+
+    DNS_METRIC_INC("dnssec.verifications");
+    std::vector<uint8_t> data = signedData(signature, rrset);
+    std::unique_ptr<EVP_MD_CTX, MdCtxDeleter> ctx(EVP_MD_CTX_new());
+    if (!ctx || EVP_DigestVerifyInit(ctx.get(), nullptr, DigestFor(key.getAlgorithm()), nullptr, publicKey.get()) != 1) {
+        return false;
+    }
+    return EVP_DigestVerify(ctx.get(), sig.data(), sig.size(), data.data(), data.size()) == 1;
+}
+
+bool Validator::current(const dnslib::RRSIGRecord& signature, std::time_t now) {
+    uint32_t time = static_cast<uint32_t>(now);
+    return static_cast<int32_t>(time - signature.getInception()) >= 0
+        && static_cast<int32_t>(signature.getExpiration() - time) >= 0;
+}
+
+std::vector<SignedRRset> Validator::group(const RecordList& records) {
+    std::vector<SignedRRset> rrsets;
+    auto find = [&](const std::string& name, uint16_t type) -> SignedRRset* {
+        for (auto& rrset : rrsets) {
+            const auto& first = *rrset.records[0];
+            if (first.getType() == type && Lower(first.getName()) == name) return &rrset;
+        }
+        return nullptr;
+    };
+
+    for (const auto& rec : records) {
+        if (std::dynamic_pointer_cast<dnslib::RRSIGRecord>(rec)) continue;
+        if (auto* rrset = find(Lower(rec->getName()), rec->getType())) {
+            rrset->records.push_back(rec);
+        } else {
+            rrsets.push_back({{rec}, {}});
+        }
+    }
+    for (const auto& rec : records) {
+        auto sig = std::dynamic_pointer_cast<dnslib::RRSIGRecord>(rec);
+        if (!sig) continue;
+        if (auto* rrset = find(Lower(sig->getName()), sig->getTypeCovered())) {
+            rrset->signatures.push_back(sig);
+        }
+    }
+    return rrsets;
+}
+
+Security Validator::check(const SignedRRset& rrset, const ZoneKeys& keys) {
+    if (!keys.secure) return Security::INSECURE;
+
+    for (const auto& sigRec : rrset.signatures) {
+        auto sig = std::dynamic_pointer_cast<dnslib::RRSIGRecord>(sigRec);
+        if (!sig || !current(*sig)) continue;
+
+        for (const auto& keyRec : keys.keys) {
+            auto key = std::dynamic_pointer_cast<dnslib::DNSKEYRecord>(keyRec);
+            if (key && verify(*sig, rrset.records, *key)) return Security::SECURE;
+        }
+    }
+    return Security::BOGUS;
+}
+
+bool Validator::matches(const dnslib::DNSKEYRecord& key, const dnslib::DSRecord& ds) {
+    if (ds.getKeyTag() != key.keyTag() || ds.getAlgorithm() != key.getAlgorithm()) return false;
+    if (Lower(ds.getName()) != Lower(key.getName())) return false;
+
+    const EVP_MD* md = nullptr;
+    switch (ds.getDigestType()) {
+    case DIGEST_SHA1: md = EVP_sha1(); break;
+    case DIGEST_SHA256: md = EVP_sha256(); break;
+    case DIGEST_SHA384: md = EVP_sha384(); break;
+    default: return false;
+    }
+
+    std::vector<uint8_t> data = CanonicalName(key.getName());
+    auto rdata = key.getRdata();
+    data.insert(data.end(), rdata.begin(), rdata.end());
+    return Digest(md, data) == ds.getDigest();
+}
+
+bool Validator::supportedAlgorithm(uint8_t algorithm) {
+    switch (algorithm) {
+    case RSASHA256:
+    case RSASHA512:
+    case ECDSAP256SHA256:
+    case ECDSAP384SHA384:
+    case ED25519:
+    case ED448:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool Validator::supportedDigest(uint8_t digestType) {
+    return digestType == DIGEST_SHA1 || digestType == DIGEST_SHA256 || digestType == DIGEST_SHA384;
+}
+
+std::optional<Validator::RecordList> Validator::validateKeySet(const RecordList& dnskeys, const RecordList& signatures, const RecordList& ds) {
+    for (const auto& dsRec : ds) {
+        auto digest = std::dynamic_pointer_cast<dnslib::DSRecord>(dsRec);
+        if (!digest) continue;
+
+        for (const auto& keyRec : dnskeys) {
+            auto key = std::dynamic_pointer_cast<dnslib::DNSKEYRecord>(keyRec);
+            if (!key || !matches(*key, *digest)) continue;
+
+            for (const auto& sigRec : signatures) {
+                auto sig = std::dynamic_pointer_cast<dnslib::RRSIGRecord>(sigRec);
+                if (!sig || sig->getTypeCovered() != TYPE_DNSKEY || !current(*sig)) continue;
+                if (!verify(*sig, dnskeys, *key)) continue;
+
+                RecordList trusted;
+                for (const auto& rec : dnskeys) {
+                    auto candidate = std::dynamic_pointer_cast<dnslib::DNSKEYRecord>(rec);
+                    if (candidate && (candidate->getFlags() & dnslib::DNSKEYRecord::ZONE_KEY)
+                        && !(candidate->getFlags() & dnslib::DNSKEYRecord::REVOKED)) {
+                        trusted.push_back(candidate);
+                    }
+                }
+                return trusted;
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+std::vector<uint8_t> Validator::nsec3Hash(const std::string& name, const std::vector<uint8_t>& salt, uint16_t iterations) {
+    std::vector<uint8_t> data = CanonicalName(name);
+    data.insert(data.end(), salt.begin(), salt.end());
+    std::vector<uint8_t> hash = Digest(EVP_sha1(), data);
+
+    for (uint16_t i = 0; i < iterations; i++) {
+        data = hash;
+        data.insert(data.end(), salt.begin(), salt.end());
+        hash = Digest(EVP_sha1(), data);
+    }
+    return hash;
+}
+
+// Whether nsec says no name lies strictly between its owner and its next name
+static bool NsecCovers(const dnslib::NSECRecord& nsec, const std::string& name) {
+    if (CanonicalCompare(nsec.getName(), name) >= 0) return false;
+    // The last NSEC of a zone points back to the apex
+    return CanonicalCompare(name, nsec.getNextName()) < 0 || CanonicalCompare(nsec.getNextName(), nsec.getName()) <= 0;
+}
+
+static std::string Nsec3Zone(const dnslib::NSEC3Record& nsec3) {
+    auto name = Lower(nsec3.getName());
+    auto dot = name.find('.');
+    return dot == std::string::npos ? "" : name.substr(dot + 1);
+}
+
+static std::string Nsec3OwnerHash(const dnslib::NSEC3Record& nsec3) {
+    return Lower(nsec3.getName().substr(0, nsec3.getName().find('.')));
+}
+
+// NSEC3 records of proofs that can be used for name, hashes computed once per parameter set
+struct Nsec3Set {
+    std::vector<std::shared_ptr<dnslib::NSEC3Record>> records;
+
+    explicit Nsec3Set(const Validator::RecordList& proofs) {
+        for (const auto& rec : proofs) {
+            auto nsec3 = std::dynamic_pointer_cast<dnslib::NSEC3Record>(rec);
+            if (nsec3 && nsec3->getHashAlgorithm() == 1 && nsec3->getIterations() <= Validator::MAX_NSEC3_ITERATIONS) {
+                records.push_back(nsec3);
+            }
+        }
+    }
+
+    std::string hash(const dnslib::NSEC3Record& nsec3, const std::string& name) const {
+        return dnslib::utils::toBase32Hex(Validator::nsec3Hash(name, nsec3.getSalt(), nsec3.getIterations()));
+    }
+
+    std::shared_ptr<dnslib::NSEC3Record> matching(const std::string& name) const {
+        for (const auto& nsec3 : records) {
+            if (IsSubdomain(Lower(name), Nsec3Zone(*nsec3)) && hash(*nsec3, name) == Nsec3OwnerHash(*nsec3)) return nsec3;
+        }
+        return nullptr;
+    }
+
+    std::shared_ptr<dnslib::NSEC3Record> covering(const std::string& name) const {
+        for (const auto& nsec3 : records) {
+            if (!IsSubdomain(Lower(name), Nsec3Zone(*nsec3))) continue;
+            // base32hex keeps the order of the hashes
+            std::string h = hash(*nsec3, name);
+            std::string owner = Nsec3OwnerHash(*nsec3);
+            std::string next = dnslib::utils::toBase32Hex(nsec3->getNextHashed());
+            bool covers = next > owner ? (owner < h && h < next) : (owner < h || h < next);
+            if (covers) return nsec3;
+        }
+        return nullptr;
+    }
+
+    struct ClosestEncloser {
+        std::string name;
+        std::shared_ptr<dnslib::NSEC3Record> nextCloserCover;
+    };
+
+    // RFC 5155, section 8.3: an existing ancestor whose child towards name provably does not exist
+    std::optional<ClosestEncloser> closestEncloser(const std::string& name) const {
+        auto labels = Labels(name);
+        for (size_t count = labels.size(); count-- > 0;) {
+            std::string candidate = Suffix(name, count);
+            if (!matching(candidate)) continue;
+
+            auto cover = covering(Suffix(name, count + 1));
+            if (!cover) return std::nullopt;
+            return ClosestEncloser{candidate, cover};
+        }
+        return std::nullopt;
+    }
+};
+
+// Closest encloser of name proven by a NSEC covering it: the longest ancestor of both ends
+static std::string NsecClosestEncloser(const dnslib::NSECRecord& nsec, const std::string& name) {
+    auto labels = Labels(Lower(name));
+    for (size_t count = labels.size(); count-- > 0;) {
+        std::string candidate = Suffix(Lower(name), count);
+        if (IsSubdomain(Lower(nsec.getName()), candidate) || IsSubdomain(Lower(nsec.getNextName()), candidate)) {
+            return candidate;
+        }
+    }
+    return "";
+}
+
+bool Validator::exceedsIterations(const RecordList& proofs) {
+    for (const auto& rec : proofs) {
+        auto nsec3 = std::dynamic_pointer_cast<dnslib::NSEC3Record>(rec);
+        if (nsec3 && nsec3->getIterations() > MAX_NSEC3_ITERATIONS) return true;
+    }
+    return false;
+}
+
+bool Validator::deniesType(const std::string& name, uint16_t type, const RecordList& proofs) {
+    // A delegation point only proves what the parent is authoritative for, DS
+    auto usable = [&](bool hasNs, bool hasSoa) {
+        return type == TYPE_DS ? !hasSoa || name.empty() : !(hasNs && !hasSoa);
+    };
+
+    for (const auto& rec : proofs) {
+        auto nsec = std::dynamic_pointer_cast<dnslib::NSECRecord>(rec);
+        if (!nsec || Lower(nsec->getName()) != Lower(name)) continue;
+        if (!nsec->hasType(type) && !nsec->hasType(TYPE_CNAME) && usable(nsec->hasType(TYPE_NS), nsec->hasType(TYPE_SOA))) {
+            return true;
+        }
+    }
+
+    Nsec3Set nsec3s(proofs);
+    if (auto match = nsec3s.matching(name)) {
+        return !match->hasType(type) && !match->hasType(TYPE_CNAME) && usable(match->hasType(TYPE_NS), match->hasType(TYPE_SOA));
+    }
+
+    // NODATA at a wildcard that would have matched name
+    for (const auto& rec : proofs) {
+        auto nsec = std::dynamic_pointer_cast<dnslib::NSECRecord>(rec);
+        if (!nsec || !NsecCovers(*nsec, name)) continue;
+
+        std::string wildcard = "*." + NsecClosestEncloser(*nsec, name);
+        for (const auto& other : proofs) {
+            auto at = std::dynamic_pointer_cast<dnslib::NSECRecord>(other);
+            if (at && Lower(at->getName()) == wildcard && !at->hasType(type) && !at->hasType(TYPE_CNAME)) return true;
+        }
+    }
+    if (auto encloser = nsec3s.closestEncloser(name)) {
+        auto wildcard = nsec3s.matching("*." + encloser->name);
+        return wildcard && !wildcard->hasType(type) && !wildcard->hasType(TYPE_CNAME);
+    }
+    return false;
+}
+
+bool Validator::deniesName(const std::string& name, const RecordList& proofs) {
+    for (const auto& rec : proofs) {
+        auto nsec = std::dynamic_pointer_cast<dnslib::NSECRecord>(rec);
+        if (!nsec || !NsecCovers(*nsec, name)) continue;
+
+        // No wildcard at the closest encloser either
+        std::string encloser = NsecClosestEncloser(*nsec, name);
+        std::string wildcard = encloser.empty() ? "*" : "*." + encloser;
+        for (const auto& other : proofs) {
+            auto cover = std::dynamic_pointer_cast<dnslib::NSECRecord>(other);
+            if (cover && NsecCovers(*cover, wildcard)) return true;
+        }
+    }
+
+    Nsec3Set nsec3s(proofs);
+    auto encloser = nsec3s.closestEncloser(Lower(name));
+    if (!encloser) return false;
+    return nsec3s.covering(encloser->name.empty() ? "*" : "*." + encloser->name) != nullptr;
+}
+
+bool Validator::deniesExactName(const std::string& name, uint8_t labels, const RecordList& proofs) {
+    for (const auto& rec : proofs) {
+        auto nsec = std::dynamic_pointer_cast<dnslib::NSECRecord>(rec);
+        if (nsec && NsecCovers(*nsec, name)) return true;
+    }
+
+    // RFC 5155, section 8.8: the next closer name is enough, the closest encloser follows from the RRSIG
+    Nsec3Set nsec3s(proofs);
+    return nsec3s.covering(Suffix(Lower(name), labels + 1)) != nullptr;
+}
+
+std::optional<Validator::Delegation> Validator::delegationFromDenial(const std::string& name, const RecordList& proofs) {
+    auto fromBitmap = [](bool hasNs, bool hasSoa, bool hasDs) -> std::optional<Delegation> {
+        if (hasSoa || hasDs) return std::nullopt;   // child side of the cut, or no denial at all
+        return hasNs ? Delegation::INSECURE : Delegation::NONE;
+    };
+
+    for (const auto& rec : proofs) {
+        auto nsec = std::dynamic_pointer_cast<dnslib::NSECRecord>(rec);
+        if (!nsec) continue;
+        if (Lower(nsec->getName()) == Lower(name)) {
+            return fromBitmap(nsec->hasType(TYPE_NS), nsec->hasType(TYPE_SOA), nsec->hasType(TYPE_DS));
+        }
+        if (NsecCovers(*nsec, name)) {
+            // No such name, or an empty non-terminal: no cut either way
+            return Delegation::NONE;
+        }
+    }
+
+    Nsec3Set nsec3s(proofs);
+    if (auto match = nsec3s.matching(name)) {
+        return fromBitmap(match->hasType(TYPE_NS), match->hasType(TYPE_SOA), match->hasType(TYPE_DS));
+    }
+    if (auto encloser = nsec3s.closestEncloser(Lower(name))) {
+        // Unsigned delegations are left out of opt-out spans, one may be hiding there
+        return encloser->nextCloserCover->optOut() ? Delegation::INSECURE : Delegation::NONE;
+    }
+    return std::nullopt;
+}
+
+std::optional<Validator::ZoneKeys> Validator::keys(const std::string& zone, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = keyCache.find(Lower(zone));
+    if (it == keyCache.end()) return std::nullopt;
+    if (now >= it->second.expires) {
+        keyCache.erase(it);
+        return std::nullopt;
+    }
+    return it->second.value;
+}
+
+void Validator::storeKeys(const std::string& zone, ZoneKeys keys, uint32_t ttl, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mtx);
+    keyCache[Lower(zone)] = {std::move(keys), now + std::chrono::seconds(std::min(ttl, MAX_TRUST_TTL))};
+}
+
+std::optional<Validator::DelegationInfo> Validator::delegation(const std::string& name, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = delegationCache.find(Lower(name));
+    if (it == delegationCache.end()) return std::nullopt;
+    if (now >= it->second.expires) {
+        delegationCache.erase(it);
+        return std::nullopt;
+    }
+    return it->second.value;
+}
+
+void Validator::storeDelegation(const std::string& name, DelegationInfo info, uint32_t ttl, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mtx);
+    delegationCache[Lower(name)] = {std::move(info), now + std::chrono::seconds(std::min(ttl, MAX_TRUST_TTL))};
+}
+
+std::string Validator::toString() const {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    size_t secure = 0;
+    for (const auto& [zone, entry] : keyCache) {
+        if (entry.value.secure) secure++;
+    }
+    std::stringstream ss;
+    ss << "anchors=" << anchors.size() << " zones=" << keyCache.size() << " signed=" << secure
+       << " unsigned=" << keyCache.size() - secure << " delegations=" << delegationCache.size() << "\n";
+    return ss.str();
+}
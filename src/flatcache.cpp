@@ -0,0 +1,343 @@
+#include "flatcache.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <string>
+
+
+constexpr uint32_t OCCUPIED = 0x80000000u;
+constexpr uint32_t TAG = 0xFF000000u;
+constexpr uint32_t INDEX = 0x00FFFFFFu;
+
+// Bucket of the hash when nothing collides, the low bits index the table
+static size_t Home(size_t hash, size_t mask) {
+    return hash & mask;
+}
+
+// Occupied bit and 7 hash bits independent of the index ones, 127 in 128 probes of another key stop at the bucket
+static uint32_t Tag(size_t hash) {
+    return OCCUPIED | static_cast<uint32_t>(static_cast<uint64_t>(hash) >> 57) << 24;
+}
+
+// Queues key for refresh once it is popular and close to expiry, as TLRUCache::get does
+static void CountHit(CacheEntry& entry, unsigned window, double minRate, std::vector<cacheKey>& queue) {
+    entry.hits++;
+    if (window == 0 || entry.prefetchQueued) return;
+
+    auto now = std::chrono::steady_clock::now();
+    auto lifetime = entry.expireTime - entry.insertTime;
+    auto remaining = entry.expireTime - now;
+    if (remaining * 100 > lifetime * window) return;
+
+    double age = std::max(std::chrono::duration<double>(now - entry.insertTime).count(), 1.0);
+    if (entry.hits * 60.0 / age >= minRate) {
+        entry.prefetchQueued = true;
+        queue.push_back(entry.key);
+    }
+}
+
+FlatCache::FlatCache(int capacity, size_t shards) {
+    size_t total = static_cast<size_t>(std::max(capacity, 1));
+    if (total > MAX_SHARDS * MAX_SHARD_CAPACITY) {
+        throw std::invalid_argument("Cache capacity " + std::to_string(total) + " over the flat cache limit");
+    }
+    // Enough shards to index every entry, those hold far more than MIN_SHARD_CAPACITY
+    size_t indexable = std::bit_ceil((total + MAX_SHARD_CAPACITY - 1) / MAX_SHARD_CAPACITY);
+    numShards = std::max(TLRUCache::shardsFor(total, shards), indexable);
+    shardBits = std::countr_zero(numShards);
+    this->shards = std::make_unique<Shard[]>(numShards);
+    for (size_t i = 0; i < numShards; i++) {
+        auto& shard = this->shards[i];
+        shard.capacity = (total + numShards - 1) / numShards;
+        // At most half full, probes stay short and buckets are only 4 bytes
+        size_t buckets = std::bit_ceil(shard.capacity * 2);
+        shard.mask = buckets - 1;
+        shard.buckets.assign(buckets, 0);
+        shard.slots.reserve(shard.capacity);
+    }
+}
+
+FlatCache::Shard& FlatCache::shardOf(size_t hash) {
+    if (shardBits == 0) return shards[0];
+
+    uint64_t mixed = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+    return shards[mixed >> (64 - shardBits)];
+}
+
+size_t FlatCache::Shard::find(const cacheKey& key, size_t hash) {
+    uint32_t tag = Tag(hash);
+    for (size_t i = Home(hash, mask); buckets[i] & OCCUPIED; i = (i + 1) & mask) {
+        if ((buckets[i] & TAG) != tag) continue;
+
+        size_t slot = buckets[i] & INDEX;
+        if (!(slots[slot].entry.key == key)) continue;
+
+        // Check if expired, including the time it may still be served stale
+        if (std::chrono::steady_clock::now() > slots[slot].entry.expireTime + staleWindow) {
+            DNS_LOG_DEBUG("Cache entry expired: " + std::to_string(key.type) + ":" + key.name);
+            erase(slot);
+            return NONE;
+        }
+        return slot;
+    }
+    return NONE;
+}
+
+size_t FlatCache::Shard::bucketOf(size_t slot) const {
+    size_t i = Home(slots[slot].hash, mask);
+    while ((buckets[i] & INDEX) != slot || !(buckets[i] & OCCUPIED)) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+bool FlatCache::Shard::outranked(const cacheKey& key, size_t hash, Trust trust, std::chrono::steady_clock::time_point now) {
+    size_t slot = find(key, hash);
+    return slot != NONE && slots[slot].entry.trust > trust && now <= slots[slot].entry.expireTime;
+}
+
+void FlatCache::Shard::erase(size_t slot) {
+    // Backward shift: later buckets of the run move into the hole unless it lies before their home
+    size_t hole = bucketOf(slot);
+    buckets[hole] = 0;
+    for (size_t next = (hole + 1) & mask; buckets[next] & OCCUPIED; next = (next + 1) & mask) {
+        size_t home = Home(slots[buckets[next] & INDEX].hash, mask);
+        if (((next - home) & mask) < ((next - hole) & mask)) continue;
+
+        buckets[hole] = buckets[next];
+        buckets[next] = 0;
+        hole = next;
+    }
+
+    // The last entry fills the place, the array stays dense
+    size_t last = slots.size() - 1;
+    if (slot != last) {
+        size_t moved = bucketOf(last);
+        slots[slot] = std::move(slots[last]);
+        buckets[moved] = (buckets[moved] & TAG) | static_cast<uint32_t>(slot);
+    }
+    slots.pop_back();
+}
+
+void FlatCache::Shard::evict(std::chrono::steady_clock::time_point now) {
+    // Ends within two sweeps, the first one clears every referenced flag
+    while (true) {
+        if (hand >= slots.size()) {
+            hand = 0;
+        }
+        auto& slot = slots[hand];
+        if (slot.referenced && now <= slot.entry.expireTime + staleWindow) {
+            slot.referenced = false;
+            hand++;
+            continue;
+        }
+        // The last entry moves in, the hand looks at it next time
+        erase(hand);
+        return;
+    }
+}
+
+void FlatCache::Shard::insert(CacheEntry entry, size_t hash) {
+    size_t existing = find(entry.key, hash);
+    if (existing != NONE) {
+        slots[existing].entry = std::move(entry);
+        slots[existing].referenced = true;
+        return;
+    }
+
+    if (slots.size() >= capacity) {
+        evict(entry.insertTime);
+    }
+    size_t i = Home(hash, mask);
+    while (buckets[i] & OCCUPIED) {
+        i = (i + 1) & mask;
+    }
+    buckets[i] = Tag(hash) | static_cast<uint32_t>(slots.size());
+    slots.push_back(Slot{std::move(entry), hash, true});
+}
+
+size_t FlatCache::tableBytes() const {
+    size_t bytes = numShards * sizeof(Shard);
+    for (size_t i = 0; i < numShards; i++) {
+        bytes += shards[i].buckets.capacity() * sizeof(uint32_t) + shards[i].slots.capacity() * sizeof(Slot);
+    }
+    return bytes;
+}
+
+std::optional<std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>>> FlatCache::get(cacheKey key, Security* security, Trust minTrust,
+                                                                                              std::chrono::steady_clock::time_point* expires) {
+    size_t hash = std::hash<cacheKey>()(key);
+    Shard& shard = shardOf(hash);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    size_t slot = shard.find(key, hash);
+    if (slot == NONE) {
+        return std::nullopt;
+    }
+    auto& entry = shard.slots[slot].entry;
+    if (entry.soa || entry.trust < minTrust || std::chrono::steady_clock::now() > entry.expireTime) {
+        return std::nullopt;
+    }
+    if (security) {
+        *security = entry.security;
+    }
+    if (expires) {
+        *expires = entry.expireTime;
+    }
+
+    shard.slots[slot].referenced = true;
+    CountHit(entry, shard.prefetchWindow, shard.prefetchMinRate, shard.prefetchQueue);
+    return entry.value;
+}
+
+bool FlatCache::put(cacheKey key, std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>> value, uint32_t TTL, Security security, Trust trust) {
+    size_t hash = std::hash<cacheKey>()(key);
+    Shard& shard = shardOf(hash);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto now = std::chrono::steady_clock::now();
+    if (shard.outranked(key, hash, trust, now)) {
+        return false;
+    }
+
+    CacheEntry entry;
+    entry.key = std::move(key);
+    entry.value = std::move(value);
+    entry.expireTime = now + std::chrono::seconds(TTL);
+    entry.insertTime = now;
+    entry.security = security;
+    entry.trust = trust;
+    shard.insert(std::move(entry), hash);
+    return true;
+}
+
+std::optional<std::shared_ptr<dnslib::ResourceRecord>> FlatCache::getNegative(cacheKey key, Security* security, std::chrono::steady_clock::time_point* expires) {
+    size_t hash = std::hash<cacheKey>()(key);
+    Shard& shard = shardOf(hash);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    size_t slot = shard.find(key, hash);
+    if (slot == NONE) {
+        return std::nullopt;
+    }
+    const auto& entry = shard.slots[slot].entry;
+    if (!entry.soa || std::chrono::steady_clock::now() > entry.expireTime) {
+        return std::nullopt;
+    }
+    if (security) {
+        *security = entry.security;
+    }
+    if (expires) {
+        *expires = entry.expireTime;
+    }
+
+    shard.slots[slot].referenced = true;
+    return entry.soa;
+}
+
+std::shared_ptr<const WireAnswer> FlatCache::getWire(const cacheKey& key, std::chrono::steady_clock::time_point& expires) {
+    size_t hash = std::hash<cacheKey>()(key);
+    Shard& shard = shardOf(hash);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    size_t slot = shard.find(key, hash);
+    if (slot == NONE) {
+        return nullptr;
+    }
+    auto& entry = shard.slots[slot].entry;
+    if (!entry.wire || std::chrono::steady_clock::now() > entry.expireTime) {
+        return nullptr;
+    }
+    expires = entry.expireTime;
+
+    shard.slots[slot].referenced = true;
+    if (!entry.soa) {
+        CountHit(entry, shard.prefetchWindow, shard.prefetchMinRate, shard.prefetchQueue);
+    }
+    return entry.wire;
+}
+
+void FlatCache::attachWire(const cacheKey& key, std::chrono::steady_clock::time_point expires, std::shared_ptr<const WireAnswer> wire) {
+    size_t hash = std::hash<cacheKey>()(key);
+    Shard& shard = shardOf(hash);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    size_t slot = shard.find(key, hash);
+    if (slot != NONE && shard.slots[slot].entry.expireTime == expires) {
+        shard.slots[slot].entry.wire = std::move(wire);
+    }
+}
+
+bool FlatCache::putNegative(cacheKey key, std::shared_ptr<dnslib::ResourceRecord> soa, uint32_t TTL, Security security) {
+    size_t hash = std::hash<cacheKey>()(key);
+    Shard& shard = shardOf(hash);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto now = std::chrono::steady_clock::now();
+    if (shard.outranked(key, hash, Trust::AUTHORITY, now)) {
+        return false;
+    }
+
+    CacheEntry entry;
+    entry.key = std::move(key);
+    entry.soa = std::move(soa);
+    entry.expireTime = now + std::chrono::seconds(TTL);
+    entry.insertTime = now;
+    entry.security = security;
+    entry.trust = Trust::AUTHORITY;
+    shard.insert(std::move(entry), hash);
+    return true;
+}
+
+void FlatCache::prefetch(const std::vector<cacheKey>& keys) {
+    // Bucket tables never move once built, their lines can be touched without the lock
+    for (const auto& key : keys) {
+        size_t hash = std::hash<cacheKey>()(key);
+        Shard& shard = shardOf(hash);
+        __builtin_prefetch(&shard.buckets[Home(hash, shard.mask)]);
+    }
+}
+
+std::optional<std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>>> FlatCache::getStale(cacheKey key) {
+    size_t hash = std::hash<cacheKey>()(key);
+    Shard& shard = shardOf(hash);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    size_t slot = shard.find(key, hash);
+    if (slot == NONE) {
+        return std::nullopt;
+    }
+    const auto& entry = shard.slots[slot].entry;
+    if (entry.soa || entry.trust < Trust::ANSWER || entry.security == Security::BOGUS) {
+        return std::nullopt;
+    }
+
+    return entry.value;
+}
+
+void FlatCache::setStaleWindow(std::chrono::seconds window) {
+    for (size_t i = 0; i < numShards; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mtx);
+        shards[i].staleWindow = window;
+    }
+}
+
+void FlatCache::setPrefetch(unsigned windowPercent, double minHitsPerMinute) {
+    for (size_t i = 0; i < numShards; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mtx);
+        shards[i].prefetchWindow = windowPercent;
+        shards[i].prefetchMinRate = minHitsPerMinute;
+    }
+}
+
+std::vector<cacheKey> FlatCache::takePrefetchCandidates() {
+    std::vector<cacheKey> keys;
+    for (size_t i = 0; i < numShards; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mtx);
+        keys.insert(keys.end(), shards[i].prefetchQueue.begin(), shards[i].prefetchQueue.end());
+        shards[i].prefetchQueue.clear();
+    }
+    return keys;
+}
@@ -4,6 +4,7 @@
 #include <fstream>
 #include <unistd.h>
 #include <string.h>
+#include <csignal>
 
 #include "dns.hpp"
 
@@ -14,21 +15,24 @@
 #include "message/DNSMessage.hpp"
 #include "utils/etsqueue.hpp"
 #include "connector.hpp"
-#include "resolver.cpp"
+#include "resolver.hpp"
 #include "utils/log.hpp"
+#include "utils/metrics.hpp"
 #include "cache.hpp"
+#include "config.hpp"
 
 
 int main(int argc, char** argv){
     
-    bool runAsDaemon = false;
-    for (int i = 1; i < argc; ++i) {
-        if (strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--daemon") == 0) {
-            runAsDaemon = true;
-        }
+    ServerConfig config;
+    try {
+        config = parseArgs(argc, argv);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << "\n" << usage(argv[0]);
+        return 1;
     }
     
-    if (runAsDaemon) {
+    if (config.daemon) {
         if (daemon(0, 0) == -1) {
             std::cerr << "Failed to daemonize" << std::endl;
             return 1;
@@ -41,7 +45,15 @@ int main(int argc, char** argv){
     // --- DNS START ---
     DNS_LOG_INFO("--- DNS Server Starting ---");
 
+    // kill -USR1 <pid> logs all counters and tables
+    utils::Metrics::get();
+    std::signal(SIGUSR1, [](int) { utils::Metrics::get().requestDump(); });
+    // kill -HUP <pid> reloads the root zone copy, the local zones and the blocklists
+    std::signal(SIGHUP, [](int) { requestReload(); });
+
     TLRUCache dnsCache(1000);
+    dnsCache.setPrefetch(config.prefetchWindow, config.prefetchMinRate);
+    dnsCache.setStaleWindow(std::chrono::seconds(config.staleWindow));
 
     utils::ETSQueue<dnslib::DNSMessageL> qIn;
     utils::ETSQueue<dnslib::DNSMessageL> qOut;
@@ -51,7 +63,7 @@ int main(int argc, char** argv){
     DNS_LOG_INFO("Logic thread started");
     */
 
-    std::thread logicThread(resolverWorker, std::ref(qIn), std::ref(qOut), std::ref(dnsCache));
+    std::thread logicThread(resolverWorker, std::ref(qIn), std::ref(qOut), std::ref(dnsCache), std::cref(config));
     DNS_LOG_INFO("Logic thread (Resolver) started");
 
     std::thread netThread(networkThread, 53, std::ref(qIn), std::ref(qOut));
@@ -0,0 +1,260 @@
+#include "nseccache.hpp"
+
+#include "dnssec.hpp"
+#include "utils/log.hpp"
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+constexpr uint16_t TYPE_NS = static_cast<uint16_t>(dnslib::TYPE::NS);
+constexpr uint16_t TYPE_SOA = static_cast<uint16_t>(dnslib::TYPE::SOA);
+// Not parsed by dnslib, still seen in type bitmaps
+constexpr uint16_t TYPE_DNAME = 39;
+
+
+static std::string Lower(std::string name) {
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+    return name;
+}
+
+static std::string ParentName(const std::string& name) {
+    auto dot = name.find('.');
+    return dot == std::string::npos ? "" : name.substr(dot + 1);
+}
+
+static bool InZone(const std::string& name, const std::string& zone) {
+    if (zone.empty() || name == zone) return true;
+    return name.size() > zone.size() && name.compare(name.size() - zone.size(), zone.size(), zone) == 0
+        && name[name.size() - zone.size() - 1] == '.';
+}
+
+static std::string FirstLabel(const std::string& name) {
+    return name.substr(0, name.find('.'));
+}
+
+static std::string Wildcard(const std::string& name) {
+    return name.empty() ? "*" : "*." + name;
+}
+
+// Labels from the right, so that plain string order is the canonical DNS name order (RFC 4034, section 6.1)
+static std::string CanonicalKey(const std::string& name) {
+    std::string key;
+    key.reserve(name.size());
+    size_t end = name.size();
+    while (end != std::string::npos && !name.empty()) {
+        size_t dot = end == 0 ? std::string::npos : name.rfind('.', end - 1);
+        size_t start = dot == std::string::npos ? 0 : dot + 1;
+        if (!key.empty()) key += '\0';
+        key.append(name, start, end - start);
+        end = dot;
+    }
+    return key;
+}
+
+// Ancestors of name up to and including zone, name first
+static std::vector<std::string> Enclosers(const std::string& name, const std::string& zone) {
+    std::vector<std::string> names{name};
+    while (names.back() != zone && !names.back().empty()) {
+        names.push_back(ParentName(names.back()));
+    }
+    return names;
+}
+
+// Whether a name with these types delegates its subtree elsewhere
+template <typename Record>
+static bool Delegates(const Record& rec) {
+    return (rec.hasType(TYPE_NS) && !rec.hasType(TYPE_SOA)) || rec.hasType(TYPE_DNAME);
+}
+
+// Live entry at or before key; with wrap, the last entry for a key before the first one
+template <typename Ranges>
+static const typename Ranges::mapped_type* Before(const Ranges& ranges, const std::string& key, NsecCache::Clock::time_point now, bool wrap) {
+    auto it = ranges.upper_bound(key);
+    if (it == ranges.begin()) {
+        if (!wrap || ranges.empty()) return nullptr;
+        it = ranges.end();
+    }
+    --it;
+    return now < it->second.expires ? &it->second : nullptr;
+}
+
+void NsecCache::insert(std::map<std::string, Entry>& ranges, std::string key, Entry entry) {
+    auto [it, inserted] = ranges.insert_or_assign(std::move(key), std::move(entry));
+    records += inserted ? 1 : 0;
+}
+
+void NsecCache::erase(const std::string& zone) {
+    auto it = zones.find(zone);
+    if (it == zones.end()) return;
+    records -= it->second.nsec.size() + it->second.nsec3.size();
+    zones.erase(it);
+}
+
+// Drops expired records, then whole zones closest to expiry while over capacity
+void NsecCache::prune(const std::string& keep, Clock::time_point now) {
+    if (records < capacity) return;
+
+    for (auto& [name, zone] : zones) {
+        for (auto* ranges : {&zone.nsec, &zone.nsec3}) {
+            records -= std::erase_if(*ranges, [&](const auto& entry) { return now >= entry.second.expires; });
+        }
+    }
+    while (records >= capacity) {
+        auto victim = zones.end();
+        for (auto it = zones.begin(); it != zones.end(); ++it) {
+            if (it->first == keep) continue;
+            if (victim == zones.end() || it->second.soaExpires < victim->second.soaExpires) victim = it;
+        }
+        if (victim == zones.end()) break;
+        records -= victim->second.nsec.size() + victim->second.nsec3.size();
+        zones.erase(victim);
+    }
+}
+
+void NsecCache::store(const RecordList& authority, Clock::time_point now) {
+    std::shared_ptr<dnslib::SOARecord> soa;
+    for (const auto& rec : authority) {
+        if ((soa = std::dynamic_pointer_cast<dnslib::SOARecord>(rec))) break;
+    }
+    if (!soa) return;
+
+    std::string zoneName = Lower(soa->getName());
+    auto expires = now + std::chrono::seconds(std::min({soa->getTtl(), soa->getMinimum(), maxTtl}));
+
+    std::lock_guard<std::mutex> lock(mtx);
+    prune(zoneName, now);
+    auto& zone = zones[zoneName];
+    zone.soa = soa;
+    zone.soaExpires = expires;
+
+    for (const auto& rec : authority) {
+        auto until = std::min(expires, now + std::chrono::seconds(rec->getTtl()));
+        std::string owner = Lower(rec->getName());
+
+        if (auto nsec = std::dynamic_pointer_cast<dnslib::NSECRecord>(rec)) {
+            if (!InZone(owner, zoneName)) continue;
+            insert(zone.nsec, CanonicalKey(owner), {rec, until});
+            continue;
+        }
+
+        auto nsec3 = std::dynamic_pointer_cast<dnslib::NSEC3Record>(rec);
+        if (!nsec3 || ParentName(owner) != zoneName || nsec3->optOut() || nsec3->getHashAlgorithm() != 1
+            || nsec3->getIterations() > Validator::MAX_NSEC3_ITERATIONS) continue;
+
+        if (nsec3->getSalt() != zone.salt || nsec3->getIterations() != zone.iterations) {
+            // Resigned with new parameters, the old hashes are of no use
+            records -= zone.nsec3.size();
+            zone.nsec3.clear();
+            zone.salt = nsec3->getSalt();
+            zone.iterations = nsec3->getIterations();
+        }
+        insert(zone.nsec3, FirstLabel(owner), {rec, until});
+    }
+}
+
+std::optional<NsecCache::Denial> NsecCache::lookup(const std::string& rawName, dnslib::TYPE type, Clock::time_point now) {
+    std::string name = Lower(rawName);
+    std::string zoneName;
+    std::shared_ptr<dnslib::ResourceRecord> soa;
+    std::vector<uint8_t> salt;
+    uint16_t iterations = 0;
+    bool hashed = false;
+    bool exact = false;
+    RecordList proofs;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        // Closest enclosing zone known, the root last
+        auto it = zones.find(name);
+        for (size_t dot = name.find('.'); it == zones.end() && dot != std::string::npos; dot = name.find('.', dot + 1)) {
+            it = zones.find(name.substr(dot + 1));
+        }
+        if (it == zones.end()) {
+            it = zones.find("");
+        }
+        if (it == zones.end()) return std::nullopt;
+
+        auto& [zoneKey, zone] = *it;
+        if (now >= zone.soaExpires) {
+            erase(zoneKey);
+            return std::nullopt;
+        }
+        zoneName = zoneKey;
+        soa = zone.soa;
+
+        auto enclosers = Enclosers(name, zoneName);
+        if (auto at = Before(zone.nsec, CanonicalKey(name), now, false)) {
+            proofs.push_back(at->record);
+            exact = Lower(at->record->getName()) == name;
+        }
+        for (size_t i = 1; i < enclosers.size(); i++) {
+            if (auto at = Before(zone.nsec, CanonicalKey(enclosers[i]), now, false)) {
+                // Below a zone cut the parent proves nothing
+                auto nsec = std::static_pointer_cast<dnslib::NSECRecord>(at->record);
+                if (i + 1 < enclosers.size() && Lower(nsec->getName()) == enclosers[i] && Delegates(*nsec)) return std::nullopt;
+            }
+            if (auto at = Before(zone.nsec, CanonicalKey(Wildcard(enclosers[i])), now, false)) {
+                proofs.push_back(at->record);
+            }
+        }
+
+        hashed = !zone.nsec3.empty();
+        salt = zone.salt;
+        iterations = zone.iterations;
+    }
+
+    if (hashed) {
+        // Hashed outside the lock, every encloser and the wildcard below it
+        auto enclosers = Enclosers(name, zoneName);
+        std::vector<std::string> hashes;
+        for (const auto& encloser : enclosers) {
+            hashes.push_back(dnslib::utils::toBase32Hex(Validator::nsec3Hash(encloser, salt, iterations)));
+            hashes.push_back(dnslib::utils::toBase32Hex(Validator::nsec3Hash(Wildcard(encloser), salt, iterations)));
+        }
+
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = zones.find(zoneName);
+        if (it == zones.end()) return std::nullopt;
+
+        for (size_t i = 0; i < hashes.size(); i++) {
+            auto at = Before(it->second.nsec3, hashes[i], now, true);
+            if (!at) continue;
+
+            auto nsec3 = std::static_pointer_cast<dnslib::NSEC3Record>(at->record);
+            bool matches = FirstLabel(Lower(nsec3->getName())) == hashes[i];
+            size_t encloser = i / 2;
+            if (matches && i % 2 == 0 && encloser == 0) exact = true;
+            if (matches && i % 2 == 0 && encloser > 0 && encloser + 1 < enclosers.size() && Delegates(*nsec3)) return std::nullopt;
+            proofs.push_back(at->record);
+        }
+    }
+
+    // Checked with the code that validates upstream denials, against the few records that matter
+    auto code = static_cast<uint16_t>(type);
+    if (exact) {
+        if (!Validator::deniesType(name, code, proofs)) return std::nullopt;
+        return Denial{dnslib::RCODE::NOERROR, soa};
+    }
+    if (Validator::deniesName(name, proofs)) {
+        return Denial{dnslib::RCODE::NAMEERROR, soa};
+    }
+    if (Validator::deniesType(name, code, proofs)) {
+        // NODATA at the wildcard that would have matched
+        return Denial{dnslib::RCODE::NOERROR, soa};
+    }
+    return std::nullopt;
+}
+
+size_t NsecCache::size() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return records;
+}
+
+std::string NsecCache::toString() const {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::stringstream ss;
+    ss << zones.size() << " zones, " << records << " NSEC/NSEC3 records\n";
+    return ss.str();
+}
@@ -0,0 +1,179 @@
+#include "nsstats.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cmath>
+#include <sstream>
+
+// Unknown servers look fast so that they get probed at least once
+constexpr double INITIAL_SRTT_MS = 10.0;
+constexpr double TIMEOUT_PENALTY_MS = 1000.0;
+// Idle statistics lose half of their weight every DECAY_HALF_LIFE
+constexpr auto DECAY_HALF_LIFE = std::chrono::seconds(60);
+
+constexpr auto MIN_TIMEOUT = std::chrono::milliseconds(100);
+constexpr auto MAX_TIMEOUT = std::chrono::milliseconds(2000);
+constexpr auto UNKNOWN_TIMEOUT = std::chrono::milliseconds(800);
+
+constexpr auto BASE_BACKOFF = std::chrono::seconds(5);
+constexpr auto MAX_BACKOFF = std::chrono::seconds(300);
+// Unused this long, what an entry knows has decayed to nothing
+constexpr auto FORGET_AFTER = DECAY_HALF_LIFE * 10;
+
+NameserverStats::NameserverStats(size_t maxServers, double exploreRate)
+    : maxServers(std::max<size_t>(maxServers, 1)), exploreRate(exploreRate) {}
+
+void NameserverStats::decay(Entry& entry, Clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - entry.updated).count();
+    double halfLife = std::chrono::duration<double>(DECAY_HALF_LIFE).count();
+    if (elapsed <= 0) return;
+
+    double factor = std::exp2(-elapsed / halfLife);
+    entry.srtt = INITIAL_SRTT_MS + (entry.srtt - INITIAL_SRTT_MS) * factor;
+    entry.timeouts *= factor;
+    entry.updated = now;
+}
+
+NameserverStats::Entry& NameserverStats::entryFor(uint32_t address, Clock::time_point now) {
+    auto it = servers.find(address);
+    if (it != servers.end()) {
+        return it->second;
+    }
+
+    if (servers.size() >= maxServers) {
+        // Forgotten entries first, the longest unused one if there are none
+        std::erase_if(servers, [now](const auto& item) {
+            return now - item.second.updated > FORGET_AFTER && item.second.backoffUntil <= now;
+        });
+    }
+    if (servers.size() >= maxServers) {
+        auto oldest = std::min_element(servers.begin(), servers.end(), [](const auto& a, const auto& b) {
+            return a.second.updated < b.second.updated;
+        });
+        servers.erase(oldest);
+    }
+    return servers[address];
+}
+
+double NameserverStats::score(uint32_t address, Clock::time_point now) {
+    auto it = servers.find(address);
+    if (it == servers.end()) {
+        return INITIAL_SRTT_MS;
+    }
+
+    auto& entry = it->second;
+    decay(entry, now);
+    return entry.srtt + entry.timeouts * TIMEOUT_PENALTY_MS;
+}
+
+void NameserverStats::recordRtt(uint32_t address, std::chrono::microseconds rtt, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    double sample = rtt.count() / 1000.0;
+
+    auto& entry = entryFor(address, now);
+    if (entry.samples == 0) {
+        entry.srtt = sample;
+        entry.rttvar = sample / 2;
+    } else {
+        decay(entry, now);
+        entry.rttvar = 0.75 * entry.rttvar + 0.25 * std::abs(entry.srtt - sample);
+        entry.srtt = 0.875 * entry.srtt + 0.125 * sample;
+    }
+
+    entry.samples++;
+    entry.consecutiveTimeouts = 0;
+    entry.backoffUntil = {};
+    entry.updated = now;
+}
+
+void NameserverStats::recordTimeout(uint32_t address, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto& entry = entryFor(address, now);
+    if (entry.samples == 0 && entry.consecutiveTimeouts == 0) {
+        entry.srtt = INITIAL_SRTT_MS;
+    } else {
+        decay(entry, now);
+    }
+
+    entry.timeouts += 1;
+    entry.consecutiveTimeouts++;
+    entry.updated = now;
+
+    if (entry.consecutiveTimeouts >= BACKOFF_THRESHOLD) {
+        int exponent = std::min(entry.consecutiveTimeouts - BACKOFF_THRESHOLD, 6);
+        auto backoff = std::min<Clock::duration>(BASE_BACKOFF * (1 << exponent), MAX_BACKOFF);
+        entry.backoffUntil = now + backoff;
+    }
+}
+
+uint32_t NameserverStats::select(const std::vector<uint32_t>& candidates, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::vector<uint32_t> usable;
+    for (auto address : candidates) {
+        auto it = servers.find(address);
+        if (it == servers.end() || it->second.backoffUntil <= now) {
+            usable.push_back(address);
+        }
+    }
+    // Everything is backed off, better to try anyway than to fail outright
+    if (usable.empty()) {
+        usable = candidates;
+    }
+
+    if (usable.size() > 1 && std::uniform_real_distribution<double>(0, 1)(rng) < exploreRate) {
+        return usable[std::uniform_int_distribution<size_t>(0, usable.size() - 1)(rng)];
+    }
+
+    uint32_t best = usable[0];
+    double bestScore = score(best, now);
+    for (size_t i = 1; i < usable.size(); i++) {
+        double s = score(usable[i], now);
+        if (s < bestScore) {
+            best = usable[i];
+            bestScore = s;
+        }
+    }
+    return best;
+}
+
+std::chrono::milliseconds NameserverStats::timeout(uint32_t address) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto it = servers.find(address);
+    if (it == servers.end() || it->second.samples == 0) {
+        return UNKNOWN_TIMEOUT;
+    }
+
+    auto rto = std::chrono::milliseconds(static_cast<int64_t>(it->second.srtt + 4 * it->second.rttvar));
+    return std::clamp<std::chrono::milliseconds>(rto, MIN_TIMEOUT, MAX_TIMEOUT);
+}
+
+size_t NameserverStats::size() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return servers.size();
+}
+
+std::string NameserverStats::toString() const {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto now = Clock::now();
+    std::stringstream ss;
+    for (const auto& [address, entry] : servers) {
+        in_addr addr;
+        addr.s_addr = htonl(address);
+
+        ss << inet_ntoa(addr)
+           << " srtt=" << static_cast<int>(entry.srtt) << "ms"
+           << " rttvar=" << static_cast<int>(entry.rttvar) << "ms"
+           << " samples=" << entry.samples
+           << " timeouts=" << entry.timeouts;
+        if (entry.backoffUntil > now) {
+            ss << " backoff=" << std::chrono::duration_cast<std::chrono::seconds>(entry.backoffUntil - now).count() << "s";
+        }
+        ss << "\n";
+    }
+    return ss.str();
+}
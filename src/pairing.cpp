@@ -0,0 +1,89 @@
+#include "pairing.hpp"
+
+#include <cmath>
+#include <sstream>
+
+// Second half of a pair comes within this window, stubs send both at once or on the first answer
+constexpr auto PAIR_WINDOW = std::chrono::seconds(2);
+// Counts lose half of their weight every HALF_LIFE, a client changing stack is noticed in minutes
+constexpr auto HALF_LIFE = std::chrono::seconds(120);
+// Clients without queries for this long may be forgotten
+constexpr auto IDLE_CLIENT = std::chrono::seconds(600);
+
+
+static bool Sibling(dnslib::TYPE a, dnslib::TYPE b) {
+    return (a == dnslib::TYPE::A && b == dnslib::TYPE::AAAA) || (a == dnslib::TYPE::AAAA && b == dnslib::TYPE::A);
+}
+
+// Estimate with one pair and one single query assumed, so a new client starts half way
+static double Rate(double paired, double queries) {
+    return (paired + 1) / (queries + 2);
+}
+
+void PairingTracker::decay(Client& client, Clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - client.updated).count();
+    if (elapsed <= 0) return;
+
+    double factor = std::exp2(-elapsed / std::chrono::duration<double>(HALF_LIFE).count());
+    client.queries *= factor;
+    client.paired *= factor;
+    client.updated = now;
+}
+
+void PairingTracker::prune(Clock::time_point now) {
+    if (clients.size() < MAX_CLIENTS) return;
+
+    std::erase_if(clients, [&](const auto& entry) { return now - entry.second.updated > IDLE_CLIENT; });
+    if (clients.size() >= MAX_CLIENTS) {
+        // Still full of active clients: start over, new ones get the default estimate anyway
+        clients.clear();
+    }
+}
+
+bool PairingTracker::observe(uint32_t address, const std::string& name, dnslib::TYPE type, Clock::time_point now) {
+    if (type != dnslib::TYPE::A && type != dnslib::TYPE::AAAA) return false;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = clients.find(address);
+    if (it == clients.end()) {
+        prune(now);
+        it = clients.emplace(address, Client{}).first;
+        it->second.updated = now;
+    }
+    auto& client = it->second;
+    decay(client, now);
+    // From the history, before this query counts
+    bool likely = Rate(client.paired, client.queries) >= ratio;
+    client.queries += 1;
+
+    for (auto& question : client.recent) {
+        if (question.paired || now - question.at > PAIR_WINDOW || !Sibling(question.type, type) || question.name != name) continue;
+
+        // Both halves count, the sibling of this one is asked already
+        question.paired = true;
+        client.paired += 2;
+        return false;
+    }
+
+    client.recent[client.next] = {name, type, now, false};
+    client.next = (client.next + 1) % RECENT;
+    return likely;
+}
+
+double PairingTracker::rate(uint32_t address) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = clients.find(address);
+    return it == clients.end() ? Rate(0, 0) : Rate(it->second.paired, it->second.queries);
+}
+
+std::string PairingTracker::toString() const {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    size_t pairing = 0;
+    for (const auto& [address, client] : clients) {
+        pairing += Rate(client.paired, client.queries) >= ratio ? 1 : 0;
+    }
+    std::stringstream ss;
+    ss << clients.size() << " clients tracked, " << pairing << " get sibling fetches\n";
+    return ss.str();
+}
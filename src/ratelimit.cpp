@@ -0,0 +1,126 @@
+#include "ratelimit.hpp"
+
+#include "utils/metrics.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <sstream>
+
+constexpr size_t HEADER_SIZE = 12;
+// Entries refused this recently count as limited clients
+constexpr auto LIMITED_WINDOW = std::chrono::seconds(1);
+
+enum ResponseKind : uint8_t { ANSWER, NODATA, NXDOMAIN, ERROR };
+
+static ResponseKind Classify(const std::vector<uint8_t>& response) {
+    if (response.size() < HEADER_SIZE) return ERROR;
+
+    uint8_t rcode = response[3] & 0x0f;
+    uint16_t answers = (response[6] << 8) | response[7];
+    if (rcode == 3) return NXDOMAIN;
+    if (rcode != 0) return ERROR;
+    return answers > 0 ? ANSWER : NODATA;
+}
+
+static uint64_t Mix(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+ResponseRateLimiter::ResponseRateLimiter(double rate, unsigned slip, size_t capacity)
+    : rate(rate), burst(std::max(rate, 1.0)), slip(slip) {
+    setsPerShard = std::max<size_t>(1, (capacity + SHARDS * WAYS - 1) / (SHARDS * WAYS));
+    for (auto& shard : shards) {
+        shard.entries.resize(setsPerShard * WAYS);
+    }
+}
+
+ResponseRateLimiter::Action ResponseRateLimiter::check(const sockaddr_in& client, const std::vector<uint8_t>& response, Clock::time_point now) {
+    uint32_t prefix = ntohl(client.sin_addr.s_addr) >> 8;
+    // The top bit keeps keys of real entries away from 0
+    uint64_t key = (1ULL << 63) | (uint64_t(prefix) << 8) | Classify(response);
+
+    uint64_t hash = Mix(key);
+    auto& shard = shards[hash % SHARDS];
+    size_t set = (hash / SHARDS) % setsPerShard;
+
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto begin = shard.entries.begin() + set * WAYS;
+    auto end = begin + WAYS;
+
+    auto entry = std::find_if(begin, end, [key](const Entry& e) { return e.key == key; });
+    if (entry == end) {
+        entry = std::min_element(begin, end, [](const Entry& a, const Entry& b) { return a.last < b.last; });
+        *entry = Entry{key, burst, now, 0};
+    }
+
+    double elapsed = std::chrono::duration<double>(now - entry->last).count();
+    entry->tokens = std::min(burst, entry->tokens + std::max(0.0, elapsed) * rate);
+    entry->last = now;
+
+    if (entry->tokens >= 1) {
+        entry->tokens -= 1;
+        entry->limited = 0;
+        return Action::SEND;
+    }
+
+    if (entry->limited++ == 0) {
+        DNS_METRIC_INC("rrl.limited_clients");
+    }
+    if (slip > 0 && entry->limited % slip == 0) {
+        return Action::SLIP;
+    }
+    return Action::DROP;
+}
+
+std::vector<uint8_t> ResponseRateLimiter::truncate(const std::vector<uint8_t>& response) {
+    if (response.size() < HEADER_SIZE) return response;
+
+    // Question name, then type and class
+    size_t pos = HEADER_SIZE;
+    while (pos < response.size() && response[pos] != 0 && (response[pos] & 0xc0) == 0) {
+        pos += response[pos] + 1;
+    }
+    if (pos < response.size() && (response[pos] & 0xc0) == 0xc0) {
+        pos += 2;
+    } else {
+        pos += 1;
+    }
+    pos += 4;
+
+    uint16_t questions = (response[4] << 8) | response[5];
+    if (questions == 0 || pos > response.size()) {
+        pos = HEADER_SIZE;
+        questions = 0;
+    }
+
+    std::vector<uint8_t> truncated(response.begin(), response.begin() + pos);
+    truncated[2] |= 0x02;
+    truncated[4] = 0;
+    truncated[5] = questions > 0 ? 1 : 0;
+    std::fill(truncated.begin() + 6, truncated.begin() + HEADER_SIZE, 0);
+    return truncated;
+}
+
+size_t ResponseRateLimiter::limitedCount(Clock::time_point now) const {
+    size_t count = 0;
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        for (const auto& entry : shard.entries) {
+            if (entry.key != 0 && entry.limited > 0 && now - entry.last < LIMITED_WINDOW) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+std::string ResponseRateLimiter::toString() const {
+    std::stringstream ss;
+    ss << "rate=" << rate << "/s slip=" << slip << " entries=" << setsPerShard * WAYS * SHARDS
+       << " limited=" << limitedCount() << "\n";
+    return ss.str();
+}
@@ -1,216 +1,1899 @@
-#include "dns.hpp"
-#include "message/DNSPacket.hpp"
-#include "utils/etsqueue.hpp"
+#include "resolver.hpp"
+
 #include "utils/log.hpp"
-#include "cache.hpp"
+#include "utils/metrics.hpp"
+#include "utils/read.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
 #include <exception>
-#include <iostream>
-#include <arpa/inet.h> 
-
-
-auto CheckCache(auto questions, auto& packet, TLRUCache& dnsCache) -> std::optional<dnslib::DNSPacket> {
-    
-    if (questions.empty()) return std::nullopt;
-
-    auto& first_question = questions[0]; 
-    
-    cacheKey key;
-    key.name = first_question.getName();
-    key.type = first_question.getType();
-    
-    //Czy wywołujemy gdzieś ten cache wgl?
-    auto cached_response = dnsCache.get(key);
-    
-    //Hit in cache
-    // 4. If address is known serialize and put to queue
-    if(cached_response.has_value()){
-        DNS_LOG_INFO("Cache HIT for: " + key.name);
-    
-        dnslib::PacketBuilder builder;
-        builder.setId(packet.getHeader().getId());
-        
-        dnslib::PacketFlag flags = dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::RECURSION_AVAIL;
-        if (packet.getHeader().recursionDesired()) {
-            flags = flags | dnslib::PacketFlag::RECURSION_DES;
-        }
-        builder.withFlags(flags);
-        
-        builder.addQuestion(first_question.getName(), first_question.getType());
-        
-        for (const auto& record : *cached_response.value()) {
-            builder.addAnswer(record);
-        }
-    
-        dnslib::DNSPacket response_packet = builder.build();
-    
-        return response_packet;
-    }
 
-    return std::nullopt;
-}
 
-struct PendingQuery {
+// Longest CNAME chain followed for a single question, in the cache and upstream
+constexpr size_t MAX_CNAME_CHAIN = 8;
+// How many glue-less NS names are resolved at once for a single referral
+constexpr size_t MAX_NS_SUBQUERIES = 3;
+// Sub-resolutions may themselves hit glue-less referrals, but not forever
+constexpr int MAX_SUBQUERY_DEPTH = 4;
+// Delegation depth followed from the root for a single name
+constexpr int MAX_REFERRALS = 16;
+// Forwarding mode: an upstream does its own retries, give it time
+constexpr auto FORWARD_TIMEOUT = std::chrono::milliseconds(2000);
+// A query waits this long at most for a throttled nameserver, then the next one is tried
+constexpr auto THROTTLE_WAIT = std::chrono::milliseconds(400);
+// Retry of a truncated answer over TCP, connection setup included
+constexpr auto TCP_TIMEOUT = std::chrono::milliseconds(3000);
+// RFC 2308 suggests capping negative TTLs at a few hours
+constexpr uint32_t MAX_NEGATIVE_TTL = 3 * 3600;
+// TTL put on stale records, RFC 8767 recommends 30 seconds
+constexpr uint32_t STALE_TTL = 30;
+// TTL of sinkhole answers to blocked names
+constexpr uint32_t BLOCKED_TTL = 300;
+// Bogus answers are cached this long at most, their SERVFAIL costs no crypto work meanwhile
+constexpr uint32_t BOGUS_TTL = 60;
+
+static std::atomic<bool> reloadRequested = false;
+
+/**
+ * @brief Client waiting for an answer, shared with its serve-stale timer
+ */
+struct Resolver::ClientSlot {
     sockaddr_in address;
+    uint16_t id;
     bool recursionDesired;
+    std::string name;
+    dnslib::TYPE type;
+    QueryContext context;
+
+    std::atomic<bool> answered = false;
+    std::vector<uint8_t> staleResponse;     // expired answer to fall back on, empty if none is cached
+    bool pairing = false;                   // will probably ask the sibling A/AAAA type next
+    std::shared_ptr<CompanionFetch> companion;
 };
 
-static std::unordered_map<uint16_t, PendingQuery> pending_queries;
+/**
+ * @brief Sibling A/AAAA fetch started ahead of the client's next query
+ *
+ * Queries for that question wait for it rather than walking from the root
+ * themselves, then find its answer in the cache.
+ */
+struct CompanionFetch : std::enable_shared_from_this<CompanionFetch> {
+    std::string name;
+    dnslib::TYPE type;
+    std::atomic<bool> launched = false;     // fetched, or given up by the resolution that carried it
 
-inline void HandleRequest(
-    dnslib::DNSMessageL& message,
-    dnslib::DNSPacket& packet,
-    utils::ETSQueue<dnslib::DNSMessageL>& outputQueue,
-    TLRUCache& dnsCache,
-    const sockaddr_in& upstreamAddr
-) {
-    auto questions = packet.getQuestions();
-    if (questions.empty()) return;
+    std::mutex mtx;
+    bool done = false;
+    std::vector<std::coroutine_handle<>> waiters;
+};
 
-    uint16_t dnsId = packet.getHeader().getId();
-    DNS_LOG_DEBUG("Received Request ID: " + std::to_string(dnsId) + " for " + questions[0].getName());
+// co_await CompanionWait{fetch, executor, deadline} suspends until the fetch is done or deadline
+// passes, holds no reference for GCC 12
+struct CompanionWait {
+    CompanionFetch* fetch;
+    utils::Executor* executor;
+    std::chrono::steady_clock::time_point deadline;
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> handle) {
+        // The frame holding this awaiter may be gone once the handle is queued, copy what the timer needs
+        auto target = executor;
+        auto until = deadline;
+        std::weak_ptr<CompanionFetch> weak = fetch->weak_from_this();
+        {
+            std::lock_guard<std::mutex> lock(fetch->mtx);
+            if (fetch->done) return false;
+            fetch->waiters.push_back(handle);
+        }
+        if (until == std::chrono::steady_clock::time_point::max()) return true;
+
+        target->postAt(until, [target, weak, handle] {
+            auto fetch = weak.lock();
+            if (!fetch) return;
+            {
+                std::lock_guard<std::mutex> lock(fetch->mtx);
+                auto it = std::find(fetch->waiters.begin(), fetch->waiters.end(), handle);
+                if (it == fetch->waiters.end()) return;
+                fetch->waiters.erase(it);
+            }
+            DNS_METRIC_INC("companion.wait_timeouts");
+            target->post(handle);
+        });
+        return true;
+    }
+    void await_resume() const noexcept {}
+};
 
-    auto response_packet = CheckCache(questions, packet, dnsCache);
+static dnslib::TYPE SiblingType(dnslib::TYPE type) {
+    return type == dnslib::TYPE::A ? dnslib::TYPE::AAAA : dnslib::TYPE::A;
+}
 
-    if (!response_packet.has_value()) {
-        DNS_LOG_INFO("Cache MISS: " + questions[0].getName() + " -> Requesting recursive...");
-        
-        pending_queries[dnsId] = {message.peerAddress, packet.getHeader().recursionDesired()};
-        message.peerAddress = upstreamAddr;
+static bool ChainContains(const RecordList& chain, const std::string& name) {
+    for (const auto& link : chain) {
+        if (link->getName() == name) return true;
+    }
+    return false;
+}
 
-        // Clear RD flag for iterative query to Root
-        if (message.data.size() >= 3) {
-            message.data[2] &= ~0x01;
+/**
+ * @brief Follows cached CNAME links starting at name
+ *
+ * Every link found is appended to chain and name is moved to its target,
+ * so on a miss name is where the resolution has to continue.
+ * With stale set expired links and records still kept by the cache count too.
+ * security is lowered to the weakest DNSSEC status of what was found,
+ * expires, if given, to the first expiry of it (fresh lookups only).
+ *
+ * @return cached records of type owned by the last name of the chain
+ */
+static std::optional<RecordList> FollowCachedChain(std::string& name, dnslib::TYPE type, RecordList& chain, Security& security, TLRUCache& dnsCache,
+                                                   bool stale = false, std::chrono::steady_clock::time_point* expires = nullptr) {
+    auto lookup = [&](const cacheKey& key) {
+        Security status = Security::UNCHECKED;
+        auto expiry = std::chrono::steady_clock::time_point::max();
+        auto found = stale ? dnsCache.getStale(key) : dnsCache.get(key, &status, Trust::ANSWER, &expiry);
+        if (found.has_value()) {
+            security = Weakest(security, status);
+            if (expires) {
+                *expires = std::min(*expires, expiry);
+            }
         }
-        outputQueue.push(std::move(message));
-    } else {
-        message.data.clear();
-        response_packet->serialize(message.data);
-        outputQueue.push(std::move(message));
+        return found;
+    };
+
+    while (true) {
+        auto cached = lookup({name, type});
+        if (cached.has_value()) {
+            return *cached.value();
+        }
+
+        if (type == dnslib::TYPE::CNAME || chain.size() >= MAX_CNAME_CHAIN) {
+            return std::nullopt;
+        }
+
+        auto link = lookup({name, dnslib::TYPE::CNAME});
+        if (!link.has_value() || link.value()->empty()) {
+            return std::nullopt;
+        }
+
+        auto cname_rec = std::dynamic_pointer_cast<dnslib::CNAMERecord>(link.value()->front());
+        if (!cname_rec || ChainContains(chain, cname_rec->getCname()) || cname_rec->getCname() == name) {
+            return std::nullopt;
+        }
+
+        chain.push_back(cname_rec);
+        name = cname_rec->getCname();
     }
 }
 
-inline void HandleResponse(
-    dnslib::DNSMessageL& message,
-    dnslib::DNSPacket& packet,
-    utils::ETSQueue<dnslib::DNSMessageL>& outputQueue,
-    TLRUCache& dnsCache
-) {
-    uint16_t dnsId = packet.getHeader().getId();
-    DNS_LOG_DEBUG("Received Response ID: " + std::to_string(dnsId));
+// Caches every RRset of the answer section under its own name and type, with its DNSSEC status and rank
+static void CacheAnswers(const std::vector<SignedRRset>& rrsets, const std::vector<Security>& statuses, Trust trust, TLRUCache& dnsCache) {
+    for (size_t i = 0; i < rrsets.size(); i++) {
+        const auto& records = rrsets[i].records;
+        uint32_t ttl = records[0]->getTtl();
+        for (const auto& rec : records) {
+            ttl = std::min(ttl, rec->getTtl());
+        }
+        if (statuses[i] == Security::BOGUS) {
+            ttl = std::min(ttl, BOGUS_TTL);
+        }
+        cacheKey key{records[0]->getName(), static_cast<dnslib::TYPE>(records[0]->getType())};
+        if (!dnsCache.put(key, std::make_shared<RecordList>(records), ttl, statuses[i], trust)) {
+            DNS_METRIC_INC("cache.outranked");
+        }
+    }
+}
 
-    if (pending_queries.count(dnsId) == 0) {
-        DNS_LOG_WARN("Zignorowano nieznaną odpowiedź ID: " + std::to_string(dnsId));
-        return;
+// Keeps the glue of a referral for later ones to the same server, ranked below answers so clients never get it
+static void CacheGlue(const std::string& ns_name, const RecordList& glue, TLRUCache& dnsCache) {
+    if (glue.empty()) return;
+
+    uint32_t ttl = glue[0]->getTtl();
+    for (const auto& rec : glue) {
+        ttl = std::min(ttl, rec->getTtl());
     }
+    dnsCache.put({ns_name, dnslib::TYPE::A}, std::make_shared<RecordList>(glue), ttl, Security::UNCHECKED, Trust::GLUE);
+}
 
-    auto answers = packet.getAnswers();
-    auto questions = packet.getQuestions();
-    auto authority = packet.getAuthority();
-    auto additional = packet.getAdditional();
-
-    // Referral handling
-    if (answers.empty() && !authority.empty() && !additional.empty()) {
-        for(const auto& auth_rec : authority) {
-            if(auth_rec->getType() != static_cast<uint16_t>(dnslib::TYPE::NS)) continue;
-            
-            auto ns_rec = std::dynamic_pointer_cast<dnslib::NSRecord>(auth_rec);
-            if(!ns_rec) continue;
-            
-            std::string ns_name = ns_rec->getNs();
-            
-            for(const auto& add_rec : additional) {
-                if(add_rec->getType() != static_cast<uint16_t>(dnslib::TYPE::A)) continue;
-                if(add_rec->getName() != ns_name) continue;
+// DNSSEC status of the RRset of owner and type among rrsets
+static Security StatusOf(const std::vector<SignedRRset>& rrsets, const std::vector<Security>& statuses, const std::string& owner, dnslib::TYPE type) {
+    for (size_t i = 0; i < rrsets.size(); i++) {
+        const auto& first = *rrsets[i].records[0];
+        if (first.getName() == owner && first.getType() == static_cast<uint16_t>(type)) return statuses[i];
+    }
+    return Security::UNCHECKED;
+}
 
-                auto a_rec = std::dynamic_pointer_cast<dnslib::ARecord>(add_rec);
-                if(!a_rec) continue;
-                
-                DNS_LOG_INFO("Referral: " + questions[0].getName() + " -> " + ns_name);
-                
-                sockaddr_in next_addr{};
-                next_addr.sin_family = AF_INET;
-                next_addr.sin_port = htons(53);
-                next_addr.sin_addr.s_addr = htonl(a_rec->getIpAddress());
-                
-                message.peerAddress = next_addr;
-                
-                dnslib::PacketBuilder builder;
-                builder.setId(dnsId);
-                builder.withFlags(dnslib::PacketFlag::NONE);
-                builder.addQuestion(questions[0].getName(), questions[0].getType());
-                
-                dnslib::DNSPacket query_pkt = builder.build();
-                message.data.clear();
-                query_pkt.serialize(message.data);
-                
-                outputQueue.push(std::move(message));
-                return;
-            }
-        }
-    }
-
-    // Cache handling
-    if (!answers.empty() && !questions.empty()) {
-        auto& first_question = questions[0];
-        auto cacheVec = std::make_shared<std::vector<std::shared_ptr<dnslib::ResourceRecord>>>(answers);
-        uint32_t ttl = answers[0]->getTtl();
-        
-        cacheKey key;
-        key.name = first_question.getName();
-        key.type = first_question.getType();
-        dnsCache.put(key, cacheVec, ttl);
-    }
-
-    // Final response
-    auto& pending = pending_queries[dnsId];
-    message.peerAddress = pending.address;
-    
-    if (message.data.size() >= 4) {
-        message.data[3] |= 0x80;
-        if (pending.recursionDesired) {
-            message.data[2] |= 0x01;
+static void CountSecurity(Security security) {
+    switch (security) {
+    case Security::SECURE: DNS_METRIC_INC("dnssec.secure"); break;
+    case Security::INSECURE: DNS_METRIC_INC("dnssec.insecure"); break;
+    case Security::BOGUS: DNS_METRIC_INC("dnssec.bogus"); break;
+    case Security::UNCHECKED: break;
+    }
+}
+
+static std::string Lower(std::string name) {
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+    return name;
+}
+
+// Name one label up, "" for a TLD
+static std::string ParentName(const std::string& name) {
+    auto dot = name.find('.');
+    return dot == std::string::npos ? "" : name.substr(dot + 1);
+}
+
+// Whether name is zone or lies below it, names lowercased
+static bool InZone(const std::string& name, const std::string& zone) {
+    if (zone.empty() || name == zone) return true;
+    return name.size() > zone.size() && name.compare(name.size() - zone.size(), zone.size(), zone) == 0
+        && name[name.size() - zone.size() - 1] == '.';
+}
+
+// Records of section the servers of zone may speak for, those owned outside it are dropped
+static RecordList Admit(const RecordList& section, const std::string& zone) {
+    if (zone.empty()) return section;
+
+    RecordList admitted;
+    for (const auto& rec : section) {
+        if (InZone(Lower(rec->getName()), zone)) {
+            admitted.push_back(rec);
         } else {
-            message.data[2] &= ~0x01;
+            DNS_METRIC_INC("cache.out_of_bailiwick");
         }
     }
+    return admitted;
+}
 
-    pending_queries.erase(dnsId);
-    DNS_LOG_DEBUG("Sending final response to client for ID: " + std::to_string(dnsId));
-    outputQueue.push(std::move(message));
+// Labels of name as counted by RRSIG, a leading wildcard label left out
+static size_t LabelCount(const std::string& name) {
+    if (name.empty() || name == "*") return 0;
+    size_t labels = std::count(name.begin(), name.end(), '.') + 1;
+    return name.rfind("*.", 0) == 0 ? labels - 1 : labels;
 }
 
-inline void resolverWorker(
-    utils::ETSQueue<dnslib::DNSMessageL>& inputQueue, 
-    utils::ETSQueue<dnslib::DNSMessageL>& outputQueue,
-    TLRUCache& dnsCache
+// Cached NODATA for name and type, or NXDOMAIN for name
+static std::optional<Resolution> LookupNegative(const std::string& name, dnslib::TYPE type, TLRUCache& dnsCache) {
+    Resolution negative;
+    if (auto soa = dnsCache.getNegative({name, type}, &negative.security, &negative.expires)) {
+        negative.authority = {soa.value()};
+        return negative;
+    }
+    if (auto soa = dnsCache.getNegative({name, NXDOMAIN_TYPE}, &negative.security, &negative.expires)) {
+        negative.rcode = dnslib::RCODE::NAMEERROR;
+        negative.authority = {soa.value()};
+        return negative;
+    }
+    return std::nullopt;
+}
+
+// NXDOMAIN for name proven by a cached NXDOMAIN of one of its ancestors (RFC 8020)
+static std::optional<Resolution> LookupDeniedAncestor(const std::string& name, TLRUCache& dnsCache) {
+    for (auto ancestor = ParentName(name); !ancestor.empty(); ancestor = ParentName(ancestor)) {
+        Resolution negative;
+        if (auto soa = dnsCache.getNegative({ancestor, NXDOMAIN_TYPE}, &negative.security, &negative.expires)) {
+            negative.rcode = dnslib::RCODE::NAMEERROR;
+            negative.authority = {soa.value()};
+            return negative;
+        }
+    }
+    return std::nullopt;
+}
+
+// Caches a NXDOMAIN or NODATA answer for name, using the SOA from the authority section
+static void CacheNegative(const std::string& name, dnslib::TYPE type, dnslib::RCODE rcode, const RecordList& authority, Security security, TLRUCache& dnsCache) {
+    if (rcode != dnslib::RCODE::NOERROR && rcode != dnslib::RCODE::NAMEERROR) return;
+
+    for (const auto& rec : authority) {
+        auto soa = std::dynamic_pointer_cast<dnslib::SOARecord>(rec);
+        if (!soa) continue;
+
+        uint32_t ttl = std::min({soa->getTtl(), soa->getMinimum(), MAX_NEGATIVE_TTL});
+        if (security == Security::BOGUS) {
+            ttl = std::min(ttl, BOGUS_TTL);
+        }
+        cacheKey key{name, rcode == dnslib::RCODE::NAMEERROR ? NXDOMAIN_TYPE : type};
+        dnsCache.putNegative(key, soa, ttl, security);
+
+        DNS_LOG_DEBUG("Negative cache: " + name + " " + std::to_string(type) + " for " + std::to_string(ttl) + "s");
+        return;
+    }
+}
+
+// Positive or negative answer for name from the cache alone
+static std::optional<Resolution> LookupCache(const std::string& name, dnslib::TYPE type, TLRUCache& dnsCache, bool stale = false) {
+    Resolution result;
+    std::string last = name;
+    Security security = Security::SECURE;
+
+    auto cached = FollowCachedChain(last, type, result.chain, security, dnsCache, stale, stale ? nullptr : &result.expires);
+    if (cached.has_value()) {
+        result.records = std::move(cached.value());
+        result.security = security;
+        result.failed = security == Security::BOGUS;
+        return result;
+    }
+    if (stale) {
+        return std::nullopt;
+    }
+
+    auto negative = LookupNegative(last, type, dnsCache);
+    if (negative.has_value()) {
+        negative->chain = std::move(result.chain);
+        negative->expires = std::min(negative->expires, result.expires);
+        negative->security = Weakest(security, negative->security);
+        negative->failed = negative->security == Security::BOGUS;
+        return negative;
+    }
+    return std::nullopt;
+}
+
+// NXDOMAIN or NODATA for name proven by cached NSEC/NSEC3 records, in place of an upstream query
+static std::optional<Resolution> LookupDenial(const std::string& name, dnslib::TYPE type, NsecCache& nsecCache) {
+    auto denial = nsecCache.lookup(name, type);
+    if (!denial.has_value()) {
+        return std::nullopt;
+    }
+    DNS_METRIC_INC("dnssec.upstream_queries_avoided");
+
+    Resolution synthesized;
+    synthesized.rcode = denial->rcode;
+    synthesized.authority = {denial->soa};
+    synthesized.security = Security::SECURE;
+    return synthesized;
+}
+
+// Offsets of the TTL of every resource record in a serialized message
+static std::vector<uint16_t> TtlOffsets(const std::vector<uint8_t>& wire) {
+    std::vector<uint16_t> offsets;
+    dnslib::utils::ByteReader reader(wire);
+    reader.setPosition(4);
+    uint16_t qdcount = reader.readU16();
+    size_t rrcount = reader.readU16();
+    rrcount += reader.readU16();
+    rrcount += reader.readU16();
+
+    for (uint16_t i = 0; i < qdcount; i++) {
+        reader.readDomain();
+        reader.setPosition(reader.position() + 4);
+    }
+
+    for (size_t i = 0; i < rrcount; i++) {
+        reader.readDomain();
+        size_t ttlPos = reader.position() + 4;
+        reader.setPosition(ttlPos + 4);
+        uint16_t rdlength = reader.readU16();
+        reader.chceckBounds(rdlength);
+        offsets.push_back(static_cast<uint16_t>(ttlPos));
+        reader.setPosition(reader.position() + rdlength);
+    }
+    return offsets;
+}
+
+static void PatchTtls(std::vector<uint8_t>& wire, const std::vector<uint16_t>& offsets, uint32_t ttl) {
+    for (uint16_t ttlPos : offsets) {
+        wire[ttlPos] = ttl >> 24;
+        wire[ttlPos + 1] = (ttl >> 16) & 0xFF;
+        wire[ttlPos + 2] = (ttl >> 8) & 0xFF;
+        wire[ttlPos + 3] = ttl & 0xFF;
+    }
+}
+
+// Overwrites the TTL of every resource record in a serialized message
+static void PatchTtls(std::vector<uint8_t>& wire, uint32_t ttl) {
+    PatchTtls(wire, TtlOffsets(wire), ttl);
+}
+
+// Whole seconds left until expires, what cached records are served with
+static uint32_t RemainingTtl(std::chrono::steady_clock::time_point expires, std::chrono::steady_clock::time_point now) {
+    if (expires <= now) return 0;
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(expires - now).count());
+}
+
+// Serializes the answer to the client's question: CNAME links, final records, negative proof
+static std::vector<uint8_t> BuildResponse(
+    uint16_t id,
+    bool recursionDesired,
+    const std::string& name,
+    dnslib::TYPE type,
+    const Resolution& resolution
 ) {
-    //preassemble of google dns adress
-    sockaddr_in rootAddr{};
+    dnslib::PacketFlag flags = dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::RECURSION_AVAIL;
+    if (recursionDesired) {
+        flags = flags | dnslib::PacketFlag::RECURSION_DES;
+    }
+    if (!resolution.failed && resolution.security == Security::SECURE) {
+        flags = flags | dnslib::PacketFlag::AUTHENTIC_DATA;
+    }
+
+    dnslib::PacketBuilder builder;
+    builder.setId(id);
+    builder.withFlags(flags);
+    builder.withRcode(resolution.failed ? dnslib::RCODE::SERVERFAILURE : resolution.rcode);
+    builder.addQuestion(name, type);
+
+    if (!resolution.failed) {
+        for (const auto& rec : resolution.chain) {
+            builder.addAnswer(rec);
+        }
+        for (const auto& rec : resolution.records) {
+            builder.addAnswer(rec);
+        }
+        for (const auto& rec : resolution.authority) {
+            builder.addAuthority(rec);
+        }
+    }
+
+    std::vector<uint8_t> wire;
+    builder.build().serialize(wire);
+    if (resolution.expires != std::chrono::steady_clock::time_point::max()) {
+        PatchTtls(wire, RemainingTtl(resolution.expires, std::chrono::steady_clock::now()));
+    }
+    return wire;
+}
+
+// Copy of a stored answer for another client: its ID and RD bit, the TTLs counted down to now
+static std::vector<uint8_t> ReplayResponse(const WireAnswer& answer, uint16_t id, bool recursionDesired, uint32_t ttl) {
+    std::vector<uint8_t> wire = answer.data;
+    wire[0] = id >> 8;
+    wire[1] = id & 0xFF;
+    wire[2] = recursionDesired ? (wire[2] | 0x01) : (wire[2] & ~0x01);
+    PatchTtls(wire, answer.ttlOffsets, ttl);
+    return wire;
+}
+
+static sockaddr_in MakeServerAddr(uint32_t address) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(53);
+    addr.sin_addr.s_addr = htonl(address);
+    return addr;
+}
+
+Resolver::Resolver(utils::Executor& executor, TLRUCache& cache, utils::ETSQueue<dnslib::DNSMessageL>& outputQueue, const ServerConfig& config)
+    : executor(executor),
+      cache(cache),
+      outputQueue(outputQueue),
+      config(config),
+      prefetchBudget(config.prefetchLimit, config.prefetchLimit),
+      alive(std::make_shared<std::atomic<bool>>(true)) {
     rootAddr.sin_family = AF_INET;
     rootAddr.sin_port = htons(53);
     inet_pton(AF_INET, "199.7.83.42", &rootAddr.sin_addr);
-    
-    while (true) {
 
-        dnslib::DNSMessageL message = inputQueue.pop();
+    utils::Metrics::get().table("nameservers", [this] { return nsStats.toString(); });
+
+    tcpPool = std::make_unique<TcpPool>(
+        [this](dnslib::DNSMessageL message) { handleMessage(std::move(message)); },
+        config.tcpConnections, std::chrono::seconds(config.tcpIdleTimeout));
+
+    if (!config.forwarders.empty()) {
+        upstreams = std::make_unique<UpstreamPool>(config.forwarders, config.hedgePercentile);
+        utils::Metrics::get().table("upstreams", [this] { return upstreams->toString(); });
+
+        for (size_t i = 0; i < upstreams->size(); i++) {
+            utils::spawn(executor, probeUpstream(i));
+        }
+        DNS_LOG_INFO("Forwarding to " + std::to_string(upstreams->size()) + " upstream resolvers");
+    }
+
+    if (config.nsMaxOutstanding > 0 || config.nsQueryRate > 0) {
+        throttle = std::make_unique<ServerThrottle>(executor, config.nsMaxOutstanding, config.nsQueryRate);
+        utils::Metrics::get().table("throttle", [this] { return throttle->toString(); });
+    }
+
+    if (config.companionFetch) {
+        pairing = std::make_unique<PairingTracker>(config.companionRatio);
+        utils::Metrics::get().table("pairing", [this] { return pairing->toString(); });
+    }
+
+    if (config.rrlRate > 0) {
+        rrl = std::make_unique<ResponseRateLimiter>(config.rrlRate, config.rrlSlip);
+        utils::Metrics::get().table("rrl", [this] { return rrl->toString(); });
+    }
+
+    if (config.zoneGuardCap > 0) {
+        zoneGuard = std::make_unique<ZoneGuard>(config.zoneGuardCap, config.zoneGuardRatio);
+        utils::Metrics::get().table("zoneguard", [this] { return zoneGuard->toString(); });
+    }
+
+    if (config.dnssec) {
+        auto anchors = config.trustAnchors.empty() ? Validator::rootAnchors() : Validator::loadAnchors(config.trustAnchors);
+        DNS_LOG_INFO("DNSSEC validation on, " + std::to_string(anchors.size()) + " trust anchors");
+        validator = std::make_unique<Validator>(std::move(anchors));
+        utils::Metrics::get().table("dnssec", [this] { return validator->toString(); });
+
+        if (config.aggressiveNsec) {
+            nsecCache = std::make_unique<NsecCache>(config.nsecCacheSize, MAX_NEGATIVE_TTL);
+            utils::Metrics::get().table("nseccache", [this] { return nsecCache->toString(); });
+        }
+    }
+
+    if (!config.rootZone.empty()) {
+        loadRootZone();
+        utils::Metrics::get().table("rootzone", [this] {
+            auto zone = rootZone.load();
+            if (!zone) return std::string("not loaded\n");
+            return "serial=" + std::to_string(zone->serial()) + " tlds=" + std::to_string(zone->tldCount())
+                + (zone->expired() ? " expired\n" : "\n");
+        });
+    }
+
+    if (!config.zoneImage.empty()) {
+        loadLocalZones();
+    }
+
+    if (!config.blocklists.empty()) {
+        // Big lists take seconds to build, queries are resolved meanwhile
+        utils::spawn(executor, loadBlocklists());
+        utils::Metrics::get().table("blocklist", [this] {
+            auto list = blocklist.load();
+            if (!list) return std::string("not loaded\n");
+            return "exact=" + std::to_string(list->exactCount()) + " subtree=" + std::to_string(list->subtreeCount())
+                + " bytes=" + std::to_string(list->memoryUsage()) + "\n";
+        });
+    }
+}
+
+Resolver::~Resolver() {
+    alive->store(false);
+    // Its thread delivers answers through this resolver
+    tcpPool.reset();
+    utils::Metrics::get().removeTable("nameservers");
+    utils::Metrics::get().removeTable("upstreams");
+    utils::Metrics::get().removeTable("throttle");
+    utils::Metrics::get().removeTable("pairing");
+    utils::Metrics::get().removeTable("rootzone");
+    utils::Metrics::get().removeTable("blocklist");
+    utils::Metrics::get().removeTable("rrl");
+    utils::Metrics::get().removeTable("zoneguard");
+    utils::Metrics::get().removeTable("dnssec");
+    utils::Metrics::get().removeTable("nseccache");
+}
+
+bool Resolver::limitResponse(const sockaddr_in& address, std::vector<uint8_t>& data) {
+    if (!rrl) return true;
+
+    switch (rrl->check(address, data)) {
+    case ResponseRateLimiter::Action::SEND:
+        return true;
+    case ResponseRateLimiter::Action::SLIP:
+        DNS_METRIC_INC("rrl.slipped");
+        data = ResponseRateLimiter::truncate(data);
+        return true;
+    case ResponseRateLimiter::Action::DROP:
+        DNS_METRIC_INC("rrl.dropped");
+        return false;
+    }
+    return true;
+}
+
+void Resolver::send(const sockaddr_in& address, std::vector<uint8_t> data) {
+    if (!limitResponse(address, data)) return;
+
+    dnslib::DNSMessageL message{};
+    message.peerAddress = address;
+    message.protocol = dnslib::PROTO::UDP;
+    message.data = std::move(data);
+    outputQueue.push(std::move(message));
+}
+
+void Resolver::handleMessage(dnslib::DNSMessageL message) {
+    dnslib::DNSPacket packet = dnslib::PacketParser::parse(message.data);
+
+    if (!packet.getHeader().isQuery()) {
+        deliverResponse(message, std::move(packet));
+        return;
+    }
+
+    std::vector<std::shared_ptr<ClientSlot>> clients;
+    if (auto client = acceptQuery(message, packet)) {
+        clients.push_back(std::move(client));
+        serveClients(clients);
+    }
+}
+
+void Resolver::handleBatch(std::vector<dnslib::DNSMessageL>& messages) {
+    std::vector<std::shared_ptr<ClientSlot>> clients;
+    clients.reserve(messages.size());
+
+    // Stage 1: headers and questions. Upstream answers resume their resolutions right away.
+    for (auto& message : messages) {
+        try {
+            dnslib::DNSPacket packet = dnslib::PacketParser::parse(message.data);
+            if (!packet.getHeader().isQuery()) {
+                deliverResponse(message, std::move(packet));
+            } else if (auto client = acceptQuery(message, packet)) {
+                clients.push_back(std::move(client));
+            }
+        } catch (const std::exception& e) {
+            DNS_LOG_ERR("Error " + std::string(e.what()));
+        }
+    }
+    messages.clear();
+
+    if (!clients.empty()) {
+        serveClients(clients);
+    }
+}
+
+void Resolver::deliverResponse(const dnslib::DNSMessageL& message, dnslib::DNSPacket packet) {
+    uint16_t dnsId = packet.getHeader().getId();
+    DNS_LOG_DEBUG("Received Response ID: " + std::to_string(dnsId));
+    if (!transactions.deliver(message, std::move(packet), executor)) {
+        DNS_LOG_WARN("Ignored response ID: " + std::to_string(dnsId) + " from unexpected source or to another question");
+        DNS_METRIC_INC("upstream.ignored_responses");
+    }
+}
+
+std::shared_ptr<Resolver::ClientSlot> Resolver::acceptQuery(const dnslib::DNSMessageL& message, const dnslib::DNSPacket& packet) {
+    auto questions = packet.getQuestions();
+    if (questions.empty()) return nullptr;
+
+    QueryContext context;
+    if (config.queryBudget > 0) {
+        auto now = std::chrono::steady_clock::now();
+        auto received = message.received == std::chrono::steady_clock::time_point{} ? now : message.received;
+        context.deadline = received + std::chrono::milliseconds(config.queryBudget);
+        if (now >= context.deadline) {
+            // Queued for longer than the client waits, nobody would read the answer
+            DNS_METRIC_INC("deadline.expired_on_arrival");
+            return nullptr;
+        }
+    }
+
+    auto client = std::make_shared<ClientSlot>();
+    client->address = message.peerAddress;
+    client->id = packet.getHeader().getId();
+    client->recursionDesired = packet.getHeader().recursionDesired();
+    client->name = questions[0].getName();
+    client->type = questions[0].getType();
+    client->context = context;
+    DNS_LOG_DEBUG("Received Request ID: " + std::to_string(client->id) + " for " + client->name);
+    return client;
+}
+
+void Resolver::serveClients(std::vector<std::shared_ptr<ClientSlot>>& clients) {
+    // Stage 2: hash the cache keys, their buckets load while the next stage starts
+    std::vector<cacheKey> keys;
+    keys.reserve(clients.size());
+    for (const auto& client : clients) {
+        keys.push_back({client->name, client->type});
+    }
+    cache.prefetch(keys);
+
+    // Stage 3: look every client up, the snapshots are loaded once for all of them
+    auto list = blocklist.load();
+    auto zones = localZones.load();
+    std::vector<std::optional<Resolution>> found(clients.size());
+    std::vector<std::vector<uint8_t>> responses(clients.size());
+    bool hits = false;
+    auto now = std::chrono::steady_clock::now();
 
+    for (size_t i = 0; i < clients.size(); i++) {
+        const auto& client = clients[i];
+        // One client failing costs no other client of the batch its answer
         try {
+            if (pairing) {
+                // Hits count too, they are often the second half of a pair
+                client->pairing = pairing->observe(ntohl(client->address.sin_addr.s_addr), client->name, client->type);
+            }
+
+            if (list && list->blocked(client->name)) {
+                DNS_LOG_INFO("Blocked: " + client->name);
+                DNS_METRIC_INC("policy.blocked");
+
+                Resolution blocked;
+                if (!config.sinkhole.has_value()) {
+                    blocked.rcode = dnslib::RCODE::NAMEERROR;
+                } else if (client->type == dnslib::TYPE::A) {
+                    blocked.records.push_back(std::make_shared<dnslib::ARecord>(client->name, BLOCKED_TTL, config.sinkhole.value()));
+                }
+                found[i] = std::move(blocked);
+                continue;
+            }
+
+            if (zones && zones->answer(client->name, client->type, client->id, client->recursionDesired, responses[i])) {
+                DNS_METRIC_INC("localzones.answers");
+                continue;
+            }
+
+            // Answered before under this key: the stored message with the client's ID and the current TTLs
+            auto expires = std::chrono::steady_clock::time_point::max();
+            if (auto wire = cache.getWire({client->name, client->type}, expires)) {
+                DNS_LOG_INFO("Cache HIT for: " + client->name);
+                DNS_METRIC_INC("cache.wire_hits");
+                responses[i] = ReplayResponse(*wire, client->id, client->recursionDesired, RemainingTtl(expires, now));
+                hits = true;
+                continue;
+            }
 
-            dnslib::PacketParser parser;
-            dnslib::DNSPacket packet = parser.parse(message.data);
+            found[i] = LookupCache(client->name, client->type, cache);
+            if (!found[i].has_value() && nsecCache) {
+                found[i] = LookupDenial(client->name, client->type, *nsecCache);
+            }
+            if (found[i].has_value()) {
+                DNS_LOG_INFO(std::string(found[i]->authority.empty() ? "Cache HIT for: " : "Negative cache HIT for: ") + client->name);
+                hits = true;
+            }
+        } catch (const std::exception& e) {
+            DNS_LOG_ERR("Error " + std::string(e.what()));
+            clients[i] = nullptr;
+            found[i].reset();
+        }
+    }
+
+    // Stage 4: serialize the answers and queue them together, resolve the rest
+    std::vector<dnslib::DNSMessageL> out;
+    out.reserve(clients.size());
+    for (size_t i = 0; i < clients.size(); i++) {
+        auto& client = clients[i];
+        if (!client) continue;
+        try {
+            if (found[i].has_value()) {
+                const auto& resolution = found[i].value();
+                responses[i] = BuildResponse(client->id, client->recursionDesired, client->name, client->type, resolution);
 
-            bool isRequest = (message.data[2] & 0x80) == 0;
-            
-            if(isRequest) {
-                HandleRequest(message, packet, outputQueue, dnsCache, rootAddr);
+                // Read from the entry of the client's own key, the next hits on it skip the builder
+                if (resolution.expires != std::chrono::steady_clock::time_point::max() && resolution.chain.empty()
+                    && resolution.rcode == dnslib::RCODE::NOERROR) {
+                    cache.attachWire({client->name, client->type}, resolution.expires,
+                                     std::make_shared<WireAnswer>(WireAnswer{responses[i], TtlOffsets(responses[i])}));
+                }
             }
-            else{
-                HandleResponse(message, packet, outputQueue, dnsCache);
+
+            if (responses[i].empty()) {
+                DNS_LOG_INFO("Cache MISS: " + client->name + " -> Requesting recursive...");
+                if (client->pairing) {
+                    // Registered before the next query of the batch, the sibling may be right behind
+                    client->companion = startCompanion(client->name, SiblingType(client->type));
+                }
+                utils::spawn(executor, serveClient(std::move(client)));
+                continue;
             }
+            if (!limitResponse(client->address, responses[i])) continue;
 
+            dnslib::DNSMessageL message{};
+            message.peerAddress = client->address;
+            message.protocol = dnslib::PROTO::UDP;
+            message.data = std::move(responses[i]);
+            out.push_back(std::move(message));
         } catch (const std::exception& e) {
             DNS_LOG_ERR("Error " + std::string(e.what()));
         }
     }
+    outputQueue.pushAll(out);
+
+    if (hits) {
+        startPrefetches();
+    }
+}
+
+utils::Task<void> Resolver::serveClient(std::shared_ptr<ClientSlot> client) {
+    auto stale = LookupCache(client->name, client->type, cache, true);
+    if (stale.has_value()) {
+        client->staleResponse = BuildResponse(client->id, client->recursionDesired, client->name, client->type, stale.value());
+        PatchTtls(client->staleResponse, STALE_TTL);
+        utils::spawn(executor, answerStale(client, client->staleResponse));
+    }
+
+    // The sibling fetch started for this client's previous query leaves the answer in the cache
+    if (auto pending = findCompanion({client->name, client->type})) {
+        DNS_METRIC_INC("companion.joined");
+        co_await CompanionWait{pending.get(), &executor, client->context.deadline};
+    }
+
+    QueryContext context = client->context;
+    context.companion = client->companion;
+
+    Resolution result = co_await resolve(client->name, client->type, context);
+
+    if (context.companion && !context.companion->launched.exchange(true)) {
+        if (upstreams && !result.failed) {
+            // Forwarded: no delegation to reuse, the upstream walks for us
+            utils::spawn(executor, fetchCompanion(context.companion, nullptr, context.deadline));
+        } else {
+            finishCompanion(context.companion);
+        }
+    }
+
+    if (result.failed && !client->staleResponse.empty()) {
+        if (!client->answered.exchange(true)) {
+            DNS_LOG_WARN("Resolution failed for " + client->name + ", falling back to stale data");
+            DNS_METRIC_INC("stale.answers");
+            send(client->address, client->staleResponse);
+        }
+        co_return;
+    }
+
+    if (client->answered.exchange(true)) {
+        // The client got stale data already, the resolution only had to refresh the cache
+        DNS_METRIC_INC("stale.refreshed");
+        co_return;
+    }
+
+    if (result.failed) {
+        DNS_LOG_WARN("Resolution failed for " + client->name);
+        DNS_METRIC_INC("resolver.servfail");
+    }
+
+    DNS_LOG_DEBUG("Sending final response to client for ID: " + std::to_string(client->id));
+    send(client->address, BuildResponse(client->id, client->recursionDesired, client->name, client->type, result));
+}
+
+utils::Task<void> Resolver::answerStale(std::shared_ptr<ClientSlot> client, std::vector<uint8_t> response) {
+    auto running = alive;
+    co_await executor.sleepFor(std::chrono::milliseconds(config.staleAnswerTimeout));
+    if (!running->load()) co_return;
+
+    // Resolution takes too long, let the client have the stale data meanwhile
+    if (!client->answered.exchange(true)) {
+        DNS_LOG_INFO("Serving stale answer for " + client->name);
+        DNS_METRIC_INC("stale.answers");
+        send(client->address, std::move(response));
+    }
+}
+
+utils::Task<Resolution> Resolver::resolve(std::string name, dnslib::TYPE type, QueryContext context) {
+    Resolution result;
+    std::string current = name;
+    // Weakest status of everything the answer is made of
+    Security security = Security::SECURE;
+    // A prefetch is for the entry still cached, it must not be its own answer
+    bool refresh = context.prefetch && context.depth == 0;
+
+    while (true) {
+        std::optional<RecordList> cached;
+        if (!refresh) {
+            cached = FollowCachedChain(current, type, result.chain, security, cache);
+        }
+        if (cached.has_value()) {
+            result.records = std::move(cached.value());
+            result.security = security;
+            result.failed = security == Security::BOGUS;
+            co_return result;
+        }
+
+        std::optional<Resolution> negative;
+        if (!refresh) {
+            negative = LookupNegative(current, type, cache);
+        }
+        refresh = false;
+        if (negative.has_value()) {
+            result.rcode = negative->rcode;
+            result.authority = std::move(negative->authority);
+            result.security = Weakest(security, negative->security);
+            result.failed = result.security == Security::BOGUS;
+            co_return result;
+        }
+
+        // Names denied by cached NSEC/NSEC3 records cost no upstream query, however many random ones come
+        if (nsecCache) {
+            if (auto denied = LookupDenial(current, type, *nsecCache)) {
+                result.rcode = denied->rcode;
+                result.authority = std::move(denied->authority);
+                result.security = security;
+                result.failed = security == Security::BOGUS;
+                co_return result;
+            }
+        }
+
+        // A zone flooded with random names only gets a few resolutions at once
+        ZoneGuard::Decision guard;
+        if (zoneGuard) {
+            guard = zoneGuard->admit(current);
+        }
+        if (guard.action == ZoneGuard::Action::REFUSE) {
+            // Only denied with proof, anything else fails so that it may be served stale
+            if (auto denied = LookupDeniedAncestor(current, cache)) {
+                DNS_METRIC_INC("zoneguard.synthesized");
+                result.rcode = denied->rcode;
+                result.authority = std::move(denied->authority);
+                result.security = Weakest(security, denied->security);
+                result.failed = result.security == Security::BOGUS;
+                co_return result;
+            }
+            DNS_METRIC_INC("zoneguard.refused");
+            result.failed = true;
+            co_return result;
+        }
+
+        auto reply = co_await lookup(current, type, context);
+        // Records the servers are not authoritative for are neither used, cached nor learnt from
+        RecordList authority;
+        if (reply.has_value()) {
+            authority = Admit(reply->packet.getAuthority(), reply->zone);
+        }
+        if (zoneGuard) {
+            if (reply.has_value()) {
+                zoneGuard->finish(guard, reply->packet.getHeader().rcode(), authority);
+            } else {
+                zoneGuard->finish(guard, std::nullopt, {});
+            }
+        }
+        if (!reply.has_value()) {
+            if (std::chrono::steady_clock::now() >= context.deadline) {
+                DNS_LOG_DEBUG("Out of time for " + name);
+                DNS_METRIC_INC("deadline.resolutions_cut");
+            }
+            result.failed = true;
+            co_return result;
+        }
 
-}
\ No newline at end of file
+        const auto& packet = reply->packet;
+        auto rcode = packet.getHeader().rcode();
+        if (rcode == dnslib::RCODE::SERVERFAILURE || rcode == dnslib::RCODE::REFUSED) {
+            result.failed = true;
+            co_return result;
+        }
+
+        auto answers = Admit(packet.getAnswers(), reply->zone);
+        auto rrsets = Validator::group(answers);
+        std::vector<Security> statuses(rrsets.size(), Security::UNCHECKED);
+        if (validator) {
+            // Wildcard expansions are proven with the NSEC records of the authority section
+            statuses = co_await validateRRsets(rrsets, authority, context);
+        }
+        CacheAnswers(rrsets, statuses, packet.getHeader().authAns() ? Trust::AUTHORITATIVE : Trust::ANSWER, cache);
+
+        // Follow the CNAME chain inside the answer section
+        std::string target = current;
+        size_t linksBefore = result.chain.size();
+        while (true) {
+            for (const auto& rec : answers) {
+                if (rec->getName() == target && rec->getType() == static_cast<uint16_t>(type)) {
+                    result.records.push_back(rec);
+                }
+            }
+            if (!result.records.empty() || type == dnslib::TYPE::CNAME) break;
+
+            std::shared_ptr<dnslib::CNAMERecord> link;
+            for (const auto& rec : answers) {
+                if (rec->getName() == target && rec->getType() == static_cast<uint16_t>(dnslib::TYPE::CNAME)) {
+                    link = std::dynamic_pointer_cast<dnslib::CNAMERecord>(rec);
+                    break;
+                }
+            }
+            if (!link) break;
+
+            result.chain.push_back(link);
+            target = link->getCname();
+
+            if (result.chain.size() > MAX_CNAME_CHAIN || ChainContains(result.chain, target)) {
+                DNS_LOG_WARN("CNAME loop or chain too long for " + name);
+                result.failed = true;
+                co_return result;
+            }
+        }
+
+        for (size_t i = linksBefore; i < result.chain.size(); i++) {
+            security = Weakest(security, StatusOf(rrsets, statuses, result.chain[i]->getName(), dnslib::TYPE::CNAME));
+        }
+        if (!result.records.empty()) {
+            security = Weakest(security, StatusOf(rrsets, statuses, target, type));
+        }
+        if (validator && security == Security::BOGUS) {
+            DNS_LOG_WARN("DNSSEC validation failed for " + name);
+            CountSecurity(security);
+            result.failed = true;
+            co_return result;
+        }
+
+        if (!result.records.empty()) {
+            result.security = security;
+            if (validator) CountSecurity(security);
+            co_return result;
+        }
+
+        if (target != current && rcode == dnslib::RCODE::NOERROR) {
+            // The chain leaves the zone that answered, chase its target ourselves
+            if (result.chain.size() >= MAX_CNAME_CHAIN) {
+                DNS_LOG_WARN("CNAME loop or chain too long for " + name);
+                result.failed = true;
+                co_return result;
+            }
+
+            DNS_LOG_INFO("CNAME: " + name + " -> chasing " + target);
+            current = target;
+            continue;
+        }
+
+        Security denial = Security::UNCHECKED;
+        if (validator) {
+            denial = co_await validateDenial(target, type, rcode, authority, context);
+            CountSecurity(Weakest(security, denial));
+        }
+        security = Weakest(security, denial);
+        if (nsecCache && denial == Security::SECURE) {
+            nsecCache->store(authority);
+        }
+        CacheNegative(target, type, rcode, authority, denial, cache);
+        if (security == Security::BOGUS) {
+            DNS_LOG_WARN("DNSSEC validation failed for " + name);
+            result.failed = true;
+            co_return result;
+        }
+
+        result.rcode = rcode;
+        result.authority = std::move(authority);
+        result.security = security;
+        co_return result;
+    }
+}
+
+utils::Task<std::optional<UpstreamReply>> Resolver::lookup(std::string name, dnslib::TYPE type, QueryContext context) {
+    if (upstreams) {
+        co_return co_await askUpstreams(name, type, context);
+    }
+    co_return co_await iterate(name, type, context);
+}
+
+utils::Task<std::optional<UpstreamReply>> Resolver::iterate(std::string name, dnslib::TYPE type, QueryContext context) {
+    std::vector<uint32_t> candidates = {ntohl(rootAddr.sin_addr.s_addr)};
+    // Bailiwick of the candidates, they are only believed about names in it
+    std::string zone;
+    bool fromRoot = true;
+    if (context.delegation && context.delegation->name == name) {
+        candidates = context.delegation->servers;
+        zone = context.delegation->zone;
+        fromRoot = false;
+    }
+    std::string lowered = Lower(name);
+
+    for (int step = 0; step < MAX_REFERRALS; step++) {
+        std::optional<UpstreamReply> reply;
+        // The local copy has no signatures for the validator
+        bool signedData = validator && (type == dnslib::TYPE::DS || type == dnslib::TYPE::DNSKEY);
+        if (step == 0 && fromRoot && !signedData) {
+            reply = askRootZone(name, type);
+        }
+        if (!reply.has_value()) {
+            reply = co_await askServers(candidates, name, type, context);
+        }
+        if (!reply.has_value()) {
+            co_return std::nullopt;
+        }
+        reply->zone = zone;
+
+        auto answers = reply->packet.getAnswers();
+        auto authority = reply->packet.getAuthority();
+        auto additional = reply->packet.getAdditional();
+        if (!answers.empty() || authority.empty()) {
+            launchCompanion(context, name, type, zone, candidates);
+            co_return reply;
+        }
+
+        // Referral handling, only to a zone below this one on the way to name
+        bool referral = false;
+        std::string cut;
+        std::vector<std::string> ns_names;
+        std::vector<uint32_t> next;
+
+        for (const auto& auth_rec : authority) {
+            if (auth_rec->getType() != static_cast<uint16_t>(dnslib::TYPE::NS)) continue;
+
+            auto ns_rec = std::dynamic_pointer_cast<dnslib::NSRecord>(auth_rec);
+            if (!ns_rec) continue;
+            referral = true;
+
+            std::string owner = Lower(ns_rec->getName());
+            if (cut.empty() && owner != zone && InZone(owner, zone) && InZone(lowered, owner)) {
+                cut = owner;
+            }
+            if (owner != cut) {
+                DNS_METRIC_INC("cache.out_of_bailiwick");
+                continue;
+            }
+
+            std::string ns_name = ns_rec->getNs();
+            ns_names.push_back(ns_name);
+            // Addresses of servers outside the zone are the business of another one
+            if (!InZone(Lower(ns_name), zone)) continue;
+
+            RecordList glue;
+            for (const auto& add_rec : additional) {
+                if (add_rec->getType() != static_cast<uint16_t>(dnslib::TYPE::A)) continue;
+                if (add_rec->getName() != ns_name) continue;
+
+                auto a_rec = std::dynamic_pointer_cast<dnslib::ARecord>(add_rec);
+                if (!a_rec) continue;
+
+                next.push_back(a_rec->getIpAddress());
+                glue.push_back(a_rec);
+            }
+            CacheGlue(ns_name, glue, cache);
+        }
+
+        if (referral && ns_names.empty()) {
+            DNS_LOG_WARN("Referral for " + name + " outside the bailiwick of " + (zone.empty() ? "." : zone));
+            co_return std::nullopt;
+        }
+
+        if (!referral) {
+            // Negative answer, the authority section holds its SOA
+            launchCompanion(context, name, type, zone, candidates);
+            co_return reply;
+        }
+
+        if (next.empty()) {
+            // Addresses resolved earlier for these NS names may still be cached
+            for (const auto& ns_name : ns_names) {
+                auto cached = cache.get({ns_name, dnslib::TYPE::A}, nullptr, Trust::GLUE);
+                if (!cached.has_value()) continue;
+
+                for (const auto& rec : *cached.value()) {
+                    auto a_rec = std::dynamic_pointer_cast<dnslib::ARecord>(rec);
+                    if (a_rec) {
+                        next.push_back(a_rec->getIpAddress());
+                    }
+                }
+            }
+        }
+
+        if (next.empty()) {
+            if (context.depth >= MAX_SUBQUERY_DEPTH) {
+                DNS_LOG_WARN("Glue-less referral chain too deep for " + name);
+                co_return std::nullopt;
+            }
+
+            // Resolve several NS addresses concurrently, the first one to arrive wins
+            std::vector<utils::Task<std::optional<uint32_t>>> lookups;
+            QueryContext sub = context;
+            sub.depth++;
+            sub.delegation = nullptr;
+            sub.companion = nullptr;
+            for (size_t i = 0; i < std::min(ns_names.size(), MAX_NS_SUBQUERIES); i++) {
+                DNS_LOG_INFO("Glue-less referral: " + name + " -> resolving " + ns_names[i]);
+                lookups.push_back(resolveAddress(ns_names[i], sub));
+            }
+
+            auto address = co_await utils::firstValue(executor, std::move(lookups));
+            if (!address.has_value()) {
+                co_return std::nullopt;
+            }
+            next = {address.value()};
+        }
+
+        DNS_LOG_INFO("Referral: " + name + " -> " + cut + ", " + std::to_string(next.size()) + " servers");
+        candidates = std::move(next);
+        zone = std::move(cut);
+    }
+
+    DNS_LOG_WARN("Too many referrals for " + name);
+    co_return std::nullopt;
+}
+
+// What a root server would answer, from the local copy of the root zone
+std::optional<UpstreamReply> Resolver::askRootZone(const std::string& name, dnslib::TYPE type) {
+    auto zone = rootZone.load();
+    if (!zone) {
+        return std::nullopt;
+    }
+    if (zone->expired()) {
+        // RFC 8806: an outdated copy must not be used, the root servers are asked instead
+        DNS_METRIC_INC("rootzone.expired");
+        return std::nullopt;
+    }
+
+    auto packet = zone->answer(name, type);
+    if (!packet.has_value()) {
+        return std::nullopt;
+    }
+
+    DNS_METRIC_INC("rootzone.answers");
+    return UpstreamReply{std::move(packet.value()), rootAddr, std::chrono::microseconds(0), ""};
+}
+
+void Resolver::loadRootZone() {
+    try {
+        auto zone = RootZone::load(config.rootZone);
+        if (zone->expired()) {
+            DNS_LOG_WARN("Root zone " + config.rootZone + " is past its SOA expire time, the root servers are used");
+        }
+        rootZone.store(zone);
+        DNS_LOG_INFO("Root zone serial " + std::to_string(zone->serial()) + " loaded, " + std::to_string(zone->tldCount()) + " TLDs");
+        DNS_METRIC_INC("rootzone.loads");
+    } catch (const std::exception& e) {
+        DNS_LOG_ERR(std::string(e.what()) + ", keeping the previous root zone copy");
+        DNS_METRIC_INC("rootzone.load_failures");
+    }
+}
+
+void Resolver::loadLocalZones() {
+    try {
+        auto zones = ZoneImage::open(config.zoneImage);
+        localZones.store(zones);
+        DNS_LOG_INFO("Zone image " + config.zoneImage + " loaded, " + std::to_string(zones->zoneCount()) + " zones, "
+            + std::to_string(zones->nameCount()) + " names");
+        DNS_METRIC_INC("localzones.loads");
+    } catch (const std::exception& e) {
+        DNS_LOG_ERR(std::string(e.what()) + ", keeping the previous zone image");
+        DNS_METRIC_INC("localzones.load_failures");
+    }
+}
+
+utils::Task<void> Resolver::loadBlocklists() {
+    try {
+        size_t skipped = 0;
+        auto list = Blocklist::load(config.blocklists, skipped);
+        blocklist.store(list);
+
+        std::string perMillion;
+        if (list->size() > 0) {
+            perMillion = ", " + std::to_string(list->memoryUsage() * 1000000 / list->size() / (1024 * 1024)) + " MiB per million";
+        }
+        DNS_LOG_INFO("Blocklist loaded, " + std::to_string(list->size()) + " rules, " + std::to_string(skipped)
+            + " malformed lines skipped, " + std::to_string(list->memoryUsage()) + " bytes" + perMillion);
+        DNS_METRIC_INC("blocklist.loads");
+    } catch (const std::exception& e) {
+        DNS_LOG_ERR(std::string(e.what()) + ", keeping the previous blocklist");
+        DNS_METRIC_INC("blocklist.load_failures");
+    }
+    co_return;
+}
+
+utils::Task<void> Resolver::reload() {
+    if (!config.rootZone.empty()) {
+        loadRootZone();
+    }
+    if (!config.zoneImage.empty()) {
+        loadLocalZones();
+    }
+    if (!config.blocklists.empty()) {
+        co_await loadBlocklists();
+    }
+}
+
+void requestReload() {
+    reloadRequested.store(true);
+}
+
+utils::Task<std::optional<UpstreamReply>> Resolver::askServers(std::vector<uint32_t> candidates, std::string name, dnslib::TYPE type, QueryContext context) {
+    Transaction transaction(transactions, executor, outputQueue, validator != nullptr);
+    std::vector<uint32_t> tried;
+
+    while (true) {
+        std::vector<uint32_t> remaining;
+        for (auto address : candidates) {
+            if (std::find(tried.begin(), tried.end(), address) == tried.end()) {
+                remaining.push_back(address);
+            }
+        }
+        if (remaining.empty()) {
+            DNS_LOG_WARN("No nameserver left to ask for " + name);
+            co_return std::nullopt;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= context.deadline) {
+            DNS_METRIC_INC("deadline.queries_skipped");
+            co_return std::nullopt;
+        }
+
+        if (throttle) {
+            // Servers with queries waiting already come last
+            std::vector<uint32_t> free;
+            for (auto address : remaining) {
+                if (throttle->queued(address) == 0) free.push_back(address);
+            }
+            if (!free.empty()) {
+                remaining = std::move(free);
+            }
+        }
+
+        uint32_t server = nsStats.select(remaining);
+        if (throttle) {
+            auto queueDeadline = std::min(now + THROTTLE_WAIT, context.deadline);
+            bool granted = co_await throttle->acquire(server, queueDeadline);
+            if (!granted) {
+                DNS_LOG_DEBUG("Nameserver too busy for " + name + ", trying another one");
+                tried.push_back(server);
+                continue;
+            }
+            now = std::chrono::steady_clock::now();
+        }
+
+        sockaddr_in serverAddr = MakeServerAddr(server);
+        transaction.send(serverAddr, name, type, false);
+        if (context.prefetch) {
+            DNS_METRIC_INC("prefetch.upstream_queries");
+        } else {
+            DNS_METRIC_INC("upstream.queries");
+        }
+
+        auto timeout = now + nsStats.timeout(server);
+        auto reply = co_await transaction.wait(std::min(timeout, context.deadline));
+        if (throttle) {
+            throttle->release(server);
+        }
+        if (reply.has_value()) {
+            nsStats.recordRtt(server, reply->rtt);
+            if (reply->packet.getHeader().truncation()) {
+                co_return co_await retryOverTcp(transaction, std::move(reply.value()), name, type, false, context);
+            }
+            co_return reply;
+        }
+
+        if (context.deadline < timeout) {
+            // Cut short, the server may not be slow at all
+            co_return std::nullopt;
+        }
+
+        DNS_LOG_DEBUG("Timeout for ID: " + std::to_string(transaction.id()) + " (" + name + ")");
+        DNS_METRIC_INC("upstream.timeouts");
+
+        nsStats.recordTimeout(server);
+        transaction.abandon(serverAddr);
+        tried.push_back(server);
+    }
+}
+
+utils::Task<std::optional<UpstreamReply>> Resolver::askUpstreams(std::string name, dnslib::TYPE type, QueryContext context) {
+    Transaction transaction(transactions, executor, outputQueue, validator != nullptr);
+    std::vector<size_t> asked;      // every upstream the question went to
+    std::vector<size_t> open;       // the ones still expected to answer
+
+    auto forwardNext = [&]() {
+        auto upstream = upstreams->select(asked);
+        if (!upstream.has_value()) return false;
+
+        upstreams->acquire(upstream.value());
+        asked.push_back(upstream.value());
+        open.push_back(upstream.value());
+        transaction.send(upstreams->address(upstream.value()), name, type, true);
+        DNS_METRIC_INC("forward.queries");
+        return true;
+    };
+
+    auto close = [&](size_t upstream, bool failed) {
+        std::erase(open, upstream);
+        transaction.abandon(upstreams->address(upstream));
+        upstreams->release(upstream);
+        if (failed) {
+            upstreams->recordFailure(upstream);
+        }
+    };
+
+    while (true) {
+        if (open.empty() && !forwardNext()) {
+            DNS_LOG_WARN("No upstream left to ask for " + name);
+            co_return std::nullopt;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if (start >= context.deadline) {
+            DNS_METRIC_INC("deadline.queries_skipped");
+            co_return std::nullopt;
+        }
+        bool cut = context.deadline < start + FORWARD_TIMEOUT;
+        auto timeout = cut ? context.deadline : start + FORWARD_TIMEOUT;
+        auto hedge = upstreams->hedgeDelay(open.back());
+        bool hedged = !hedge.has_value();
+
+        while (!open.empty()) {
+            auto deadline = hedged ? timeout : std::min<std::chrono::steady_clock::time_point>(start + hedge.value(), timeout);
+            auto reply = co_await transaction.wait(deadline);
+
+            if (!reply.has_value()) {
+                if (!hedged && deadline < timeout) {
+                    // Slower than usual, whichever upstream answers first wins
+                    hedged = true;
+                    if (forwardNext()) {
+                        DNS_LOG_DEBUG("Hedging ID: " + std::to_string(transaction.id()) + " (" + name + ")");
+                        DNS_METRIC_INC("forward.hedged");
+                    }
+                    continue;
+                }
+
+                if (cut) {
+                    for (auto upstream : std::vector<size_t>(open)) {
+                        close(upstream, false);
+                    }
+                    co_return std::nullopt;
+                }
+
+                DNS_LOG_DEBUG("Timeout for ID: " + std::to_string(transaction.id()) + " (" + name + ")");
+                DNS_METRIC_INC("upstream.timeouts");
+                for (auto upstream : std::vector<size_t>(open)) {
+                    close(upstream, true);
+                }
+                break;
+            }
+
+            auto upstream = upstreams->find(reply->source).value();
+            auto rcode = reply->packet.getHeader().rcode();
+            if (rcode == dnslib::RCODE::SERVERFAILURE || rcode == dnslib::RCODE::REFUSED) {
+                // This upstream cannot help, wait for a hedge still running or ask another one
+                close(upstream, true);
+                continue;
+            }
+
+            upstreams->recordAnswer(upstream, reply->rtt);
+            if (open.front() != upstream) {
+                DNS_METRIC_INC("forward.hedge_wins");
+            }
+            for (auto other : std::vector<size_t>(open)) {
+                close(other, false);
+            }
+            if (reply->packet.getHeader().truncation()) {
+                co_return co_await retryOverTcp(transaction, std::move(reply.value()), name, type, true, context);
+            }
+            co_return reply;
+        }
+    }
+}
+
+// Asks the server that sent a truncated answer again over TCP, the truncated answer is kept if that fails
+utils::Task<UpstreamReply> Resolver::retryOverTcp(Transaction& transaction, UpstreamReply truncated, std::string name, dnslib::TYPE type, bool recursionDesired, QueryContext context) {
+    DNS_LOG_DEBUG("Truncated answer for " + name + ", asking again over TCP");
+    DNS_METRIC_INC("upstream.tcp_retries");
+    auto deadline = std::min(std::chrono::steady_clock::now() + TCP_TIMEOUT, context.deadline);
+    transaction.sendTcp(*tcpPool, truncated.source, name, type, recursionDesired, deadline);
+
+    auto reply = co_await transaction.wait(deadline);
+    if (reply.has_value()) {
+        co_return std::move(reply.value());
+    }
+
+    DNS_LOG_WARN("TCP retry failed for " + name + ", passing the truncated answer on");
+    DNS_METRIC_INC("upstream.tcp_failures");
+    transaction.abandon(truncated.source);
+    co_return truncated;
+}
+
+utils::Task<std::optional<uint32_t>> Resolver::resolveAddress(std::string name, QueryContext context) {
+    Resolution result = co_await resolve(name, dnslib::TYPE::A, context);
+    if (result.failed) {
+        co_return std::nullopt;
+    }
+
+    for (const auto& rec : result.records) {
+        auto a_rec = std::dynamic_pointer_cast<dnslib::ARecord>(rec);
+        if (a_rec) {
+            co_return a_rec->getIpAddress();
+        }
+    }
+    co_return std::nullopt;
+}
+
+// Name one label below zone on the way down to name
+static std::string ChildTowards(const std::string& name, const std::string& zone) {
+    std::string prefix = zone.empty() ? name : name.substr(0, name.size() - zone.size() - 1);
+    auto dot = prefix.rfind('.');
+    std::string label = dot == std::string::npos ? prefix : prefix.substr(dot + 1);
+    return zone.empty() ? label : label + "." + zone;
+}
+
+static bool IsDenial(const SignedRRset& rrset) {
+    auto type = rrset.records[0]->getType();
+    return type == static_cast<uint16_t>(dnslib::TYPE::NSEC) || type == static_cast<uint16_t>(dnslib::TYPE::NSEC3);
+}
+
+static uint32_t MinTtl(const RecordList& records, uint32_t ttl) {
+    for (const auto& rec : records) {
+        ttl = std::min(ttl, rec->getTtl());
+    }
+    return ttl;
+}
+
+utils::Task<std::vector<Security>> Resolver::validateRRsets(std::vector<SignedRRset> rrsets, RecordList authority, QueryContext context) {
+    std::vector<Security> statuses;
+    if (rrsets.size() == 1) {
+        statuses.push_back(co_await validateRRset(std::move(rrsets[0]), std::move(authority), context));
+        co_return statuses;
+    }
+
+    // RRsets are checked independently, idle workers take some of them
+    std::vector<utils::Task<Security>> checks;
+    for (auto& rrset : rrsets) {
+        checks.push_back(validateRRset(std::move(rrset), authority, context));
+    }
+    auto results = co_await utils::allValues(executor, std::move(checks));
+    for (auto& status : results) {
+        statuses.push_back(status.value_or(Security::BOGUS));
+    }
+    co_return statuses;
+}
+
+utils::Task<Security> Resolver::validateRRset(SignedRRset rrset, RecordList authority, QueryContext context) {
+    std::string owner = Lower(rrset.records[0]->getName());
+    // DS records are signed by the parent zone
+    bool ds = rrset.records[0]->getType() == static_cast<uint16_t>(dnslib::TYPE::DS);
+
+    if (rrset.signatures.empty()) {
+        std::string signer = ds ? ParentName(owner) : owner;
+        auto zone = co_await enclosingZone(signer, context);
+        co_return zone.has_value() && !zone->second.secure ? Security::INSECURE : Security::BOGUS;
+    }
+
+    for (const auto& rec : rrset.signatures) {
+        auto sig = std::dynamic_pointer_cast<dnslib::RRSIGRecord>(rec);
+        std::string signer = Lower(sig->getSignerName());
+        if (!InZone(owner, signer) || (ds && signer == owner)) continue;
+
+        auto keys = co_await zoneKeys(signer, context);
+        if (!keys.has_value()) continue;
+
+        Security status = Validator::check({rrset.records, {sig}}, keys.value());
+        if (status == Security::SECURE && sig->getLabels() < LabelCount(owner)) {
+            // Expanded from a wildcard, the name itself has to be proven not to exist
+            auto proofs = co_await provenDenials(authority, context);
+            if (!Validator::deniesExactName(owner, sig->getLabels(), proofs)) {
+                status = Security::BOGUS;
+            }
+        }
+        if (status != Security::BOGUS) {
+            co_return status;
+        }
+    }
+    co_return Security::BOGUS;
+}
+
+utils::Task<Security> Resolver::validateDenial(std::string name, dnslib::TYPE type, dnslib::RCODE rcode, RecordList authority, QueryContext context) {
+    name = Lower(name);
+    auto rrsets = Validator::group(authority);
+    std::erase_if(rrsets, [](const SignedRRset& rrset) {
+        return !IsDenial(rrset) && rrset.records[0]->getType() != static_cast<uint16_t>(dnslib::TYPE::SOA);
+    });
+    if (rrsets.empty()) {
+        // Nothing to check, acceptable outside signed zones only
+        auto zone = co_await enclosingZone(name, context);
+        co_return zone.has_value() && !zone->second.secure ? Security::INSECURE : Security::BOGUS;
+    }
+
+    auto statuses = co_await validateRRsets(rrsets, {}, context);
+    Security security = Security::SECURE;
+    RecordList proofs;
+    for (size_t i = 0; i < rrsets.size(); i++) {
+        security = Weakest(security, statuses[i]);
+        if (IsDenial(rrsets[i])) {
+            proofs.insert(proofs.end(), rrsets[i].records.begin(), rrsets[i].records.end());
+        }
+    }
+    if (security != Security::SECURE) {
+        co_return security;
+    }
+    if (Validator::exceedsIterations(proofs)) {
+        co_return Security::INSECURE;
+    }
+
+    bool proven = rcode == dnslib::RCODE::NAMEERROR
+        ? Validator::deniesName(name, proofs)
+        : Validator::deniesType(name, static_cast<uint16_t>(type), proofs);
+    co_return proven ? Security::SECURE : Security::BOGUS;
+}
+
+utils::Task<RecordList> Resolver::provenDenials(RecordList authority, QueryContext context) {
+    auto rrsets = Validator::group(authority);
+    std::erase_if(rrsets, [](const SignedRRset& rrset) { return !IsDenial(rrset); });
+    auto statuses = co_await validateRRsets(rrsets, {}, context);
+
+    RecordList proofs;
+    for (size_t i = 0; i < rrsets.size(); i++) {
+        if (statuses[i] == Security::SECURE) {
+            proofs.insert(proofs.end(), rrsets[i].records.begin(), rrsets[i].records.end());
+        }
+    }
+    co_return proofs;
+}
+
+utils::Task<std::optional<Validator::ZoneKeys>> Resolver::zoneKeys(std::string zone, QueryContext context) {
+    if (auto cached = validator->keys(zone)) {
+        DNS_METRIC_INC("dnssec.key_cache_hits");
+        co_return cached;
+    }
+
+    auto ds = validator->anchorsFor(zone);
+    if (ds.empty()) {
+        auto delegation = co_await delegationOf(zone, context);
+        if (!delegation.has_value() || delegation->kind == Validator::Delegation::NONE) {
+            co_return std::nullopt;
+        }
+        if (delegation->kind == Validator::Delegation::INSECURE) {
+            co_return Validator::ZoneKeys{};
+        }
+        ds = delegation->ds;
+    }
+
+    // A zone signed only with algorithms we do not implement counts as unsigned (RFC 4035, section 5.2)
+    std::erase_if(ds, [](const auto& rec) {
+        auto digest = std::dynamic_pointer_cast<dnslib::DSRecord>(rec);
+        return !digest || !Validator::supportedAlgorithm(digest->getAlgorithm()) || !Validator::supportedDigest(digest->getDigestType());
+    });
+    if (ds.empty()) {
+        validator->storeKeys(zone, {}, MAX_NEGATIVE_TTL);
+        co_return Validator::ZoneKeys{};
+    }
+
+    auto reply = co_await lookup(zone, dnslib::TYPE::DNSKEY, context);
+    if (!reply.has_value()) {
+        co_return std::nullopt;
+    }
+
+    SignedRRset keySet;
+    for (auto& rrset : Validator::group(reply->packet.getAnswers())) {
+        if (rrset.records[0]->getType() == static_cast<uint16_t>(dnslib::TYPE::DNSKEY) && Lower(rrset.records[0]->getName()) == zone) {
+            keySet = std::move(rrset);
+        }
+    }
+    auto trusted = Validator::validateKeySet(keySet.records, keySet.signatures, ds);
+    if (!trusted.has_value()) {
+        DNS_LOG_WARN("No DNSKEY of " + zone + " validates against its DS records");
+        co_return std::nullopt;
+    }
+
+    Validator::ZoneKeys keys{true, std::move(trusted.value())};
+    validator->storeKeys(zone, keys, MinTtl(keySet.records, MAX_NEGATIVE_TTL));
+    co_return keys;
+}
+
+utils::Task<std::optional<Validator::DelegationInfo>> Resolver::delegationOf(std::string name, QueryContext context) {
+    if (auto cached = validator->delegation(name)) {
+        co_return cached;
+    }
+
+    auto parent = co_await enclosingZone(ParentName(name), context);
+    if (!parent.has_value()) {
+        co_return std::nullopt;
+    }
+    if (!parent->second.secure) {
+        co_return Validator::DelegationInfo{Validator::Delegation::INSECURE, {}};
+    }
+
+    auto reply = co_await lookup(name, dnslib::TYPE::DS, context);
+    if (!reply.has_value()) {
+        co_return std::nullopt;
+    }
+    auto rcode = reply->packet.getHeader().rcode();
+    if (rcode != dnslib::RCODE::NOERROR && rcode != dnslib::RCODE::NAMEERROR) {
+        co_return std::nullopt;
+    }
+
+    // Everything here is signed by the parent zone, whose keys are at hand
+    Validator::DelegationInfo info;
+    uint32_t ttl = MAX_NEGATIVE_TTL;
+    for (const auto& rrset : Validator::group(reply->packet.getAnswers())) {
+        if (rrset.records[0]->getType() != static_cast<uint16_t>(dnslib::TYPE::DS) || Lower(rrset.records[0]->getName()) != name) continue;
+        if (Validator::check(rrset, parent->second) != Security::SECURE) {
+            DNS_LOG_WARN("Bogus DS records for " + name);
+            co_return std::nullopt;
+        }
+        info = {Validator::Delegation::SECURE, rrset.records};
+        ttl = MinTtl(rrset.records, ttl);
+    }
+
+    if (info.ds.empty()) {
+        // No DS: the denial tells an unsigned delegation from a name that is no zone cut
+        RecordList proofs;
+        for (const auto& rrset : Validator::group(reply->packet.getAuthority())) {
+            if (!IsDenial(rrset)) continue;
+            if (Validator::check(rrset, parent->second) != Security::SECURE) {
+                co_return std::nullopt;
+            }
+            proofs.insert(proofs.end(), rrset.records.begin(), rrset.records.end());
+            ttl = MinTtl(rrset.records, ttl);
+        }
+
+        auto kind = Validator::exceedsIterations(proofs) ? Validator::Delegation::INSECURE : Validator::delegationFromDenial(name, proofs);
+        if (!kind.has_value()) {
+            DNS_LOG_WARN("Missing DS records for " + name + " are not proven");
+            co_return std::nullopt;
+        }
+        info.kind = kind.value();
+    }
+
+    validator->storeDelegation(name, info, ttl);
+    co_return info;
+}
+
+utils::Task<std::optional<std::pair<std::string, Validator::ZoneKeys>>> Resolver::enclosingZone(std::string name, QueryContext context) {
+    // The closest trust anchor above name starts the chain, outside all of them nothing is signed
+    std::string zone = name;
+    while (validator->anchorsFor(zone).empty()) {
+        if (zone.empty()) {
+            co_return std::make_pair(std::string(), Validator::ZoneKeys{});
+        }
+        zone = ParentName(zone);
+    }
+
+    auto keys = co_await zoneKeys(zone, context);
+    if (!keys.has_value()) {
+        co_return std::nullopt;
+    }
+
+    // Down one label at a time, each may be a zone cut
+    std::string cursor = zone;
+    while (keys->secure && cursor != name) {
+        cursor = ChildTowards(name, cursor);
+        auto delegation = co_await delegationOf(cursor, context);
+        if (!delegation.has_value()) {
+            co_return std::nullopt;
+        }
+        if (delegation->kind == Validator::Delegation::NONE) continue;
+
+        zone = cursor;
+        keys = co_await zoneKeys(zone, context);
+        if (!keys.has_value()) {
+            co_return std::nullopt;
+        }
+    }
+    co_return std::make_pair(zone, keys.value());
+}
+
+// Starts background refreshes for popular entries close to expiry
+void Resolver::startPrefetches() {
+    for (auto& key : cache.takePrefetchCandidates()) {
+        {
+            std::lock_guard<std::mutex> lock(prefetchMtx);
+            if (prefetchInflight.count(key) != 0) continue;
+
+            if (!prefetchBudget.tryTake()) {
+                DNS_METRIC_INC("prefetch.rate_limited");
+                continue;
+            }
+            prefetchInflight.insert(key);
+        }
+
+        DNS_LOG_DEBUG("Prefetch: " + key.name + " " + std::to_string(key.type));
+        DNS_METRIC_INC("prefetch.started");
+        utils::spawn(executor, prefetch(std::move(key)));
+    }
+}
+
+std::shared_ptr<CompanionFetch> Resolver::startCompanion(const std::string& name, dnslib::TYPE type) {
+    if (LookupCache(name, type, cache).has_value()) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(companionMtx);
+    // The asking client will wait for a fetch of its own type, the query carrying that one fetches this
+    // type already. Two clients asking one type each would otherwise wait for each other.
+    if (companions.count(cacheKey{name, SiblingType(type)}) > 0) {
+        return nullptr;
+    }
+    auto [it, inserted] = companions.try_emplace(cacheKey{name, type});
+    if (!inserted) {
+        // The client asked both at once, the other query fetches it
+        return nullptr;
+    }
+    it->second = std::make_shared<CompanionFetch>();
+    it->second->name = name;
+    it->second->type = type;
+    return it->second;
+}
+
+std::shared_ptr<CompanionFetch> Resolver::findCompanion(const cacheKey& key) {
+    std::lock_guard<std::mutex> lock(companionMtx);
+    auto it = companions.find(key);
+    return it == companions.end() ? nullptr : it->second;
+}
+
+void Resolver::launchCompanion(const QueryContext& context, const std::string& name, dnslib::TYPE type, const std::string& zone, const std::vector<uint32_t>& servers) {
+    auto companion = context.companion;
+    if (!companion || type != SiblingType(companion->type) || companion->launched.exchange(true)) return;
+
+    // The walk to these servers is done already, the sibling is one query away
+    auto delegation = std::make_shared<const Delegation>(Delegation{name, zone, servers});
+    utils::spawn(executor, fetchCompanion(companion, delegation, context.deadline));
+}
+
+utils::Task<void> Resolver::fetchCompanion(std::shared_ptr<CompanionFetch> companion, std::shared_ptr<const Delegation> delegation, std::chrono::steady_clock::time_point deadline) {
+    DNS_LOG_DEBUG("Fetching " + std::to_string(companion->type) + " for " + companion->name + " ahead of the client");
+    DNS_METRIC_INC("companion.fetches");
+
+    QueryContext context;
+    context.deadline = deadline;
+    context.delegation = std::move(delegation);
+    try {
+        co_await resolve(companion->name, companion->type, context);
+    } catch (const std::exception& e) {
+        DNS_LOG_ERR("Error " + std::string(e.what()));
+    }
+    finishCompanion(companion);
+}
+
+void Resolver::finishCompanion(const std::shared_ptr<CompanionFetch>& companion) {
+    {
+        std::lock_guard<std::mutex> lock(companionMtx);
+        auto it = companions.find(cacheKey{companion->name, companion->type});
+        if (it != companions.end() && it->second == companion) {
+            companions.erase(it);
+        }
+    }
+
+    std::vector<std::coroutine_handle<>> waiters;
+    {
+        std::lock_guard<std::mutex> lock(companion->mtx);
+        companion->done = true;
+        waiters = std::move(companion->waiters);
+    }
+    for (auto waiter : waiters) {
+        executor.post(waiter);
+    }
+}
+
+utils::Task<void> Resolver::prefetch(cacheKey key) {
+    QueryContext context;
+    context.prefetch = true;
+    if (config.queryBudget > 0) {
+        context.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config.queryBudget);
+    }
+    Resolution result = co_await resolve(key.name, key.type, context);
+
+    {
+        std::lock_guard<std::mutex> lock(prefetchMtx);
+        prefetchInflight.erase(key);
+    }
+
+    if (result.failed) {
+        DNS_METRIC_INC("prefetch.failed");
+    } else {
+        DNS_METRIC_INC("prefetch.completed");
+    }
+}
+
+// Forwarding mode: asks the upstream a trivial question every health interval
+utils::Task<void> Resolver::probeUpstream(size_t upstream) {
+    auto running = alive;
+
+    while (true) {
+        co_await executor.sleepFor(std::chrono::seconds(config.healthInterval));
+        if (!running->load()) co_return;
+
+        Transaction transaction(transactions, executor, outputQueue);
+        upstreams->acquire(upstream);
+        transaction.send(upstreams->address(upstream), ".", dnslib::TYPE::NS, true);
+        DNS_METRIC_INC("forward.probes");
+
+        auto reply = co_await transaction.wait(std::chrono::steady_clock::now() + FORWARD_TIMEOUT);
+        if (!running->load()) co_return;
+
+        upstreams->release(upstream);
+        auto rcode = reply.has_value() ? reply->packet.getHeader().rcode() : dnslib::RCODE::SERVERFAILURE;
+        if (rcode == dnslib::RCODE::SERVERFAILURE || rcode == dnslib::RCODE::REFUSED) {
+            upstreams->recordFailure(upstream);
+        } else {
+            upstreams->recordAnswer(upstream, reply->rtt);
+        }
+    }
+}
+
+void resolverWorker(
+    utils::ETSQueue<dnslib::DNSMessageL>& inputQueue,
+    utils::ETSQueue<dnslib::DNSMessageL>& outputQueue,
+    TLRUCache& dnsCache,
+    const ServerConfig& config
+) {
+    utils::Executor executor(config.threads);
+    Resolver resolver(executor, dnsCache, outputQueue, config);
+    DNS_LOG_INFO("Resolver running on " + std::to_string(executor.size()) + " workers");
+
+    std::vector<dnslib::DNSMessageL> batch;
+    batch.reserve(config.batchSize);
+
+    while (true) {
+
+        if (utils::Metrics::get().takeDumpRequest()) {
+            DNS_LOG_INFO(utils::Metrics::get().dump());
+        }
+
+        // Parsing zones and lists takes a while, a worker does it while the others keep resolving
+        if (reloadRequested.exchange(false)) {
+            utils::spawn(executor, resolver.reload());
+        }
+
+        // Wake up regularly to serve metric dump requests
+        if (inputQueue.popBatch(batch, config.batchSize, std::chrono::milliseconds(50)) == 0) {
+            continue;
+        }
+
+        try {
+            resolver.handleBatch(batch);
+        } catch (const std::exception& e) {
+            DNS_LOG_ERR("Error " + std::string(e.what()));
+        }
+        batch.clear();
+    }
+
+}
@@ -0,0 +1,117 @@
+#include "rootzone.hpp"
+#include "zonefile.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+
+std::shared_ptr<const RootZone> RootZone::load(const std::string& path) {
+    std::ifstream in(path);
+    struct stat info{};
+    if (!in || stat(path.c_str(), &info) != 0) {
+        throw std::runtime_error("Cannot read root zone " + path);
+    }
+
+    auto zone = std::make_shared<RootZone>();
+    ZoneFileReader reader(in, path);
+    ZoneFileRecord record;
+
+    while (reader.next(record)) {
+        const auto& owner = record.owner;
+        const auto& rdata = record.rdata;
+
+        if (record.type == "SOA") {
+            if (rdata.size() != 7) throw reader.error("malformed SOA");
+            if (!owner.empty()) throw reader.error("SOA for " + owner + " is not the root");
+            if (zone->soa) throw reader.error("more than one SOA");
+            zone->soa = std::make_shared<dnslib::SOARecord>(
+                owner, record.ttl, reader.name(rdata[0]), reader.name(rdata[1]),
+                reader.number(rdata[2]), reader.number(rdata[3]), reader.number(rdata[4]),
+                reader.number(rdata[5]), reader.number(rdata[6]));
+        } else if (record.type == "NS") {
+            if (rdata.size() != 1) throw reader.error("malformed NS");
+            auto ns = std::make_shared<dnslib::NSRecord>(owner, record.ttl, reader.name(rdata[0]));
+            if (owner.empty()) {
+                zone->apexNs.push_back(ns);
+            } else if (owner.find('.') == std::string::npos) {
+                zone->delegations[owner].push_back(ns);
+            } else {
+                throw reader.error("delegation of " + owner + " below a TLD");
+            }
+        } else if (record.type == "A") {
+            in_addr address{};
+            if (rdata.size() != 1 || inet_pton(AF_INET, rdata[0].c_str(), &address) != 1) throw reader.error("malformed A");
+            zone->glue[owner].push_back(std::make_shared<dnslib::ARecord>(owner, record.ttl, ntohl(address.s_addr)));
+        }
+        // AAAA, DS, RRSIG, NSEC, DNSKEY, ZONEMD... are not needed for referrals over IPv4
+    }
+
+    if (!zone->soa) throw std::runtime_error("Root zone " + path + " has no SOA");
+    if (zone->apexNs.empty()) throw std::runtime_error("Root zone " + path + " has no NS records at the apex");
+    if (zone->delegations.empty()) throw std::runtime_error("Root zone " + path + " delegates no TLD");
+
+    zone->expiresAt = std::chrono::system_clock::from_time_t(info.st_mtime) + std::chrono::seconds(zone->soa->getExpire());
+    return zone;
+}
+
+void RootZone::addGlue(dnslib::PacketBuilder& builder, const RecordList& nsRecords) const {
+    for (const auto& rec : nsRecords) {
+        auto ns = std::static_pointer_cast<dnslib::NSRecord>(rec);
+        auto it = glue.find(ns->getNs());
+        if (it == glue.end()) continue;
+
+        for (const auto& address : it->second) {
+            builder.addAdditional(address);
+        }
+    }
+}
+
+std::optional<dnslib::DNSPacket> RootZone::answer(const std::string& name, dnslib::TYPE type) const {
+    std::string key = name;
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (!key.empty() && key.back() == '.') key.pop_back();
+
+    dnslib::PacketBuilder builder;
+    builder.addQuestion(name, type);
+
+    if (key.empty()) {
+        builder.withFlags(dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::AUTHORITATIVE);
+        if (type == dnslib::TYPE::NS) {
+            for (const auto& rec : apexNs) {
+                builder.addAnswer(rec);
+            }
+            addGlue(builder, apexNs);
+        } else if (type == dnslib::TYPE::SOA) {
+            builder.addAnswer(soa);
+        } else {
+            // Only the records kept from the file are known to exist
+            return std::nullopt;
+        }
+        return builder.build();
+    }
+
+    std::string tld = key.substr(key.rfind('.') + 1);
+    auto delegation = delegations.find(tld);
+
+    if (delegation == delegations.end()) {
+        builder.withFlags(dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::AUTHORITATIVE);
+        builder.withRcode(dnslib::RCODE::NAMEERROR);
+        builder.addAuthority(soa);
+        return builder.build();
+    }
+
+    // The DS record of a TLD is served by the root, it is not kept here
+    if (key == tld && type == dnslib::TYPE::DS) {
+        return std::nullopt;
+    }
+
+    builder.withFlags(dnslib::PacketFlag::RESPONSE);
+    for (const auto& rec : delegation->second) {
+        builder.addAuthority(rec);
+    }
+    addGlue(builder, delegation->second);
+    return builder.build();
+}
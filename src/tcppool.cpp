@@ -0,0 +1,301 @@
+#include "tcppool.hpp"
+
+#include "utils/log.hpp"
+#include "utils/metrics.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// A query is sent again on a new connection at most this many times
+constexpr int MAX_ATTEMPTS = 2;
+// Idle connections are looked for at least this often
+constexpr int LOOP_TIMEOUT_MS = 1000;
+
+static bool SameServer(const sockaddr_in& a, const sockaddr_in& b) {
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+TcpPool::TcpPool(Deliver deliver, size_t maxPerServer, std::chrono::seconds idleTimeout)
+    : deliver(std::move(deliver)), maxPerServer(std::max<size_t>(1, maxPerServer)), idleTimeout(idleTimeout) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+        throw std::runtime_error("Cannot set up the TCP pool: " + std::string(strerror(errno)));
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+
+    thread = std::thread([this] { run(); });
+}
+
+TcpPool::~TcpPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    uint64_t one = 1;
+    (void)write(wakeFd, &one, sizeof(one));
+    thread.join();
+
+    for (auto& [fd, connection] : connections) {
+        close(fd);
+    }
+    close(wakeFd);
+    close(epollFd);
+}
+
+void TcpPool::send(const sockaddr_in& server, std::vector<uint8_t> query, Clock::time_point deadline) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        submitted.emplace_back(server, Query{std::move(query), deadline, 0});
+    }
+    uint64_t one = 1;
+    (void)write(wakeFd, &one, sizeof(one));
+}
+
+void TcpPool::run() {
+    epoll_event events[32];
+
+    while (true) {
+        int count = epoll_wait(epollFd, events, 32, LOOP_TIMEOUT_MS);
+
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.fd == wakeFd) {
+                uint64_t value;
+                (void)read(wakeFd, &value, sizeof(value));
+                continue;
+            }
+
+            auto it = connections.find(events[i].data.fd);
+            if (it != connections.end()) {
+                handle(*it->second, events[i].events);
+            }
+        }
+
+        std::vector<std::pair<sockaddr_in, Query>> queries;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (stopping) return;
+            queries.swap(submitted);
+        }
+        for (auto& [server, query] : queries) {
+            dispatch(server, std::move(query));
+        }
+
+        closeIdle(Clock::now());
+    }
+}
+
+void TcpPool::dispatch(const sockaddr_in& server, Query query) {
+    if (query.data.size() < 2 || query.data.size() > 0xFFFF) return;
+
+    Connection* chosen = nullptr;
+    size_t serverConnections = 0;
+    for (auto& [fd, connection] : connections) {
+        if (!SameServer(connection->server, server)) continue;
+        serverConnections++;
+        if (chosen == nullptr || connection->pending.size() < chosen->pending.size()) {
+            chosen = connection.get();
+        }
+    }
+
+    if (chosen == nullptr || (chosen->pending.size() >= MAX_PIPELINE && serverConnections < maxPerServer)) {
+        if (auto* fresh = open(server)) {
+            chosen = fresh;
+        }
+    } else {
+        DNS_METRIC_INC("tcp.reused");
+    }
+    if (chosen == nullptr) {
+        DNS_METRIC_INC("tcp.connect_failures");
+        return;
+    }
+
+    uint16_t id = (query.data[0] << 8) | query.data[1];
+    uint16_t length = query.data.size();
+    chosen->out.push_back(length >> 8);
+    chosen->out.push_back(length & 0xFF);
+    chosen->out.insert(chosen->out.end(), query.data.begin(), query.data.end());
+    chosen->pending[id] = std::move(query);
+    chosen->lastUsed = Clock::now();
+    DNS_METRIC_INC("tcp.queries");
+
+    if (chosen->connected) {
+        flush(*chosen);
+    }
+}
+
+TcpPool::Connection* TcpPool::open(const sockaddr_in& server) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        DNS_LOG_ERR("TCP socket creation failed: " + std::string(strerror(errno)));
+        return nullptr;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&server), sizeof(server)) != 0 && errno != EINPROGRESS) {
+        close(fd);
+        return nullptr;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    auto connection = std::make_unique<Connection>();
+    connection->fd = fd;
+    connection->server = server;
+    connection->lastUsed = Clock::now();
+
+    auto* raw = connection.get();
+    connections[fd] = std::move(connection);
+    openConnections.store(connections.size());
+    DNS_METRIC_INC("tcp.connections_opened");
+    return raw;
+}
+
+void TcpPool::handle(Connection& connection, uint32_t events) {
+    if (!connection.connected && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0) {
+            DNS_LOG_DEBUG("TCP connect failed: " + std::string(strerror(error)));
+            fail(connection);
+            return;
+        }
+        connection.connected = true;
+    }
+
+    if (events & EPOLLIN) {
+        uint8_t buffer[4096];
+        bool closed = false;
+        while (true) {
+            ssize_t got = read(connection.fd, buffer, sizeof(buffer));
+            if (got > 0) {
+                connection.in.insert(connection.in.end(), buffer, buffer + got);
+                continue;
+            }
+            if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (got < 0 && errno == EINTR) continue;
+
+            // Closed by the server, or broken. Answers read so far still count.
+            closed = true;
+            break;
+        }
+
+        size_t pos = 0;
+        while (connection.in.size() - pos >= 2) {
+            size_t length = (connection.in[pos] << 8) | connection.in[pos + 1];
+            if (connection.in.size() - pos - 2 < length) break;
+
+            dnslib::DNSMessageL message{};
+            message.data.assign(connection.in.begin() + pos + 2, connection.in.begin() + pos + 2 + length);
+            message.peerAddress = connection.server;
+            message.clientFd = -1;
+            message.protocol = dnslib::PROTO::TCP;
+            pos += 2 + length;
+
+            if (length < 2) continue;
+            uint16_t id = (message.data[0] << 8) | message.data[1];
+            if (connection.pending.erase(id) == 0) continue;
+            connection.lastUsed = Clock::now();
+
+            try {
+                deliver(std::move(message));
+            } catch (const std::exception& e) {
+                DNS_LOG_ERR("Error " + std::string(e.what()));
+            }
+        }
+        connection.in.erase(connection.in.begin(), connection.in.begin() + pos);
+
+        if (closed) {
+            fail(connection);
+            return;
+        }
+    }
+
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        fail(connection);
+        return;
+    }
+
+    if (connection.connected) {
+        flush(connection);
+    }
+}
+
+void TcpPool::flush(Connection& connection) {
+    size_t written = 0;
+    while (written < connection.out.size()) {
+        ssize_t sent = ::send(connection.fd, connection.out.data() + written, connection.out.size() - written, MSG_NOSIGNAL);
+        if (sent > 0) {
+            written += sent;
+        } else if (sent < 0 && errno == EINTR) {
+            continue;
+        } else {
+            break;
+        }
+    }
+    connection.out.erase(connection.out.begin(), connection.out.begin() + written);
+
+    epoll_event ev{};
+    ev.events = connection.out.empty() ? EPOLLIN : EPOLLIN | EPOLLOUT;
+    ev.data.fd = connection.fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &ev);
+}
+
+void TcpPool::fail(Connection& connection) {
+    int fd = connection.fd;
+    sockaddr_in server = connection.server;
+    auto pending = std::move(connection.pending);
+
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+    openConnections.store(connections.size());
+
+    // Servers close idle or busy connections whenever they like, give the queries another one
+    auto now = Clock::now();
+    for (auto& [id, query] : pending) {
+        if (++query.attempts >= MAX_ATTEMPTS || query.deadline <= now) continue;
+        DNS_METRIC_INC("tcp.resent");
+        dispatch(server, std::move(query));
+    }
+}
+
+void TcpPool::closeIdle(Clock::time_point now) {
+    for (auto it = connections.begin(); it != connections.end();) {
+        auto& connection = *it->second;
+        size_t expired = std::erase_if(connection.pending, [&](const auto& entry) { return entry.second.deadline <= now; });
+        if (expired > 0) {
+            DNS_METRIC_INC("tcp.expired");
+        }
+
+        // Nothing answered in time and nothing else waiting: the server is stuck, not idle
+        bool stuck = expired > 0 && connection.pending.empty();
+        if (stuck || (connection.pending.empty() && now - connection.lastUsed > idleTimeout)) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, connection.fd, nullptr);
+            close(connection.fd);
+            it = connections.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    openConnections.store(connections.size());
+}
@@ -0,0 +1,149 @@
+#include "throttle.hpp"
+
+#include "utils/metrics.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <sstream>
+
+// Weight of a new sample in the smoothed queueing delay, as for SRTT
+constexpr double DELAY_GAIN = 0.125;
+
+
+std::shared_ptr<ServerThrottle::Server> ServerThrottle::find(uint32_t address, bool create) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto it = servers.find(address);
+    if (it != servers.end()) return it->second;
+    if (!create) return nullptr;
+
+    if (servers.size() >= MAX_SERVERS) {
+        // Forget the idle servers, the busy ones keep their queue
+        std::erase_if(servers, [](const auto& entry) {
+            std::lock_guard<std::mutex> serverLock(entry.second->mtx);
+            return entry.second->outstanding == 0 && entry.second->waiting == 0;
+        });
+    }
+
+    auto server = std::make_shared<Server>();
+    server->maxOutstanding = maxOutstanding;
+    if (rate > 0) {
+        server->bucket.emplace(rate, std::max(rate, 1.0));
+    }
+    servers.emplace(address, server);
+    return server;
+}
+
+bool ServerThrottle::admit(Server& server) {
+    if (server.maxOutstanding > 0 && server.outstanding >= server.maxOutstanding) return false;
+    if (server.bucket && !server.bucket->tryTake()) return false;
+
+    server.outstanding++;
+    return true;
+}
+
+void ServerThrottle::dispatch(const std::shared_ptr<Server>& server, utils::Executor& executor) {
+    auto now = Clock::now();
+    while (!server->queue.empty()) {
+        auto& waiter = server->queue.front();
+        if (waiter->done) {
+            server->queue.pop_front();
+            continue;
+        }
+        if (!admit(*server)) break;
+
+        double delay = std::chrono::duration<double, std::milli>(now - waiter->queued).count();
+        server->delayAvg = server->delayed == 0 ? delay : server->delayAvg + DELAY_GAIN * (delay - server->delayAvg);
+        server->delayMax = std::max(server->delayMax, delay);
+        server->delayed++;
+        server->waiting--;
+
+        waiter->done = true;
+        *waiter->granted = true;
+        executor.post(waiter->handle);
+        server->queue.pop_front();
+    }
+
+    // Out of tokens rather than slots: nothing else will wake the queue up
+    bool slotFree = server->maxOutstanding == 0 || server->outstanding < server->maxOutstanding;
+    if (server->waiting > 0 && slotFree && server->bucket && !server->timerArmed) {
+        server->timerArmed = true;
+        executor.postAt(now + server->bucket->untilAvailable(), [server, &executor] {
+            std::lock_guard<std::mutex> lock(server->mtx);
+            server->timerArmed = false;
+            dispatch(server, executor);
+        });
+    }
+}
+
+bool ServerThrottle::enqueue(uint32_t address, Clock::time_point deadline, std::coroutine_handle<> handle, bool* granted) {
+    auto server = find(address, true);
+    auto now = Clock::now();
+
+    std::lock_guard<std::mutex> lock(server->mtx);
+    if (server->waiting == 0 && admit(*server)) {
+        *granted = true;
+        return false;
+    }
+    if (now >= deadline) {
+        return false;
+    }
+
+    auto waiter = std::make_shared<Waiter>(Waiter{handle, granted, now});
+    server->queue.push_back(waiter);
+    server->waiting++;
+    DNS_METRIC_INC("throttle.queued");
+
+    executor.postAt(deadline, [server, waiter, &executor = executor] {
+        {
+            std::lock_guard<std::mutex> lock(server->mtx);
+            if (waiter->done) return;
+            // Left in the queue, dispatch() drops it once it gets to the front
+            waiter->done = true;
+            server->waiting--;
+            server->expired++;
+        }
+        DNS_METRIC_INC("throttle.queue_timeouts");
+        executor.post(waiter->handle);
+    });
+    dispatch(server, executor);
+    return true;
+}
+
+void ServerThrottle::release(uint32_t address) {
+    auto server = find(address, false);
+    if (!server) return;
+
+    std::lock_guard<std::mutex> lock(server->mtx);
+    if (server->outstanding > 0) server->outstanding--;
+    dispatch(server, executor);
+}
+
+size_t ServerThrottle::queued(uint32_t address) {
+    auto server = find(address, false);
+    if (!server) return 0;
+
+    std::lock_guard<std::mutex> lock(server->mtx);
+    return server->waiting;
+}
+
+std::string ServerThrottle::toString() const {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::stringstream ss;
+    ss << servers.size() << " servers tracked\n";
+    for (const auto& [address, server] : servers) {
+        std::lock_guard<std::mutex> serverLock(server->mtx);
+        if (server->delayed == 0 && server->expired == 0 && server->waiting == 0) continue;
+
+        in_addr addr;
+        addr.s_addr = htonl(address);
+        ss << inet_ntoa(addr)
+           << " outstanding=" << server->outstanding
+           << " queued=" << server->waiting
+           << " delayed=" << server->delayed
+           << " expired=" << server->expired
+           << " delay_avg=" << static_cast<int>(server->delayAvg) << "ms"
+           << " delay_max=" << static_cast<int>(server->delayMax) << "ms\n";
+    }
+    return ss.str();
+}
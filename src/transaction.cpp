@@ -0,0 +1,140 @@
+#include "transaction.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+#include "builder/PacketBuilder.hpp"
+
+static bool SameServer(const sockaddr_in& a, const sockaddr_in& b) {
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+static bool SameName(const std::string& a, const std::string& b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](unsigned char x, unsigned char y) {
+        return std::tolower(x) == std::tolower(y);
+    });
+}
+
+// Whether packet answers the question of state, a guessed ID is not enough
+static bool SameQuestion(const dnslib::DNSPacket& packet, const TransactionTable::State& state) {
+    const auto& questions = packet.getQuestions();
+    return questions.size() == 1 && questions[0].getType() == state.type && questions[0].getClass() == dnslib::CLASS::IN
+        && SameName(questions[0].getName(), state.name);
+}
+
+std::shared_ptr<TransactionTable::State> TransactionTable::open() {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::uniform_int_distribution<uint16_t> dist(1, 0xFFFF);
+    uint16_t id;
+    do {
+        id = dist(rng);
+    } while (transactions.count(id) != 0);
+
+    auto state = std::make_shared<State>();
+    state->id = id;
+    transactions[id] = state;
+    return state;
+}
+
+void TransactionTable::close(uint16_t id) {
+    std::lock_guard<std::mutex> lock(mtx);
+    transactions.erase(id);
+}
+
+bool TransactionTable::deliver(const dnslib::DNSMessageL& message, dnslib::DNSPacket packet, utils::Executor& executor) {
+    std::shared_ptr<State> state;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = transactions.find(packet.getHeader().getId());
+        if (it == transactions.end()) return false;
+        state = it->second;
+    }
+
+    std::coroutine_handle<> waiter;
+    {
+        std::lock_guard<std::mutex> lock(state->mtx);
+        if (!SameQuestion(packet, *state)) return false;
+
+        auto sent = std::find_if(state->outstanding.begin(), state->outstanding.end(), [&](const auto& entry) {
+            return SameServer(entry.first, message.peerAddress);
+        });
+        if (sent == state->outstanding.end()) return false;
+
+        auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sent->second);
+        state->replies.push_back({std::move(packet), message.peerAddress, rtt, ""});
+        state->outstanding.erase(sent);
+
+        waiter = std::exchange(state->waiter, nullptr);
+    }
+
+    if (waiter) {
+        executor.post(waiter);
+    }
+    return true;
+}
+
+size_t TransactionTable::size() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return transactions.size();
+}
+
+Transaction::Transaction(TransactionTable& table, utils::Executor& executor, utils::ETSQueue<dnslib::DNSMessageL>& outputQueue, bool dnssecOk)
+    : table(table), executor(executor), outputQueue(outputQueue), state(table.open()), dnssecOk(dnssecOk) {}
+
+Transaction::~Transaction() {
+    table.close(state->id);
+}
+
+// EDNS payload size advertised with DO, small enough not to fragment (DNS flag day 2020)
+constexpr uint16_t EDNS_PAYLOAD_SIZE = 1232;
+
+static std::vector<uint8_t> BuildQuery(uint16_t id, const std::string& name, dnslib::TYPE type, bool recursionDesired, bool dnssecOk) {
+    dnslib::PacketBuilder builder;
+    builder.setId(id);
+    builder.withFlags(recursionDesired ? dnslib::PacketFlag::RECURSION_DES : dnslib::PacketFlag::NONE);
+    builder.addQuestion(name, type);
+    if (dnssecOk) {
+        builder.addAdditional(std::make_shared<dnslib::OPTRecord>(EDNS_PAYLOAD_SIZE, true));
+    }
+
+    std::vector<uint8_t> wire;
+    builder.build().serialize(wire);
+    return wire;
+}
+
+void Transaction::send(const sockaddr_in& server, const std::string& name, dnslib::TYPE type, bool recursionDesired) {
+    dnslib::DNSMessageL message{};
+    message.peerAddress = server;
+    message.protocol = dnslib::PROTO::UDP;
+    message.data = BuildQuery(state->id, name, type, recursionDesired, dnssecOk);
+
+    {
+        std::lock_guard<std::mutex> lock(state->mtx);
+        state->name = name;
+        state->type = type;
+        state->outstanding.push_back({server, std::chrono::steady_clock::now()});
+    }
+    outputQueue.push(std::move(message));
+}
+
+void Transaction::sendTcp(TcpPool& pool, const sockaddr_in& server, const std::string& name, dnslib::TYPE type, bool recursionDesired,
+                          std::chrono::steady_clock::time_point deadline) {
+    {
+        std::lock_guard<std::mutex> lock(state->mtx);
+        state->name = name;
+        state->type = type;
+        state->outstanding.push_back({server, std::chrono::steady_clock::now()});
+    }
+    pool.send(server, BuildQuery(state->id, name, type, recursionDesired, dnssecOk), deadline);
+}
+
+size_t Transaction::outstanding() {
+    std::lock_guard<std::mutex> lock(state->mtx);
+    return state->outstanding.size();
+}
+
+void Transaction::abandon(const sockaddr_in& server) {
+    std::lock_guard<std::mutex> lock(state->mtx);
+    std::erase_if(state->outstanding, [&](const auto& entry) { return SameServer(entry.first, server); });
+}
@@ -0,0 +1,157 @@
+#include "upstream.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <sstream>
+
+// Percentiles need a few samples to mean anything, hedge after this meanwhile
+constexpr auto INITIAL_HEDGE = std::chrono::milliseconds(100);
+constexpr size_t MIN_SAMPLES = 8;
+// Never hedge sooner than this, jitter of a fast upstream is not worth a duplicate
+constexpr auto MIN_HEDGE = std::chrono::milliseconds(1);
+constexpr auto MAX_HEDGE = std::chrono::milliseconds(1000);
+
+
+static std::string toText(const sockaddr_in& address) {
+    char text[INET_ADDRSTRLEN] = {};
+    inet_ntop(AF_INET, &address.sin_addr, text, sizeof(text));
+    return std::string(text) + ":" + std::to_string(ntohs(address.sin_port));
+}
+
+UpstreamPool::UpstreamPool(std::vector<sockaddr_in> servers, double hedgePercentile)
+    : hedgePercentile(hedgePercentile) {
+    for (const auto& address : servers) {
+        Upstream upstream;
+        upstream.address = address;
+        upstreams.push_back(std::move(upstream));
+    }
+}
+
+std::chrono::microseconds UpstreamPool::percentile(const Upstream& upstream, double pct) const {
+    if (upstream.latencies.empty()) {
+        return std::chrono::microseconds(0);
+    }
+
+    auto sorted = upstream.latencies;
+    size_t rank = static_cast<size_t>(pct / 100.0 * (sorted.size() - 1) + 0.5);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+std::optional<size_t> UpstreamPool::find(const sockaddr_in& address) const {
+    for (size_t i = 0; i < upstreams.size(); i++) {
+        const auto& candidate = upstreams[i].address;
+        if (candidate.sin_addr.s_addr == address.sin_addr.s_addr && candidate.sin_port == address.sin_port) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<size_t> UpstreamPool::select(const std::vector<size_t>& exclude) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::vector<size_t> healthy;
+    std::vector<size_t> down;
+    for (size_t i = 0; i < upstreams.size(); i++) {
+        if (std::find(exclude.begin(), exclude.end(), i) != exclude.end()) continue;
+        (upstreams[i].healthy ? healthy : down).push_back(i);
+    }
+
+    // Every upstream is down, better to try anyway than to fail outright
+    auto& usable = healthy.empty() ? down : healthy;
+    if (usable.empty()) {
+        return std::nullopt;
+    }
+    if (usable.size() == 1) {
+        return usable[0];
+    }
+
+    // Power of two choices: spreads load without herding on a single "best" upstream
+    std::uniform_int_distribution<size_t> dist(0, usable.size() - 1);
+    size_t a = usable[dist(rng)];
+    size_t b = usable[dist(rng)];
+    while (b == a) {
+        b = usable[dist(rng)];
+    }
+
+    if (upstreams[a].outstanding != upstreams[b].outstanding) {
+        return upstreams[a].outstanding < upstreams[b].outstanding ? a : b;
+    }
+    return percentile(upstreams[a], 50) <= percentile(upstreams[b], 50) ? a : b;
+}
+
+void UpstreamPool::acquire(size_t index) {
+    std::lock_guard<std::mutex> lock(mtx);
+    upstreams[index].outstanding++;
+}
+
+void UpstreamPool::release(size_t index) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (upstreams[index].outstanding > 0) {
+        upstreams[index].outstanding--;
+    }
+}
+
+void UpstreamPool::recordAnswer(size_t index, std::chrono::microseconds rtt) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto& upstream = upstreams[index];
+    if (upstream.latencies.size() < LATENCY_WINDOW) {
+        upstream.latencies.push_back(rtt);
+    } else {
+        upstream.latencies[upstream.nextSample] = rtt;
+    }
+    upstream.nextSample = (upstream.nextSample + 1) % LATENCY_WINDOW;
+
+    upstream.answers++;
+    upstream.consecutiveFailures = 0;
+    if (!upstream.healthy) {
+        upstream.healthy = true;
+        DNS_LOG_INFO("Upstream " + toText(upstream.address) + " is up");
+    }
+}
+
+void UpstreamPool::recordFailure(size_t index) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto& upstream = upstreams[index];
+    upstream.failures++;
+    upstream.consecutiveFailures++;
+    if (upstream.healthy && upstream.consecutiveFailures >= FAILURE_THRESHOLD) {
+        upstream.healthy = false;
+        DNS_LOG_WARN("Upstream " + toText(upstream.address) + " is down");
+    }
+}
+
+std::optional<std::chrono::microseconds> UpstreamPool::hedgeDelay(size_t index) const {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (hedgePercentile <= 0 || upstreams.size() < 2) {
+        return std::nullopt;
+    }
+
+    const auto& upstream = upstreams[index];
+    if (upstream.latencies.size() < MIN_SAMPLES) {
+        return INITIAL_HEDGE;
+    }
+    return std::clamp<std::chrono::microseconds>(percentile(upstream, hedgePercentile), MIN_HEDGE, MAX_HEDGE);
+}
+
+std::string UpstreamPool::toString() const {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::stringstream ss;
+    for (const auto& upstream : upstreams) {
+        ss << toText(upstream.address)
+           << (upstream.healthy ? " up" : " down")
+           << " outstanding=" << upstream.outstanding
+           << " p50=" << percentile(upstream, 50).count() << "us"
+           << " p" << hedgePercentile << "=" << percentile(upstream, hedgePercentile).count() << "us"
+           << " answers=" << upstream.answers
+           << " failures=" << upstream.failures
+           << "\n";
+    }
+    return ss.str();
+}
@@ -46,6 +46,19 @@ T ETSQueue<T>::pop() {
     return item;
 }
 
+template <typename T>
+bool ETSQueue<T>::popFor(T& outItem, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (!m_cond.wait_for(lock, timeout, [this]() { return !m_queue.empty(); })) {
+        return false;
+    }
+
+    outItem = std::move(m_queue.front());
+    m_queue.pop();
+    return true;
+}
+
 template <typename T>
 bool ETSQueue<T>::tryPop(T& outItem) {
     std::lock_guard<std::mutex> lock(m_mutex);
@@ -57,6 +70,40 @@ bool ETSQueue<T>::tryPop(T& outItem) {
     return true;
 }
 
+template <typename T>
+void ETSQueue<T>::pushAll(std::vector<T>& items) {
+    if (items.empty()) return;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (auto& item : items) {
+            m_queue.push(std::move(item));
+        }
+    }
+    items.clear();
+    m_cond.notify_one();
+
+    uint64_t u = 1;
+    ssize_t ret = write(m_eventFd, &u, sizeof(uint64_t));
+    (void)ret;
+}
+
+template <typename T>
+size_t ETSQueue<T>::popBatch(std::vector<T>& out, size_t max, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (!m_cond.wait_for(lock, timeout, [this]() { return !m_queue.empty(); })) {
+        return 0;
+    }
+
+    size_t count = 0;
+    while (count < max && !m_queue.empty()) {
+        out.push_back(std::move(m_queue.front()));
+        m_queue.pop();
+        count++;
+    }
+    return count;
+}
+
 template <typename T>
 bool ETSQueue<T>::empty() const {
     std::lock_guard<std::mutex> lock(m_mutex);
@@ -0,0 +1,134 @@
+#include "utils/executor.hpp"
+
+namespace utils {
+
+// Worker the current thread runs, so that work scheduled from it stays local
+static thread_local Executor* currentExecutor = nullptr;
+static thread_local size_t currentWorker = 0;
+
+Executor::Executor(size_t threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        workers[i]->thread = std::thread(&Executor::runWorker, this, i);
+    }
+    timerThread = std::thread(&Executor::runTimers, this);
+}
+
+Executor::~Executor() {
+    {
+        std::lock_guard<std::mutex> lock(timerMtx);
+        timersStopping = true;
+    }
+    timerCond.notify_all();
+    timerThread.join();
+
+    {
+        std::lock_guard<std::mutex> lock(idleMtx);
+        stopping = true;
+    }
+    idleCond.notify_all();
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+}
+
+void Executor::post(std::coroutine_handle<> handle) {
+    size_t index = currentExecutor == this
+        ? currentWorker
+        : nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mtx);
+        workers[index]->tasks.push_back(handle);
+    }
+    queued.fetch_add(1);
+
+    // Taking the lock orders the notification after a worker's check of queued
+    { std::lock_guard<std::mutex> lock(idleMtx); }
+    idleCond.notify_one();
+}
+
+void Executor::postAt(Clock::time_point deadline, std::function<void()> callback) {
+    bool earliest;
+    {
+        std::lock_guard<std::mutex> lock(timerMtx);
+        earliest = timers.empty() || deadline < timers.top().deadline;
+        timers.push({deadline, timerSeq++, std::move(callback)});
+    }
+    if (earliest) {
+        timerCond.notify_one();
+    }
+}
+
+bool Executor::takeWork(size_t index, std::coroutine_handle<>& handle) {
+    {
+        auto& own = *workers[index];
+        std::lock_guard<std::mutex> lock(own.mtx);
+        if (!own.tasks.empty()) {
+            handle = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < workers.size(); i++) {
+        auto& victim = *workers[(index + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if (!victim.tasks.empty()) {
+            handle = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void Executor::runWorker(size_t index) {
+    currentExecutor = this;
+    currentWorker = index;
+
+    while (true) {
+        std::coroutine_handle<> handle;
+        if (takeWork(index, handle)) {
+            queued.fetch_sub(1);
+            handle.resume();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idleMtx);
+        idleCond.wait(lock, [this] { return stopping || queued.load() > 0; });
+        if (stopping) return;
+    }
+}
+
+void Executor::runTimers() {
+    std::unique_lock<std::mutex> lock(timerMtx);
+
+    while (!timersStopping) {
+        if (timers.empty()) {
+            timerCond.wait(lock);
+            continue;
+        }
+
+        auto deadline = timers.top().deadline;
+        if (Clock::now() < deadline) {
+            timerCond.wait_until(lock, deadline);
+            continue;
+        }
+
+        auto callback = std::move(const_cast<Timer&>(timers.top()).callback);
+        timers.pop();
+
+        lock.unlock();
+        callback();
+        lock.lock();
+    }
+}
+
+}
@@ -0,0 +1,414 @@
+#include "zoneimage.hpp"
+#include "zonefile.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+
+
+namespace {
+
+constexpr uint16_t TYPE_A = static_cast<uint16_t>(dnslib::TYPE::A);
+constexpr uint16_t TYPE_NS = static_cast<uint16_t>(dnslib::TYPE::NS);
+constexpr uint16_t TYPE_CNAME = static_cast<uint16_t>(dnslib::TYPE::CNAME);
+constexpr uint16_t TYPE_SOA = static_cast<uint16_t>(dnslib::TYPE::SOA);
+constexpr uint16_t TYPE_PTR = static_cast<uint16_t>(dnslib::TYPE::PTR);
+constexpr uint16_t TYPE_MX = static_cast<uint16_t>(dnslib::TYPE::MX);
+constexpr uint16_t TYPE_TXT = static_cast<uint16_t>(dnslib::TYPE::TXT);
+constexpr uint16_t TYPE_AAAA = static_cast<uint16_t>(dnslib::TYPE::AAAA);
+// Not in dnslib::TYPE
+constexpr uint16_t TYPE_SRV = 33;
+
+const std::unordered_map<std::string, uint16_t> TYPE_NAMES = {
+    {"A", TYPE_A}, {"NS", TYPE_NS}, {"CNAME", TYPE_CNAME}, {"SOA", TYPE_SOA}, {"PTR", TYPE_PTR},
+    {"MX", TYPE_MX}, {"TXT", TYPE_TXT}, {"AAAA", TYPE_AAAA}, {"SRV", TYPE_SRV},
+};
+
+struct BuildRRset {
+    size_t zone;
+    uint32_t ttl = UINT32_MAX;
+    std::vector<std::vector<uint8_t>> rdatas{};
+    std::vector<std::string> targets{};     // names whose addresses go to the additional section
+};
+
+struct BuildZone {
+    std::string apex;
+    std::vector<uint8_t> negative;
+};
+
+bool IsBelow(const std::string& name, const std::string& apex) {
+    if (apex.empty()) return true;
+    return name == apex || (name.size() > apex.size() && name.ends_with(apex) && name[name.size() - apex.size() - 1] == '.');
+}
+
+void WriteName(std::vector<uint8_t>& buffer, const std::string& name, const ZoneFileReader& reader) {
+    if (name.size() > 253) {
+        throw reader.error("name too long: " + name);
+    }
+    try {
+        dnslib::utils::writeDomain(buffer, name);
+    } catch (const std::exception& e) {
+        throw reader.error(std::string(e.what()) + ": " + name);
+    }
+}
+
+uint16_t Number16(const std::string& token, const ZoneFileReader& reader) {
+    uint32_t value = reader.number(token);
+    if (value > UINT16_MAX) throw reader.error("invalid 16-bit number " + token);
+    return static_cast<uint16_t>(value);
+}
+
+// Character-string of a TXT record, from a quoted or bare token
+void WriteText(std::vector<uint8_t>& buffer, const std::string& token, const ZoneFileReader& reader) {
+    std::string text = token;
+    if (text.size() >= 2 && text.front() == '"' && text.back() == '"') {
+        text = text.substr(1, text.size() - 2);
+    }
+
+    std::string raw;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] != '\\' || i + 1 >= text.size()) {
+            raw += text[i];
+        } else if (i + 3 < text.size() && std::isdigit(static_cast<unsigned char>(text[i + 1]))) {
+            raw += static_cast<char>(std::stoi(text.substr(i + 1, 3)));
+            i += 3;
+        } else {
+            raw += text[++i];
+        }
+    }
+
+    if (raw.size() > 255) throw reader.error("TXT string longer than 255 bytes");
+    buffer.push_back(static_cast<uint8_t>(raw.size()));
+    buffer.insert(buffer.end(), raw.begin(), raw.end());
+}
+
+// RDATA in wire format, targets gets the names additional records are looked up for
+std::vector<uint8_t> EncodeRdata(uint16_t type, const std::vector<std::string>& rdata, const ZoneFileReader& reader, std::vector<std::string>& targets) {
+    std::vector<uint8_t> wire;
+    auto expect = [&](size_t count) {
+        if (rdata.size() != count) throw reader.error("wrong number of RDATA fields");
+    };
+
+    // RFC 3597 generic form, \# LENGTH HEX...
+    if (!rdata.empty() && rdata[0] == "\\#") {
+        if (rdata.size() < 2) throw reader.error("malformed generic RDATA");
+        uint32_t length = reader.number(rdata[1]);
+        std::string hex;
+        for (size_t i = 2; i < rdata.size(); i++) hex += rdata[i];
+        if (hex.size() != length * 2 || hex.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+            throw reader.error("malformed generic RDATA");
+        }
+        for (size_t i = 0; i < hex.size(); i += 2) {
+            wire.push_back(static_cast<uint8_t>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+        }
+        return wire;
+    }
+
+    switch (type) {
+        case TYPE_A: {
+            expect(1);
+            in_addr address{};
+            if (inet_pton(AF_INET, rdata[0].c_str(), &address) != 1) throw reader.error("invalid IPv4 address " + rdata[0]);
+            wire.resize(4);
+            std::memcpy(wire.data(), &address, 4);
+            break;
+        }
+        case TYPE_AAAA: {
+            expect(1);
+            in6_addr address{};
+            if (inet_pton(AF_INET6, rdata[0].c_str(), &address) != 1) throw reader.error("invalid IPv6 address " + rdata[0]);
+            wire.resize(16);
+            std::memcpy(wire.data(), &address, 16);
+            break;
+        }
+        case TYPE_NS:
+        case TYPE_CNAME:
+        case TYPE_PTR: {
+            expect(1);
+            std::string target = reader.name(rdata[0]);
+            WriteName(wire, target, reader);
+            if (type == TYPE_NS) targets.push_back(target);
+            break;
+        }
+        case TYPE_MX: {
+            expect(2);
+            std::string target = reader.name(rdata[1]);
+            dnslib::utils::writeU16(wire, Number16(rdata[0], reader));
+            WriteName(wire, target, reader);
+            targets.push_back(target);
+            break;
+        }
+        case TYPE_SRV: {
+            expect(4);
+            std::string target = reader.name(rdata[3]);
+            for (int i = 0; i < 3; i++) {
+                dnslib::utils::writeU16(wire, Number16(rdata[i], reader));
+            }
+            WriteName(wire, target, reader);
+            targets.push_back(target);
+            break;
+        }
+        case TYPE_SOA: {
+            expect(7);
+            WriteName(wire, reader.name(rdata[0]), reader);
+            WriteName(wire, reader.name(rdata[1]), reader);
+            for (int i = 2; i < 7; i++) {
+                dnslib::utils::writeU32(wire, reader.number(rdata[i]));
+            }
+            break;
+        }
+        case TYPE_TXT: {
+            if (rdata.empty()) throw reader.error("TXT without strings");
+            for (const auto& token : rdata) {
+                WriteText(wire, token, reader);
+            }
+            break;
+        }
+        default:
+            throw reader.error("RDATA of type " + std::to_string(type) + " must use the generic \\# form");
+    }
+
+    if (wire.size() > UINT16_MAX) throw reader.error("RDATA too long");
+    return wire;
+}
+
+uint16_t ParseType(const std::string& text, const ZoneFileReader& reader) {
+    auto known = TYPE_NAMES.find(text);
+    if (known != TYPE_NAMES.end()) return known->second;
+
+    if (text.starts_with("TYPE") && text.size() > 4) {
+        return Number16(text.substr(4), reader);
+    }
+    throw reader.error("unsupported type " + text + ", use the TYPEnnn \\# generic form");
+}
+
+void WriteRecord(std::vector<uint8_t>& out, const std::string& owner, uint16_t type, uint32_t ttl, const std::vector<uint8_t>& rdata) {
+    dnslib::utils::writeDomain(out, owner);
+    dnslib::utils::writeU16(out, type);
+    dnslib::utils::writeU16(out, 1);
+    dnslib::utils::writeU32(out, ttl);
+    dnslib::utils::writeU16(out, static_cast<uint16_t>(rdata.size()));
+    out.insert(out.end(), rdata.begin(), rdata.end());
+}
+
+uint32_t Offset32(size_t offset) {
+    if (offset > UINT32_MAX) throw std::runtime_error("Zone image data exceeds 4 GiB");
+    return static_cast<uint32_t>(offset);
+}
+
+void Align(std::vector<uint8_t>& image) {
+    image.resize((image.size() + 7) & ~size_t(7));
+}
+
+template <typename T>
+uint64_t AppendArray(std::vector<uint8_t>& image, const std::vector<T>& items) {
+    Align(image);
+    uint64_t offset = image.size();
+    image.resize(image.size() + items.size() * sizeof(T));
+    if (!items.empty()) {
+        std::memcpy(image.data() + offset, items.data(), items.size() * sizeof(T));
+    }
+    return offset;
+}
+
+}
+
+ZoneCompileStats compileZones(const std::vector<std::string>& files, const std::string& output) {
+    // Owner name -> type -> RRset, std::map keeps the names in the order of the image index
+    std::map<std::string, std::map<uint16_t, BuildRRset>> owners;
+    std::vector<BuildZone> zones;
+    ZoneCompileStats stats;
+
+    for (const auto& path : files) {
+        std::ifstream in(path);
+        if (!in) throw std::runtime_error("Cannot read zone file " + path);
+
+        ZoneFileReader reader(in, path);
+        ZoneFileRecord record;
+        size_t zone = zones.size();
+        BuildZone built;
+        bool apexNs = false;
+        std::optional<ZoneFileRecord> soa;
+
+        while (reader.next(record)) {
+            uint16_t type = ParseType(record.type, reader);
+
+            if (!soa.has_value()) {
+                // The SOA comes first, it tells where the zone starts
+                if (type != TYPE_SOA) throw reader.error("the zone must start with its SOA");
+                soa = record;
+                built.apex = record.owner;
+                for (const auto& existing : zones) {
+                    if (existing.apex == built.apex) throw reader.error("zone " + built.apex + " is defined twice");
+                }
+            } else if (type == TYPE_SOA) {
+                throw reader.error("more than one SOA");
+            }
+
+            if (!IsBelow(record.owner, built.apex)) {
+                throw reader.error(record.owner + " is outside of zone " + built.apex);
+            }
+            if (record.owner == "*" || record.owner.starts_with("*.")) {
+                throw reader.error("wildcard owner names are not supported");
+            }
+
+            std::vector<std::string> targets;
+            auto rdata = EncodeRdata(type, record.rdata, reader, targets);
+
+            auto& rrset = owners[record.owner].try_emplace(type, BuildRRset{zone}).first->second;
+            if (rrset.zone != zone) {
+                // The same name in two zones: the data of the deeper zone is authoritative
+                if (zones[rrset.zone].apex.size() > built.apex.size()) continue;
+                rrset = BuildRRset{zone};
+            }
+            if (std::find(rrset.rdatas.begin(), rrset.rdatas.end(), rdata) != rrset.rdatas.end()) continue;
+
+            rrset.ttl = std::min(rrset.ttl, record.ttl);
+            rrset.rdatas.push_back(std::move(rdata));
+            rrset.targets.insert(rrset.targets.end(), targets.begin(), targets.end());
+            if (type == TYPE_NS && record.owner == built.apex) apexNs = true;
+        }
+        if (!soa.has_value()) throw std::runtime_error("Zone file " + path + " has no SOA");
+        if (!apexNs) throw std::runtime_error("Zone " + built.apex + " has no NS records at its apex");
+
+        // RFC 2308: negative answers carry the SOA with the smaller of its TTL and MINIMUM
+        const auto& soaRRset = owners[built.apex][TYPE_SOA];
+        uint32_t minimum = reader.number(soa->rdata[6]);
+        WriteRecord(built.negative, built.apex, TYPE_SOA, std::min(soa->ttl, minimum), soaRRset.rdatas.front());
+        zones.push_back(std::move(built));
+    }
+
+    // CNAME and other data cannot share a name
+    for (const auto& [owner, rrsets] : owners) {
+        if (rrsets.count(TYPE_CNAME) != 0 && rrsets.size() > 1) {
+            throw std::runtime_error(owner + " has a CNAME and other records");
+        }
+    }
+
+    // Empty non-terminals between every owner and its apex exist, NXDOMAIN must not be answered for them
+    std::set<std::string> ents;
+    for (const auto& [owner, rrsets] : owners) {
+        const auto& apex = zones[rrsets.begin()->second.zone].apex;
+        std::string name = owner;
+        while (name != apex) {
+            auto dot = name.find('.');
+            name = dot == std::string::npos ? "" : name.substr(dot + 1);
+            if (owners.count(name) == 0) ents.insert(name);
+        }
+    }
+    for (const auto& name : ents) {
+        owners[name];
+    }
+
+    std::vector<zoneimage::Zone> zoneTable(zones.size());
+    std::vector<zoneimage::Name> nameTable;
+    std::vector<zoneimage::RRset> rrsetTable;
+    std::vector<uint8_t> keys;
+    std::vector<uint8_t> data;
+    std::unordered_map<std::string, uint32_t> nameIndex;
+
+    auto closestZone = [&](const std::string& name) {
+        size_t best = 0;
+        int bestLength = -1;
+        for (size_t i = 0; i < zones.size(); i++) {
+            if (IsBelow(name, zones[i].apex) && static_cast<int>(zones[i].apex.size()) > bestLength) {
+                best = i;
+                bestLength = static_cast<int>(zones[i].apex.size());
+            }
+        }
+        return best;
+    };
+
+    for (const auto& [owner, rrsets] : owners) {
+        zoneimage::Name entry{};
+        entry.keyOffset = Offset32(keys.size());
+        entry.keyLength = static_cast<uint16_t>(owner.size());
+        entry.rrsetCount = static_cast<uint16_t>(rrsets.size());
+        entry.firstRRset = static_cast<uint32_t>(rrsetTable.size());
+        entry.zone = static_cast<uint32_t>(closestZone(owner));
+        keys.insert(keys.end(), owner.begin(), owner.end());
+        nameIndex[owner] = static_cast<uint32_t>(nameTable.size());
+        nameTable.push_back(entry);
+
+        for (const auto& [type, rrset] : rrsets) {
+            zoneimage::RRset set{};
+            set.type = type;
+            set.count = static_cast<uint16_t>(rrset.rdatas.size());
+            set.offset = Offset32(data.size());
+            for (const auto& rdata : rrset.rdatas) {
+                WriteRecord(data, owner, type, rrset.ttl, rdata);
+            }
+            set.length = Offset32(data.size() - set.offset);
+            rrsetTable.push_back(set);
+            stats.records += rrset.rdatas.size();
+        }
+    }
+
+    // Additional sections, now that every address RRset is in place
+    size_t rrsetIndex = 0;
+    for (const auto& [owner, rrsets] : owners) {
+        for (const auto& [type, rrset] : rrsets) {
+            auto& entry = rrsetTable[rrsetIndex++];
+            entry.additionalOffset = Offset32(data.size());
+            for (const auto& target : rrset.targets) {
+                auto it = nameIndex.find(target);
+                if (it == nameIndex.end()) continue;
+
+                const auto& name = nameTable[it->second];
+                for (uint32_t i = 0; i < name.rrsetCount; i++) {
+                    const auto& address = rrsetTable[name.firstRRset + i];
+                    if (address.type != TYPE_A && address.type != TYPE_AAAA) continue;
+                    data.insert(data.end(), data.begin() + address.offset, data.begin() + address.offset + address.length);
+                    entry.additionalCount += address.count;
+                }
+            }
+            entry.additionalLength = Offset32(data.size() - entry.additionalOffset);
+        }
+    }
+
+    for (size_t i = 0; i < zones.size(); i++) {
+        zoneTable[i].apex = nameIndex.at(zones[i].apex);
+        zoneTable[i].negativeOffset = Offset32(data.size());
+        data.insert(data.end(), zones[i].negative.begin(), zones[i].negative.end());
+        zoneTable[i].negativeLength = Offset32(data.size() - zoneTable[i].negativeOffset);
+    }
+
+    zoneimage::Header header{};
+    std::memcpy(header.magic, zoneimage::MAGIC, sizeof(header.magic));
+    header.version = zoneimage::VERSION;
+    header.zoneCount = static_cast<uint32_t>(zoneTable.size());
+    header.nameCount = static_cast<uint32_t>(nameTable.size());
+    header.rrsetCount = static_cast<uint32_t>(rrsetTable.size());
+
+    std::vector<uint8_t> image(sizeof(header));
+    header.zonesOffset = AppendArray(image, zoneTable);
+    header.namesOffset = AppendArray(image, nameTable);
+    header.rrsetsOffset = AppendArray(image, rrsetTable);
+    header.keysOffset = AppendArray(image, keys);
+    header.keysSize = keys.size();
+    header.dataOffset = AppendArray(image, data);
+    header.dataSize = data.size();
+    std::memcpy(image.data(), &header, sizeof(header));
+
+    std::string temporary = output + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size()));
+        if (!out) throw std::runtime_error("Cannot write zone image " + temporary);
+    }
+    if (std::rename(temporary.c_str(), output.c_str()) != 0) {
+        throw std::runtime_error("Cannot replace zone image " + output);
+    }
+
+    stats.zones = zoneTable.size();
+    stats.names = nameTable.size();
+    stats.rrsets = rrsetTable.size();
+    stats.bytes = image.size();
+    return stats;
+}
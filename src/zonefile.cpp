@@ -0,0 +1,155 @@
+#include "zonefile.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+
+static std::string Lower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+    return text;
+}
+
+static bool IsNumber(const std::string& token) {
+    return !token.empty() && token.find_first_not_of("0123456789") == std::string::npos;
+}
+
+ZoneFileReader::ZoneFileReader(std::istream& in, std::string source, std::string origin)
+    : in(in), source(std::move(source)), origin(std::move(origin)) {}
+
+std::runtime_error ZoneFileReader::error(const std::string& reason) const {
+    return std::runtime_error(source + ":" + std::to_string(lineNo) + ": " + reason);
+}
+
+std::string ZoneFileReader::name(const std::string& token) const {
+    std::string result = Lower(token);
+
+    if (result == "@") return origin;
+    if (result == ".") return "";
+    if (!result.empty() && result.back() == '.') {
+        result.pop_back();
+        return result;
+    }
+    return origin.empty() ? result : result + "." + origin;
+}
+
+uint32_t ZoneFileReader::number(const std::string& token) const {
+    if (!IsNumber(token) || token.size() > 10 || std::stoull(token) > UINT32_MAX) {
+        throw error("invalid number " + token);
+    }
+    return static_cast<uint32_t>(std::stoull(token));
+}
+
+/**
+ * Reads the next entry as tokens, joining lines continued with parentheses.
+ * The first token is empty when the entry starts with blank space, meaning
+ * it reuses the previous owner name. Quoted tokens keep their quotes.
+ */
+bool ZoneFileReader::nextEntry(std::vector<std::string>& tokens) {
+    tokens.clear();
+    std::string line;
+    int depth = 0;
+
+    while (std::getline(in, line)) {
+        lineNo++;
+
+        if (tokens.empty() && depth == 0 && !line.empty() && std::isspace(static_cast<unsigned char>(line[0]))) {
+            tokens.push_back("");
+        }
+
+        std::string current;
+        bool quoted = false;
+        auto flush = [&]() {
+            if (!current.empty()) tokens.push_back(std::move(current));
+            current.clear();
+        };
+
+        for (size_t i = 0; i < line.size(); i++) {
+            char c = line[i];
+            if (quoted) {
+                current += c;
+                if (c == '\\' && i + 1 < line.size()) {
+                    current += line[++i];
+                } else if (c == '"') {
+                    quoted = false;
+                    flush();
+                }
+            } else if (c == '"') {
+                flush();
+                current += c;
+                quoted = true;
+            } else if (c == ';') {
+                break;
+            } else if (c == '(') {
+                flush();
+                depth++;
+            } else if (c == ')') {
+                flush();
+                depth--;
+            } else if (std::isspace(static_cast<unsigned char>(c))) {
+                flush();
+            } else {
+                current += c;
+            }
+        }
+        if (quoted) {
+            throw error("unterminated string");
+        }
+        flush();
+
+        if (depth > 0) continue;
+        if (depth < 0) throw error("unbalanced parentheses");
+        if (tokens.size() > 1 || (tokens.size() == 1 && !tokens[0].empty())) return true;
+        tokens.clear();
+    }
+
+    if (depth > 0) {
+        throw error("unbalanced parentheses");
+    }
+    return false;
+}
+
+bool ZoneFileReader::next(ZoneFileRecord& record) {
+    std::vector<std::string> tokens;
+
+    while (nextEntry(tokens)) {
+        if (tokens[0] == "$TTL" && tokens.size() == 2) {
+            defaultTtl = number(tokens[1]);
+            continue;
+        }
+        if (tokens[0] == "$ORIGIN" && tokens.size() == 2) {
+            origin = name(tokens[1]);
+            continue;
+        }
+        if (tokens[0][0] == '$') {
+            throw error("unsupported directive " + tokens[0]);
+        }
+
+        if (!tokens[0].empty()) {
+            owner = name(tokens[0]);
+        }
+
+        // [TTL] [CLASS] TYPE RDATA, TTL and class in either order
+        size_t pos = 1;
+        std::optional<uint32_t> ttl;
+        for (int field = 0; field < 2 && pos < tokens.size(); field++) {
+            if (IsNumber(tokens[pos])) {
+                ttl = number(tokens[pos++]);
+            } else if (Lower(tokens[pos]) == "in") {
+                pos++;
+            }
+        }
+        if (!ttl.has_value()) ttl = defaultTtl.has_value() ? defaultTtl : lastTtl;
+        if (!ttl.has_value()) throw error("record without TTL");
+        lastTtl = ttl;
+
+        if (pos >= tokens.size()) throw error("record without type");
+
+        record.owner = owner;
+        record.ttl = ttl.value();
+        record.type = tokens[pos++];
+        std::transform(record.type.begin(), record.type.end(), record.type.begin(), [](unsigned char c) { return std::toupper(c); });
+        record.rdata.assign(tokens.begin() + pos, tokens.end());
+        return true;
+    }
+    return false;
+}
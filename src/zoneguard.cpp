@@ -0,0 +1,137 @@
+#include "zoneguard.hpp"
+
+#include "utils/log.hpp"
+#include "utils/metrics.hpp"
+#include <cmath>
+#include <sstream>
+
+// Counts lose half of their weight every HALF_LIFE, an attack is noticed within seconds
+constexpr auto HALF_LIFE = std::chrono::seconds(10);
+// Zones without traffic for this long may be forgotten
+constexpr auto IDLE_ZONE = std::chrono::seconds(300);
+
+
+void ZoneGuard::decay(Zone& zone, Clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - zone.updated).count();
+    if (elapsed <= 0) return;
+
+    double factor = std::exp2(-elapsed / std::chrono::duration<double>(HALF_LIFE).count());
+    zone.total *= factor;
+    zone.failed *= factor;
+    zone.updated = now;
+}
+
+// Decays the counts, adds a resolution if told so, and re-evaluates the zone
+void ZoneGuard::update(const std::string& name, Zone& zone, std::optional<bool> failed, Clock::time_point now) {
+    decay(zone, now);
+    if (failed.has_value()) {
+        zone.total += 1;
+        zone.failed += failed.value() ? 1 : 0;
+    }
+
+    bool attacked = zone.total >= MIN_SAMPLES && zone.failed >= ratio * zone.total;
+    if (attacked && !zone.attacked) {
+        DNS_LOG_WARN("Zone " + name + " looks under a random subdomain attack, " + std::to_string(cap) + " queries at once allowed");
+        DNS_METRIC_INC("zoneguard.attacks");
+    } else if (!attacked && zone.attacked) {
+        DNS_LOG_INFO("Zone " + name + " no longer looks under attack");
+    }
+    zone.attacked = attacked;
+}
+
+void ZoneGuard::prune(Clock::time_point now) {
+    if (zones.size() < MAX_ZONES) return;
+
+    for (auto it = zones.begin(); it != zones.end();) {
+        bool idle = it->second.outstanding == 0 && now - it->second.updated > IDLE_ZONE;
+        it = idle ? zones.erase(it) : std::next(it);
+    }
+    // Still full: quiet zones go too
+    for (auto it = zones.begin(); it != zones.end() && zones.size() >= MAX_ZONES;) {
+        bool quiet = it->second.outstanding == 0 && !it->second.attacked;
+        it = quiet ? zones.erase(it) : std::next(it);
+    }
+}
+
+ZoneGuard::Decision ZoneGuard::admit(const std::string& name, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    // Closest enclosing zone known, the root last
+    auto it = zones.find(name);
+    for (size_t dot = name.find('.'); it == zones.end() && dot != std::string::npos; dot = name.find('.', dot + 1)) {
+        it = zones.find(name.substr(dot + 1));
+    }
+    if (it == zones.end()) {
+        it = zones.find("");
+    }
+    if (it == zones.end()) {
+        return {};
+    }
+
+    auto& [zoneName, zone] = *it;
+    update(zoneName, zone, std::nullopt, now);
+
+    if (zone.attacked && zone.outstanding >= cap) {
+        DNS_METRIC_INC("zoneguard.capped");
+        return {Action::REFUSE, std::nullopt};
+    }
+
+    zone.outstanding++;
+    return {Action::ASK, zoneName};
+}
+
+void ZoneGuard::finish(const Decision& decision, std::optional<dnslib::RCODE> rcode, const RecordList& authority, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    Zone* charged = nullptr;
+    if (decision.zone.has_value()) {
+        auto it = zones.find(decision.zone.value());
+        if (it != zones.end()) {
+            charged = &it->second;
+            if (charged->outstanding > 0) charged->outstanding--;
+        }
+    }
+
+    if (rcode == dnslib::RCODE::NAMEERROR) {
+        for (const auto& rec : authority) {
+            auto soa = std::dynamic_pointer_cast<dnslib::SOARecord>(rec);
+            if (!soa) continue;
+
+            // The zone that said NXDOMAIN is the one to watch
+            if (zones.find(soa->getName()) == zones.end()) {
+                prune(now);
+            }
+            auto& zone = zones.try_emplace(soa->getName(), Zone{0, 0, 0, false, now}).first->second;
+            update(soa->getName(), zone, true, now);
+            return;
+        }
+    }
+
+    if (charged != nullptr) {
+        // No answer or a server failure: nothing learnt about the name
+        std::optional<bool> failed;
+        if (rcode == dnslib::RCODE::NOERROR || rcode == dnslib::RCODE::NAMEERROR) {
+            failed = rcode == dnslib::RCODE::NAMEERROR;
+        }
+        update(decision.zone.value(), *charged, failed, now);
+    }
+}
+
+bool ZoneGuard::underAttack(const std::string& zone) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = zones.find(zone);
+    return it != zones.end() && it->second.attacked;
+}
+
+std::string ZoneGuard::toString() const {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::stringstream ss;
+    ss << zones.size() << " zones tracked\n";
+    for (const auto& [name, zone] : zones) {
+        if (!zone.attacked) continue;
+        ss << (name.empty() ? "." : name) << " nxdomain=" << static_cast<int>(100 * zone.failed / zone.total)
+           << "% outstanding=" << zone.outstanding << "\n";
+    }
+    return ss.str();
+}
@@ -0,0 +1,298 @@
+#include "zoneimage.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+// Plain UDP without EDNS
+constexpr size_t MAX_UDP_RESPONSE = 512;
+// Links of a CNAME chain followed inside the image
+constexpr int MAX_CNAME_CHAIN = 8;
+
+constexpr uint16_t TYPE_NS = static_cast<uint16_t>(dnslib::TYPE::NS);
+constexpr uint16_t TYPE_CNAME = static_cast<uint16_t>(dnslib::TYPE::CNAME);
+// Not in dnslib::TYPE
+constexpr uint16_t TYPE_ANY = 255;
+
+struct ZoneImage::Sections {
+    dnslib::RCODE rcode = dnslib::RCODE::NOERROR;
+    bool authoritative = true;
+    std::vector<uint8_t> answer;
+    std::vector<uint8_t> authority;
+    std::vector<uint8_t> additional;
+    uint16_t answerCount = 0;
+    uint16_t authorityCount = 0;
+    uint16_t additionalCount = 0;
+};
+
+static std::runtime_error Corrupt() {
+    return std::runtime_error("Corrupt zone image");
+}
+
+static bool Fits(uint64_t offset, uint64_t length, uint64_t size) {
+    return offset <= size && length <= size - offset;
+}
+
+// Reads an uncompressed name, as the compiler writes them
+static std::string ReadName(const uint8_t* wire, size_t length, size_t& pos) {
+    std::string name;
+    while (pos < length && wire[pos] != 0) {
+        uint8_t label = wire[pos++];
+        if (label > 63 || pos + label > length) throw Corrupt();
+        if (!name.empty()) name += '.';
+        name.append(reinterpret_cast<const char*>(wire + pos), label);
+        pos += label;
+    }
+    if (pos >= length) throw Corrupt();
+    pos++;
+    return name;
+}
+
+ZoneImage::~ZoneImage() {
+    if (base != nullptr) {
+        munmap(const_cast<uint8_t*>(base), size);
+    }
+}
+
+std::shared_ptr<const ZoneImage> ZoneImage::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open zone image " + path + ": " + strerror(errno));
+    }
+
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(zoneimage::Header)) {
+        close(fd);
+        throw std::runtime_error("Zone image " + path + " is too short");
+    }
+
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Cannot map zone image " + path + ": " + strerror(errno));
+    }
+    // Lookups jump around the index, read-ahead would only waste page cache
+    madvise(mapped, info.st_size, MADV_RANDOM);
+
+    std::shared_ptr<ZoneImage> image(new ZoneImage());
+    image->base = static_cast<const uint8_t*>(mapped);
+    image->size = info.st_size;
+    image->header = reinterpret_cast<const zoneimage::Header*>(image->base);
+
+    const auto& header = *image->header;
+    if (std::memcmp(header.magic, zoneimage::MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error(path + " is not a zone image");
+    }
+    if (header.version != zoneimage::VERSION) {
+        throw std::runtime_error("Zone image " + path + " has version " + std::to_string(header.version) + ", expected " + std::to_string(zoneimage::VERSION));
+    }
+
+    bool valid = header.zoneCount > 0
+        && Fits(header.zonesOffset, uint64_t(header.zoneCount) * sizeof(zoneimage::Zone), image->size)
+        && Fits(header.namesOffset, uint64_t(header.nameCount) * sizeof(zoneimage::Name), image->size)
+        && Fits(header.rrsetsOffset, uint64_t(header.rrsetCount) * sizeof(zoneimage::RRset), image->size)
+        && Fits(header.keysOffset, header.keysSize, image->size)
+        && Fits(header.dataOffset, header.dataSize, image->size)
+        && header.zonesOffset % alignof(zoneimage::Zone) == 0
+        && header.namesOffset % alignof(zoneimage::Name) == 0
+        && header.rrsetsOffset % alignof(zoneimage::RRset) == 0;
+    if (!valid) {
+        throw std::runtime_error("Zone image " + path + " is truncated or corrupt");
+    }
+
+    image->zones = reinterpret_cast<const zoneimage::Zone*>(image->base + header.zonesOffset);
+    image->names = reinterpret_cast<const zoneimage::Name*>(image->base + header.namesOffset);
+    image->rrsets = reinterpret_cast<const zoneimage::RRset*>(image->base + header.rrsetsOffset);
+    image->keys = reinterpret_cast<const char*>(image->base + header.keysOffset);
+    image->data = image->base + header.dataOffset;
+    return image;
+}
+
+std::string_view ZoneImage::key(uint32_t name) const {
+    const auto& entry = names[name];
+    if (!Fits(entry.keyOffset, entry.keyLength, header->keysSize)) throw Corrupt();
+    return std::string_view(keys + entry.keyOffset, entry.keyLength);
+}
+
+std::optional<uint32_t> ZoneImage::find(std::string_view wanted) const {
+    uint32_t low = 0;
+    uint32_t high = header->nameCount;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        int order = key(middle).compare(wanted);
+        if (order == 0) return middle;
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return std::nullopt;
+}
+
+const zoneimage::RRset* ZoneImage::findRRset(uint32_t name, uint16_t type) const {
+    const auto& entry = names[name];
+    if (!Fits(entry.firstRRset, entry.rrsetCount, header->rrsetCount)) throw Corrupt();
+
+    for (uint32_t i = 0; i < entry.rrsetCount; i++) {
+        if (rrsets[entry.firstRRset + i].type == type) {
+            return &rrsets[entry.firstRRset + i];
+        }
+    }
+    return nullptr;
+}
+
+void ZoneImage::append(std::vector<uint8_t>& section, uint16_t& count, uint32_t offset, uint32_t length, uint16_t records) const {
+    if (!Fits(offset, length, header->dataSize)) throw Corrupt();
+    section.insert(section.end(), data + offset, data + offset + length);
+    count += records;
+}
+
+/**
+ * Walks from the name up to the closest name the image has, then down from
+ * its zone apex looking for a delegation before answering.
+ *
+ * @return false if the name is in none of the zones
+ */
+bool ZoneImage::lookup(std::string_view name, uint16_t type, Sections& sections, int depth) const {
+    // Suffixes of name, the name itself first and the root last
+    std::vector<std::string_view> suffixes = {name};
+    for (size_t dot = name.find('.'); dot != std::string_view::npos; dot = name.find('.', dot + 1)) {
+        suffixes.push_back(name.substr(dot + 1));
+    }
+    if (!name.empty()) {
+        suffixes.push_back("");
+    }
+
+    size_t closest = 0;
+    std::optional<uint32_t> found;
+    for (; closest < suffixes.size() && !found.has_value(); closest++) {
+        found = find(suffixes[closest]);
+    }
+    if (!found.has_value()) {
+        return false;
+    }
+    closest--;
+
+    uint32_t zoneIndex = names[found.value()].zone;
+    if (zoneIndex >= header->zoneCount) throw Corrupt();
+    const auto& zone = zones[zoneIndex];
+    if (zone.apex >= header->nameCount) throw Corrupt();
+    size_t apexLength = key(zone.apex).size();
+
+    // A delegation between the apex and the name sends the client to the child zone
+    for (size_t i = suffixes.size(); i-- > closest;) {
+        if (suffixes[i].size() <= apexLength) continue;
+
+        auto cut = find(suffixes[i]);
+        if (!cut.has_value()) continue;
+
+        const auto* ns = findRRset(cut.value(), TYPE_NS);
+        if (ns == nullptr) continue;
+
+        if (sections.answerCount == 0) {
+            sections.authoritative = false;
+        }
+        append(sections.authority, sections.authorityCount, ns->offset, ns->length, ns->count);
+        append(sections.additional, sections.additionalCount, ns->additionalOffset, ns->additionalLength, ns->additionalCount);
+        return true;
+    }
+
+    if (closest != 0) {
+        sections.rcode = dnslib::RCODE::NAMEERROR;
+        append(sections.authority, sections.authorityCount, zone.negativeOffset, zone.negativeLength, 1);
+        return true;
+    }
+
+    const auto& entry = names[found.value()];
+    if (!Fits(entry.firstRRset, entry.rrsetCount, header->rrsetCount)) throw Corrupt();
+    if (type == TYPE_ANY && entry.rrsetCount > 0) {
+        for (uint32_t i = 0; i < entry.rrsetCount; i++) {
+            const auto& rrset = rrsets[entry.firstRRset + i];
+            append(sections.answer, sections.answerCount, rrset.offset, rrset.length, rrset.count);
+        }
+        return true;
+    }
+
+    if (const auto* rrset = findRRset(found.value(), type)) {
+        append(sections.answer, sections.answerCount, rrset->offset, rrset->length, rrset->count);
+        append(sections.additional, sections.additionalCount, rrset->additionalOffset, rrset->additionalLength, rrset->additionalCount);
+        return true;
+    }
+
+    if (const auto* cname = findRRset(found.value(), TYPE_CNAME)) {
+        append(sections.answer, sections.answerCount, cname->offset, cname->length, cname->count);
+        if (depth >= MAX_CNAME_CHAIN) return true;
+
+        // Owner, type, class, TTL and RDLENGTH come before the target
+        if (!Fits(cname->offset, cname->length, header->dataSize)) throw Corrupt();
+        const uint8_t* record = data + cname->offset;
+        size_t pos = 0;
+        ReadName(record, cname->length, pos);
+        pos += 10;
+        std::string target = ReadName(record, cname->length, pos);
+
+        // Targets outside of the image are left to the client to resolve
+        lookup(target, type, sections, depth + 1);
+        return true;
+    }
+
+    // NODATA
+    append(sections.authority, sections.authorityCount, zone.negativeOffset, zone.negativeLength, 1);
+    return true;
+}
+
+bool ZoneImage::answer(const std::string& name, dnslib::TYPE type, uint16_t id, bool recursionDesired, std::vector<uint8_t>& response) const {
+    std::string wanted = name;
+    std::transform(wanted.begin(), wanted.end(), wanted.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (!wanted.empty() && wanted.back() == '.') wanted.pop_back();
+
+    Sections sections;
+    if (!lookup(wanted, static_cast<uint16_t>(type), sections, 0)) {
+        return false;
+    }
+
+    std::vector<uint8_t> question;
+    dnslib::utils::writeDomain(question, name);
+    dnslib::utils::writeU16(question, static_cast<uint16_t>(type));
+    dnslib::utils::writeU16(question, 1);
+
+    // Glue goes first, then everything: the client retries over TCP on TC
+    size_t length = 12 + question.size() + sections.answer.size() + sections.authority.size();
+    bool truncated = false;
+    if (length + sections.additional.size() > MAX_UDP_RESPONSE) {
+        sections.additional.clear();
+        sections.additionalCount = 0;
+    }
+    if (length > MAX_UDP_RESPONSE) {
+        truncated = true;
+        sections.answer.clear();
+        sections.authority.clear();
+        sections.answerCount = 0;
+        sections.authorityCount = 0;
+    }
+
+    uint16_t flags = 0x8000 | 0x0080 | static_cast<uint16_t>(sections.rcode);
+    if (sections.authoritative) flags |= 0x0400;
+    if (truncated) flags |= 0x0200;
+    if (recursionDesired) flags |= 0x0100;
+
+    response.clear();
+    response.reserve(length + sections.additional.size());
+    dnslib::utils::writeU16(response, id);
+    dnslib::utils::writeU16(response, flags);
+    dnslib::utils::writeU16(response, 1);
+    dnslib::utils::writeU16(response, sections.answerCount);
+    dnslib::utils::writeU16(response, sections.authorityCount);
+    dnslib::utils::writeU16(response, sections.additionalCount);
+    response.insert(response.end(), question.begin(), question.end());
+    response.insert(response.end(), sections.answer.begin(), sections.answer.end());
+    response.insert(response.end(), sections.authority.begin(), sections.authority.end());
+    response.insert(response.end(), sections.additional.begin(), sections.additional.end());
+    return true;
+}
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include "cache.hpp"
+#include "ResolverHarness.hpp"
+#include "utils/metrics.hpp"
+
+static std::shared_ptr<RecordList> Address(const std::string& name, uint32_t address) {
+    return std::make_shared<RecordList>(RecordList{std::make_shared<dnslib::ARecord>(name, 300, address)});
+}
+
+static uint32_t AddressOf(const RecordList& records) {
+    auto a_rec = std::dynamic_pointer_cast<dnslib::ARecord>(records.at(0));
+    return a_rec ? a_rec->getIpAddress() : 0;
+}
+
+TEST(CacheTrustTest, LowerRanksNeverReplaceFreshData) {
+    TLRUCache cache(10);
+    cacheKey key{"ns.example.com", dnslib::TYPE::A};
+
+    // Glue is only for finding servers
+    EXPECT_TRUE(cache.put(key, Address("ns.example.com", 1), 300, Security::UNCHECKED, Trust::GLUE));
+    EXPECT_FALSE(cache.get(key).has_value());
+    ASSERT_TRUE(cache.get(key, nullptr, Trust::GLUE).has_value());
+    EXPECT_FALSE(cache.getStale(key).has_value());
+
+    EXPECT_TRUE(cache.put(key, Address("ns.example.com", 2), 300, Security::UNCHECKED, Trust::AUTHORITATIVE));
+    EXPECT_FALSE(cache.put(key, Address("ns.example.com", 3), 300, Security::UNCHECKED, Trust::ANSWER));
+    EXPECT_FALSE(cache.put(key, Address("ns.example.com", 4), 300, Security::UNCHECKED, Trust::GLUE));
+    EXPECT_EQ(AddressOf(*cache.get(key).value()), 2u);
+
+    // Once expired anything may take the place
+    EXPECT_TRUE(cache.put(key, Address("ns.example.com", 5), 0, Security::UNCHECKED, Trust::AUTHORITATIVE));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    EXPECT_TRUE(cache.put(key, Address("ns.example.com", 6), 300, Security::UNCHECKED, Trust::GLUE));
+    EXPECT_EQ(AddressOf(*cache.get(key, nullptr, Trust::GLUE).value()), 6u);
+}
+
+// Iterative resolution against servers that hand out data about zones they do not serve
+class BailiwickTest : public ResolverHarness {
+protected:
+    const uint32_t exampleServer = 0xC0000235;  // 192.0.2.53
+    const uint32_t victimServer = 0xC0000236;   // 192.0.2.54
+    const uint32_t victimAddress = 0xC0000250;  // 192.0.2.80
+    const uint32_t forged = 0x06060606;
+
+    void SetUp() override {
+        start();
+    }
+
+    static void refer(dnslib::PacketBuilder& builder, const std::string& zone, uint32_t server) {
+        builder.addAuthority(std::make_shared<dnslib::NSRecord>(zone, 3600, "ns." + zone));
+        builder.addAdditional(std::make_shared<dnslib::ARecord>("ns." + zone, 3600, server));
+    }
+
+    // The example.com server slips a victim.net address into its answer and refers a subzone to victim.net
+    void serve(const dnslib::DNSMessageL& query) override {
+        auto packet = dnslib::PacketParser::parse(query.data);
+        auto question = packet.getQuestions()[0];
+        const std::string& name = question.getName();
+        uint32_t server = serverOf(query);
+
+        dnslib::PacketBuilder builder;
+        builder.setId(packet.getHeader().getId());
+        builder.addQuestion(name, question.getType());
+        if (server == root) {
+            builder.withFlags(dnslib::PacketFlag::RESPONSE);
+            bool victim = name.size() >= 10 && name.compare(name.size() - 10, 10, "victim.net") == 0;
+            refer(builder, victim ? "victim.net" : "example.com", victim ? victimServer : exampleServer);
+        } else if (server == exampleServer && name == "www.example.com") {
+            builder.withFlags(dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::AUTHORITATIVE);
+            builder.addAnswer(std::make_shared<dnslib::CNAMERecord>(name, 300, "www.victim.net"));
+            builder.addAnswer(std::make_shared<dnslib::ARecord>("www.victim.net", 86400, forged));
+        } else if (server == exampleServer) {
+            builder.withFlags(dnslib::PacketFlag::RESPONSE);
+            refer(builder, "victim.net", forged);
+        } else {
+            builder.withFlags(dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::AUTHORITATIVE);
+            builder.addAnswer(std::make_shared<dnslib::ARecord>(name, 300, victimAddress));
+        }
+        reply(query, builder);
+    }
+
+    // Plays the servers until the client response is out, records where the queries went
+    std::optional<dnslib::DNSPacket> run(std::vector<uint32_t>& servers) {
+        std::vector<dnslib::DNSMessageL> queries;
+        auto responses = ResolverHarness::run(1, queries);
+        for (const auto& query : queries) {
+            servers.push_back(serverOf(query));
+        }
+        if (responses.empty()) return std::nullopt;
+        return responses[0];
+    }
+};
+
+TEST_F(BailiwickTest, AnswersForOtherZonesAreAskedForAgain) {
+    auto& dropped = utils::Metrics::get().counter("cache.out_of_bailiwick");
+    uint64_t before = dropped.load();
+
+    ask(0x3001, "www.example.com");
+    std::vector<uint32_t> servers;
+    auto response = run(servers);
+    ASSERT_TRUE(response.has_value());
+
+    // The forged address is ignored, the chain is chased at the victim.net server
+    EXPECT_EQ(servers, (std::vector<uint32_t>{root, exampleServer, root, victimServer}));
+    auto answers = response->getAnswers();
+    ASSERT_EQ(answers.size(), 2u);
+    auto a_rec = std::dynamic_pointer_cast<dnslib::ARecord>(answers[1]);
+    ASSERT_TRUE(a_rec);
+    EXPECT_EQ(a_rec->getIpAddress(), victimAddress);
+    EXPECT_EQ(dropped.load(), before + 1);
+
+    auto cached = cache.get({"www.victim.net", dnslib::TYPE::A});
+    ASSERT_TRUE(cached.has_value());
+    EXPECT_EQ(AddressOf(*cached.value()), victimAddress);
+}
+
+TEST_F(BailiwickTest, ReferralsOutsideTheZoneFail) {
+    ask(0x3002, "sub.example.com");
+    std::vector<uint32_t> servers;
+    auto response = run(servers);
+    ASSERT_TRUE(response.has_value());
+
+    EXPECT_EQ(response->getHeader().rcode(), dnslib::RCODE::SERVERFAILURE);
+    EXPECT_EQ(servers, (std::vector<uint32_t>{root, exampleServer}));
+    // Neither the forged glue nor the glue from the root is handed to clients
+    EXPECT_FALSE(cache.get({"ns.victim.net", dnslib::TYPE::A}, nullptr, Trust::GLUE).has_value());
+    EXPECT_FALSE(cache.get({"ns.example.com", dnslib::TYPE::A}).has_value());
+    EXPECT_TRUE(cache.get({"ns.example.com", dnslib::TYPE::A}, nullptr, Trust::GLUE).has_value());
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include "blocklist.hpp"
+
+static std::shared_ptr<const Blocklist> Build(const std::vector<std::string>& rules) {
+    Blocklist::Builder builder;
+    for (const auto& rule : rules) {
+        EXPECT_TRUE(builder.add(rule)) << rule;
+    }
+    return builder.build();
+}
+
+TEST(BlocklistTest, ExactRulesOnlyMatchTheName) {
+    auto list = Build({"ads.example.com"});
+
+    EXPECT_TRUE(list->blocked("ads.example.com"));
+    EXPECT_FALSE(list->blocked("example.com"));
+    EXPECT_FALSE(list->blocked("www.ads.example.com"));
+    EXPECT_FALSE(list->blocked("ads.example.org"));
+    EXPECT_EQ(list->exactCount(), 1u);
+}
+
+TEST(BlocklistTest, SubtreeRulesMatchTheNameAndBelow) {
+    auto list = Build({"*.tracker.net"});
+
+    EXPECT_TRUE(list->blocked("tracker.net"));
+    EXPECT_TRUE(list->blocked("a.b.tracker.net"));
+    EXPECT_FALSE(list->blocked("net"));
+    EXPECT_FALSE(list->blocked("mytracker.net"));
+    EXPECT_EQ(list->subtreeCount(), 1u);
+}
+
+TEST(BlocklistTest, IgnoresCaseAndTrailingDot) {
+    auto list = Build({"Ads.Example.COM."});
+
+    EXPECT_TRUE(list->blocked("ads.example.com"));
+    EXPECT_TRUE(list->blocked("ADS.EXAMPLE.COM."));
+}
+
+TEST(BlocklistTest, MergedEdgesSplitWhereRulesBranch) {
+    auto list = Build({"a.b.c.example", "b.c.example", "x.c.example", "deep.one.two.three.example", "*.three.example"});
+
+    EXPECT_TRUE(list->blocked("a.b.c.example"));
+    EXPECT_TRUE(list->blocked("b.c.example"));
+    EXPECT_TRUE(list->blocked("x.c.example"));
+    EXPECT_FALSE(list->blocked("c.example"));
+    EXPECT_FALSE(list->blocked("z.b.c.example"));
+    EXPECT_FALSE(list->blocked("one.two.example"));
+    EXPECT_TRUE(list->blocked("two.three.example"));
+    EXPECT_FALSE(list->blocked("example"));
+}
+
+TEST(BlocklistTest, RejectsMalformedNames) {
+    Blocklist::Builder builder;
+    EXPECT_FALSE(builder.add(""));
+    EXPECT_FALSE(builder.add("a..example"));
+    EXPECT_FALSE(builder.add("bad name.example"));
+    EXPECT_FALSE(builder.add(std::string(64, 'a') + ".example"));
+    EXPECT_TRUE(builder.add("under_score.example"));
+}
+
+TEST(BlocklistTest, LoadsPlainAndHostsFormats) {
+    std::string path = testing::TempDir() + "blocklist.txt";
+    std::ofstream(path) << "# comment\n"
+                           "ads.example.com\n"
+                           "*.tracker.net   # trailing comment\n"
+                           "0.0.0.0 localhost\n"
+                           "0.0.0.0 ads.example.org ads2.example.org\n"
+                           ":: ipv6.example\n"
+                           "bad..name\n";
+
+    size_t skipped = 0;
+    auto list = Blocklist::load({path}, skipped);
+    std::remove(path.c_str());
+
+    EXPECT_EQ(list->size(), 5u);
+    EXPECT_EQ(skipped, 1u);
+    EXPECT_TRUE(list->blocked("ads2.example.org"));
+    EXPECT_TRUE(list->blocked("ipv6.example"));
+    EXPECT_FALSE(list->blocked("localhost"));
+    EXPECT_GT(list->memoryUsage(), 0u);
+
+    EXPECT_THROW(Blocklist::load({path}, skipped), std::runtime_error);
+}
+
+TEST(BlocklistTest, ManyRulesStayCompact) {
+    Blocklist::Builder builder;
+    for (int i = 0; i < 20000; i++) {
+        builder.add("host" + std::to_string(i) + ".ads" + std::to_string(i % 50) + ".example");
+    }
+    auto list = builder.build();
+
+    EXPECT_EQ(list->size(), 20000u);
+    EXPECT_TRUE(list->blocked("host1234.ads34.example"));
+    EXPECT_FALSE(list->blocked("host1234.ads35.example"));
+    EXPECT_FALSE(list->blocked("host20000.ads0.example"));
+    EXPECT_LT(list->memoryUsage() / list->size(), 64u);
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <bit>
+#include <thread>
+#include "cache.hpp"
+
+static cacheKey Key(size_t i) {
+    return {"host" + std::to_string(i) + ".example.com", dnslib::TYPE::A};
+}
+
+static std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>> Records(size_t i) {
+    auto records = std::make_shared<std::vector<std::shared_ptr<dnslib::ResourceRecord>>>();
+    records->push_back(std::make_shared<dnslib::ARecord>(Key(i).name, 300, static_cast<uint32_t>(i)));
+    return records;
+}
+
+TEST(ShardedCacheTest, ShardCountFollowsTheCapacity) {
+    EXPECT_EQ(TLRUCache(100, 16).shardCount(), 1u);
+    EXPECT_EQ(TLRUCache(10000, 8).shardCount(), 8u);
+    EXPECT_EQ(TLRUCache(10000, 5).shardCount(), 8u);
+    EXPECT_EQ(TLRUCache(1000000, 1000).shardCount(), TLRUCache::MAX_SHARDS);
+    EXPECT_GE(TLRUCache(1000000).shardCount(), 1u);
+}
+
+TEST(ShardedCacheTest, ShardsNeverFallBelowTheMinimumCapacity) {
+    // 15 shards would fit, rounding up to 16 would leave 63 entries each
+    EXPECT_EQ(TLRUCache(1000, 16).shardCount(), 8u);
+    EXPECT_EQ(TLRUCache(1000, 15).shardCount(), 8u);
+    for (int capacity : {64, 127, 1000, 4095, 100000}) {
+        for (size_t shards : {0, 1, 3, 16, 1000}) {
+            TLRUCache cache(capacity, shards);
+            EXPECT_EQ(std::popcount(cache.shardCount()), 1) << capacity << " " << shards;
+            EXPECT_GE(capacity / cache.shardCount(), TLRUCache::MIN_SHARD_CAPACITY) << capacity << " " << shards;
+        }
+    }
+}
+
+TEST(ShardedCacheTest, EveryShardKeepsItsShareOfTheCapacity) {
+    TLRUCache cache(1024, 4);
+    ASSERT_EQ(cache.shardCount(), 4u);
+    for (size_t i = 0; i < 5000; i++) {
+        cache.put(Key(i), Records(i), 300);
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < 5000; i++) {
+        kept += cache.get(Key(i)).has_value() ? 1 : 0;
+    }
+    EXPECT_LE(kept, 1024u);
+    EXPECT_GT(kept, 900u);
+    EXPECT_TRUE(cache.get(Key(4999)).has_value());
+    EXPECT_FALSE(cache.get(Key(0)).has_value());
+}
+
+TEST(ShardedCacheTest, ThreadsShareTheCache) {
+    TLRUCache cache(100000, 8);
+    constexpr size_t THREADS = 4;
+    constexpr size_t KEYS = 5000;
+
+    std::atomic<size_t> misses = 0;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < THREADS; t++) {
+        threads.emplace_back([&, t] {
+            for (size_t i = t * KEYS; i < (t + 1) * KEYS; i++) {
+                cache.put(Key(i), Records(i), 300);
+                // Keys of the other threads are read while they are written
+                cache.get(Key((i + KEYS) % (THREADS * KEYS)));
+                if (!cache.get(Key(i)).has_value()) misses++;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(misses.load(), 0u);
+    for (size_t i = 0; i < THREADS * KEYS; i++) {
+        auto records = cache.get(Key(i));
+        ASSERT_TRUE(records.has_value());
+        EXPECT_EQ(std::dynamic_pointer_cast<dnslib::ARecord>(records.value()->front())->getIpAddress(), i);
+    }
+}
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include <map>
+#include "ResolverHarness.hpp"
+
+// A forwarder whose upstream answers every name with the records listed
+// for it, so chains that leave the answering zone are chased link by link
+class CnameChainTest : public ResolverHarness {
+protected:
+    const sockaddr_in upstream = Addr("127.0.0.1", 5301);
+    std::map<std::string, RecordList> data;
+
+    void SetUp() override {
+        config.forwarders = {upstream};
+        config.hedgePercentile = 0;
+        config.healthInterval = 3600;
+        start();
+    }
+
+    void link(const std::string& name, const std::string& target, uint32_t ttl) {
+        data[name].push_back(std::make_shared<dnslib::CNAMERecord>(name, ttl, target));
+    }
+
+    void address(const std::string& owner, const std::string& name, uint32_t ttl) {
+        data[owner].push_back(std::make_shared<dnslib::ARecord>(name, ttl, "192.0.2.1"));
+    }
+
+    void serve(const dnslib::DNSMessageL& query) override {
+        auto packet = dnslib::PacketParser::parse(query.data);
+        auto question = packet.getQuestions()[0];
+
+        dnslib::PacketBuilder builder;
+        builder.setId(packet.getHeader().getId());
+        builder.withFlags(dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::RECURSION_DES | dnslib::PacketFlag::RECURSION_AVAIL);
+        builder.addQuestion(question.getName(), question.getType());
+        for (const auto& rec : data[question.getName()]) {
+            builder.addAnswer(rec);
+        }
+        reply(query, builder);
+    }
+
+    // Seconds the cache keeps key for, 0 if it is not cached
+    uint32_t cachedFor(const cacheKey& key) {
+        auto expires = std::chrono::steady_clock::time_point::max();
+        if (!cache.get(key, nullptr, Trust::ANSWER, &expires).has_value()) return 0;
+        return static_cast<uint32_t>(std::chrono::ceil<std::chrono::seconds>(expires - std::chrono::steady_clock::now()).count());
+    }
+
+    std::vector<std::string> askedNames(const std::vector<dnslib::DNSMessageL>& queries) {
+        std::vector<std::string> names;
+        for (const auto& query : queries) {
+            names.push_back(questionOf(query).getName());
+        }
+        return names;
+    }
+};
+
+TEST_F(CnameChainTest, ChainsLeavingTheZoneAreChasedAndEveryLinkIsCached) {
+    // Each zone only knows its own link
+    link("www.example.com", "cdn.example.net", 300);
+    link("cdn.example.net", "edge.example.org", 60);
+    address("edge.example.org", "edge.example.org", 30);
+
+    ask(0x2801, "www.example.com");
+    std::vector<dnslib::DNSMessageL> queries;
+    auto responses = run(1, queries);
+    ASSERT_EQ(responses.size(), 1u);
+    EXPECT_EQ(askedNames(queries), (std::vector<std::string>{"www.example.com", "cdn.example.net", "edge.example.org"}));
+
+    auto answers = responses[0].getAnswers();
+    ASSERT_EQ(answers.size(), 3u);
+    EXPECT_EQ(answers[0]->getName(), "www.example.com");
+    EXPECT_EQ(answers[1]->getName(), "cdn.example.net");
+    EXPECT_EQ(answers[2]->getType(), static_cast<uint16_t>(dnslib::TYPE::A));
+
+    EXPECT_EQ(cachedFor({"www.example.com", dnslib::TYPE::CNAME}), 300u);
+    EXPECT_EQ(cachedFor({"cdn.example.net", dnslib::TYPE::CNAME}), 60u);
+    EXPECT_EQ(cachedFor({"edge.example.org", dnslib::TYPE::A}), 30u);
+}
+
+TEST_F(CnameChainTest, LaterQueriesOnlyAskForWhatIsNotCached) {
+    link("cdn.example.net", "edge.example.org", 300);
+    address("cdn.example.net", "edge.example.org", 300);
+    link("alias.example.com", "cdn.example.net", 300);
+
+    ask(0x2802, "cdn.example.net");
+    std::vector<dnslib::DNSMessageL> queries;
+    ASSERT_EQ(run(1, queries).size(), 1u);
+    ASSERT_EQ(queries.size(), 1u);
+
+    // Only the new first link is asked for, the rest comes from the cache
+    ask(0x2803, "alias.example.com");
+    queries.clear();
+    auto responses = run(1, queries);
+    ASSERT_EQ(responses.size(), 1u);
+    EXPECT_EQ(askedNames(queries), (std::vector<std::string>{"alias.example.com"}));
+    ASSERT_EQ(responses[0].getAnswers().size(), 3u);
+
+    // Entirely from the cache
+    ask(0x2804, "alias.example.com");
+    queries.clear();
+    responses = run(1, queries);
+    ASSERT_EQ(responses.size(), 1u);
+    EXPECT_TRUE(queries.empty());
+    EXPECT_EQ(responses[0].getAnswers().size(), 3u);
+}
+
+TEST_F(CnameChainTest, LoopAcrossZonesIsServfail) {
+    link("loop.example.com", "loop.example.net", 300);
+    link("loop.example.net", "loop.example.com", 300);
+
+    ask(0x2805, "loop.example.com");
+    std::vector<dnslib::DNSMessageL> queries;
+    auto responses = run(1, queries);
+    ASSERT_EQ(responses.size(), 1u);
+    EXPECT_EQ(responses[0].getHeader().rcode(), dnslib::RCODE::SERVERFAILURE);
+    EXPECT_EQ(queries.size(), 2u);
+    EXPECT_TRUE(idle());
+}
+
+TEST_F(CnameChainTest, OverlongChainIsServfail) {
+    // Twelve zones in a row, each pointing to the next
+    for (int i = 0; i < 12; i++) {
+        link("hop" + std::to_string(i) + ".example", "hop" + std::to_string(i + 1) + ".example", 300);
+    }
+    address("hop12.example", "hop12.example", 300);
+
+    ask(0x2806, "hop0.example");
+    std::vector<dnslib::DNSMessageL> queries;
+    auto responses = run(1, queries);
+    ASSERT_EQ(responses.size(), 1u);
+    EXPECT_EQ(responses[0].getHeader().rcode(), dnslib::RCODE::SERVERFAILURE);
+    EXPECT_LE(queries.size(), 8u);
+    EXPECT_TRUE(idle());
+
+    // Also when a single answer holds the whole chain
+    for (int i = 0; i < 12; i++) {
+        data["long0.example"].push_back(std::make_shared<dnslib::CNAMERecord>(
+            "long" + std::to_string(i) + ".example", 300, "long" + std::to_string(i + 1) + ".example"));
+    }
+    ask(0x2807, "long0.example");
+    queries.clear();
+    responses = run(1, queries);
+    ASSERT_EQ(responses.size(), 1u);
+    EXPECT_EQ(responses[0].getHeader().rcode(), dnslib::RCODE::SERVERFAILURE);
+    EXPECT_EQ(queries.size(), 1u);
+}
@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+#include "pairing.hpp"
+#include "ResolverHarness.hpp"
+#include "utils/metrics.hpp"
+
+using namespace std::chrono_literals;
+
+constexpr uint32_t CLIENT = 0x7F000001;
+
+TEST(PairingTest, NewClientsGetSiblingFetchesUntilTheyProveSingleStack) {
+    PairingTracker tracker(0.5);
+    auto now = PairingTracker::Clock::now();
+
+    EXPECT_TRUE(tracker.observe(CLIENT, "a.example.com", dnslib::TYPE::A, now));
+    for (int i = 0; i < 10; i++) {
+        tracker.observe(CLIENT, "host" + std::to_string(i) + ".example.com", dnslib::TYPE::A, now);
+    }
+    EXPECT_LT(tracker.rate(CLIENT), 0.2);
+    EXPECT_FALSE(tracker.observe(CLIENT, "b.example.com", dnslib::TYPE::A, now));
+
+    // Other types are not tracked, other clients start afresh
+    EXPECT_FALSE(tracker.observe(CLIENT, "example.com", dnslib::TYPE::MX, now));
+    EXPECT_TRUE(tracker.observe(CLIENT + 1, "b.example.com", dnslib::TYPE::A, now));
+}
+
+TEST(PairingTest, PairsRaiseTheRateAndTheirSecondHalfFetchesNothing) {
+    PairingTracker tracker(0.8);
+    auto now = PairingTracker::Clock::now();
+
+    for (int i = 0; i < 10; i++) {
+        std::string name = "host" + std::to_string(i) + ".example.com";
+        tracker.observe(CLIENT, name, dnslib::TYPE::AAAA, now);
+        EXPECT_FALSE(tracker.observe(CLIENT, name, dnslib::TYPE::A, now + 10ms));
+    }
+    EXPECT_GT(tracker.rate(CLIENT), 0.9);
+    EXPECT_TRUE(tracker.observe(CLIENT, "next.example.com", dnslib::TYPE::A, now));
+
+    // Too late to be the same lookup
+    tracker.observe(CLIENT, "late.example.com", dnslib::TYPE::A, now);
+    EXPECT_TRUE(tracker.observe(CLIENT, "late.example.com", dnslib::TYPE::AAAA, now + 10s));
+}
+
+// Iterative resolution with sibling fetches, the test plays the root and the example.com servers
+class CompanionFetchTest : public ResolverHarness {
+protected:
+    const uint32_t zoneServer = 0xC0000235;     // 192.0.2.53
+
+    void SetUp() override {
+        config.companionFetch = true;
+        start();
+    }
+
+    // The root refers example.com to its server, which has the address records
+    void serve(const dnslib::DNSMessageL& query) override {
+        auto packet = dnslib::PacketParser::parse(query.data);
+        auto question = packet.getQuestions()[0];
+
+        dnslib::PacketBuilder builder;
+        builder.setId(packet.getHeader().getId());
+        builder.withFlags(dnslib::PacketFlag::RESPONSE);
+        builder.addQuestion(question.getName(), question.getType());
+        if (serverOf(query) == root) {
+            builder.addAuthority(std::make_shared<dnslib::NSRecord>("example.com", 3600, "ns.example.com"));
+            builder.addAdditional(std::make_shared<dnslib::ARecord>("ns.example.com", 3600, zoneServer));
+        } else if (question.getType() == dnslib::TYPE::A) {
+            builder.addAnswer(std::make_shared<dnslib::ARecord>(question.getName(), 300, "192.0.2.1"));
+        } else {
+            std::vector<uint8_t> address(16, 0);
+            address[0] = 0x20;
+            address[1] = 0x01;
+            address[15] = 1;
+            builder.addAnswer(std::make_shared<dnslib::UnknownRecord>(question.getName(), 28, 300, address));
+        }
+        reply(query, builder);
+    }
+};
+
+TEST_F(CompanionFetchTest, SiblingIsFetchedFromTheSameServersAndAnsweredFromTheCache) {
+    auto& fetches = utils::Metrics::get().counter("companion.fetches");
+    uint64_t before = fetches.load();
+
+    ask(0x1001, "www.example.com", dnslib::TYPE::A);
+    std::vector<dnslib::DNSMessageL> queries;
+    auto responses = run(1, queries);
+    ASSERT_EQ(responses.size(), 1u);
+    EXPECT_EQ(responses[0].getAnswers().size(), 1u);
+    dnslib::DNSMessageL message;
+    while (out.popFor(message, std::chrono::milliseconds(200))) {
+        ASSERT_TRUE(isQuery(message));
+        queries.push_back(message);
+        serve(message);
+    }
+
+    // The AAAA query goes straight to the example.com server, no second walk from the root
+    ASSERT_EQ(queries.size(), 3u);
+    EXPECT_EQ(serverOf(queries[2]), zoneServer);
+    EXPECT_EQ(questionOf(queries[2]).getType(), dnslib::TYPE::AAAA);
+    EXPECT_EQ(fetches.load(), before + 1);
+
+    ask(0x1002, "www.example.com", dnslib::TYPE::AAAA);
+    responses = run(1, queries);
+    ASSERT_EQ(responses.size(), 1u);
+    ASSERT_EQ(responses[0].getAnswers().size(), 1u);
+    EXPECT_EQ(responses[0].getAnswers()[0]->getType(), 28);
+    EXPECT_EQ(queries.size(), 3u);
+    EXPECT_TRUE(idle(std::chrono::milliseconds(50)));
+}
+
+TEST_F(CompanionFetchTest, SiblingAskedMeanwhileWaitsForTheFetch) {
+    auto& joined = utils::Metrics::get().counter("companion.joined");
+    uint64_t before = joined.load();
+
+    // A dual-stack stub sends both before any answer
+    ask(0x2001, "mail.example.com", dnslib::TYPE::A);
+    ask(0x2002, "mail.example.com", dnslib::TYPE::AAAA);
+
+    std::vector<dnslib::DNSMessageL> queries;
+    auto responses = run(2, queries);
+    ASSERT_EQ(responses.size(), 2u);
+    for (const auto& response : responses) {
+        EXPECT_EQ(response.getAnswers().size(), 1u);
+    }
+
+    // One walk: root, then A and AAAA at the example.com server
+    ASSERT_EQ(queries.size(), 3u);
+    EXPECT_EQ(serverOf(queries[0]), root);
+    EXPECT_EQ(serverOf(queries[2]), zoneServer);
+    EXPECT_EQ(joined.load(), before + 1);
+    EXPECT_TRUE(idle(std::chrono::milliseconds(50)));
+}
+
+// As the resolver workers do: resolutions spawned from the batch start once it is handled
+static utils::Task<void> HandleBatch(Resolver& resolver, std::vector<dnslib::DNSMessageL> batch) {
+    resolver.handleBatch(batch);
+    co_return;
+}
+
+TEST_F(CompanionFetchTest, TwoClientsAskingOneTypeEachDoNotWaitForEachOther) {
+    // Single-stack stubs asking the same name in one batch
+    auto first = query(0x3001, "both.example.com", dnslib::TYPE::A);
+    auto second = query(0x3002, "both.example.com", dnslib::TYPE::AAAA);
+    second.peerAddress = Addr("127.0.0.2", 40000);
+    utils::spawn(executor, HandleBatch(*resolver, {first, second}));
+
+    std::vector<dnslib::DNSMessageL> queries;
+    auto responses = run(2, queries);
+    ASSERT_EQ(responses.size(), 2u);
+    for (const auto& response : responses) {
+        EXPECT_EQ(response.getAnswers().size(), 1u);
+    }
+    EXPECT_EQ(queries.size(), 3u);
+
+    // Nothing is left pending for the name
+    ask(0x3003, "both.example.com", dnslib::TYPE::AAAA);
+    responses = run(1, queries);
+    ASSERT_EQ(responses.size(), 1u);
+    EXPECT_EQ(responses[0].getAnswers().size(), 1u);
+}
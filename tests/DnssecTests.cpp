@@ -0,0 +1,441 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <openssl/core_names.h>
+#include <openssl/ecdsa.h>
+#include <openssl/evp.h>
+#include "dnssec.hpp"
+#include "ResolverHarness.hpp"
+#include "utils/metrics.hpp"
+
+// Test zones are signed here with freshly generated keys, the validator
+// sees them the way an upstream would send them
+
+constexpr uint8_t RSASHA256 = 8;
+constexpr uint8_t ECDSAP256SHA256 = 13;
+constexpr uint8_t ED25519 = 15;
+
+struct TestKey {
+    std::shared_ptr<EVP_PKEY> pkey;
+    std::shared_ptr<dnslib::DNSKEYRecord> dnskey;
+};
+
+static std::vector<uint8_t> Bignum(EVP_PKEY* pkey, const char* name) {
+    BIGNUM* bn = nullptr;
+    EVP_PKEY_get_bn_param(pkey, name, &bn);
+    std::vector<uint8_t> bytes(BN_num_bytes(bn));
+    BN_bn2bin(bn, bytes.data());
+    BN_free(bn);
+    return bytes;
+}
+
+static TestKey MakeKey(const std::string& zone, uint8_t algorithm, uint16_t flags = dnslib::DNSKEYRecord::ZONE_KEY) {
+    EVP_PKEY* pkey = nullptr;
+    std::vector<uint8_t> publicKey;
+
+    if (algorithm == ED25519) {
+        pkey = EVP_PKEY_Q_keygen(nullptr, nullptr, "ED25519");
+        size_t length = 32;
+        publicKey.resize(length);
+        EVP_PKEY_get_raw_public_key(pkey, publicKey.data(), &length);
+    } else if (algorithm == ECDSAP256SHA256) {
+        pkey = EVP_PKEY_Q_keygen(nullptr, nullptr, "EC", "P-256");
+        uint8_t point[65];
+        size_t length = 0;
+        EVP_PKEY_get_octet_string_param(pkey, OSSL_PKEY_PARAM_PUB_KEY, point, sizeof(point), &length);
+        publicKey.assign(point + 1, point + length);
+    } else {
+        pkey = EVP_PKEY_Q_keygen(nullptr, nullptr, "RSA", static_cast<size_t>(1024));
+        auto e = Bignum(pkey, OSSL_PKEY_PARAM_RSA_E);
+        auto n = Bignum(pkey, OSSL_PKEY_PARAM_RSA_N);
+        publicKey.push_back(e.size());
+        publicKey.insert(publicKey.end(), e.begin(), e.end());
+        publicKey.insert(publicKey.end(), n.begin(), n.end());
+    }
+
+    return {std::shared_ptr<EVP_PKEY>(pkey, EVP_PKEY_free),
+            std::make_shared<dnslib::DNSKEYRecord>(zone, 3600, flags, 3, algorithm, publicKey)};
+}
+
+static std::shared_ptr<dnslib::RRSIGRecord> Sign(const Validator::RecordList& rrset, const TestKey& key,
+                                                 int64_t validFrom = -3600, int64_t validFor = 86400) {
+    const auto& first = *rrset[0];
+    std::string owner = first.getName();
+    uint8_t labels = owner.empty() ? 0 : std::count(owner.begin(), owner.end(), '.') + 1;
+    if (owner.rfind("*.", 0) == 0) labels--;
+    uint32_t now = std::time(nullptr);
+
+    dnslib::RRSIGRecord unsigned_(owner, first.getTtl(), first.getType(), key.dnskey->getAlgorithm(), labels, first.getTtl(),
+        now + validFrom + validFor, now + validFrom, key.dnskey->keyTag(), key.dnskey->getName(), {});
+    auto data = Validator::signedData(unsigned_, rrset);
+
+    const EVP_MD* md = key.dnskey->getAlgorithm() == ED25519 ? nullptr : EVP_sha256();
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    EVP_DigestSignInit(ctx, nullptr, md, nullptr, key.pkey.get());
+    size_t length = 0;
+    EVP_DigestSign(ctx, nullptr, &length, data.data(), data.size());
+    std::vector<uint8_t> signature(length);
+    EVP_DigestSign(ctx, signature.data(), &length, data.data(), data.size());
+    signature.resize(length);
+    EVP_MD_CTX_free(ctx);
+
+    if (key.dnskey->getAlgorithm() == ECDSAP256SHA256) {
+        // DER to r and s, 32 bytes each
+        const uint8_t* der = signature.data();
+        ECDSA_SIG* sig = d2i_ECDSA_SIG(nullptr, &der, signature.size());
+        std::vector<uint8_t> raw(64);
+        BN_bn2binpad(ECDSA_SIG_get0_r(sig), raw.data(), 32);
+        BN_bn2binpad(ECDSA_SIG_get0_s(sig), raw.data() + 32, 32);
+        ECDSA_SIG_free(sig);
+        signature = raw;
+    }
+
+    return std::make_shared<dnslib::RRSIGRecord>(owner, first.getTtl(), first.getType(), key.dnskey->getAlgorithm(), labels,
+        first.getTtl(), now + validFrom + validFor, now + validFrom, key.dnskey->keyTag(), key.dnskey->getName(), signature);
+}
+
+static std::shared_ptr<dnslib::DSRecord> MakeDs(const dnslib::DNSKEYRecord& key) {
+    std::vector<uint8_t> data;
+    std::string owner;
+    for (char c : key.getName()) owner += std::tolower(c);
+    dnslib::utils::writeDomain(data, owner);
+    auto rdata = key.getRdata();
+    data.insert(data.end(), rdata.begin(), rdata.end());
+
+    std::vector<uint8_t> digest(32);
+    unsigned int length = 0;
+    EVP_Digest(data.data(), data.size(), digest.data(), &length, EVP_sha256(), nullptr);
+    return std::make_shared<dnslib::DSRecord>(key.getName(), 3600, key.keyTag(), key.getAlgorithm(), 2, digest);
+}
+
+static std::string Hex(const std::vector<uint8_t>& bytes) {
+    std::string hex;
+    char digits[3];
+    for (uint8_t byte : bytes) {
+        std::snprintf(digits, sizeof(digits), "%02x", byte);
+        hex += digits;
+    }
+    return hex;
+}
+
+static std::shared_ptr<dnslib::ResourceRecord> A(const std::string& name, const std::string& ip) {
+    return std::make_shared<dnslib::ARecord>(name, 3600, ip);
+}
+
+static std::shared_ptr<dnslib::ResourceRecord> Nsec(const std::string& owner, const std::string& next, std::vector<uint16_t> types) {
+    return std::make_shared<dnslib::NSECRecord>(owner, 3600, next, std::move(types));
+}
+
+TEST(DnssecTest, VerifiesEverySupportedKind) {
+    for (uint8_t algorithm : {ED25519, ECDSAP256SHA256, RSASHA256}) {
+        auto key = MakeKey("example.com", algorithm);
+        Validator::RecordList rrset = {A("www.example.com", "192.0.2.1")};
+        auto sig = Sign(rrset, key);
+
+        EXPECT_TRUE(Validator::verify(*sig, rrset, *key.dnskey)) << int(algorithm);
+        EXPECT_FALSE(Validator::verify(*sig, {A("www.example.com", "192.0.2.2")}, *key.dnskey)) << int(algorithm);
+    }
+}
+
+TEST(DnssecTest, CanonicalFormIgnoresCaseAndOrder) {
+    auto key = MakeKey("example.com", ED25519);
+    auto sig = Sign({A("www.example.com", "192.0.2.1"), A("www.example.com", "192.0.2.2")}, key);
+
+    Validator::RecordList reordered = {A("WWW.Example.COM", "192.0.2.2"), A("WWW.Example.COM", "192.0.2.1")};
+    EXPECT_TRUE(Validator::verify(*sig, reordered, *key.dnskey));
+}
+
+TEST(DnssecTest, WildcardExpansionIsSignedAsTheWildcard) {
+    auto key = MakeKey("example.com", ED25519);
+    auto sig = Sign({A("*.example.com", "192.0.2.1")}, key);
+    EXPECT_EQ(sig->getLabels(), 2);
+
+    EXPECT_TRUE(Validator::verify(*sig, {A("anything.example.com", "192.0.2.1")}, *key.dnskey));
+}
+
+TEST(DnssecTest, DsMatchesRfcExampleKey) {
+    const std::vector<uint8_t> rfcKey = {
+        0x01, 0x03, 0x9e, 0x8a, 0x24, 0x74, 0x18, 0xe3, 0x18, 0x90, 0x3b, 0x21, 0x5a,
+        0x84, 0x8a, 0xcf, 0xd5, 0xf3, 0x7f, 0x02, 0x6b, 0xd4, 0x06, 0x2d, 0xb2, 0x6c,
+        0x77, 0x4c, 0x69, 0x09, 0x68, 0xd5, 0xd5, 0x6d, 0xf8, 0xbf, 0xda, 0x91, 0xe6,
+        0xf3, 0x6d, 0x9a, 0x27, 0x98, 0x88, 0xf4, 0x13, 0x33, 0x35, 0x7c, 0x5e, 0x60,
+        0x29, 0x99, 0x0d, 0x10, 0xfd, 0xf5, 0x66, 0x30, 0x62, 0xa5, 0x12, 0x76, 0x33,
+        0x26, 0x98, 0x0a, 0x61, 0x5d, 0xdb, 0xf1, 0x7a, 0x05, 0xdd, 0xfc, 0xce, 0x7e,
+        0x5f, 0xb3, 0xab, 0xcc, 0xa0, 0x5a, 0x31, 0xb0, 0x95, 0x74, 0x52, 0xd4, 0x52,
+        0x1e, 0x83, 0x87, 0x07, 0x89, 0x06, 0x31, 0x15, 0xbf, 0x97, 0xf6, 0xc3, 0x08,
+        0xcc, 0xf5, 0x7c, 0xdc, 0x9c, 0xe7, 0xfe, 0x10, 0xf6, 0xed, 0x1b, 0xd0, 0xcc,
+        0x06, 0x60, 0x03, 0x8c, 0x50, 0xdc, 0xdb, 0x0f, 0xeb, 0x96, 0x3c, 0x2f, 0x17
+    };
+    // RFC 4034, section 5.4
+    dnslib::DNSKEYRecord key("dskey.example.com", 86400, 256, 3, 5, rfcKey);
+    dnslib::DSRecord ds("dskey.example.com", 86400, 60485, 5, 1, {
+        0x2B, 0xB1, 0x83, 0xAF, 0x5F, 0x22, 0x58, 0x81, 0x79, 0xA5,
+        0x3B, 0x0A, 0x98, 0x63, 0x1F, 0xAD, 0x1A, 0x29, 0x21, 0x18});
+    EXPECT_TRUE(Validator::matches(key, ds));
+
+    dnslib::DNSKEYRecord elsewhere("example.com", 86400, 256, 3, 5, rfcKey);
+    EXPECT_FALSE(Validator::matches(elsewhere, ds));
+}
+
+TEST(DnssecTest, KeySetNeedsASignatureByAKeyOfTheDs) {
+    auto ksk = MakeKey("example.com", ECDSAP256SHA256, dnslib::DNSKEYRecord::ZONE_KEY | dnslib::DNSKEYRecord::SECURE_ENTRY);
+    auto zsk = MakeKey("example.com", ECDSAP256SHA256);
+    Validator::RecordList keys = {ksk.dnskey, zsk.dnskey};
+    Validator::RecordList sigs = {Sign(keys, ksk)};
+
+    auto trusted = Validator::validateKeySet(keys, sigs, {MakeDs(*ksk.dnskey)});
+    ASSERT_TRUE(trusted.has_value());
+    EXPECT_EQ(trusted->size(), 2u);
+
+    // The ZSK did not sign the key set, its DS alone proves nothing
+    EXPECT_FALSE(Validator::validateKeySet(keys, sigs, {MakeDs(*zsk.dnskey)}).has_value());
+}
+
+TEST(DnssecTest, SignatureValidityUsesSerialArithmetic) {
+    auto key = MakeKey("example.com", ED25519);
+    Validator::RecordList rrset = {A("www.example.com", "192.0.2.1")};
+    std::time_t now = std::time(nullptr);
+
+    EXPECT_TRUE(Validator::current(*Sign(rrset, key)));
+    EXPECT_FALSE(Validator::current(*Sign(rrset, key, -7200, 3600)));
+    EXPECT_FALSE(Validator::current(*Sign(rrset, key, 3600, 3600)));
+
+    // A period across the 2106 wrap of the 32-bit time
+    dnslib::RRSIGRecord wrapping("www.example.com", 60, 1, ED25519, 3, 60, 100, 0xFFFFFF00, 1, "example.com", {});
+    EXPECT_TRUE(Validator::current(wrapping, static_cast<std::time_t>(0x100000010)));
+    EXPECT_FALSE(Validator::current(wrapping, now));
+}
+
+TEST(DnssecTest, Nsec3HashMatchesRfcExample) {
+    // RFC 5155, appendix A
+    auto hash = Validator::nsec3Hash("example", {0xAA, 0xBB, 0xCC, 0xDD}, 12);
+    EXPECT_EQ(dnslib::utils::toBase32Hex(hash), "0p9mhaveqvm6t7vbl5lop2u3t2rp3tom");
+}
+
+TEST(DnssecTest, NsecProvesMissingNamesTypesAndDelegations) {
+    // example.com, a.example.com with an A record, sub.example.com delegated without DS, z.example.com
+    Validator::RecordList proofs = {
+        Nsec("example.com", "a.example.com", {2, 6, 46, 47, 48}),
+        Nsec("a.example.com", "sub.example.com", {1, 46, 47}),
+        Nsec("sub.example.com", "z.example.com", {2, 46, 47}),
+        Nsec("z.example.com", "example.com", {1, 46, 47}),
+    };
+
+    EXPECT_TRUE(Validator::deniesType("a.example.com", 15, proofs));
+    EXPECT_FALSE(Validator::deniesType("a.example.com", 1, proofs));
+    // The parent side of a delegation only speaks for DS
+    EXPECT_FALSE(Validator::deniesType("sub.example.com", 1, proofs));
+    EXPECT_TRUE(Validator::deniesType("sub.example.com", 43, proofs));
+
+    EXPECT_TRUE(Validator::deniesName("b.example.com", proofs));
+    EXPECT_TRUE(Validator::deniesName("zz.example.com", proofs));
+    EXPECT_FALSE(Validator::deniesName("a.example.com", proofs));
+    EXPECT_FALSE(Validator::deniesName("b.example.com", {proofs[1]}));
+
+    EXPECT_EQ(Validator::delegationFromDenial("sub.example.com", proofs), Validator::Delegation::INSECURE);
+    EXPECT_EQ(Validator::delegationFromDenial("a.example.com", proofs), Validator::Delegation::NONE);
+    EXPECT_EQ(Validator::delegationFromDenial("b.example.com", proofs), Validator::Delegation::NONE);
+    // The apex NSEC is the child side of the cut above example.com
+    EXPECT_FALSE(Validator::delegationFromDenial("example.com", proofs).has_value());
+}
+
+TEST(DnssecTest, CachedKeysExpire) {
+    Validator validator({});
+    auto now = Validator::Clock::now();
+    validator.storeKeys("Example.com", {true, {}}, 10, now);
+
+    ASSERT_TRUE(validator.keys("example.com", now + std::chrono::seconds(5)).has_value());
+    EXPECT_TRUE(validator.keys("example.com", now + std::chrono::seconds(5))->secure);
+    EXPECT_FALSE(validator.keys("example.com", now + std::chrono::seconds(11)).has_value());
+}
+
+TEST(DnssecTest, AnchorsAreReadFromMasterFileLines) {
+    std::string path = testing::TempDir() + "anchors.txt";
+    {
+        std::ofstream file(path);
+        file << "; trust anchors\n"
+             << "example.com. 3600 IN DS 60485 5 1 2BB183AF5F22588179A53B0A98631FAD1A292118\n"
+             << "\n"
+             << ". DS 20326 8 2 E06D44B80B8F1D39A95C0B0D7C65D08458E880409BBC683457104237C7F8EC8D\n";
+    }
+
+    auto anchors = Validator::loadAnchors(path);
+    ASSERT_EQ(anchors.size(), 2u);
+    Validator validator(anchors);
+    EXPECT_EQ(validator.anchorsFor("example.com").size(), 1u);
+    EXPECT_EQ(validator.anchorsFor("").size(), 1u);
+    EXPECT_TRUE(validator.anchorsFor("www.example.com").empty());
+
+    {
+        std::ofstream file(path);
+        file << "example.com. IN NS ns.example.com.\n";
+    }
+    EXPECT_THROW(Validator::loadAnchors(path), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+// A validating forwarder in front of a stand-in upstream serving a signed example.com
+class ValidatingResolverTest : public ResolverHarness {
+protected:
+    const sockaddr_in upstream = Addr("127.0.0.1", 5301);
+
+    TestKey ksk = MakeKey("example.com", ED25519, dnslib::DNSKEYRecord::ZONE_KEY | dnslib::DNSKEYRecord::SECURE_ENTRY);
+    TestKey zsk = MakeKey("example.com", ED25519);
+    std::string anchors = testing::TempDir() + "example-anchor.txt";
+
+    void SetUp() override {
+        auto ds = MakeDs(*ksk.dnskey);
+        std::ofstream file(anchors);
+        file << "example.com. IN DS " << ds->getKeyTag() << " " << int(ds->getAlgorithm()) << " 2 "
+             << Hex(ds->getDigest()) << "\n";
+        file.close();
+
+        config.forwarders = {upstream};
+        config.hedgePercentile = 0;
+        config.healthInterval = 3600;
+        config.trustAnchors = anchors;
+        config.dnssec = true;
+        start();
+    }
+
+    void TearDown() override {
+        std::remove(anchors.c_str());
+    }
+
+    // Answers an upstream query with records, checking it asks for signatures
+    void answer(const dnslib::DNSMessageL& query, const Validator::RecordList& records, const Validator::RecordList& authority = {},
+                dnslib::RCODE rcode = dnslib::RCODE::NOERROR) {
+        auto packet = dnslib::PacketParser::parse(query.data);
+        ASSERT_EQ(packet.getAdditional().size(), 1u);
+        auto opt = std::dynamic_pointer_cast<dnslib::OPTRecord>(packet.getAdditional()[0]);
+        ASSERT_TRUE(opt && opt->getDnssecOk());
+
+        dnslib::PacketBuilder builder;
+        builder.setId(packet.getHeader().getId());
+        builder.withFlags(dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::RECURSION_DES | dnslib::PacketFlag::RECURSION_AVAIL);
+        builder.withRcode(rcode);
+        builder.addQuestion(packet.getQuestions()[0].getName(), packet.getQuestions()[0].getType());
+        for (const auto& rec : records) {
+            builder.addAnswer(rec);
+        }
+        for (const auto& rec : authority) {
+            builder.addAuthority(rec);
+        }
+        reply(query, builder);
+    }
+
+    Validator::RecordList keySet() {
+        Validator::RecordList keys = {ksk.dnskey, zsk.dnskey};
+        keys.push_back(Sign(keys, ksk));
+        return keys;
+    }
+
+    static dnslib::TYPE asked(const dnslib::DNSMessageL& query) {
+        return questionOf(query).getType();
+    }
+};
+
+TEST_F(ValidatingResolverTest, SignedAnswerGetsAuthenticDataAndIsNotCheckedAgain) {
+    auto& verifications = utils::Metrics::get().counter("dnssec.verifications");
+
+    ask(0x1001, "www.example.com");
+    Validator::RecordList rrset = {A("www.example.com", "192.0.2.1")};
+    answer(next(), {rrset[0], Sign(rrset, zsk)});
+
+    // The key set is fetched to check the signature
+    auto keyQuery = next();
+    ASSERT_EQ(asked(keyQuery), dnslib::TYPE::DNSKEY);
+    answer(keyQuery, keySet());
+
+    auto response = dnslib::PacketParser::parse(next().data);
+    EXPECT_EQ(response.getHeader().rcode(), dnslib::RCODE::NOERROR);
+    EXPECT_TRUE(response.getHeader().authenticData());
+    ASSERT_EQ(response.getAnswers().size(), 1u);
+
+    // Served from the cache with its status, no crypto work
+    uint64_t before = verifications.load();
+    ask(0x1002, "www.example.com");
+    auto cached = dnslib::PacketParser::parse(next().data);
+    EXPECT_TRUE(cached.getHeader().authenticData());
+    EXPECT_EQ(verifications.load(), before);
+    EXPECT_TRUE(idle());
+}
+
+TEST_F(ValidatingResolverTest, TamperedAnswerIsServfail) {
+    ask(0x2001, "www.example.com");
+    auto sig = Sign({A("www.example.com", "192.0.2.1")}, zsk);
+    answer(next(), {A("www.example.com", "203.0.113.66"), sig});
+
+    auto keyQuery = next();
+    ASSERT_EQ(asked(keyQuery), dnslib::TYPE::DNSKEY);
+    answer(keyQuery, keySet());
+
+    auto response = dnslib::PacketParser::parse(next().data);
+    EXPECT_EQ(response.getHeader().rcode(), dnslib::RCODE::SERVERFAILURE);
+    EXPECT_TRUE(response.getAnswers().empty());
+
+    // Remembered as bogus for a while
+    ask(0x2002, "www.example.com");
+    EXPECT_EQ(dnslib::PacketParser::parse(next().data).getHeader().rcode(), dnslib::RCODE::SERVERFAILURE);
+    EXPECT_TRUE(idle());
+}
+
+TEST_F(ValidatingResolverTest, StrippedSignatureInASignedZoneIsServfail) {
+    ask(0x3001, "www.example.com");
+    answer(next(), {A("www.example.com", "192.0.2.1")});
+
+    // Unsigned data is fine only below an unsigned delegation, the zone proves there is none at www
+    auto keyQuery = next();
+    ASSERT_EQ(asked(keyQuery), dnslib::TYPE::DNSKEY);
+    answer(keyQuery, keySet());
+    auto dsQuery = next();
+    ASSERT_EQ(asked(dsQuery), dnslib::TYPE::DS);
+
+    Validator::RecordList nsec = {Nsec("www.example.com", "example.com", {1, 46, 47})};
+    auto soa = std::make_shared<dnslib::SOARecord>("example.com", 3600, "ns.example.com", "admin.example.com", 1, 3600, 600, 86400, 300);
+    Validator::RecordList soaSet = {soa};
+    answer(dsQuery, {}, {soa, Sign(soaSet, zsk), nsec[0], Sign(nsec, zsk)});
+
+    auto response = dnslib::PacketParser::parse(next().data);
+    EXPECT_EQ(response.getHeader().rcode(), dnslib::RCODE::SERVERFAILURE);
+}
+
+TEST_F(ValidatingResolverTest, NamesInAProvenGapAreDeniedWithoutAskingUpstream) {
+    auto& avoided = utils::Metrics::get().counter("dnssec.upstream_queries_avoided");
+
+    ask(0x4001, "a1.example.com");
+    auto soa = std::make_shared<dnslib::SOARecord>("example.com", 3600, "ns.example.com", "admin.example.com", 1, 3600, 600, 86400, 300);
+    Validator::RecordList soaSet = {soa};
+    // Nothing between the apex and www, the wildcard included
+    Validator::RecordList apex = {Nsec("example.com", "www.example.com", {2, 6, 46, 47, 48})};
+    answer(next(), {}, {soa, Sign(soaSet, zsk), apex[0], Sign(apex, zsk)}, dnslib::RCODE::NAMEERROR);
+
+    // The SOA and the NSEC are checked in parallel, each may ask for the key set on a cold cache
+    auto message = next();
+    while (dnslib::PacketParser::parse(message.data).getHeader().isQuery()) {
+        ASSERT_EQ(asked(message), dnslib::TYPE::DNSKEY);
+        answer(message, keySet());
+        message = next();
+    }
+
+    auto first = dnslib::PacketParser::parse(message.data);
+    EXPECT_EQ(first.getHeader().rcode(), dnslib::RCODE::NAMEERROR);
+    EXPECT_TRUE(first.getHeader().authenticData());
+
+    // Another name of the same gap, and a type the apex does not have, come from the NSEC alone
+    uint64_t before = avoided.load();
+    ask(0x4002, "random7.example.com");
+    auto synthesized = dnslib::PacketParser::parse(next().data);
+    EXPECT_EQ(synthesized.getHeader().rcode(), dnslib::RCODE::NAMEERROR);
+    EXPECT_TRUE(synthesized.getHeader().authenticData());
+    ASSERT_EQ(synthesized.getAuthority().size(), 1u);
+    EXPECT_EQ(synthesized.getAuthority()[0]->getName(), "example.com");
+
+    ask(0x4003, "example.com");
+    auto nodata = dnslib::PacketParser::parse(next().data);
+    EXPECT_EQ(nodata.getHeader().rcode(), dnslib::RCODE::NOERROR);
+    EXPECT_TRUE(nodata.getAnswers().empty());
+
+    EXPECT_EQ(avoided.load(), before + 2);
+    EXPECT_TRUE(idle());
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <future>
+#include "utils/executor.hpp"
+#include "utils/task.hpp"
+
+using namespace std::chrono_literals;
+
+static utils::Task<int> Add(int a, int b) {
+    co_return a + b;
+}
+
+static utils::Task<std::optional<int>> After(utils::Executor& executor, std::chrono::milliseconds delay, std::optional<int> value) {
+    co_await executor.sleepFor(delay);
+    co_return value;
+}
+
+TEST(ExecutorTest, SpawnedTasksRunOnTheWorkers) {
+    utils::Executor executor(4);
+    std::atomic<int> done = 0;
+    std::promise<void> finished;
+
+    auto work = [&]() -> utils::Task<void> {
+        int sum = co_await Add(1, 2);
+        if (done.fetch_add(sum) + sum == 300) {
+            finished.set_value();
+        }
+    };
+    for (int i = 0; i < 100; i++) {
+        utils::spawn(executor, work());
+    }
+
+    ASSERT_EQ(finished.get_future().wait_for(2s), std::future_status::ready);
+    EXPECT_EQ(done.load(), 300);
+}
+
+TEST(ExecutorTest, SleepResumesAfterTheDeadline) {
+    utils::Executor executor(1);
+    std::promise<std::chrono::steady_clock::duration> slept;
+
+    auto start = std::chrono::steady_clock::now();
+    auto work = [&]() -> utils::Task<void> {
+        co_await executor.sleepFor(50ms);
+        slept.set_value(std::chrono::steady_clock::now() - start);
+    };
+    utils::spawn(executor, work());
+
+    auto future = slept.get_future();
+    ASSERT_EQ(future.wait_for(2s), std::future_status::ready);
+    EXPECT_GE(future.get(), 50ms);
+}
+
+TEST(ExecutorTest, FirstValueSkipsEmptyResults) {
+    utils::Executor executor(2);
+    std::promise<std::optional<int>> first;
+
+    auto work = [&]() -> utils::Task<void> {
+        std::vector<utils::Task<std::optional<int>>> tasks;
+        tasks.push_back(After(executor, 1ms, std::nullopt));
+        tasks.push_back(After(executor, 20ms, 7));
+        tasks.push_back(After(executor, 500ms, 9));
+        first.set_value(co_await utils::firstValue(executor, std::move(tasks)));
+    };
+    utils::spawn(executor, work());
+
+    auto future = first.get_future();
+    ASSERT_EQ(future.wait_for(400ms), std::future_status::ready);
+    EXPECT_EQ(future.get(), 7);
+}
+
+TEST(ExecutorTest, FirstValueIsEmptyWhenNoTaskProducesOne) {
+    utils::Executor executor(2);
+    std::promise<std::optional<int>> first;
+
+    auto work = [&]() -> utils::Task<void> {
+        std::vector<utils::Task<std::optional<int>>> tasks;
+        tasks.push_back(After(executor, 1ms, std::nullopt));
+        tasks.push_back(After(executor, 5ms, std::nullopt));
+        first.set_value(co_await utils::firstValue(executor, std::move(tasks)));
+    };
+    utils::spawn(executor, work());
+
+    auto future = first.get_future();
+    ASSERT_EQ(future.wait_for(2s), std::future_status::ready);
+    EXPECT_FALSE(future.get().has_value());
+}
+
+TEST(ExecutorTest, AllValuesKeepsTheOrderOfTasks) {
+    utils::Executor executor(2);
+    std::promise<std::vector<std::optional<std::optional<int>>>> all;
+
+    auto work = [&]() -> utils::Task<void> {
+        std::vector<utils::Task<std::optional<int>>> tasks;
+        tasks.push_back(After(executor, 30ms, 1));
+        tasks.push_back(After(executor, 1ms, std::nullopt));
+        tasks.push_back(After(executor, 10ms, 3));
+        all.set_value(co_await utils::allValues(executor, std::move(tasks)));
+    };
+    utils::spawn(executor, work());
+
+    auto future = all.get_future();
+    ASSERT_EQ(future.wait_for(2s), std::future_status::ready);
+    auto values = future.get();
+    ASSERT_EQ(values.size(), 3u);
+    EXPECT_EQ(values[0].value(), 1);
+    EXPECT_FALSE(values[1].value().has_value());
+    EXPECT_EQ(values[2].value(), 3);
+}
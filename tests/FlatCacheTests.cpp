@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include "flatcache.hpp"
+
+static cacheKey Key(size_t i) {
+    return {"host" + std::to_string(i) + ".example.com", dnslib::TYPE::A};
+}
+
+static std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>> Records(size_t i) {
+    auto records = std::make_shared<std::vector<std::shared_ptr<dnslib::ResourceRecord>>>();
+    records->push_back(std::make_shared<dnslib::ARecord>(Key(i).name, 300, static_cast<uint32_t>(i)));
+    return records;
+}
+
+static uint32_t AddressOf(const std::shared_ptr<std::vector<std::shared_ptr<dnslib::ResourceRecord>>>& records) {
+    return std::dynamic_pointer_cast<dnslib::ARecord>(records->front())->getIpAddress();
+}
+
+TEST(FlatCacheTest, ShardsLikeTheListCache) {
+    EXPECT_EQ(FlatCache(1000, 16).shardCount(), 8u);
+    for (int capacity : {64, 1000, 100000}) {
+        for (size_t shards : {0, 3, 16}) {
+            EXPECT_EQ(FlatCache(capacity, shards).shardCount(), TLRUCache(capacity, shards).shardCount()) << capacity << " " << shards;
+        }
+    }
+}
+
+TEST(FlatCacheTest, KeepsEntriesLikeTheListCache) {
+    FlatCache cache(100);
+    EXPECT_FALSE(cache.get(Key(1)).has_value());
+
+    cache.put(Key(1), Records(1), 300, Security::SECURE);
+    Security security = Security::UNCHECKED;
+    auto found = cache.get(Key(1), &security);
+    ASSERT_TRUE(found.has_value());
+    EXPECT_EQ(AddressOf(found.value()), 1u);
+    EXPECT_EQ(security, Security::SECURE);
+
+    cache.put(Key(1), Records(2), 300);
+    EXPECT_EQ(AddressOf(cache.get(Key(1)).value()), 2u);
+    EXPECT_FALSE(cache.put(Key(1), Records(3), 300, Security::UNCHECKED, Trust::GLUE));
+
+    // Negative entries share the table, get() does not return them
+    auto soa = std::make_shared<dnslib::SOARecord>("example.com", 300, "ns.example.com", "admin.example.com", 1, 3600, 600, 86400, 300);
+    cache.putNegative(Key(4), soa, 300);
+    EXPECT_FALSE(cache.get(Key(4)).has_value());
+    EXPECT_TRUE(cache.getNegative(Key(4)).has_value());
+    EXPECT_FALSE(cache.getNegative(Key(1)).has_value());
+}
+
+TEST(FlatCacheTest, ClockEvictsEntriesNotUsedSinceTheLastSweep) {
+    FlatCache cache(64, 1);
+    for (size_t i = 0; i < 64; i++) {
+        cache.put(Key(i), Records(i), 300);
+    }
+    // New entries start referenced, the hand clears them all on its way round and takes one
+    cache.put(Key(1000), Records(1000), 300);
+    size_t evicted = 0;
+    while (evicted < 64 && cache.getStale(Key(evicted)).has_value()) {
+        evicted++;
+    }
+    ASSERT_LT(evicted, 64u);
+
+    for (size_t i = 0; i < 32; i++) {
+        cache.get(Key(i));
+    }
+    // One sweep has as many unreferenced entries as these need
+    for (size_t i = 64; i < 95; i++) {
+        cache.put(Key(i), Records(i), 300);
+    }
+
+    // getStale() leaves the referenced bits alone
+    for (size_t i = 0; i < 32; i++) {
+        EXPECT_EQ(cache.getStale(Key(i)).has_value(), i != evicted) << i;
+    }
+    size_t kept = 0;
+    for (size_t i = 32; i < 64; i++) {
+        kept += cache.getStale(Key(i)).has_value() ? 1 : 0;
+    }
+    EXPECT_LE(kept, 1u);
+    for (size_t i = 64; i < 95; i++) {
+        EXPECT_TRUE(cache.getStale(Key(i)).has_value()) << i;
+    }
+    EXPECT_TRUE(cache.getStale(Key(1000)).has_value());
+}
+
+TEST(FlatCacheTest, RemovedEntriesLeaveTheOthersReachable) {
+    FlatCache cache(1000, 1);
+    for (size_t i = 0; i < 700; i++) {
+        cache.put(Key(i), Records(i), i % 2 == 0 ? 0 : 300);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+    // Looking up the expired ones removes them, the probe runs around them are shifted back
+    for (size_t i = 0; i < 700; i += 2) {
+        EXPECT_FALSE(cache.getStale(Key(i)).has_value());
+    }
+    for (size_t i = 1; i < 700; i += 2) {
+        auto found = cache.get(Key(i));
+        ASSERT_TRUE(found.has_value()) << i;
+        EXPECT_EQ(AddressOf(found.value()), i);
+    }
+}
@@ -0,0 +1,271 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include "ResolverHarness.hpp"
+#include "utils/metrics.hpp"
+
+class ForwardingTest : public ResolverHarness {
+protected:
+    const sockaddr_in upstreamA = Addr("127.0.0.1", 5301);
+    const sockaddr_in upstreamB = Addr("127.0.0.1", 5302);
+
+    void forwardTo(std::vector<sockaddr_in> upstreams, double hedgePercentile) {
+        config.forwarders = std::move(upstreams);
+        config.hedgePercentile = hedgePercentile;
+        config.healthInterval = 3600;
+        start();
+    }
+
+    void askAt(uint16_t id, const std::string& name, std::chrono::steady_clock::time_point received) {
+        auto message = query(id, name);
+        message.received = received;
+        resolver->handleMessage(std::move(message));
+    }
+
+    // Answers query as the upstream it was sent to
+    void answer(const dnslib::DNSMessageL& query, dnslib::RCODE rcode, const std::string& ip = "") {
+        auto packet = dnslib::PacketParser::parse(query.data);
+        auto question = packet.getQuestions()[0];
+
+        dnslib::PacketBuilder builder;
+        builder.setId(packet.getHeader().getId());
+        builder.withFlags(dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::RECURSION_DES | dnslib::PacketFlag::RECURSION_AVAIL);
+        builder.withRcode(rcode);
+        builder.addQuestion(question.getName(), question.getType());
+        if (!ip.empty()) {
+            builder.addAnswer(std::make_shared<dnslib::ARecord>(question.getName(), 60, ip));
+        }
+        reply(query, builder);
+    }
+};
+
+TEST_F(ForwardingTest, ForwardsWithRecursionDesiredAndCachesTheAnswer) {
+    forwardTo({upstreamA}, 0);
+
+    ask(0x1234, "www.example.com");
+    auto query = next();
+    ASSERT_TRUE(SameAddr(query.peerAddress, upstreamA));
+    EXPECT_TRUE(dnslib::PacketParser::parse(query.data).getHeader().recursionDesired());
+
+    answer(query, dnslib::RCODE::NOERROR, "192.0.2.1");
+    auto response = next();
+    ASSERT_TRUE(SameAddr(response.peerAddress, client));
+    auto packet = dnslib::PacketParser::parse(response.data);
+    EXPECT_EQ(packet.getHeader().getId(), 0x1234);
+    ASSERT_EQ(packet.getAnswers().size(), 1u);
+
+    ask(0x1235, "www.example.com");
+    EXPECT_TRUE(SameAddr(next().peerAddress, client));
+    EXPECT_TRUE(idle());
+}
+
+TEST_F(ForwardingTest, SlowUpstreamIsHedged) {
+    forwardTo({upstreamA, upstreamB}, 90);
+    auto& wins = utils::Metrics::get().counter("forward.hedge_wins");
+    uint64_t winsBefore = wins.load();
+
+    ask(0x2222, "slow.example.com");
+    auto first = next();
+    EXPECT_TRUE(idle());
+
+    // No latency history yet, the hedge goes out after the initial 100ms
+    auto hedge = next();
+    EXPECT_FALSE(SameAddr(hedge.peerAddress, first.peerAddress));
+
+    answer(hedge, dnslib::RCODE::NOERROR, "192.0.2.2");
+    auto response = next();
+    ASSERT_TRUE(SameAddr(response.peerAddress, client));
+    EXPECT_EQ(dnslib::PacketParser::parse(response.data).getHeader().getId(), 0x2222);
+    EXPECT_EQ(wins.load(), winsBefore + 1);
+
+    // The slow one answers eventually, nobody is waiting anymore
+    answer(first, dnslib::RCODE::NOERROR, "192.0.2.2");
+    EXPECT_TRUE(idle());
+}
+
+TEST_F(ForwardingTest, RefusedQueryMovesToAnotherUpstream) {
+    forwardTo({upstreamA, upstreamB}, 0);
+
+    ask(0x3333, "refused.example.com");
+    auto first = next();
+    answer(first, dnslib::RCODE::REFUSED);
+
+    auto retry = next();
+    EXPECT_FALSE(SameAddr(retry.peerAddress, first.peerAddress));
+    answer(retry, dnslib::RCODE::NOERROR, "192.0.2.3");
+
+    auto response = next();
+    ASSERT_TRUE(SameAddr(response.peerAddress, client));
+    auto packet = dnslib::PacketParser::parse(response.data);
+    EXPECT_EQ(packet.getHeader().rcode(), dnslib::RCODE::NOERROR);
+    EXPECT_EQ(packet.getAnswers().size(), 1u);
+}
+
+TEST_F(ForwardingTest, ServfailWhenEveryUpstreamFails) {
+    forwardTo({upstreamA, upstreamB}, 0);
+
+    ask(0x4444, "broken.example.com");
+    answer(next(), dnslib::RCODE::SERVERFAILURE);
+    answer(next(), dnslib::RCODE::SERVERFAILURE);
+
+    auto response = next();
+    ASSERT_TRUE(SameAddr(response.peerAddress, client));
+    EXPECT_EQ(dnslib::PacketParser::parse(response.data).getHeader().rcode(), dnslib::RCODE::SERVERFAILURE);
+    EXPECT_TRUE(idle());
+}
+
+TEST_F(ForwardingTest, TruncatedAnswerIsAskedAgainOverTcp) {
+    // Stand-in upstream on TCP, same address and port
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    ASSERT_EQ(bind(listener, reinterpret_cast<const sockaddr*>(&upstreamA), sizeof(upstreamA)), 0);
+    listen(listener, 1);
+
+    std::thread tcpUpstream([&] {
+        int fd = accept(listener, nullptr, nullptr);
+        uint8_t prefix[2];
+        ASSERT_EQ(recv(fd, prefix, 2, MSG_WAITALL), 2);
+        dnslib::DNSMessageL query{};
+        query.data.resize((prefix[0] << 8) | prefix[1]);
+        ASSERT_EQ(recv(fd, query.data.data(), query.data.size(), MSG_WAITALL), static_cast<ssize_t>(query.data.size()));
+        auto packet = dnslib::PacketParser::parse(query.data);
+
+        dnslib::PacketBuilder builder;
+        builder.setId(packet.getHeader().getId());
+        builder.withFlags(dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::RECURSION_AVAIL);
+        builder.addQuestion("big.example.com", dnslib::TYPE::A);
+        builder.addAnswer(std::make_shared<dnslib::ARecord>("big.example.com", 60, 0xC0000205));
+        std::vector<uint8_t> wire;
+        builder.build().serialize(wire);
+
+        uint8_t length[2] = {static_cast<uint8_t>(wire.size() >> 8), static_cast<uint8_t>(wire.size())};
+        ::send(fd, length, 2, 0);
+        ::send(fd, wire.data(), wire.size(), 0);
+        close(fd);
+    });
+
+    forwardTo({upstreamA}, 0);
+    ask(0x4444, "big.example.com");
+    auto query = next();
+
+    dnslib::PacketBuilder builder;
+    builder.setId(dnslib::PacketParser::parse(query.data).getHeader().getId());
+    builder.withFlags(dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::TRUNCATED | dnslib::PacketFlag::RECURSION_AVAIL);
+    builder.addQuestion("big.example.com", dnslib::TYPE::A);
+    dnslib::DNSMessageL truncated{};
+    truncated.peerAddress = upstreamA;
+    builder.build().serialize(truncated.data);
+    resolver->handleMessage(std::move(truncated));
+
+    auto response = next();
+    tcpUpstream.join();
+    close(listener);
+
+    ASSERT_TRUE(SameAddr(response.peerAddress, client));
+    auto packet = dnslib::PacketParser::parse(response.data);
+    EXPECT_FALSE(packet.getHeader().truncation());
+    ASSERT_EQ(packet.getAnswers().size(), 1u);
+}
+
+TEST_F(ForwardingTest, ResolutionStopsWhenTheQueryBudgetRunsOut) {
+    config.queryBudget = 200;
+    forwardTo({upstreamA}, 0);
+    auto& cut = utils::Metrics::get().counter("deadline.resolutions_cut");
+    uint64_t cutBefore = cut.load();
+
+    auto start = std::chrono::steady_clock::now();
+    askAt(0x5555, "silent.example.com", start);
+    auto query = next();
+    ASSERT_TRUE(SameAddr(query.peerAddress, upstreamA));
+
+    // The upstream never answers, the client gets SERVFAIL once the budget is spent
+    auto response = next();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    ASSERT_TRUE(SameAddr(response.peerAddress, client));
+    EXPECT_EQ(dnslib::PacketParser::parse(response.data).getHeader().rcode(), dnslib::RCODE::SERVERFAILURE);
+    EXPECT_LT(elapsed, std::chrono::milliseconds(1000));
+    EXPECT_EQ(cut.load(), cutBefore + 1);
+}
+
+TEST_F(ForwardingTest, QueriesOlderThanTheBudgetAreDropped) {
+    config.queryBudget = 200;
+    forwardTo({upstreamA}, 0);
+
+    askAt(0x6666, "late.example.com", std::chrono::steady_clock::now() - std::chrono::seconds(1));
+    EXPECT_TRUE(idle());
+}
+
+TEST_F(ForwardingTest, BatchAnswersCachedQueriesAndResolvesTheOthers) {
+    forwardTo({upstreamA}, 0);
+    for (std::string name : {"a.example.com", "b.example.com"}) {
+        auto records = std::make_shared<RecordList>();
+        records->push_back(std::make_shared<dnslib::ARecord>(name, 60, "192.0.2.1"));
+        cache.put({name, dnslib::TYPE::A}, records, 60);
+    }
+
+    std::vector<dnslib::DNSMessageL> batch;
+    batch.push_back(query(1, "a.example.com"));
+    batch.push_back(query(4, "d.example.com"));
+    batch.back().data.resize(5);
+    batch.push_back(query(3, "c.example.com"));
+    batch.push_back(query(2, "b.example.com"));
+    resolver->handleBatch(batch);
+    EXPECT_TRUE(batch.empty());
+
+    // The unparsable message is skipped, the cached answers keep their order
+    std::vector<uint16_t> answered;
+    int forwarded = 0;
+    for (int i = 0; i < 3; i++) {
+        auto message = next();
+        if (SameAddr(message.peerAddress, upstreamA)) {
+            forwarded++;
+        } else {
+            answered.push_back(dnslib::PacketParser::parse(message.data).getHeader().getId());
+        }
+    }
+    EXPECT_EQ(forwarded, 1);
+    EXPECT_EQ(answered, (std::vector<uint16_t>{1, 2}));
+    EXPECT_TRUE(idle());
+}
+
+TEST_F(ForwardingTest, AnswerToAnotherQuestionIsIgnored) {
+    forwardTo({upstreamA}, 0);
+    auto& ignored = utils::Metrics::get().counter("upstream.ignored_responses");
+    uint64_t before = ignored.load();
+
+    ask(0x7777, "www.example.com");
+    auto query = next();
+    uint16_t id = dnslib::PacketParser::parse(query.data).getHeader().getId();
+
+    // Right ID and source, but not what was asked
+    auto forge = [&](const std::string& name, dnslib::TYPE type) {
+        dnslib::PacketBuilder builder;
+        builder.setId(id);
+        builder.withFlags(dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::RECURSION_AVAIL);
+        builder.addQuestion(name, type);
+        builder.addAnswer(std::make_shared<dnslib::ARecord>("www.example.com", 60, "6.6.6.6"));
+        reply(query, builder);
+    };
+    forge("evil.example.com", dnslib::TYPE::A);
+    forge("www.example.com", dnslib::TYPE::MX);
+    EXPECT_TRUE(idle());
+    EXPECT_EQ(ignored.load(), before + 2);
+
+    // The question may come back in another case (0x20)
+    dnslib::PacketBuilder builder;
+    builder.setId(id);
+    builder.withFlags(dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::RECURSION_AVAIL);
+    builder.addQuestion("WWW.Example.COM", dnslib::TYPE::A);
+    builder.addAnswer(std::make_shared<dnslib::ARecord>("www.example.com", 60, 0xC0000207u));
+    reply(query, builder);
+
+    auto response = next();
+    ASSERT_TRUE(SameAddr(response.peerAddress, client));
+    auto packet = dnslib::PacketParser::parse(response.data);
+    ASSERT_EQ(packet.getAnswers().size(), 1u);
+    auto a_rec = std::dynamic_pointer_cast<dnslib::ARecord>(packet.getAnswers()[0]);
+    ASSERT_TRUE(a_rec);
+    EXPECT_EQ(a_rec->getIpAddress(), 0xC0000207u);
+}
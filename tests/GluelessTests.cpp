@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include "ResolverHarness.hpp"
+
+// Iterative resolution of example.com, whose servers are named in other
+// zones and come without glue. The test plays the root and every server.
+class GluelessTest : public ResolverHarness {
+protected:
+    const uint32_t serverA = 0xC0000210;        // 192.0.2.16, dns-a.net
+    const uint32_t serverB = 0xC0000211;        // 192.0.2.17, dns-b.net
+    const uint32_t zoneServer = 0xC0000235;     // 192.0.2.53, example.com
+    // Example.com and example.net name each other's servers, without glue
+    bool loop = false;
+
+    void SetUp() override {
+        start();
+    }
+
+    static bool EndsWith(const std::string& name, const std::string& zone) {
+        return name.size() >= zone.size() && name.compare(name.size() - zone.size(), zone.size(), zone) == 0;
+    }
+
+    static void refer(dnslib::PacketBuilder& builder, const std::string& zone, const std::vector<std::string>& servers, uint32_t glue = 0) {
+        for (const auto& server : servers) {
+            builder.addAuthority(std::make_shared<dnslib::NSRecord>(zone, 3600, server));
+            if (glue) {
+                builder.addAdditional(std::make_shared<dnslib::ARecord>(server, 3600, glue));
+            }
+        }
+    }
+
+    void serve(const dnslib::DNSMessageL& query) override {
+        auto packet = dnslib::PacketParser::parse(query.data);
+        auto question = packet.getQuestions()[0];
+        const std::string& name = question.getName();
+
+        dnslib::PacketBuilder builder;
+        builder.setId(packet.getHeader().getId());
+        builder.withFlags(dnslib::PacketFlag::RESPONSE);
+        builder.addQuestion(name, question.getType());
+        if (serverOf(query) == root) {
+            if (loop) {
+                bool com = EndsWith(name, "example.com");
+                refer(builder, com ? "example.com" : "example.net", {com ? "ns.example.net" : "ns.example.com"});
+            } else if (EndsWith(name, "example.com")) {
+                refer(builder, "example.com", {"ns1.dns-a.net", "ns2.dns-b.net"});
+            } else {
+                bool a = EndsWith(name, "dns-a.net");
+                refer(builder, a ? "dns-a.net" : "dns-b.net", {a ? "ns.dns-a.net" : "ns.dns-b.net"}, a ? serverA : serverB);
+            }
+        } else {
+            builder.withFlags(dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::AUTHORITATIVE);
+            uint32_t address = serverOf(query) == zoneServer ? 0xC0000201 : zoneServer;
+            builder.addAnswer(std::make_shared<dnslib::ARecord>(name, 300, address));
+        }
+        reply(query, builder);
+    }
+};
+
+TEST_F(GluelessTest, ServerAddressesAreResolvedTogetherAndTheFirstWins) {
+    ask(0x2601, "www.example.com");
+    auto referral = next();
+    ASSERT_EQ(serverOf(referral), root);
+    serve(referral);
+
+    // Both NS names are looked up before either lookup has an answer
+    std::vector<dnslib::DNSMessageL> lookups = {next(), next()};
+    std::vector<std::string> names;
+    for (const auto& lookup : lookups) {
+        EXPECT_EQ(serverOf(lookup), root);
+        names.push_back(questionOf(lookup).getName());
+    }
+    std::sort(names.begin(), names.end());
+    EXPECT_EQ(names, (std::vector<std::string>{"ns1.dns-a.net", "ns2.dns-b.net"}));
+    for (const auto& lookup : lookups) {
+        serve(lookup);
+    }
+
+    // dns-b.net never answers, the address from dns-a.net is used as soon as it is in
+    dnslib::DNSMessageL message = next();
+    for (int i = 0; i < 3 && serverOf(message) != zoneServer; i++) {
+        if (serverOf(message) == serverA) {
+            serve(message);
+        } else {
+            ASSERT_EQ(serverOf(message), serverB);
+        }
+        message = next();
+    }
+    ASSERT_EQ(serverOf(message), zoneServer);
+    EXPECT_EQ(questionOf(message).getName(), "www.example.com");
+    serve(message);
+
+    // The dns-b.net query may still be on its way
+    message = next();
+    if (serverOf(message) == serverB) {
+        message = next();
+    }
+    auto response = dnslib::PacketParser::parse(message.data);
+    EXPECT_FALSE(response.getHeader().isQuery());
+    ASSERT_EQ(response.getAnswers().size(), 1u);
+    auto a_rec = std::dynamic_pointer_cast<dnslib::ARecord>(response.getAnswers()[0]);
+    ASSERT_TRUE(a_rec);
+    EXPECT_EQ(a_rec->getIpAddress(), 0xC0000201u);
+
+    // The server address is kept for the next referral to it
+    EXPECT_TRUE(cache.get({"ns1.dns-a.net", dnslib::TYPE::A}, nullptr, Trust::GLUE).has_value());
+}
+
+TEST_F(GluelessTest, ServersNamingEachOtherStopAtTheDepthLimit) {
+    loop = true;
+    ask(0x2602, "www.example.com");
+
+    std::vector<dnslib::DNSMessageL> queries;
+    auto responses = run(1, queries);
+    ASSERT_EQ(responses.size(), 1u);
+    EXPECT_EQ(responses[0].getHeader().rcode(), dnslib::RCODE::SERVERFAILURE);
+
+    // One walk per nesting level, the first and four sub-resolutions
+    EXPECT_EQ(queries.size(), 5u);
+    for (const auto& query : queries) {
+        EXPECT_EQ(serverOf(query), root);
+    }
+}
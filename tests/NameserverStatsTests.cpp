@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include "nsstats.hpp"
+
+using namespace std::chrono_literals;
+
+constexpr uint32_t SERVER_A = 0xC0000201;
+constexpr uint32_t SERVER_B = 0xC0000202;
+constexpr uint32_t SERVER_C = 0xC0000203;
+
+TEST(NameserverStatsTest, SamplesSmoothTheRetransmissionTimeout) {
+    NameserverStats stats(16, 0);
+    auto now = NameserverStats::Clock::now();
+    EXPECT_EQ(stats.timeout(SERVER_A), 800ms);
+
+    // First sample: SRTT 100, RTTVAR 50
+    stats.recordRtt(SERVER_A, 100ms, now);
+    EXPECT_EQ(stats.timeout(SERVER_A), 300ms);
+
+    // An equal sample only shrinks the variance: 0.75 * 50
+    stats.recordRtt(SERVER_A, 100ms, now);
+    EXPECT_EQ(stats.timeout(SERVER_A), 250ms);
+
+    // SRTT 0.875 * 100 + 0.125 * 20 = 90, RTTVAR 0.75 * 37.5 + 0.25 * 80 = 48.125
+    stats.recordRtt(SERVER_A, 20ms, now);
+    EXPECT_EQ(stats.timeout(SERVER_A), 282ms);
+
+    stats.recordRtt(SERVER_B, 1ms, now);
+    EXPECT_EQ(stats.timeout(SERVER_B), 100ms);
+}
+
+TEST(NameserverStatsTest, PicksTheFastestAndProbesUnknownServers) {
+    NameserverStats stats(16, 0);
+    auto now = NameserverStats::Clock::now();
+    stats.recordRtt(SERVER_A, 50ms, now);
+    stats.recordRtt(SERVER_B, 20ms, now);
+
+    EXPECT_EQ(stats.select({SERVER_A, SERVER_B}, now), SERVER_B);
+    EXPECT_EQ(stats.select({SERVER_B, SERVER_A}, now), SERVER_B);
+    // Never asked, it looks faster than both until it is
+    EXPECT_EQ(stats.select({SERVER_A, SERVER_B, SERVER_C}, now), SERVER_C);
+}
+
+TEST(NameserverStatsTest, ServersNotPickedDecayBackIntoFavour) {
+    NameserverStats stats(16, 0);
+    auto now = NameserverStats::Clock::now();
+    stats.recordRtt(SERVER_A, 200ms, now);
+    stats.recordRtt(SERVER_B, 50ms, now);
+    EXPECT_EQ(stats.select({SERVER_A, SERVER_B}, now), SERVER_B);
+
+    // Ten idle minutes bring the slow one close to the initial estimate, the used one is measured again
+    auto later = now + 10min;
+    stats.recordRtt(SERVER_B, 50ms, later);
+    EXPECT_EQ(stats.select({SERVER_A, SERVER_B}, later), SERVER_A);
+}
+
+TEST(NameserverStatsTest, RepeatedTimeoutsBackTheServerOff) {
+    NameserverStats stats(16, 0);
+    auto now = NameserverStats::Clock::now();
+    stats.recordRtt(SERVER_A, 10ms, now);
+    stats.recordRtt(SERVER_B, 5000ms, now);
+
+    for (int i = 0; i < NameserverStats::BACKOFF_THRESHOLD; i++) {
+        stats.recordTimeout(SERVER_A, now);
+    }
+    // Even a very slow server beats one in back-off, a lone candidate is asked anyway
+    EXPECT_EQ(stats.select({SERVER_A, SERVER_B}, now), SERVER_B);
+    EXPECT_EQ(stats.select({SERVER_A}, now), SERVER_A);
+
+    // After the 5s back-off the timeout penalty alone is less than the slow server's SRTT
+    EXPECT_EQ(stats.select({SERVER_A, SERVER_B}, now + 6s), SERVER_A);
+
+    // Another timeout doubles the back-off, an answer ends it
+    stats.recordTimeout(SERVER_A, now + 6s);
+    EXPECT_EQ(stats.select({SERVER_A, SERVER_B}, now + 12s), SERVER_B);
+    stats.recordRtt(SERVER_A, 10ms, now + 12s);
+    EXPECT_EQ(stats.select({SERVER_A, SERVER_B}, now + 12s), SERVER_A);
+}
+
+TEST(NameserverStatsTest, TracksABoundedNumberOfServers) {
+    NameserverStats stats(4, 0);
+    auto now = NameserverStats::Clock::now();
+    for (uint32_t i = 0; i < 10; i++) {
+        stats.recordRtt(SERVER_A + i, 30ms, now + std::chrono::seconds(i));
+    }
+    EXPECT_EQ(stats.size(), 4u);
+
+    // The longest unused ones made room, the latest are kept
+    EXPECT_EQ(stats.timeout(SERVER_A), 800ms);
+    EXPECT_NE(stats.timeout(SERVER_A + 9), 800ms);
+    EXPECT_NE(stats.timeout(SERVER_A + 6), 800ms);
+}
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include "ResolverHarness.hpp"
+
+// A forwarder whose upstream denies names with an SOA in the authority section (RFC 2308)
+class NegativeCacheTest : public ResolverHarness {
+protected:
+    const sockaddr_in upstream = Addr("127.0.0.1", 5301);
+
+    void SetUp() override {
+        config.forwarders = {upstream};
+        config.hedgePercentile = 0;
+        config.healthInterval = 3600;
+        start();
+    }
+
+    static std::shared_ptr<dnslib::SOARecord> Soa(uint32_t ttl, uint32_t minimum) {
+        return std::make_shared<dnslib::SOARecord>("example.com", ttl, "ns.example.com", "admin.example.com", 1, 3600, 600, 86400, minimum);
+    }
+
+    void deny(const dnslib::DNSMessageL& query, dnslib::RCODE rcode, std::shared_ptr<dnslib::SOARecord> soa) {
+        auto question = questionOf(query);
+        dnslib::PacketBuilder builder;
+        builder.setId(dnslib::PacketParser::parse(query.data).getHeader().getId());
+        builder.withFlags(dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::RECURSION_DES | dnslib::PacketFlag::RECURSION_AVAIL);
+        builder.withRcode(rcode);
+        builder.addQuestion(question.getName(), question.getType());
+        builder.addAuthority(soa);
+        reply(query, builder);
+    }
+
+    // Seconds the cache keeps the negative entry of key for, 0 if there is none
+    uint32_t cachedFor(const cacheKey& key) {
+        auto expires = std::chrono::steady_clock::time_point::max();
+        if (!cache.getNegative(key, nullptr, &expires).has_value()) return 0;
+        return static_cast<uint32_t>(std::chrono::ceil<std::chrono::seconds>(expires - std::chrono::steady_clock::now()).count());
+    }
+};
+
+TEST_F(NegativeCacheTest, NxdomainIsCachedForTheNameWithTheSoaMinimum) {
+    ask(0x2901, "missing.example.com");
+    deny(next(), dnslib::RCODE::NAMEERROR, Soa(3600, 60));
+    auto response = dnslib::PacketParser::parse(next().data);
+    EXPECT_EQ(response.getHeader().rcode(), dnslib::RCODE::NAMEERROR);
+
+    // min(SOA TTL, MINIMUM), for every type of the name
+    EXPECT_EQ(cachedFor({"missing.example.com", NXDOMAIN_TYPE}), 60u);
+    EXPECT_EQ(cachedFor({"missing.example.com", dnslib::TYPE::A}), 0u);
+    EXPECT_FALSE(cache.get({"missing.example.com", dnslib::TYPE::A}).has_value());
+
+    // Answered from the cache with the SOA as proof, whatever the type
+    ask(0x2902, "missing.example.com", dnslib::TYPE::MX);
+    auto cached = dnslib::PacketParser::parse(next().data);
+    EXPECT_EQ(cached.getHeader().getId(), 0x2902);
+    EXPECT_EQ(cached.getHeader().rcode(), dnslib::RCODE::NAMEERROR);
+    EXPECT_TRUE(cached.getAnswers().empty());
+    ASSERT_EQ(cached.getAuthority().size(), 1u);
+    EXPECT_EQ(cached.getAuthority()[0]->getType(), static_cast<uint16_t>(dnslib::TYPE::SOA));
+    EXPECT_LE(cached.getAuthority()[0]->getTtl(), 60u);
+    EXPECT_TRUE(idle());
+}
+
+TEST_F(NegativeCacheTest, NodataIsCachedPerTypeWithTheSoaTtl) {
+    ask(0x2903, "www.example.com", dnslib::TYPE::MX);
+    deny(next(), dnslib::RCODE::NOERROR, Soa(30, 600));
+    auto response = dnslib::PacketParser::parse(next().data);
+    EXPECT_EQ(response.getHeader().rcode(), dnslib::RCODE::NOERROR);
+    EXPECT_TRUE(response.getAnswers().empty());
+
+    EXPECT_EQ(cachedFor({"www.example.com", dnslib::TYPE::MX}), 30u);
+    EXPECT_EQ(cachedFor({"www.example.com", NXDOMAIN_TYPE}), 0u);
+
+    ask(0x2904, "www.example.com", dnslib::TYPE::MX);
+    auto cached = dnslib::PacketParser::parse(next().data);
+    EXPECT_EQ(cached.getHeader().rcode(), dnslib::RCODE::NOERROR);
+    EXPECT_TRUE(cached.getAnswers().empty());
+    ASSERT_EQ(cached.getAuthority().size(), 1u);
+    EXPECT_EQ(cached.getAuthority()[0]->getType(), static_cast<uint16_t>(dnslib::TYPE::SOA));
+
+    // Other types of the name still go upstream
+    ask(0x2905, "www.example.com");
+    auto query = next();
+    EXPECT_TRUE(isQuery(query));
+    EXPECT_TRUE(SameAddr(query.peerAddress, upstream));
+}
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include "dnssec.hpp"
+#include "nseccache.hpp"
+
+using namespace std::chrono_literals;
+
+constexpr uint16_t A = 1, NS = 2, SOA = 6, MX = 15, RRSIG = 46, NSEC = 47, DNSKEY = 48;
+
+static std::shared_ptr<dnslib::ResourceRecord> Soa(const std::string& zone, uint32_t minimum = 300) {
+    return std::make_shared<dnslib::SOARecord>(zone, 3600, "ns." + zone, "hostmaster." + zone, 1, 7200, 900, 1209600, minimum);
+}
+
+static std::shared_ptr<dnslib::ResourceRecord> Nsec(const std::string& owner, const std::string& next, std::vector<uint16_t> types) {
+    return std::make_shared<dnslib::NSECRecord>(owner, 3600, next, std::move(types));
+}
+
+static std::string Hash(const std::string& name) {
+    return dnslib::utils::toBase32Hex(Validator::nsec3Hash(name, {0xAB}, 1));
+}
+
+static std::vector<uint8_t> HashBytes(const std::string& name) {
+    return Validator::nsec3Hash(name, {0xAB}, 1);
+}
+
+static std::shared_ptr<dnslib::ResourceRecord> Nsec3(const std::string& owner, const std::string& next, std::vector<uint16_t> types,
+                                                     uint8_t flags = 0) {
+    return std::make_shared<dnslib::NSEC3Record>(Hash(owner) + ".example", 3600, 1, flags, 1, std::vector<uint8_t>{0xAB},
+                                                 HashBytes(next), std::move(types));
+}
+
+TEST(NsecCacheTest, DeniesNamesAndTypesInsideCachedRanges) {
+    NsecCache cache(100, 3600);
+    auto now = NsecCache::Clock::now();
+
+    // alpha and delta exist, nothing between them nor under the apex wildcard
+    cache.store({Soa("example.com"), Nsec("example.com", "alpha.example.com", {NS, SOA, RRSIG, NSEC, DNSKEY}),
+                 Nsec("alpha.example.com", "delta.example.com", {A, RRSIG, NSEC})}, now);
+    EXPECT_EQ(cache.size(), 2u);
+
+    auto denial = cache.lookup("Bravo.Example.com", dnslib::TYPE::A, now);
+    ASSERT_TRUE(denial.has_value());
+    EXPECT_EQ(denial->rcode, dnslib::RCODE::NAMEERROR);
+    EXPECT_EQ(denial->soa->getName(), "example.com");
+    EXPECT_EQ(cache.lookup("x.charlie.example.com", dnslib::TYPE::A, now)->rcode, dnslib::RCODE::NAMEERROR);
+
+    auto nodata = cache.lookup("alpha.example.com", dnslib::TYPE::MX, now);
+    ASSERT_TRUE(nodata.has_value());
+    EXPECT_EQ(nodata->rcode, dnslib::RCODE::NOERROR);
+
+    // Existing data, names past the known ranges and other zones stay upstream business
+    EXPECT_FALSE(cache.lookup("alpha.example.com", dnslib::TYPE::A, now).has_value());
+    EXPECT_FALSE(cache.lookup("echo.example.com", dnslib::TYPE::A, now).has_value());
+    EXPECT_FALSE(cache.lookup("bravo.example.org", dnslib::TYPE::A, now).has_value());
+}
+
+TEST(NsecCacheTest, ProvesNothingBelowADelegation) {
+    NsecCache cache(100, 3600);
+    auto now = NsecCache::Clock::now();
+
+    cache.store({Soa("example.com"), Nsec("example.com", "sub.example.com", {NS, SOA, RRSIG, NSEC, DNSKEY}),
+                 Nsec("sub.example.com", "zulu.example.com", {NS, RRSIG, NSEC})}, now);
+
+    // The names under sub live in the child zone, the parent NSEC only covers them by its order
+    EXPECT_FALSE(cache.lookup("www.sub.example.com", dnslib::TYPE::A, now).has_value());
+    EXPECT_EQ(cache.lookup("tango.example.com", dnslib::TYPE::A, now)->rcode, dnslib::RCODE::NAMEERROR);
+}
+
+TEST(NsecCacheTest, DeniesWithHashedRanges) {
+    NsecCache cache(100, 3600);
+    auto now = NsecCache::Clock::now();
+
+    // The apex and www are the only names, the two records close the hash ring
+    cache.store({Soa("example"), Nsec3("example", "www.example", {NS, SOA, RRSIG, DNSKEY}),
+                 Nsec3("www.example", "example", {A, RRSIG})}, now);
+
+    EXPECT_EQ(cache.lookup("nope.example", dnslib::TYPE::A, now)->rcode, dnslib::RCODE::NAMEERROR);
+    EXPECT_EQ(cache.lookup("www.example", dnslib::TYPE::MX, now)->rcode, dnslib::RCODE::NOERROR);
+    EXPECT_FALSE(cache.lookup("www.example", dnslib::TYPE::A, now).has_value());
+}
+
+TEST(NsecCacheTest, SkipsOptOutSpans) {
+    NsecCache cache(100, 3600);
+    auto now = NsecCache::Clock::now();
+
+    cache.store({Soa("example"), Nsec3("example", "www.example", {NS, SOA, RRSIG, DNSKEY}, dnslib::NSEC3Record::OPT_OUT),
+                 Nsec3("www.example", "example", {A, RRSIG}, dnslib::NSEC3Record::OPT_OUT)}, now);
+
+    EXPECT_EQ(cache.size(), 0u);
+    EXPECT_FALSE(cache.lookup("nope.example", dnslib::TYPE::A, now).has_value());
+}
+
+TEST(NsecCacheTest, RecordsLastNoLongerThanTheSoaMinimum) {
+    NsecCache cache(100, 3600);
+    auto now = NsecCache::Clock::now();
+
+    cache.store({Soa("example.com", 60), Nsec("example.com", "www.example.com", {NS, SOA, RRSIG, NSEC})}, now);
+    EXPECT_TRUE(cache.lookup("mail.example.com", dnslib::TYPE::A, now + 59s).has_value());
+    EXPECT_FALSE(cache.lookup("mail.example.com", dnslib::TYPE::A, now + 60s).has_value());
+}
+
+TEST(NsecCacheTest, DropsOtherZonesWhenFull) {
+    NsecCache cache(2, 3600);
+    auto now = NsecCache::Clock::now();
+
+    cache.store({Soa("example.com"), Nsec("example.com", "www.example.com", {NS, SOA, RRSIG, NSEC}),
+                 Nsec("www.example.com", "example.com", {A, RRSIG, NSEC})}, now);
+    cache.store({Soa("example.org"), Nsec("example.org", "www.example.org", {NS, SOA, RRSIG, NSEC})}, now + 1s);
+
+    EXPECT_FALSE(cache.lookup("mail.example.com", dnslib::TYPE::A, now + 1s).has_value());
+    EXPECT_TRUE(cache.lookup("mail.example.org", dnslib::TYPE::A, now + 1s).has_value());
+    EXPECT_EQ(cache.size(), 1u);
+}
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include "ResolverHarness.hpp"
+#include "utils/metrics.hpp"
+
+using namespace std::chrono_literals;
+
+static std::shared_ptr<RecordList> Address(const std::string& name, uint32_t ttl) {
+    return std::make_shared<RecordList>(RecordList{std::make_shared<dnslib::ARecord>(name, ttl, "192.0.2.1")});
+}
+
+TEST(PrefetchQueueTest, PopularEntriesNearExpiryAreQueuedOnce) {
+    TLRUCache cache(10);
+    cache.setPrefetch(50, 1);
+    cacheKey key{"www.example.com", dnslib::TYPE::A};
+    cacheKey rare{"rare.example.com", dnslib::TYPE::A};
+    cache.put(key, Address(key.name, 2), 2);
+    cache.put(rare, Address(rare.name, 2), 2);
+
+    // Early in its lifetime a hit queues nothing
+    cache.get(key);
+    cache.get(key);
+    EXPECT_TRUE(cache.takePrefetchCandidates().empty());
+
+    std::this_thread::sleep_for(1100ms);
+    cache.get(key);
+    cache.get(key);
+    EXPECT_EQ(cache.takePrefetchCandidates(), std::vector<cacheKey>{key});
+    cache.get(key);
+    EXPECT_TRUE(cache.takePrefetchCandidates().empty());
+
+    // Fewer hits per minute than asked for
+    cache.setPrefetch(50, 1000);
+    cache.get(rare);
+    EXPECT_TRUE(cache.takePrefetchCandidates().empty());
+
+    // A refreshed entry may be queued again
+    cache.setPrefetch(50, 1);
+    cache.put(key, Address(key.name, 2), 0);
+    cache.getStale(key);
+    cache.put(key, Address(key.name, 1), 1);
+    std::this_thread::sleep_for(600ms);
+    cache.get(key);
+    EXPECT_EQ(cache.takePrefetchCandidates(), std::vector<cacheKey>{key});
+}
+
+// A forwarder with entries of two seconds, refreshed in the last half of their lifetime
+class PrefetchTest : public ResolverHarness {
+protected:
+    const sockaddr_in upstream = Addr("127.0.0.1", 5301);
+
+    void SetUp() override {
+        config.forwarders = {upstream};
+        config.hedgePercentile = 0;
+        config.healthInterval = 3600;
+        config.prefetchLimit = 1;
+        cache.setPrefetch(50, 1);
+        start();
+    }
+
+    void answer(const dnslib::DNSMessageL& query, uint32_t ttl) {
+        auto question = questionOf(query);
+        dnslib::PacketBuilder builder;
+        builder.setId(dnslib::PacketParser::parse(query.data).getHeader().getId());
+        builder.withFlags(dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::RECURSION_DES | dnslib::PacketFlag::RECURSION_AVAIL);
+        builder.addQuestion(question.getName(), question.getType());
+        builder.addAnswer(std::make_shared<dnslib::ARecord>(question.getName(), ttl, "192.0.2.1"));
+        reply(query, builder);
+    }
+
+    // Seconds the cache keeps key for, 0 if it is not cached
+    uint32_t cachedFor(const cacheKey& key) {
+        auto expires = std::chrono::steady_clock::time_point::max();
+        if (!cache.get(key, nullptr, Trust::ANSWER, &expires).has_value()) return 0;
+        return static_cast<uint32_t>(std::chrono::ceil<std::chrono::seconds>(expires - std::chrono::steady_clock::now()).count());
+    }
+};
+
+TEST_F(PrefetchTest, PopularEntryIsRefreshedInTheBackgroundOnce) {
+    auto& completed = utils::Metrics::get().counter("prefetch.completed");
+    uint64_t before = completed.load();
+
+    ask(0x3001, "www.example.com");
+    answer(next(), 2);
+    EXPECT_FALSE(isQuery(next()));
+
+    std::this_thread::sleep_for(1100ms);
+
+    // The client is answered from the cache, the refresh goes out behind it
+    ask(0x3002, "www.example.com");
+    auto response = next();
+    EXPECT_FALSE(isQuery(response));
+    EXPECT_EQ(dnslib::PacketParser::parse(response.data).getHeader().getId(), 0x3002);
+    auto refresh = next();
+    ASSERT_TRUE(isQuery(refresh));
+    EXPECT_EQ(questionOf(refresh).getName(), "www.example.com");
+
+    // Not queued again while the refresh is in flight
+    ask(0x3003, "www.example.com");
+    EXPECT_FALSE(isQuery(next()));
+    EXPECT_TRUE(idle());
+
+    answer(refresh, 300);
+    EXPECT_TRUE(idle());
+    EXPECT_EQ(completed.load(), before + 1);
+    EXPECT_EQ(cachedFor({"www.example.com", dnslib::TYPE::A}), 300u);
+}
+
+TEST_F(PrefetchTest, RefreshesStopAtTheBudget) {
+    auto& limited = utils::Metrics::get().counter("prefetch.rate_limited");
+    uint64_t before = limited.load();
+
+    for (std::string name : {"a.example.com", "b.example.com"}) {
+        cache.put({name, dnslib::TYPE::A}, Address(name, 2), 2);
+    }
+    std::this_thread::sleep_for(1100ms);
+
+    // One refresh per second: the first popular entry gets it, the second is skipped
+    ask(0x3004, "a.example.com");
+    EXPECT_FALSE(isQuery(next()));
+    EXPECT_TRUE(isQuery(next()));
+    ask(0x3005, "b.example.com");
+    EXPECT_FALSE(isQuery(next()));
+    EXPECT_TRUE(idle());
+    EXPECT_EQ(limited.load(), before + 1);
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include "ratelimit.hpp"
+
+using Action = ResponseRateLimiter::Action;
+using namespace std::chrono_literals;
+
+static sockaddr_in Client(const char* ip) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+    return addr;
+}
+
+// Header with one question for "a." type A and the given rcode and answer count
+static std::vector<uint8_t> Response(uint8_t rcode, uint8_t answers) {
+    std::vector<uint8_t> wire = {0x12, 0x34, 0x81, static_cast<uint8_t>(0x80 | rcode), 0, 1, 0, answers, 0, 0, 0, 0,
+                                 1, 'a', 0, 0, 1, 0, 1};
+    for (int i = 0; i < answers; i++) {
+        wire.insert(wire.end(), {0xc0, 12, 0, 1, 0, 1, 0, 0, 0, 60, 0, 4, 10, 0, 0, 1});
+    }
+    return wire;
+}
+
+TEST(RateLimitTest, LimitsPerPrefixAfterTheBurst) {
+    ResponseRateLimiter rrl(5, 0);
+    auto now = ResponseRateLimiter::Clock::now();
+    auto answer = Response(0, 1);
+
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(rrl.check(Client("192.0.2.1"), answer, now), Action::SEND);
+    }
+    // Same /24, other host
+    EXPECT_EQ(rrl.check(Client("192.0.2.77"), answer, now), Action::DROP);
+    EXPECT_EQ(rrl.limitedCount(now), 1u);
+
+    // Other prefix, and other response kind from the same prefix
+    EXPECT_EQ(rrl.check(Client("192.0.3.1"), answer, now), Action::SEND);
+    EXPECT_EQ(rrl.check(Client("192.0.2.1"), Response(3, 0), now), Action::SEND);
+}
+
+TEST(RateLimitTest, RefillsOverTime) {
+    ResponseRateLimiter rrl(10, 0);
+    auto now = ResponseRateLimiter::Clock::now();
+    auto answer = Response(0, 1);
+
+    for (int i = 0; i < 10; i++) {
+        rrl.check(Client("198.51.100.1"), answer, now);
+    }
+    EXPECT_EQ(rrl.check(Client("198.51.100.1"), answer, now), Action::DROP);
+    EXPECT_EQ(rrl.check(Client("198.51.100.1"), answer, now + 100ms), Action::SEND);
+    EXPECT_EQ(rrl.limitedCount(now + 2s), 0u);
+}
+
+TEST(RateLimitTest, SlipsEveryNthRefusedResponse) {
+    ResponseRateLimiter rrl(1, 2);
+    auto now = ResponseRateLimiter::Clock::now();
+    auto answer = Response(0, 1);
+
+    EXPECT_EQ(rrl.check(Client("203.0.113.9"), answer, now), Action::SEND);
+    EXPECT_EQ(rrl.check(Client("203.0.113.9"), answer, now), Action::DROP);
+    EXPECT_EQ(rrl.check(Client("203.0.113.9"), answer, now), Action::SLIP);
+    EXPECT_EQ(rrl.check(Client("203.0.113.9"), answer, now), Action::DROP);
+    EXPECT_EQ(rrl.check(Client("203.0.113.9"), answer, now), Action::SLIP);
+}
+
+TEST(RateLimitTest, TruncatedResponseKeepsOnlyTheQuestion) {
+    auto answer = Response(0, 2);
+    auto truncated = ResponseRateLimiter::truncate(answer);
+
+    ASSERT_EQ(truncated.size(), 19u);
+    EXPECT_EQ(truncated[0], 0x12);
+    EXPECT_TRUE(truncated[2] & 0x02);
+    EXPECT_EQ(truncated[5], 1);
+    EXPECT_EQ(truncated[7], 0);
+    EXPECT_EQ(truncated[14], 0);
+}
+
+TEST(RateLimitTest, FixedTableEvictsOldEntries) {
+    ResponseRateLimiter rrl(1, 0, 64);
+    auto now = ResponseRateLimiter::Clock::now();
+    auto answer = Response(0, 1);
+
+    EXPECT_EQ(rrl.check(Client("10.0.0.1"), answer, now), Action::SEND);
+    EXPECT_EQ(rrl.check(Client("10.0.0.1"), answer, now), Action::DROP);
+    for (int i = 1; i <= 1000; i++) {
+        std::string ip = "10." + std::to_string(i / 256) + "." + std::to_string(i % 256) + ".1";
+        rrl.check(Client(ip.c_str()), answer, now + 1ms);
+    }
+    // Forgotten, it starts over with a full bucket
+    EXPECT_EQ(rrl.check(Client("10.0.0.1"), answer, now + 2ms), Action::SEND);
+}
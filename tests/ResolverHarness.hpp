@@ -0,0 +1,112 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "resolver.hpp"
+
+// The resolver is driven through its queues, the tests play both the
+// client and the servers it asks. Fixtures derive from ResolverHarness,
+// fill in config, call start() and answer upstream queries in serve().
+
+inline sockaddr_in Addr(const char* ip, uint16_t port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+    return addr;
+}
+
+inline bool SameAddr(const sockaddr_in& a, const sockaddr_in& b) {
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+class ResolverHarness : public ::testing::Test {
+protected:
+    const sockaddr_in client = Addr("127.0.0.1", 40000);
+    const uint32_t root = 0xC707532A;           // 199.7.83.42, where iterative walks start
+
+    ServerConfig config;
+    TLRUCache cache{100};
+    utils::ETSQueue<dnslib::DNSMessageL> out;
+    // Declared before the executor so that no worker still runs when it is destroyed
+    std::unique_ptr<Resolver> resolver;
+    utils::Executor executor{2};
+
+    void start() {
+        resolver = std::make_unique<Resolver>(executor, cache, out, config);
+    }
+
+    dnslib::DNSMessageL query(uint16_t id, const std::string& name, dnslib::TYPE type = dnslib::TYPE::A, bool recursionDesired = true) {
+        dnslib::PacketBuilder builder;
+        builder.setId(id);
+        if (recursionDesired) {
+            builder.withFlags(dnslib::PacketFlag::RECURSION_DES);
+        }
+        builder.addQuestion(name, type);
+
+        dnslib::DNSMessageL message{};
+        message.peerAddress = client;
+        builder.build().serialize(message.data);
+        return message;
+    }
+
+    void ask(uint16_t id, const std::string& name, dnslib::TYPE type = dnslib::TYPE::A, bool recursionDesired = true) {
+        resolver->handleMessage(query(id, name, type, recursionDesired));
+    }
+
+    // Hands the message of builder to the resolver as the reply of the server query went to
+    void reply(const dnslib::DNSMessageL& query, dnslib::PacketBuilder& builder) {
+        dnslib::DNSMessageL message{};
+        message.peerAddress = query.peerAddress;
+        builder.build().serialize(message.data);
+        resolver->handleMessage(std::move(message));
+    }
+
+    // Answers an upstream query, nothing by default
+    virtual void serve(const dnslib::DNSMessageL&) {}
+
+    // Resolutions run on the executor, give them a moment to produce the next message
+    dnslib::DNSMessageL next() {
+        dnslib::DNSMessageL message;
+        EXPECT_TRUE(out.popFor(message, std::chrono::milliseconds(1000)));
+        return message;
+    }
+
+    bool idle(std::chrono::milliseconds wait = std::chrono::milliseconds(30)) {
+        dnslib::DNSMessageL message;
+        return !out.popFor(message, wait);
+    }
+
+    // Serves upstream queries until count client responses are out, returns them with the queries seen
+    std::vector<dnslib::DNSPacket> run(size_t count, std::vector<dnslib::DNSMessageL>& queries,
+                                       std::chrono::milliseconds wait = std::chrono::milliseconds(1000)) {
+        std::vector<dnslib::DNSPacket> responses;
+        dnslib::DNSMessageL message;
+        while (responses.size() < count && out.popFor(message, wait)) {
+            if (isQuery(message)) {
+                queries.push_back(message);
+                serve(message);
+            } else {
+                responses.push_back(dnslib::PacketParser::parse(message.data));
+            }
+        }
+        return responses;
+    }
+
+    static bool isQuery(const dnslib::DNSMessageL& message) {
+        return dnslib::PacketParser::parse(message.data).getHeader().isQuery();
+    }
+
+    // Server a query went to, host order
+    static uint32_t serverOf(const dnslib::DNSMessageL& query) {
+        return ntohl(query.peerAddress.sin_addr.s_addr);
+    }
+
+    static dnslib::DNSQuestion questionOf(const dnslib::DNSMessageL& query) {
+        return dnslib::PacketParser::parse(query.data).getQuestions()[0];
+    }
+};
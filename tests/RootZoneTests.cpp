@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include "rootzone.hpp"
+
+static const char* ZONE = R"(; excerpt of root.zone
+.			86400	IN	SOA	a.root-servers.net. nstld.verisign-grs.com. 2026101900 1800 900 604800 86400
+.			518400	IN	NS	a.root-servers.net.
+a.root-servers.net.	518400	IN	A	198.41.0.4
+a.root-servers.net.	518400	IN	AAAA	2001:503:ba3e::2:30
+com.			172800	IN	NS	a.gtld-servers.net.
+com.			172800	IN	NS	b.gtld-servers.net.
+com.			86400	IN	DS	19718 13 2 8acbb0cd28f41250a80a491389424d341522d946b0da0c0291f2d3d771d7805a
+a.gtld-servers.net.	172800	IN	A	192.5.6.30
+b.gtld-servers.net.	172800	IN	A	192.33.14.30
+net.	172800	IN	NS	a.gtld-servers.net.
+example	3600	IN	NS	( ns1.example.
+	)
+)";
+
+class RootZoneTest : public ::testing::Test {
+protected:
+    std::string path = testing::TempDir() + "root.zone";
+
+    void write(const std::string& content) {
+        std::ofstream(path) << content;
+    }
+
+    void TearDown() override {
+        std::remove(path.c_str());
+    }
+};
+
+TEST_F(RootZoneTest, LoadsDelegationsAndGlue) {
+    write(ZONE);
+    auto zone = RootZone::load(path);
+
+    EXPECT_EQ(zone->serial(), 2026101900u);
+    EXPECT_EQ(zone->tldCount(), 3u);
+    EXPECT_FALSE(zone->expired());
+}
+
+TEST_F(RootZoneTest, ReferralCarriesNsAndGlue) {
+    write(ZONE);
+    auto packet = RootZone::load(path)->answer("www.Example.COM", dnslib::TYPE::A);
+
+    ASSERT_TRUE(packet.has_value());
+    EXPECT_EQ(packet->getHeader().rcode(), dnslib::RCODE::NOERROR);
+    EXPECT_TRUE(packet->getAnswers().empty());
+    ASSERT_EQ(packet->getAuthority().size(), 2u);
+    EXPECT_EQ(packet->getAuthority()[0]->getName(), "com");
+    ASSERT_EQ(packet->getAdditional().size(), 2u);
+    auto glue = std::dynamic_pointer_cast<dnslib::ARecord>(packet->getAdditional()[0]);
+    ASSERT_TRUE(glue);
+    EXPECT_EQ(glue->getIpAddress(), 0xC005061Eu);
+}
+
+TEST_F(RootZoneTest, UndelegatedTldIsNxdomainWithSoa) {
+    write(ZONE);
+    auto packet = RootZone::load(path)->answer("printer.lan", dnslib::TYPE::A);
+
+    ASSERT_TRUE(packet.has_value());
+    EXPECT_EQ(packet->getHeader().rcode(), dnslib::RCODE::NAMEERROR);
+    ASSERT_EQ(packet->getAuthority().size(), 1u);
+    EXPECT_EQ(packet->getAuthority()[0]->getType(), static_cast<uint16_t>(dnslib::TYPE::SOA));
+}
+
+TEST_F(RootZoneTest, QuestionsForSkippedRecordsGoToTheNetwork) {
+    write(ZONE);
+    auto zone = RootZone::load(path);
+
+    EXPECT_FALSE(zone->answer("com", static_cast<dnslib::TYPE>(43)).has_value());
+    EXPECT_FALSE(zone->answer("", dnslib::TYPE::MX).has_value());
+    EXPECT_EQ(zone->answer("", dnslib::TYPE::NS)->getAnswers().size(), 1u);
+}
+
+TEST_F(RootZoneTest, RejectsInvalidZones) {
+    write(". 86400 IN NS a.root-servers.net.\ncom. 172800 IN NS a.gtld-servers.net.\n");
+    EXPECT_THROW(RootZone::load(path), std::runtime_error);
+
+    write(std::string(ZONE) + "sub.com. 3600 IN NS ns.sub.com.\n");
+    EXPECT_THROW(RootZone::load(path), std::runtime_error);
+
+    write(std::string(ZONE) + "com. IN NS b.gtld-servers.net. extra\n");
+    EXPECT_THROW(RootZone::load(path), std::runtime_error);
+
+    EXPECT_THROW(RootZone::load(path + ".missing"), std::runtime_error);
+}
+
+TEST_F(RootZoneTest, ExpiresAfterSoaExpireSinceLastModified) {
+    write(". 86400 IN SOA a.root-servers.net. nstld.verisign-grs.com. 1 1800 900 0 86400\n"
+          ". 518400 IN NS a.root-servers.net.\n"
+          "com. 172800 IN NS a.gtld-servers.net.\n");
+    auto zone = RootZone::load(path);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    EXPECT_TRUE(zone->expired());
+}
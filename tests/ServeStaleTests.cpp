@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include "ResolverHarness.hpp"
+#include "utils/metrics.hpp"
+
+using namespace std::chrono_literals;
+
+// A forwarder whose upstream never answers, expired entries are all it has (RFC 8767)
+class ServeStaleTest : public ResolverHarness {
+protected:
+    const sockaddr_in upstream = Addr("127.0.0.1", 5301);
+
+    void SetUp() override {
+        config.forwarders = {upstream};
+        config.hedgePercentile = 0;
+        config.healthInterval = 3600;
+        config.staleAnswerTimeout = 100;
+        config.queryBudget = 400;
+        cache.setStaleWindow(std::chrono::seconds(3600));
+        start();
+    }
+
+    // Stores an entry that expires as it is stored
+    void expired(const std::string& name, Security security = Security::UNCHECKED, Trust trust = Trust::ANSWER) {
+        auto records = std::make_shared<RecordList>(RecordList{std::make_shared<dnslib::ARecord>(name, 300, "192.0.2.1")});
+        cache.put({name, dnslib::TYPE::A}, records, 0, security, trust);
+    }
+
+    // Asks for name and returns the client's response, the upstream query is left unanswered
+    dnslib::DNSPacket unanswered(uint16_t id, const std::string& name, std::chrono::steady_clock::duration& waited) {
+        auto start = std::chrono::steady_clock::now();
+        ask(id, name);
+        auto query = next();
+        EXPECT_TRUE(SameAddr(query.peerAddress, upstream));
+        auto response = next();
+        waited = std::chrono::steady_clock::now() - start;
+        EXPECT_TRUE(SameAddr(response.peerAddress, client));
+        return dnslib::PacketParser::parse(response.data);
+    }
+};
+
+TEST_F(ServeStaleTest, ExpiredAnswerIsServedWhenTheUpstreamIsSlow) {
+    auto& stale = utils::Metrics::get().counter("stale.answers");
+    uint64_t before = stale.load();
+    expired("www.example.com");
+
+    std::chrono::steady_clock::duration waited;
+    auto response = unanswered(0x3101, "www.example.com", waited);
+    EXPECT_GE(waited, 100ms);
+    EXPECT_LT(waited, 400ms);
+    EXPECT_EQ(response.getHeader().rcode(), dnslib::RCODE::NOERROR);
+    ASSERT_EQ(response.getAnswers().size(), 1u);
+    EXPECT_EQ(response.getAnswers()[0]->getTtl(), 30u);
+    EXPECT_EQ(stale.load(), before + 1);
+
+    // The resolution running out later sends nothing more
+    EXPECT_TRUE(idle(500ms));
+}
+
+TEST_F(ServeStaleTest, BogusAndGlueAreNeverServedStale) {
+    expired("bogus.example.com", Security::BOGUS);
+    expired("ns.example.com", Security::UNCHECKED, Trust::GLUE);
+
+    for (std::string name : {"bogus.example.com", "ns.example.com"}) {
+        std::chrono::steady_clock::duration waited;
+        auto response = unanswered(0x3102, name, waited);
+        EXPECT_EQ(response.getHeader().rcode(), dnslib::RCODE::SERVERFAILURE) << name;
+        EXPECT_GE(waited, 400ms) << name;
+    }
+}
+
+TEST_F(ServeStaleTest, NothingOlderThanTheWindowIsServed) {
+    cache.setStaleWindow(std::chrono::seconds(1));
+    expired("old.example.com");
+    std::this_thread::sleep_for(1100ms);
+    EXPECT_FALSE(cache.getStale({"old.example.com", dnslib::TYPE::A}).has_value());
+
+    std::chrono::steady_clock::duration waited;
+    auto response = unanswered(0x3103, "old.example.com", waited);
+    EXPECT_EQ(response.getHeader().rcode(), dnslib::RCODE::SERVERFAILURE);
+    EXPECT_TRUE(response.getAnswers().empty());
+}
@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <condition_variable>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include "tcppool.hpp"
+
+// Listening socket on a free loopback port
+static int Listen(sockaddr_in& address) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+    listen(fd, 8);
+    return fd;
+}
+
+static bool ReadMessage(int fd, std::vector<uint8_t>& message) {
+    uint8_t prefix[2];
+    if (recv(fd, prefix, 2, MSG_WAITALL) != 2) return false;
+    message.resize((prefix[0] << 8) | prefix[1]);
+    return recv(fd, message.data(), message.size(), MSG_WAITALL) == static_cast<ssize_t>(message.size());
+}
+
+static void WriteMessage(int fd, std::vector<uint8_t> message) {
+    message[2] |= 0x80;
+    uint8_t prefix[2] = {static_cast<uint8_t>(message.size() >> 8), static_cast<uint8_t>(message.size())};
+    ::send(fd, prefix, 2, 0);
+    ::send(fd, message.data(), message.size(), 0);
+}
+
+static std::vector<uint8_t> Query(uint16_t id) {
+    return {static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id), 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 'a', 0, 0, 1, 0, 1};
+}
+
+static TcpPool::Clock::time_point Deadline(std::chrono::milliseconds timeout = std::chrono::seconds(5)) {
+    return TcpPool::Clock::now() + timeout;
+}
+
+class TcpPoolTest : public ::testing::Test {
+protected:
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::vector<uint16_t> answered;
+
+    TcpPool::Deliver collect() {
+        return [this](dnslib::DNSMessageL message) {
+            std::lock_guard<std::mutex> lock(mtx);
+            EXPECT_EQ(message.protocol, dnslib::PROTO::TCP);
+            answered.push_back((message.data[0] << 8) | message.data[1]);
+            cond.notify_all();
+        };
+    }
+
+    bool waitFor(size_t count) {
+        std::unique_lock<std::mutex> lock(mtx);
+        return cond.wait_for(lock, std::chrono::seconds(2), [&] { return answered.size() >= count; });
+    }
+};
+
+TEST_F(TcpPoolTest, PipelinesQueriesOnOneConnection) {
+    sockaddr_in server;
+    int listener = Listen(server);
+    int accepted = 0;
+
+    std::thread upstream([&] {
+        int fd = accept(listener, nullptr, nullptr);
+        accepted++;
+        std::vector<uint8_t> first, second;
+        ASSERT_TRUE(ReadMessage(fd, first));
+        ASSERT_TRUE(ReadMessage(fd, second));
+        // Out of order
+        WriteMessage(fd, second);
+        WriteMessage(fd, first);
+        close(fd);
+    });
+
+    TcpPool pool(collect(), 2, std::chrono::seconds(10));
+    pool.send(server, Query(0x0101), Deadline());
+    pool.send(server, Query(0x0202), Deadline());
+
+    ASSERT_TRUE(waitFor(2));
+    EXPECT_EQ(answered, (std::vector<uint16_t>{0x0202, 0x0101}));
+    upstream.join();
+    EXPECT_EQ(accepted, 1);
+    close(listener);
+}
+
+TEST_F(TcpPoolTest, ResendsWhenTheServerClosesEarly) {
+    sockaddr_in server;
+    int listener = Listen(server);
+
+    std::thread upstream([&] {
+        // The first connection is dropped without an answer
+        int fd = accept(listener, nullptr, nullptr);
+        std::vector<uint8_t> query;
+        ASSERT_TRUE(ReadMessage(fd, query));
+        close(fd);
+
+        fd = accept(listener, nullptr, nullptr);
+        ASSERT_TRUE(ReadMessage(fd, query));
+        WriteMessage(fd, query);
+        close(fd);
+    });
+
+    TcpPool pool(collect(), 1, std::chrono::seconds(10));
+    pool.send(server, Query(0x0303), Deadline());
+
+    ASSERT_TRUE(waitFor(1));
+    EXPECT_EQ(answered[0], 0x0303);
+    upstream.join();
+    close(listener);
+}
+
+TEST_F(TcpPoolTest, ClosesConnectionsWhoseQueriesAllExpired) {
+    sockaddr_in server;
+    int listener = Listen(server);
+    bool closed = false;
+
+    std::thread upstream([&] {
+        // Reads the query and never answers
+        int fd = accept(listener, nullptr, nullptr);
+        std::vector<uint8_t> query;
+        ASSERT_TRUE(ReadMessage(fd, query));
+        uint8_t byte;
+        closed = recv(fd, &byte, 1, 0) == 0;
+        close(fd);
+    });
+
+    TcpPool pool(collect(), 1, std::chrono::seconds(60));
+    pool.send(server, Query(0x0404), Deadline(std::chrono::milliseconds(200)));
+
+    // Long before the idle timeout
+    auto start = TcpPool::Clock::now();
+    upstream.join();
+    EXPECT_TRUE(closed);
+    EXPECT_LT(TcpPool::Clock::now() - start, std::chrono::seconds(3));
+    for (int i = 0; i < 100 && pool.connectionCount() > 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(pool.connectionCount(), 0u);
+    close(listener);
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <thread>
+#include "throttle.hpp"
+#include "utils/task.hpp"
+
+using namespace std::chrono_literals;
+
+constexpr uint32_t SERVER = 0x0A000001;     // 10.0.0.1
+constexpr uint32_t OTHER = 0x0A000002;
+
+static bool WaitFor(const std::function<bool()>& condition, std::chrono::milliseconds limit = 2000ms) {
+    auto until = std::chrono::steady_clock::now() + limit;
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > until) return false;
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+TEST(ThrottleTest, QueuesQueriesOverTheCapInOrder) {
+    utils::Executor executor(2);
+    ServerThrottle throttle(executor, 2, 0);
+    auto deadline = ServerThrottle::Clock::now() + 5s;
+
+    std::mutex mtx;
+    std::vector<int> order;
+    auto query = [&](int index, uint32_t address) -> utils::Task<void> {
+        bool granted = co_await throttle.acquire(address, deadline);
+        if (granted) {
+            std::lock_guard<std::mutex> lock(mtx);
+            order.push_back(index);
+        }
+    };
+    auto granted = [&] {
+        std::lock_guard<std::mutex> lock(mtx);
+        return order.size();
+    };
+
+    for (int i = 0; i < 5; i++) {
+        utils::spawn(executor, query(i, SERVER));
+        ASSERT_TRUE(WaitFor([&] { return granted() == static_cast<size_t>(std::min(i + 1, 2)) && throttle.queued(SERVER) == static_cast<size_t>(std::max(i - 1, 0)); }));
+    }
+    EXPECT_EQ(throttle.queued(SERVER), 3u);
+
+    // Another server is not held up
+    utils::spawn(executor, query(9, OTHER));
+    ASSERT_TRUE(WaitFor([&] { return granted() == 3; }));
+
+    throttle.release(SERVER);
+    ASSERT_TRUE(WaitFor([&] { return granted() == 4; }));
+    throttle.release(SERVER);
+    ASSERT_TRUE(WaitFor([&] { return granted() == 5; }));
+    throttle.release(SERVER);
+    ASSERT_TRUE(WaitFor([&] { return granted() == 6; }));
+
+    std::lock_guard<std::mutex> lock(mtx);
+    EXPECT_EQ(order, (std::vector<int>{0, 1, 9, 2, 3, 4}));
+    EXPECT_EQ(throttle.queued(SERVER), 0u);
+    EXPECT_NE(throttle.toString().find("10.0.0.1 outstanding=2 queued=0 delayed=3"), std::string::npos);
+}
+
+TEST(ThrottleTest, PacesQueriesPastTheBurst) {
+    utils::Executor executor(2);
+    ServerThrottle throttle(executor, 0, 50);
+    auto start = ServerThrottle::Clock::now();
+    auto deadline = start + 5s;
+
+    std::atomic<int> granted = 0;
+    std::promise<ServerThrottle::Clock::duration> last;
+    auto query = [&]() -> utils::Task<void> {
+        if (co_await throttle.acquire(SERVER, deadline) && ++granted == 55) {
+            last.set_value(ServerThrottle::Clock::now() - start);
+        }
+    };
+    for (int i = 0; i < 55; i++) {
+        utils::spawn(executor, query());
+    }
+
+    // The burst goes at once, the 5 others one token (20ms) apart
+    auto future = last.get_future();
+    ASSERT_EQ(future.wait_for(2s), std::future_status::ready);
+    EXPECT_GE(future.get(), 90ms);
+    EXPECT_EQ(throttle.queued(SERVER), 0u);
+}
+
+TEST(ThrottleTest, GivesUpAtTheDeadline) {
+    utils::Executor executor(1);
+    ServerThrottle throttle(executor, 1, 0);
+    auto now = ServerThrottle::Clock::now();
+
+    std::promise<bool> first;
+    std::promise<bool> second;
+    auto query = [&](std::promise<bool>& result, ServerThrottle::Clock::time_point deadline) -> utils::Task<void> {
+        bool granted = co_await throttle.acquire(SERVER, deadline);
+        result.set_value(granted);
+    };
+    utils::spawn(executor, query(first, now + 5s));
+    EXPECT_TRUE(first.get_future().get());
+    utils::spawn(executor, query(second, now + 50ms));
+
+    auto future = second.get_future();
+    ASSERT_EQ(future.wait_for(2s), std::future_status::ready);
+    EXPECT_FALSE(future.get());
+    EXPECT_EQ(throttle.queued(SERVER), 0u);
+
+    // The expired query left no slot taken, the next one gets the released slot
+    throttle.release(SERVER);
+    std::promise<bool> third;
+    utils::spawn(executor, query(third, now + 5s));
+    EXPECT_TRUE(third.get_future().get());
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include "upstream.hpp"
+
+static sockaddr_in Addr(const char* ip, uint16_t port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+    return addr;
+}
+
+static UpstreamPool TwoUpstreams(double hedgePercentile = 90) {
+    return UpstreamPool({Addr("127.0.0.1", 5301), Addr("127.0.0.1", 5302)}, hedgePercentile);
+}
+
+TEST(UpstreamPoolTest, FindMatchesAddressAndPort) {
+    auto pool = TwoUpstreams();
+
+    EXPECT_EQ(pool.find(Addr("127.0.0.1", 5302)), 1u);
+    EXPECT_FALSE(pool.find(Addr("127.0.0.1", 53)).has_value());
+    EXPECT_FALSE(pool.find(Addr("127.0.0.2", 5301)).has_value());
+}
+
+TEST(UpstreamPoolTest, SelectSkipsExcluded) {
+    auto pool = TwoUpstreams();
+
+    EXPECT_EQ(pool.select({0}), 1u);
+    EXPECT_EQ(pool.select({1}), 0u);
+    EXPECT_FALSE(pool.select({0, 1}).has_value());
+}
+
+TEST(UpstreamPoolTest, SelectSpreadsByOutstandingQueries) {
+    auto pool = TwoUpstreams();
+
+    pool.acquire(0);
+    for (int i = 0; i < 20; i++) {
+        EXPECT_EQ(pool.select({}), 1u);
+    }
+
+    pool.release(0);
+    pool.acquire(1);
+    pool.acquire(1);
+    EXPECT_EQ(pool.select({}), 0u);
+}
+
+TEST(UpstreamPoolTest, FailingUpstreamIsAvoidedUntilItAnswers) {
+    auto pool = TwoUpstreams();
+
+    for (int i = 0; i < UpstreamPool::FAILURE_THRESHOLD; i++) {
+        pool.recordFailure(0);
+    }
+    for (int i = 0; i < 20; i++) {
+        EXPECT_EQ(pool.select({}), 1u);
+    }
+    // Nothing healthy left, a down upstream beats no upstream
+    EXPECT_EQ(pool.select({1}), 0u);
+
+    pool.recordAnswer(0, std::chrono::milliseconds(5));
+    pool.acquire(1);
+    EXPECT_EQ(pool.select({}), 0u);
+}
+
+TEST(UpstreamPoolTest, HedgeDelayFollowsLatencyPercentile) {
+    auto pool = TwoUpstreams(90);
+
+    // Not enough samples yet
+    EXPECT_EQ(pool.hedgeDelay(0), std::chrono::milliseconds(100));
+
+    for (int ms = 1; ms <= 50; ms++) {
+        pool.recordAnswer(0, std::chrono::milliseconds(ms));
+    }
+    auto delay = pool.hedgeDelay(0);
+    ASSERT_TRUE(delay.has_value());
+    EXPECT_GE(delay.value(), std::chrono::milliseconds(44));
+    EXPECT_LE(delay.value(), std::chrono::milliseconds(46));
+}
+
+TEST(UpstreamPoolTest, NoHedgingWhenDisabledOrAlone) {
+    auto disabled = TwoUpstreams(0);
+    EXPECT_FALSE(disabled.hedgeDelay(0).has_value());
+
+    UpstreamPool alone({Addr("127.0.0.1", 5301)}, 90);
+    EXPECT_FALSE(alone.hedgeDelay(0).has_value());
+}
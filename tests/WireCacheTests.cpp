@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include "cache.hpp"
+#include "ResolverHarness.hpp"
+#include "utils/metrics.hpp"
+
+static std::shared_ptr<RecordList> Address(const std::string& name, uint32_t address, uint32_t ttl = 300) {
+    return std::make_shared<RecordList>(RecordList{std::make_shared<dnslib::ARecord>(name, ttl, address)});
+}
+
+TEST(WireCacheTest, StoredAnswersGoWithTheirEntry) {
+    TLRUCache cache(10);
+    cacheKey key{"www.example.com", dnslib::TYPE::A};
+    auto wire = std::make_shared<WireAnswer>(WireAnswer{{1, 2, 3}, {}});
+    auto expires = std::chrono::steady_clock::time_point::max();
+
+    cache.put(key, Address(key.name, 1), 300);
+    EXPECT_FALSE(cache.getWire(key, expires));
+    ASSERT_TRUE(cache.get(key, nullptr, Trust::ANSWER, &expires).has_value());
+
+    // Built from an entry since replaced: nothing is stored
+    cache.attachWire(key, expires - std::chrono::seconds(1), wire);
+    EXPECT_FALSE(cache.getWire(key, expires));
+
+    cache.attachWire(key, expires, wire);
+    auto found = std::chrono::steady_clock::time_point::max();
+    EXPECT_EQ(cache.getWire(key, found), wire);
+    EXPECT_EQ(found, expires);
+
+    // New data drops the message built from the old
+    cache.put(key, Address(key.name, 2), 300);
+    EXPECT_FALSE(cache.getWire(key, found));
+}
+
+class WireCacheResolverTest : public ResolverHarness {
+protected:
+    void SetUp() override {
+        start();
+    }
+
+    std::optional<dnslib::DNSPacket> askCached(uint16_t id, bool recursionDesired, const std::string& name) {
+        ask(id, name, dnslib::TYPE::A, recursionDesired);
+        dnslib::DNSMessageL message;
+        if (!out.popFor(message, std::chrono::milliseconds(1000))) return std::nullopt;
+        return dnslib::PacketParser::parse(message.data);
+    }
+};
+
+TEST_F(WireCacheResolverTest, RepeatedHitsReuseTheFirstAnswer) {
+    auto& wireHits = utils::Metrics::get().counter("cache.wire_hits");
+    uint64_t before = wireHits.load();
+    cache.put({"www.example.com", dnslib::TYPE::A}, Address("www.example.com", 0xC0000201), 300);
+
+    auto first = askCached(0x5001, true, "www.example.com");
+    ASSERT_TRUE(first.has_value());
+    EXPECT_EQ(wireHits.load(), before);
+    ASSERT_EQ(first->getAnswers().size(), 1u);
+    uint32_t firstTtl = first->getAnswers()[0]->getTtl();
+    EXPECT_GE(firstTtl, 299u);
+    EXPECT_LE(firstTtl, 300u);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+    // Same bytes but for the ID, the RD bit and the TTLs counted down
+    auto second = askCached(0x5002, false, "www.example.com");
+    ASSERT_TRUE(second.has_value());
+    EXPECT_EQ(wireHits.load(), before + 1);
+    EXPECT_EQ(second->getHeader().getId(), 0x5002);
+    EXPECT_FALSE(second->getHeader().recursionDesired());
+    ASSERT_EQ(second->getAnswers().size(), 1u);
+    auto a_rec = std::dynamic_pointer_cast<dnslib::ARecord>(second->getAnswers()[0]);
+    ASSERT_TRUE(a_rec);
+    EXPECT_EQ(a_rec->getIpAddress(), 0xC0000201u);
+    EXPECT_LT(a_rec->getTtl(), firstTtl);
+
+    auto third = askCached(0x5003, true, "www.example.com");
+    ASSERT_TRUE(third.has_value());
+    EXPECT_EQ(wireHits.load(), before + 2);
+    EXPECT_EQ(third->getHeader().getId(), 0x5003);
+    EXPECT_TRUE(third->getHeader().recursionDesired());
+}
@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+#include "ResolverHarness.hpp"
+#include "zoneguard.hpp"
+
+using Action = ZoneGuard::Action;
+using namespace std::chrono_literals;
+
+static ZoneGuard::RecordList Soa(const std::string& zone, uint32_t minimum = 300) {
+    return {std::make_shared<dnslib::SOARecord>(zone, 3600, "ns." + zone, "hostmaster." + zone, 1, 7200, 900, 1209600, minimum)};
+}
+
+// Resolves count random names under zone, all ending in NXDOMAIN
+static void Flood(ZoneGuard& guard, const std::string& zone, int count, ZoneGuard::Clock::time_point now) {
+    for (int i = 0; i < count; i++) {
+        auto decision = guard.admit("r" + std::to_string(i) + "." + zone, now);
+        ASSERT_EQ(decision.action, Action::ASK);
+        guard.finish(decision, dnslib::RCODE::NAMEERROR, Soa(zone), now);
+    }
+}
+
+TEST(ZoneGuardTest, UnknownZonesAreNotLimited) {
+    ZoneGuard guard(2, 0.8);
+    auto now = ZoneGuard::Clock::now();
+
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(guard.admit("www.example.com", now).action, Action::ASK);
+    }
+}
+
+TEST(ZoneGuardTest, CapsAZoneUnderAttack) {
+    ZoneGuard guard(2, 0.8);
+    auto now = ZoneGuard::Clock::now();
+
+    Flood(guard, "victim.example", 30, now);
+    EXPECT_TRUE(guard.underAttack("victim.example"));
+
+    auto first = guard.admit("x1.victim.example", now);
+    auto second = guard.admit("x2.victim.example", now);
+    EXPECT_EQ(first.action, Action::ASK);
+    EXPECT_EQ(second.action, Action::ASK);
+
+    auto third = guard.admit("x3.deeper.victim.example", now);
+    EXPECT_EQ(third.action, Action::REFUSE);
+    EXPECT_FALSE(third.zone.has_value());
+
+    // Other zones keep their capacity
+    EXPECT_EQ(guard.admit("www.other.example", now).action, Action::ASK);
+
+    // A slot frees up once an outstanding resolution ends
+    guard.finish(first, dnslib::RCODE::NAMEERROR, Soa("victim.example"), now);
+    EXPECT_EQ(guard.admit("x4.victim.example", now).action, Action::ASK);
+}
+
+TEST(ZoneGuardTest, OutagesAreNotAnAttack) {
+    ZoneGuard guard(1, 0.8);
+    auto now = ZoneGuard::Clock::now();
+
+    // Learn the zone with a few real NXDOMAINs among many answers
+    Flood(guard, "down.example", 2, now);
+    for (int i = 0; i < 8; i++) {
+        auto decision = guard.admit("host" + std::to_string(i) + ".down.example", now);
+        guard.finish(decision, dnslib::RCODE::NOERROR, {}, now);
+    }
+
+    // Then its servers stop answering, or fail
+    for (int i = 0; i < 40; i++) {
+        auto decision = guard.admit("host" + std::to_string(i) + ".down.example", now);
+        ASSERT_EQ(decision.action, Action::ASK);
+        if (i % 2 == 0) {
+            guard.finish(decision, std::nullopt, {}, now);
+        } else {
+            guard.finish(decision, dnslib::RCODE::SERVERFAILURE, {}, now);
+        }
+    }
+    EXPECT_FALSE(guard.underAttack("down.example"));
+    guard.admit("a.down.example", now);
+    EXPECT_EQ(guard.admit("b.down.example", now).action, Action::ASK);
+}
+
+TEST(ZoneGuardTest, MostlyPositiveZonesAreNotUnderAttack) {
+    ZoneGuard guard(1, 0.8);
+    auto now = ZoneGuard::Clock::now();
+
+    Flood(guard, "busy.example", 10, now);
+    for (int i = 0; i < 40; i++) {
+        auto decision = guard.admit("host" + std::to_string(i) + ".busy.example", now);
+        guard.finish(decision, dnslib::RCODE::NOERROR, {}, now);
+    }
+    EXPECT_FALSE(guard.underAttack("busy.example"));
+}
+
+TEST(ZoneGuardTest, AttackEndsAsCountsDecay) {
+    ZoneGuard guard(1, 0.8);
+    auto now = ZoneGuard::Clock::now();
+
+    Flood(guard, "victim.example", 30, now);
+    guard.admit("a.victim.example", now);
+    EXPECT_EQ(guard.admit("b.victim.example", now).action, Action::REFUSE);
+
+    EXPECT_EQ(guard.admit("c.victim.example", now + 60s).action, Action::ASK);
+    EXPECT_FALSE(guard.underAttack("victim.example"));
+}
+
+// A forwarder for a zone flooded with random names, one resolution at a time
+class ZoneGuardResolverTest : public ResolverHarness {
+protected:
+    const sockaddr_in upstream = Addr("127.0.0.1", 5301);
+    bool answering = true;
+
+    void SetUp() override {
+        config.forwarders = {upstream};
+        config.hedgePercentile = 0;
+        config.healthInterval = 3600;
+        config.zoneGuardCap = 1;
+        cache.setStaleWindow(std::chrono::seconds(3600));
+        start();
+    }
+
+    // Every name is denied by victim.example
+    void serve(const dnslib::DNSMessageL& query) override {
+        if (!answering) return;
+        auto question = questionOf(query);
+        dnslib::PacketBuilder builder;
+        builder.setId(dnslib::PacketParser::parse(query.data).getHeader().getId());
+        builder.withFlags(dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::RECURSION_DES | dnslib::PacketFlag::RECURSION_AVAIL);
+        builder.withRcode(dnslib::RCODE::NAMEERROR);
+        builder.addQuestion(question.getName(), question.getType());
+        builder.addAuthority(Soa("victim.example")[0]);
+        reply(query, builder);
+    }
+
+    dnslib::DNSPacket response() {
+        auto message = next();
+        EXPECT_FALSE(isQuery(message));
+        return dnslib::PacketParser::parse(message.data);
+    }
+};
+
+TEST_F(ZoneGuardResolverTest, CappedNamesAreOnlyDeniedWithProof) {
+    for (int i = 0; i < 25; i++) {
+        ask(0x3801, "r" + std::to_string(i) + ".victim.example");
+        std::vector<dnslib::DNSMessageL> queries;
+        ASSERT_EQ(run(1, queries).size(), 1u);
+        ASSERT_EQ(queries.size(), 1u);
+    }
+
+    // The only slot is taken by a resolution left unanswered
+    answering = false;
+    ask(0x3802, "held.victim.example");
+    ASSERT_TRUE(isQuery(next()));
+
+    // Below a cached NXDOMAIN: denied without asking
+    ask(0x3803, "x.r0.victim.example");
+    auto denied = response();
+    EXPECT_EQ(denied.getHeader().rcode(), dnslib::RCODE::NAMEERROR);
+    ASSERT_EQ(denied.getAuthority().size(), 1u);
+    EXPECT_EQ(denied.getAuthority()[0]->getName(), "victim.example");
+
+    // A name that existed is served stale rather than denied
+    auto records = std::make_shared<RecordList>(RecordList{std::make_shared<dnslib::ARecord>("www.victim.example", 300, "192.0.2.1")});
+    cache.put({"www.victim.example", dnslib::TYPE::A}, records, 0);
+    ask(0x3804, "www.victim.example");
+    auto stale = response();
+    EXPECT_EQ(stale.getHeader().rcode(), dnslib::RCODE::NOERROR);
+    EXPECT_EQ(stale.getAnswers().size(), 1u);
+
+    // Without proof nor stale data it fails
+    ask(0x3805, "new.victim.example");
+    EXPECT_EQ(response().getHeader().rcode(), dnslib::RCODE::SERVERFAILURE);
+}
+
+// Iterative resolution, the root refers each .com zone to a server of its own
+class ZoneGuardBailiwickTest : public ResolverHarness {
+protected:
+    const uint32_t exampleServer = 0xC0000235;  // 192.0.2.53
+    const uint32_t otherServer = 0xC0000236;    // 192.0.2.54
+
+    void SetUp() override {
+        config.zoneGuardCap = 1;
+        start();
+    }
+
+    // example.com denies every name, with the SOA of com it has no say over
+    void serve(const dnslib::DNSMessageL& query) override {
+        auto packet = dnslib::PacketParser::parse(query.data);
+        auto question = packet.getQuestions()[0];
+
+        dnslib::PacketBuilder builder;
+        builder.setId(packet.getHeader().getId());
+        builder.withFlags(dnslib::PacketFlag::RESPONSE);
+        builder.addQuestion(question.getName(), question.getType());
+        if (serverOf(query) == root) {
+            std::string zone = question.getName().ends_with("example.com") ? "example.com" : "other.com";
+            builder.addAuthority(std::make_shared<dnslib::NSRecord>(zone, 3600, "ns." + zone));
+            builder.addAdditional(std::make_shared<dnslib::ARecord>("ns." + zone, 3600, zone == "example.com" ? exampleServer : otherServer));
+        } else if (serverOf(query) == exampleServer) {
+            builder.withFlags(dnslib::PacketFlag::RESPONSE | dnslib::PacketFlag::AUTHORITATIVE);
+            builder.withRcode(dnslib::RCODE::NAMEERROR);
+            builder.addAuthority(Soa("com")[0]);
+        }
+        reply(query, builder);
+    }
+};
+
+TEST_F(ZoneGuardBailiwickTest, SoaFromOutsideTheZoneIsNotLearnt) {
+    for (int i = 0; i < 25; i++) {
+        ask(0x3811, "r" + std::to_string(i) + ".example.com");
+        std::vector<dnslib::DNSMessageL> queries;
+        auto responses = run(1, queries);
+        ASSERT_EQ(responses.size(), 1u);
+        EXPECT_EQ(responses[0].getHeader().rcode(), dnslib::RCODE::NAMEERROR);
+    }
+
+    // com is not tracked: with the other.com server silent, a second name under it still goes upstream
+    ask(0x3812, "www.other.com");
+    dnslib::DNSMessageL message;
+    while (out.popFor(message, std::chrono::milliseconds(200))) {
+        ASSERT_TRUE(isQuery(message));
+        if (serverOf(message) == root) serve(message);
+    }
+    ask(0x3813, "mail.other.com");
+    EXPECT_TRUE(isQuery(next()));
+}
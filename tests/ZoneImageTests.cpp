@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include "zoneimage.hpp"
+
+static const char* ZONE = R"($ORIGIN corp.example.
+$TTL 3600
+@       IN SOA ns1 hostmaster ( 2026101901 7200 900 1209600 300 )
+        IN NS  ns1
+        IN NS  ns2.corp.example.
+        IN MX  10 mail
+ns1     IN A   10.0.0.1
+ns2     IN A   10.0.0.2
+mail    IN A   10.0.0.25
+www     IN CNAME web.int
+web.int IN A   10.0.1.80
+        IN A   10.0.1.81
+        IN TXT "v=spf1 -all" "second string"
+lab     IN NS  ns.lab
+ns.lab  IN A   10.0.9.1
+)";
+
+class ZoneImageTest : public ::testing::Test {
+protected:
+    std::string zonePath = testing::TempDir() + "corp.zone";
+    std::string imagePath = testing::TempDir() + "zones.img";
+
+    void compile(const std::string& content) {
+        std::ofstream(zonePath) << content;
+        compileZones({zonePath}, imagePath);
+    }
+
+    dnslib::DNSPacket ask(const ZoneImage& image, const std::string& name, dnslib::TYPE type) {
+        std::vector<uint8_t> response;
+        EXPECT_TRUE(image.answer(name, type, 0x4242, true, response));
+        return dnslib::PacketParser::parse(response);
+    }
+
+    void TearDown() override {
+        std::remove(zonePath.c_str());
+        std::remove(imagePath.c_str());
+    }
+};
+
+TEST_F(ZoneImageTest, AnswersAuthoritativelyWithAdditionalAddresses) {
+    compile(ZONE);
+    auto image = ZoneImage::open(imagePath);
+    EXPECT_EQ(image->zoneCount(), 1u);
+
+    auto packet = ask(*image, "Corp.Example", static_cast<dnslib::TYPE>(15));
+    EXPECT_EQ(packet.getHeader().getId(), 0x4242);
+    EXPECT_TRUE(packet.getHeader().authAns());
+    EXPECT_EQ(packet.getHeader().rcode(), dnslib::RCODE::NOERROR);
+    ASSERT_EQ(packet.getAnswers().size(), 1u);
+    ASSERT_EQ(packet.getAdditional().size(), 1u);
+    EXPECT_EQ(packet.getAdditional()[0]->getName(), "mail.corp.example");
+}
+
+TEST_F(ZoneImageTest, FollowsCnameInsideTheImage) {
+    compile(ZONE);
+    auto packet = ask(*ZoneImage::open(imagePath), "www.corp.example", dnslib::TYPE::A);
+
+    ASSERT_EQ(packet.getAnswers().size(), 3u);
+    EXPECT_EQ(packet.getAnswers()[0]->getType(), static_cast<uint16_t>(dnslib::TYPE::CNAME));
+    EXPECT_EQ(packet.getAnswers()[1]->getName(), "web.int.corp.example");
+}
+
+TEST_F(ZoneImageTest, NegativeAnswersCarryTheSoaWithMinimumTtl) {
+    compile(ZONE);
+    auto image = ZoneImage::open(imagePath);
+
+    auto nxdomain = ask(*image, "missing.corp.example", dnslib::TYPE::A);
+    EXPECT_EQ(nxdomain.getHeader().rcode(), dnslib::RCODE::NAMEERROR);
+    ASSERT_EQ(nxdomain.getAuthority().size(), 1u);
+    EXPECT_EQ(nxdomain.getAuthority()[0]->getTtl(), 300u);
+
+    auto nodata = ask(*image, "mail.corp.example", dnslib::TYPE::MX);
+    EXPECT_EQ(nodata.getHeader().rcode(), dnslib::RCODE::NOERROR);
+    EXPECT_TRUE(nodata.getAnswers().empty());
+    EXPECT_EQ(nodata.getAuthority().size(), 1u);
+
+    // Empty non-terminal: int.corp.example only exists because of web.int
+    auto empty = ask(*image, "int.corp.example", dnslib::TYPE::A);
+    EXPECT_EQ(empty.getHeader().rcode(), dnslib::RCODE::NOERROR);
+}
+
+TEST_F(ZoneImageTest, DelegationIsAReferralWithGlue) {
+    compile(ZONE);
+    auto packet = ask(*ZoneImage::open(imagePath), "host.lab.corp.example", dnslib::TYPE::A);
+
+    EXPECT_FALSE(packet.getHeader().authAns());
+    EXPECT_TRUE(packet.getAnswers().empty());
+    ASSERT_EQ(packet.getAuthority().size(), 1u);
+    EXPECT_EQ(packet.getAuthority()[0]->getName(), "lab.corp.example");
+    ASSERT_EQ(packet.getAdditional().size(), 1u);
+}
+
+TEST_F(ZoneImageTest, NamesOutsideTheZonesAreLeftToTheResolver) {
+    compile(ZONE);
+    auto image = ZoneImage::open(imagePath);
+
+    std::vector<uint8_t> response;
+    EXPECT_FALSE(image->answer("www.example", dnslib::TYPE::A, 1, true, response));
+    EXPECT_FALSE(image->answer("corp.example.org", dnslib::TYPE::A, 1, true, response));
+}
+
+TEST_F(ZoneImageTest, RejectsInvalidZones) {
+    EXPECT_THROW(compile("www.corp.example. 60 IN A 10.0.0.1\n"), std::runtime_error);
+    EXPECT_THROW(compile(std::string(ZONE) + "www.other.example. IN A 10.0.0.1\n"), std::runtime_error);
+    EXPECT_THROW(compile(std::string(ZONE) + "web.int IN CNAME www\n"), std::runtime_error);
+    EXPECT_THROW(compile(std::string(ZONE) + "* IN A 10.0.0.1\n"), std::runtime_error);
+    EXPECT_THROW(compile(std::string(ZONE) + "x IN HINFO cpu os\n"), std::runtime_error);
+    EXPECT_NO_THROW(compile(std::string(ZONE) + "x IN TYPE65280 \\# 2 beef\n"));
+}
+
+TEST_F(ZoneImageTest, RejectsFilesThatAreNotImages) {
+    std::ofstream(imagePath) << std::string(200, 'x');
+    EXPECT_THROW(ZoneImage::open(imagePath), std::runtime_error);
+    EXPECT_THROW(ZoneImage::open(imagePath + ".missing"), std::runtime_error);
+}
@@ -0,0 +1,25 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "zoneimage.hpp"
+
+// Compiles master files into the image loaded by dns-server --zones
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " OUTPUT ZONEFILE...\n"
+                  << "  every zone file holds one zone and starts with its SOA\n";
+        return 1;
+    }
+
+    std::vector<std::string> files(argv + 2, argv + argc);
+    try {
+        auto stats = compileZones(files, argv[1]);
+        std::cout << argv[1] << ": " << stats.zones << " zones, " << stats.names << " names, "
+                  << stats.rrsets << " RRsets, " << stats.records << " records, " << stats.bytes << " bytes\n";
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}